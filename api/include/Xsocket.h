@@ -95,6 +95,25 @@ typedef struct {
 	int status; // 1: ready to be read, 0: waiting for chunk response, -1: failed
 } ChunkStatus;
 
+/* What XfetchChunks() and friends report for each chunk */
+typedef struct {
+	unsigned index;	// position of the chunk in the list
+	int size;		// bytes in the chunk, -1 if it failed
+	int status;		// READY_TO_READ, or why the chunk failed
+} XfetchEvent;
+
+typedef void (*XfetchCallback)(void *arg, unsigned index, const char *data, int size, int status);
+
+/* Options for XfetchChunks() and friends; zero fields take the defaults */
+typedef struct {
+	unsigned window;	// chunks requested at once to begin with
+	unsigned maxWindow;	// most chunks requested at once
+	unsigned timeout;	// msec to wait for a chunk
+	XfetchCallback callback;	// called for each chunk, in order
+	void *arg;			// passed to callback
+	int notifyFd;		// if positive, an XfetchEvent is written here per chunk
+} XfetchOptions;
+
 
 // XIA specific addrinfo flags
 #define XAI_DAGHOST	AI_NUMERICHOST	// if set, name is a dag instead of a generic name string
@@ -148,6 +167,9 @@ extern int XrequestChunks(int sockfd, const ChunkStatus *chunks, int numChunks);
 extern int XgetChunkStatus(int sockfd, char* dag, size_t dagLen);
 extern int XgetChunkStatuses(int sockfd, ChunkStatus *statusList, int numCids);
 extern int XreadChunk(int sockfd, void *rbuf, size_t len, int flags, char *cid, size_t cidLen);
+extern int XfetchChunks(int sockfd, ChunkStatus *chunks, unsigned numChunks, const XfetchOptions *opts);
+extern int XfetchBuffer(int sockfd, ChunkStatus *chunks, unsigned numChunks, char *buf, size_t len, const XfetchOptions *opts);
+extern int XfetchFile(int sockfd, ChunkStatus *chunks, unsigned numChunks, const char *fname, const XfetchOptions *opts);
 extern int XpushChunkto(const ChunkContext* ctx, const char* buf, size_t len, int flags, const struct sockaddr *addr, socklen_t addrlen, ChunkInfo* info);
 extern int XpushBufferto(const ChunkContext *ctx, const char *data, size_t len, int flags, const struct sockaddr *addr, socklen_t addrlen, ChunkInfo **info, unsigned chunkSize);
 extern int XpushFileto(const ChunkContext *ctx, const char *fname, int flags, const struct sockaddr *addr, socklen_t addrlen, ChunkInfo **info, unsigned chunkSize);
@@ -45,6 +45,9 @@ XrequestChunk() and XrequestChunks() bring one or more chunks of content from
 the network to the local machine. XgetChunkStatus() and XgetChunkStatuses()
 check to see if the requested content is available to be read. XreadChunk()
 is then used to get the content into the application. 
+XfetchChunks(), XfetchBuffer() and XfetchFile() do all three for a list of
+chunks, keeping a window of requests outstanding and delivering the chunks
+in order as they arrive.
 
 Xclose() is used to close a socket.
 
@@ -87,6 +90,8 @@ the network to the local machine
 - XgetChunkStatus(), XgetChunkStatuses() get the rediness status of one or more
 chunks of content
 - XreadChunk() load a single chunk into memory
+- XfetchChunks(), XfetchBuffer(), XfetchFile() bring a list of chunks to the
+application in order, with a window of requests outstanding
 
 
 @todo add description of DAGs (who can provide?)
@@ -0,0 +1,304 @@
+/*
+** Copyright 2011 Carnegie Mellon University
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*/
+/*!
+** @file XfetchChunks.c
+** @brief implements XfetchChunks(), XfetchBuffer(), and XfetchFile()
+*/
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "Xsocket.h"
+#include "Xinit.h"
+#include "Xutil.h"
+
+#define FETCH_WINDOW		8		// chunks requested at once to begin with
+#define FETCH_MAX_WINDOW	256		// most chunks requested at once
+#define FETCH_TIMEOUT		30000	// msec to wait for a chunk
+#define FETCH_MIN_POLL		1		// msec between status checks, at first
+#define FETCH_MAX_POLL		64		// and at most
+
+static unsigned long long now_ms()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (unsigned long long)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/*
+** Hand chunk @a index to the application's callback and notification fd.
+*/
+static void fetch_notify(const XfetchOptions *opts, unsigned index, const char *data, int size, int status)
+{
+	if (!opts)
+		return;
+
+	if (opts->callback)
+		opts->callback(opts->arg, index, data, size, status);
+
+	if (opts->notifyFd > 0) {
+		XfetchEvent ev;
+		ev.index = index;
+		ev.size = size;
+		ev.status = status;
+		if (write(opts->notifyFd, &ev, sizeof(ev)) != sizeof(ev))
+			LOGF("unable to post the event for chunk %u: %s", index, strerror(errno));
+	}
+}
+
+/*
+** The fetch engine.  Chunks are requested in order, keeping a window of them
+** outstanding, and delivered in order as soon as the first outstanding one
+** is ready: read into @a buf if there is one, and written to @a fp if there
+** is one.
+**
+** The window starts at opts->window chunks.  Each time a window's worth of
+** chunks has been delivered, the engine compares the rate it delivered them
+** at with the rate of the window before: a faster rate grows the window by
+** half, a rate more than 10% slower shrinks it by a quarter.
+*/
+static int fetch(int sockfd, ChunkStatus *chunks, unsigned numChunks, const XfetchOptions *opts,
+	char *buf, size_t len, FILE *fp)
+{
+	unsigned window = FETCH_WINDOW;
+	unsigned maxWindow = FETCH_MAX_WINDOW;
+	unsigned timeout = FETCH_TIMEOUT;
+	unsigned head = 0;		// next chunk to deliver
+	unsigned next = 0;		// next chunk to request
+	unsigned poll = FETCH_MIN_POLL;
+	unsigned long long *requested;	// when each outstanding chunk was requested
+	unsigned long long epochStart;
+	unsigned epochDone = 0;
+	double lastRate = 0;
+	size_t offset = 0;
+	char *scratch = NULL;
+	int rc = 0;
+
+	if (validateSocket(sockfd, XSOCK_CHUNK, EAFNOSUPPORT) < 0) {
+		LOGF("Socket %d must be a chunk socket", sockfd);
+		return -1;
+	}
+
+	if (numChunks == 0)
+		return 0;
+
+	if (!chunks) {
+		LOG("null pointer error!");
+		errno = EFAULT;
+		return -1;
+	}
+
+	if (opts) {
+		if (opts->maxWindow)
+			maxWindow = MIN(opts->maxWindow, FETCH_MAX_WINDOW);
+		if (opts->window)
+			window = opts->window;
+		if (opts->timeout)
+			timeout = opts->timeout;
+	}
+	window = MAX(1, MIN(window, maxWindow));
+
+	if (!(requested = (unsigned long long *)malloc(maxWindow * sizeof(unsigned long long))))
+		return -1;
+	if (!buf && !(scratch = (char *)malloc(XIA_MAXCHUNK))) {
+		free(requested);
+		return -1;
+	}
+
+	for (unsigned i = 0; i < numChunks; i++)
+		chunks[i].status = 0;
+
+	epochStart = now_ms();
+	while (head < numChunks) {
+
+		// keep the window full
+		if (next < numChunks && next - head < window) {
+			unsigned n = MIN(numChunks - next, window - (next - head));
+			if (XrequestChunks(sockfd, &chunks[next], n) < 0) {
+				rc = -1;
+				break;
+			}
+			unsigned long long t = now_ms();
+			for (unsigned i = next; i < next + n; i++) {
+				requested[i % maxWindow] = t;
+				chunks[i].status = WAITING_FOR_CHUNK;
+			}
+			next += n;
+		}
+
+		if (XgetChunkStatuses(sockfd, &chunks[head], next - head) < 0) {
+			rc = -1;
+			break;
+		}
+
+		// deliver the chunks that are ready, in order
+		unsigned delivered = 0;
+		while (head < next && chunks[head].status != WAITING_FOR_CHUNK) {
+			int status = chunks[head].status;
+			if (status != READY_TO_READ) {
+				LOGF("chunk %u (%s) failed with status %d", head, chunks[head].cid, status);
+				fetch_notify(opts, head, NULL, -1, status);
+				errno = EIO;
+				rc = -1;
+				break;
+			}
+
+			char *dst = buf ? buf + offset : scratch;
+			size_t room = buf ? len - offset : XIA_MAXCHUNK;
+			int size = XreadChunk(sockfd, dst, room, 0, chunks[head].cid, chunks[head].cidLen);
+			if (size < 0) {
+				rc = -1;
+				break;
+			}
+			if (fp && fwrite(dst, 1, size, fp) != (size_t)size) {
+				rc = -1;
+				break;
+			}
+			offset += size;
+			fetch_notify(opts, head, dst, size, READY_TO_READ);
+			head++;
+			delivered++;
+		}
+		if (rc < 0 || head == numChunks)
+			break;
+
+		unsigned long long t = now_ms();
+		if (delivered) {
+			poll = FETCH_MIN_POLL;
+			epochDone += delivered;
+			if (epochDone >= window && t > epochStart) {
+				double rate = (double)epochDone / (t - epochStart);
+				if (rate > lastRate)
+					window = MIN(maxWindow, window + window / 2 + 1);
+				else if (rate < lastRate * 0.9)
+					window = MAX(1, window - window / 4);
+				lastRate = rate;
+				epochStart = t;
+				epochDone = 0;
+			}
+
+		} else if (t - requested[head % maxWindow] > timeout) {
+			LOGF("timed out waiting for chunk %u (%s)", head, chunks[head].cid);
+			chunks[head].status = REQUEST_FAILED;
+			fetch_notify(opts, head, NULL, -1, REQUEST_FAILED);
+			errno = ETIMEDOUT;
+			rc = -1;
+			break;
+
+		} else {
+			// nothing yet, check less and less often
+			usleep(poll * 1000);
+			poll = MIN(poll * 2, FETCH_MAX_POLL);
+		}
+	}
+
+	free(requested);
+	free(scratch);
+	return rc < 0 ? -1 : (int)head;
+}
+
+/*!
+** @brief Fetch a list of content chunks, handing each to the application in
+** order as it arrives.
+**
+** XfetchChunks() requests the chunks in @a chunks, keeping a window of
+** requests outstanding, and reads each chunk as soon as it and every chunk
+** before it are ready. It replaces the XrequestChunks(), XgetChunkStatuses(),
+** XreadChunk() loop that applications would otherwise write. The window
+** adapts to the rate at which chunks complete, between 1 and
+** opts->maxWindow chunks.
+**
+** Each chunk is passed to opts->callback, if set, and an XfetchEvent
+** describing it is written to opts->notifyFd, if positive. The chunk data
+** handed to the callback is only valid until it returns.
+**
+** @param sockfd the control socket (must be of type XSOCK_CHUNK)
+** @param chunks the chunk manifest, as full content DAGs. On return, the
+** status of each chunk is set as XgetChunkStatuses() would.
+** @param numChunks number of chunks in the list
+** @param opts how to fetch and where to report chunks, or NULL for the
+** defaults: a window of 8 chunks growing up to 256, and a 30 second timeout
+** per chunk.
+**
+** @returns the number of chunks fetched, which is numChunks, on success
+** @returns -1 on error with errno set: EIO if a chunk failed or had an
+** invalid hash, ETIMEDOUT if a chunk did not arrive in time. Chunks before
+** the failed one have been delivered.
+*/
+int XfetchChunks(int sockfd, ChunkStatus *chunks, unsigned numChunks, const XfetchOptions *opts)
+{
+	return fetch(sockfd, chunks, numChunks, opts, NULL, 0, NULL);
+}
+
+/*!
+** @brief Fetch a list of content chunks into a buffer.
+**
+** XfetchBuffer() works as XfetchChunks() does, but reads the chunks, one
+** after the other, straight into @a buf.
+**
+** @param sockfd the control socket (must be of type XSOCK_CHUNK)
+** @param chunks the chunk manifest, as full content DAGs
+** @param numChunks number of chunks in the list
+** @param buf buffer to receive the content
+** @param len length of buf; if the content is larger, XfetchBuffer() fails
+** @param opts how to fetch and where to report chunks, or NULL
+**
+** @returns the number of chunks fetched on success
+** @returns -1 on error with errno set
+*/
+int XfetchBuffer(int sockfd, ChunkStatus *chunks, unsigned numChunks, char *buf, size_t len, const XfetchOptions *opts)
+{
+	if (!buf) {
+		errno = EFAULT;
+		return -1;
+	}
+	return fetch(sockfd, chunks, numChunks, opts, buf, len, NULL);
+}
+
+/*!
+** @brief Fetch a list of content chunks into a file.
+**
+** XfetchFile() works as XfetchChunks() does, and writes the chunks in order
+** to the file @a fname, which it creates or truncates.
+**
+** @param sockfd the control socket (must be of type XSOCK_CHUNK)
+** @param chunks the chunk manifest, as full content DAGs
+** @param numChunks number of chunks in the list
+** @param fname the file to write
+** @param opts how to fetch and where to report chunks, or NULL
+**
+** @returns the number of chunks fetched on success
+** @returns -1 on error with errno set
+*/
+int XfetchFile(int sockfd, ChunkStatus *chunks, unsigned numChunks, const char *fname, const XfetchOptions *opts)
+{
+	FILE *fp;
+	int rc;
+
+	if (!fname) {
+		errno = EFAULT;
+		return -1;
+	}
+
+	if (!(fp = fopen(fname, "wb")))
+		return -1;
+
+	rc = fetch(sockfd, chunks, numChunks, opts, NULL, 0, fp);
+
+	if (fclose(fp) != 0 && rc >= 0)
+		rc = -1;
+	return rc;
+}
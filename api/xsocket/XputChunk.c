@@ -23,8 +23,50 @@
 #include "Xinit.h"
 #include "Xutil.h"
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <errno.h>
 
+// XputFile() and XputBuffer() put their chunks in batches, several batches
+// at a time, so filling a batch here overlaps with hashing and caching the
+// previous one in click.  Batches go through a shared memory window when
+// click can read it, and inside the messages otherwise.
+#define PUT_WINDOW			2		// messages awaiting a reply
+#define PUT_BATCH_CHUNKS	256		// most chunks in a batch
+#define PUT_BATCH_BYTES		(1024 * 1024)	// most bytes in a batch
+#define PUT_INLINE_BYTES	60000	// most chunk bytes inside one message
+
+typedef struct {
+	unsigned first;				// index of the batch's first chunk
+	unsigned count;
+	char *data;					// chunk i is at data + i * chunkSize
+	unsigned length[PUT_BATCH_CHUNKS];
+	unsigned lastMsg;			// last message sent for the batch
+} PutBatch;
+
+typedef struct {
+	unsigned first;
+	unsigned count;
+} PutMsg;
+
+typedef struct {
+	const ChunkContext *ctx;
+	ChunkInfo *info;
+	unsigned chunkSize;
+	unsigned batchChunks;		// chunks per batch
+	char shmName[64];
+	char *window;				// PUT_WINDOW batches of batchChunks chunks
+	size_t windowSize;
+	int mapped;					// the window is shared memory
+	int shared;					// click reads the window in place
+	int probed;					// click has read the window once
+	unsigned batches;			// batches started
+	unsigned sent;				// messages sent
+	unsigned acked;				// messages answered
+	PutBatch batch[PUT_WINDOW];
+	PutMsg msg[PUT_WINDOW];
+} Putter;
+
 /*!
 ** @brief Allocate content cache space for use by the XputChunk(), 
 ** XputFile(), and XputBuffer() functions.
@@ -99,6 +141,215 @@ int XfreeCacheSlice(ChunkContext *ctx)
 	return rc;
 }
 
+/*
+** Set up putter @a put for chunks of up to @a chunkSize bytes, whose
+** results go to @a info.  The window is shared with click when possible.
+*/
+static int put_open(Putter *put, const ChunkContext *ctx, unsigned chunkSize, ChunkInfo *info)
+{
+	static unsigned instance = 0;
+	int fd;
+
+	memset(put, 0, sizeof(Putter));
+	put->ctx = ctx;
+	put->info = info;
+	put->chunkSize = chunkSize;
+	put->batchChunks = MIN(PUT_BATCH_CHUNKS, MAX(1, PUT_BATCH_BYTES / chunkSize));
+	put->windowSize = (size_t)PUT_WINDOW * put->batchChunks * chunkSize;
+
+	snprintf(put->shmName, sizeof(put->shmName), "/xia-put-%d-%d-%u",
+		getpid(), ctx->sockfd, __sync_fetch_and_add(&instance, 1));
+	if ((fd = shm_open(put->shmName, O_RDWR | O_CREAT | O_EXCL, 0644)) >= 0) {
+		if (ftruncate(fd, put->windowSize) == 0) {
+			put->window = (char *)mmap(NULL, put->windowSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (put->window == MAP_FAILED)
+				put->window = NULL;
+		}
+		close(fd);
+		if (put->window)
+			put->mapped = put->shared = 1;
+		else
+			shm_unlink(put->shmName);
+	}
+
+	if (!put->window && !(put->window = (char *)malloc(put->windowSize)))
+		return -1;
+	for (int i = 0; i < PUT_WINDOW; i++)
+		put->batch[i].data = put->window + (size_t)i * put->batchChunks * chunkSize;
+	return 0;
+}
+
+/*
+** Wait for the reply to the oldest message, and record the CIDs it carries.
+** Once a reply has been read the message counts as answered, even if the
+** reply reports an error.
+*/
+static int put_ack(Putter *put)
+{
+	char buffer[MAXBUFLEN];
+	int rc;
+
+	if ((rc = click_reply(put->ctx->sockfd, buffer, sizeof(buffer))) < 0) {
+		LOGF("Error getting status from Click: %s", strerror(errno));
+		return -1;
+	}
+
+	xia::XSocketMsg _socketMsgReply;
+	std::string bufStr(buffer, rc);
+	_socketMsgReply.ParseFromString(bufStr);
+
+	xia::X_Putchunks_Msg *_msgReply = _socketMsgReply.mutable_x_putchunks();
+	PutMsg *m = &put->msg[put->acked % PUT_WINDOW];
+	unsigned batch = put->acked++;
+	if (_socketMsgReply.type() != xia::XPUTCHUNKS || _msgReply->batch() != batch) {
+		errno = EPROTO;
+		return -1;
+	}
+	if (_msgReply->status() != 0) {
+		errno = _msgReply->status();
+		return -1;
+	}
+	if ((unsigned)_msgReply->cid_size() != m->count) {
+		errno = EPROTO;
+		return -1;
+	}
+
+	for (unsigned i = 0; i < m->count; i++) {
+		ChunkInfo *info = &put->info[m->first + i];
+		strncpy(info->cid, _msgReply->cid(i).c_str(), CID_HASH_SIZE);
+		info->cid[CID_HASH_SIZE] = 0;
+		info->ttl = put->ctx->ttl;
+		info->timestamp.tv_sec = _msgReply->timestamp();
+		info->timestamp.tv_usec = 0;
+	}
+	return 0;
+}
+
+/*
+** Send chunks @a first to @a first + @a count of batch @a b in one message,
+** inside it unless @a shared.  At most PUT_WINDOW messages await replies.
+*/
+static int put_msg(Putter *put, PutBatch *b, unsigned first, unsigned count, int shared)
+{
+	while (put->sent - put->acked >= PUT_WINDOW)
+		if (put_ack(put) < 0)
+			return -1;
+
+	xia::XSocketMsg xsm;
+	xsm.set_type(xia::XPUTCHUNKS);
+	xia::X_Putchunks_Msg *_msg = xsm.mutable_x_putchunks();
+
+	_msg->set_contextid(put->ctx->contextID);
+	_msg->set_ttl(put->ctx->ttl);
+	_msg->set_cachesize(put->ctx->cacheSize);
+	_msg->set_cachepolicy(put->ctx->cachePolicy);
+	_msg->set_batch(put->sent);
+	if (shared)
+		_msg->set_shm(put->shmName);
+
+	for (unsigned i = first; i < first + count; i++) {
+		const char *data = b->data + (size_t)i * put->chunkSize;
+		if (shared) {
+			_msg->add_offset(data - put->window);
+			_msg->add_length(b->length[i]);
+		} else
+			_msg->add_payload(data, b->length[i]);
+	}
+
+	if (click_send(put->ctx->sockfd, &xsm) < 0) {
+		LOGF("Error talking to Click: %s", strerror(errno));
+		return -1;
+	}
+
+	PutMsg *m = &put->msg[put->sent % PUT_WINDOW];
+	m->first = b->first + first;
+	m->count = count;
+	b->lastMsg = put->sent++;
+	return 0;
+}
+
+/*
+** Send batch @a b, in as many messages as its chunks need if they can't go
+** through the window.  The first shared batch is confirmed before going on,
+** so a click that can't read the window gets the batch inside messages.
+*/
+static int put_send(Putter *put, PutBatch *b)
+{
+	if (put->shared) {
+		if (put_msg(put, b, 0, b->count, 1) < 0)
+			return -1;
+		if (put->probed)
+			return 0;
+		if (put_ack(put) == 0) {
+			put->probed = 1;
+			return 0;
+		}
+		LOGF("Click can't read chunks in %s (%s), sending them inline", put->shmName, strerror(errno));
+		put->shared = 0;
+	}
+
+	for (unsigned i = 0; i < b->count; ) {
+		unsigned n = 0;
+		size_t bytes = 0;
+		while (i + n < b->count && (n == 0 || bytes + b->length[i + n] <= PUT_INLINE_BYTES))
+			bytes += b->length[i + n++];
+		if (put_msg(put, b, i, n, 0) < 0)
+			return -1;
+		i += n;
+	}
+	return 0;
+}
+
+/*
+** Return an empty batch to fill, once click is done with whatever the batch
+** held before.
+*/
+static PutBatch *put_next(Putter *put, unsigned first)
+{
+	PutBatch *b = &put->batch[put->batches % PUT_WINDOW];
+
+	if (put->batches >= PUT_WINDOW)
+		while (put->acked <= b->lastMsg)
+			if (put_ack(put) < 0)
+				return NULL;
+	put->batches++;
+	b->first = first;
+	b->count = 0;
+	return b;
+}
+
+/*
+** Wait for the outstanding replies and release the window.  Replies are
+** read even after an error, so none is left on the socket for the next put
+** on this context; the first error is the one returned.
+*/
+static int put_close(Putter *put, int rc)
+{
+	int err = errno;
+
+	while (put->acked < put->sent) {
+		unsigned acked = put->acked;
+		if (put_ack(put) < 0) {
+			if (rc == 0) {
+				rc = -1;
+				err = errno;
+			}
+			// nothing more will come from a socket that failed
+			if (put->acked == acked)
+				break;
+		}
+	}
+
+	if (put->mapped) {
+		munmap(put->window, put->windowSize);
+		shm_unlink(put->shmName);
+	} else
+		free(put->window);
+	if (rc < 0)
+		errno = err;
+	return rc;
+}
+
 /*!
 ** @brief Publish a single chunk of content.
 **
@@ -170,7 +421,7 @@ int XputChunk(const ChunkContext *ctx, const char *data, unsigned length, ChunkI
     _socketMsgReply.ParseFromString(bufStr);
     if(_socketMsgReply.type() == xia::XPUTCHUNK) {
 		xia::X_Putchunk_Msg *_msgReply = _socketMsgReply.mutable_x_putchunk();
-		info->size = _msgReply->payload().size();
+		info->size = _msgReply->has_length() ? _msgReply->length() : _msgReply->payload().size();
 		strcpy(info->cid, _msgReply->cid().c_str());
 		info->ttl= _msgReply->ttl();
 		info->timestamp.tv_sec=_msgReply->timestamp();
@@ -185,8 +436,10 @@ int XputChunk(const ChunkContext *ctx, const char *data, unsigned length, ChunkI
 /*!
 ** @brief Publish a file by breaking it into one or more content chunks.
 **
-** XputFile() calls XputChunk() internally and has the same requiremts as that 
-** function.
+** XputFile() has the same requiremts as XputChunk(), but sends the chunks to
+** click in batches, reading the file straight into memory shared with click
+** when it can, and does not wait for click to finish one batch before
+** reading the next.
 **
 ** On success, the CID of the chunk is set to the 40 character hash of the
 ** content data. The CID is not a full DAG, and must be converted to a DAG
@@ -217,8 +470,9 @@ int XputFile(ChunkContext *ctx, const char *fname, unsigned chunkSize, ChunkInfo
 	unsigned numChunks;
 	unsigned i;
 	int rc;
-	int count;
-	char *buf;
+	size_t count;
+	Putter put;
+	PutBatch *b;
 
 	if (ctx == NULL) {
 		errno = EFAULT;
@@ -244,39 +498,47 @@ int XputFile(ChunkContext *ctx, const char *fname, unsigned chunkSize, ChunkInfo
 	numChunks = fs.st_size / chunkSize;
 	if (fs.st_size % chunkSize)
 		numChunks ++;
-	//FIXME: this should be numChunks, sizeof(ChunkInfo)
-	if (!(infoList = (ChunkInfo*)calloc(numChunks, chunkSize))) {
+	if (!(infoList = (ChunkInfo*)calloc(MAX(numChunks, 1), sizeof(ChunkInfo)))) {
 		fclose(fp);
 		return -1;
 	}
 
-	if (!(buf = (char*)malloc(chunkSize))) {
+	if (put_open(&put, ctx, chunkSize, infoList) < 0) {
 		free(infoList);
 		fclose(fp);
 		return -1;
 	}
 
+	// read the file straight into the window
 	i = 0;
-	while (!feof(fp)) {
-	
-		if ((count = fread(buf, sizeof(char), chunkSize, fp)) > 0) {
-
-			if ((rc = XputChunk(ctx, buf, count, &infoList[i])) < 0)
+	rc = 0;
+	while (rc == 0 && i < numChunks) {
+		if (!(b = put_next(&put, i))) {
+			rc = -1;
+			break;
+		}
+		while (b->count < put.batchChunks && i < numChunks) {
+			count = fread(b->data + (size_t)b->count * chunkSize, sizeof(char), chunkSize, fp);
+			if (count == 0)
 				break;
-			i++;
+			b->length[b->count++] = count;
+			infoList[i++].size = count;
 		}
+		if (b->count == 0)
+			break;
+		rc = put_send(&put, b);
 	}
 
-	if (i != numChunks) {
+	rc = put_close(&put, rc);
+	if (rc == 0 && i != numChunks) {
 		// FIXME: something happened, what do we want to do in this case?
 		rc = -1;
 	}
-	else
+	else if (rc == 0)
 		rc = i;
 
 	*info = infoList;
 	fclose(fp);
-	free(buf);
 
 	return rc;
 }
@@ -285,8 +547,8 @@ int XputFile(ChunkContext *ctx, const char *fname, unsigned chunkSize, ChunkInfo
 /*!
 ** @brief Publish a file by breaking it into one or more content chunks.
 **
-** XputBuffer() calls XputChunk() internally and has the same requiremts as that 
-** function.
+** XputBuffer() has the same requiremts as XputChunk(), but sends the chunks
+** to click in batches, as XputFile() does.
 **
 ** On success, the CID of the chunk is set to the 40 character hash of the
 ** content data. The CID is not a full DAG, and must be converted to a DAG
@@ -316,9 +578,10 @@ int XputBuffer(ChunkContext *ctx, const char *data, unsigned len, unsigned chunk
 	unsigned numChunks;
 	unsigned i;
 	int rc;
-	int count;
-	char *buf;
+	unsigned count;
 	const char *p;
+	Putter put;
+	PutBatch *b;
 
 	if (ctx == NULL || data == NULL) {
 		errno = EFAULT;
@@ -334,34 +597,43 @@ int XputBuffer(ChunkContext *ctx, const char *data, unsigned len, unsigned chunk
 	if (len % chunkSize)
 		numChunks ++;
 
-	if (!(infoList = (ChunkInfo*)calloc(numChunks, chunkSize))) {
+	if (!(infoList = (ChunkInfo*)calloc(MAX(numChunks, 1), sizeof(ChunkInfo)))) {
 		return -1;
 	}
 
-	if (!(buf = (char*)malloc(chunkSize))) {
+	if (put_open(&put, ctx, chunkSize, infoList) < 0) {
 		free(infoList);
 		return -1;
 	}
 
 	p = data;
-	for (i = 0; i < numChunks; i++) {
-		count = MIN(len, chunkSize);
-
-		if ((rc = XputChunk(ctx, p, count, &infoList[i])) < 0)
+	i = 0;
+	rc = 0;
+	while (rc == 0 && i < numChunks) {
+		if (!(b = put_next(&put, i))) {
+			rc = -1;
 			break;
-		len -= count;
-		p += chunkSize;
+		}
+		while (b->count < put.batchChunks && i < numChunks) {
+			count = MIN(len, chunkSize);
+			memcpy(b->data + (size_t)b->count * chunkSize, p, count);
+			b->length[b->count++] = count;
+			infoList[i++].size = count;
+			len -= count;
+			p += chunkSize;
+		}
+		rc = put_send(&put, b);
 	}
 
-	if (i != numChunks) {
+	rc = put_close(&put, rc);
+	if (rc == 0 && i != numChunks) {
 		// FIXME: something happened, what do we want to do in this case?
 		rc = -1;
 	}
-	else
+	else if (rc == 0)
 		rc = i;
 
 	*info = infoList;
-	free(buf);
 
 	return rc;
 }
@@ -0,0 +1,211 @@
+/*
+ * xiacacheevictortest.{cc,hh} -- regression tests for XIA cache eviction
+ */
+
+#include <click/config.h>
+#include "xiacacheevictortest.hh"
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <elements/xia/xiacacheevictor.hh>
+CLICK_DECLS
+
+XIACacheEvictorTest::XIACacheEvictorTest()
+{
+}
+
+XIACacheEvictorTest::~XIACacheEvictorTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
+
+/* Chunks are named by one character, the last byte of their CID. */
+static XID
+cid(char c)
+{
+    struct click_xia_xid x;
+    memset(&x, 0, sizeof(x));
+    x.type = htonl(CLICK_XIA_XID_TYPE_CID);
+    x.id[CLICK_XIA_XID_ID_LEN - 1] = c;
+    return XID(x);
+}
+
+static void
+insert(XIACacheEvictor &ev, const char *names, uint32_t size = 10)
+{
+    for (; *names; names++)
+	ev.insert(cid(*names), size);
+}
+
+static void
+touch(XIACacheEvictor &ev, const char *names)
+{
+    for (; *names; names++)
+	ev.touch(cid(*names));
+}
+
+/* Evict @a n chunks (all of them if @a n is negative) and return their
+   names in eviction order. */
+static String
+evict(XIACacheEvictor &ev, int n = -1)
+{
+    StringAccum sa;
+    XID xid;
+    uint32_t size;
+    for (; n && ev.evict(xid, size); n--)
+	sa << (char) xid.xid().id[CLICK_XIA_XID_ID_LEN - 1];
+    return sa.take_string();
+}
+
+#define CHECK_EVICT(ev, n, expect) do {					\
+	String order = evict((ev), (n));				\
+	if (order != (expect))						\
+	    return errh->error("%s:%d: %s evicted %<%s%>, expected %<%s%>", \
+			       __FILE__, __LINE__, XIACacheEvictor::policy_name((ev).policy()), \
+			       order.c_str(), (expect));		\
+    } while (0)
+
+static int
+check_simple(ErrorHandler *errh)
+{
+    XIACacheEvictor lru(XIACacheEvictor::LRU), fifo(XIACacheEvictor::FIFO);
+    XID xid;
+
+    insert(lru, "abcd");
+    touch(lru, "ac");
+    CHECK(lru.peek(xid) && xid == cid('b'));
+    CHECK_EVICT(lru, -1, "bdac");
+
+    insert(fifo, "abcd");
+    touch(fifo, "ac");
+    CHECK_EVICT(fifo, -1, "abcd");
+    CHECK(!fifo.peek(xid));
+
+    // remove() and re-inserting as a hit
+    insert(lru, "abcd", 5);
+    CHECK(lru.size() == 4 && lru.bytes() == 20);
+    CHECK(lru.remove(cid('b')) && !lru.remove(cid('b')));
+    CHECK(!lru.contains(cid('b')));
+    insert(lru, "a", 50);
+    CHECK(lru.size() == 3 && lru.bytes() == 60);
+    CHECK_EVICT(lru, -1, "cda");
+    CHECK(lru.size() == 0 && lru.bytes() == 0);
+    return 0;
+}
+
+static int
+check_clock(ErrorHandler *errh)
+{
+    XIACacheEvictor ev(XIACacheEvictor::CLOCK);
+    XID xid;
+
+    // a and c were hit: the hand passes them once
+    insert(ev, "abcd");
+    touch(ev, "ac");
+    CHECK(ev.peek(xid) && xid == cid('a'));
+    CHECK_EVICT(ev, 1, "b");
+    CHECK_EVICT(ev, 1, "d");
+    touch(ev, "c");
+    CHECK_EVICT(ev, -1, "ac");
+    return 0;
+}
+
+static int
+check_s3fifo(ErrorHandler *errh)
+{
+    XIACacheEvictor ev(XIACacheEvictor::S3FIFO);
+
+    // a, hit twice in the small queue, is promoted; b, hit once, is not
+    insert(ev, "abcd");
+    touch(ev, "aab");
+    CHECK_EVICT(ev, 2, "bc");
+    CHECK(!ev.contains(cid('b')) && ev.size() == 2 && ev.bytes() == 20);
+
+    // ghost b comes back straight into the main queue, behind a
+    insert(ev, "b");
+    CHECK(ev.contains(cid('b')));
+    CHECK_EVICT(ev, 1, "d");
+
+    // the main queue gives hit chunks another round
+    insert(ev, "e");
+    touch(ev, "a");
+    CHECK_EVICT(ev, -1, "eba");
+    return 0;
+}
+
+static int
+check_gdsf(ErrorHandler *errh)
+{
+    XIACacheEvictor ev(XIACacheEvictor::GDSF);
+    XID xid;
+
+    // large cold chunks go first, small popular ones last
+    ev.insert(cid('a'), 100);
+    ev.insert(cid('b'), 10);
+    ev.insert(cid('c'), 1000);
+    touch(ev, "aaa");
+    CHECK(ev.peek(xid) && xid == cid('c'));
+    CHECK_EVICT(ev, 1, "c");
+
+    // inflation: a new chunk starts at the last victim's priority, so it
+    // outranks c but not a or b
+    ev.insert(cid('d'), 1000);
+    CHECK_EVICT(ev, -1, "dab");
+
+    // touching a chunk raises its priority past the others'
+    insert(ev, "xyz");
+    touch(ev, "x");
+    CHECK_EVICT(ev, -1, "yzx");
+    return 0;
+}
+
+static int
+check_set_policy(ErrorHandler *errh)
+{
+    XIACacheEvictor ev(XIACacheEvictor::GDSF);
+    static const char names[] = "ahbgcfdei";
+
+    // leaving GDSF keeps priority order, even where it differs from the
+    // heap's array order: one hit each, so the largest chunk goes first
+    for (int i = 0; names[i]; i++)
+	ev.insert(cid(names[i]), 100 * (names[i] - 'a' + 1));
+    ev.set_policy(XIACacheEvictor::FIFO);
+    CHECK(ev.size() == 9);
+    CHECK_EVICT(ev, -1, "ihgfedcba");
+
+    // LRU keeps its recency order under FIFO and CLOCK
+    ev.set_policy(XIACacheEvictor::LRU);
+    insert(ev, "abcd");
+    touch(ev, "b");
+    ev.set_policy(XIACacheEvictor::FIFO);
+    ev.set_policy(XIACacheEvictor::CLOCK);
+    CHECK_EVICT(ev, -1, "acdb");
+
+    // S3FIFO's small queue comes before its main queue; ghosts are dropped
+    ev.set_policy(XIACacheEvictor::S3FIFO);
+    insert(ev, "abcd");
+    touch(ev, "aa");
+    CHECK_EVICT(ev, 1, "b");
+    ev.set_policy(XIACacheEvictor::LRU);
+    CHECK(!ev.contains(cid('b')) && ev.size() == 3);
+    CHECK_EVICT(ev, -1, "cda");
+    return 0;
+}
+
+int
+XIACacheEvictorTest::initialize(ErrorHandler *errh)
+{
+    XIACacheEvictor::Policy p;
+    if (!XIACacheEvictor::parse_policy("s3fifo", p) || p != XIACacheEvictor::S3FIFO
+	|| XIACacheEvictor::parse_policy("lfu", p))
+	return errh->error("parse_policy failed");
+    if (check_simple(errh) < 0 || check_clock(errh) < 0 || check_s3fifo(errh) < 0
+	|| check_gdsf(errh) < 0 || check_set_policy(errh) < 0)
+	return -1;
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(XIACacheEvictor)
+EXPORT_ELEMENT(XIACacheEvictorTest)
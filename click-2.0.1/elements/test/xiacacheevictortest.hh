@@ -0,0 +1,37 @@
+#ifndef CLICK_XIACACHEEVICTORTEST_HH
+#define CLICK_XIACACHEEVICTORTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+XIACacheEvictorTest()
+
+=s test
+
+runs regression tests for XIA cache eviction
+
+=d
+
+XIACacheEvictorTest runs regression tests for XIACacheEvictor, which orders
+XIAContentModule's cached chunks for eviction, at initialization time.  It
+checks the eviction order of every policy, and that changing policy keeps
+the chunks in their current eviction order.  It does not route packets.
+
+=a XIATinyLFUTest
+*/
+
+class XIACacheEvictorTest : public Element { public:
+
+    XIACacheEvictorTest();
+    ~XIACacheEvictorTest();
+
+    const char *class_name() const		{ return "XIACacheEvictorTest"; }
+
+    int initialize(ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,186 @@
+/*
+ * xiaconntabletest.{cc,hh} -- regression tests for XIA connection state
+ */
+
+#include <click/config.h>
+#include "xiaconntabletest.hh"
+#include <click/error.hh>
+#include <elements/xia/xiaconntable.hh>
+CLICK_DECLS
+
+XIAConnTableTest::XIAConnTableTest()
+{
+}
+
+XIAConnTableTest::~XIAConnTableTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
+
+namespace {
+struct Conn {
+    static int live;
+    int id;
+    Conn() : id(-1) { live++; }
+    ~Conn() { live--; }
+};
+int Conn::live = 0;
+
+typedef XIAConnTable<Conn> Table;
+}
+
+static XID
+sid(uint32_t n)
+{
+    struct click_xia_xid x;
+    memset(&x, 0, sizeof(x));
+    x.type = htonl(CLICK_XIA_XID_TYPE_SID);
+    x.id[CLICK_XIA_XID_ID_LEN - 4] = n >> 24;
+    x.id[CLICK_XIA_XID_ID_LEN - 3] = n >> 16;
+    x.id[CLICK_XIA_XID_ID_LEN - 2] = n >> 8;
+    x.id[CLICK_XIA_XID_ID_LEN - 1] = n;
+    return XID(x);
+}
+
+static int
+check_handles(ErrorHandler *errh)
+{
+    Table t;
+    Table::Handle a, b, c;
+    Conn *ca = t.alloc(a), *cb = t.alloc(b);
+    CHECK(a && b && a != b && ca != cb);
+    CHECK(t.size() == 2 && Conn::live == 2);
+    CHECK(t.get(a) == ca && t.get(b) == cb);
+    CHECK(!t.get(0) && !t.get(a + 1000));
+
+    // a freed handle finds nothing and frees nothing, even once its slot
+    // holds a new object
+    t.free(a);
+    CHECK(t.size() == 1 && Conn::live == 1);
+    CHECK(!t.get(a));
+    Conn *cc = t.alloc(c);
+    CHECK(c != a && cc == ca);
+    CHECK(!t.get(a) && t.get(c) == cc);
+    t.free(a);
+    CHECK(t.size() == 2 && t.get(c) == cc);
+
+    // so does a stale port
+    t.set_port(1000, b);
+    t.set_port(1001, c);
+    CHECK(t.port(1000) == cb && t.port(1001) == cc && t.port_handle(1001) == c);
+    t.free(b);
+    CHECK(!t.port(1000) && t.port(1001) == cc);
+    t.erase_port(1001);
+    CHECK(!t.port(1001) && !t.port_handle(1001));
+
+    // more than one chunk, freed and reused in any order
+    Vector<Table::Handle> hs;
+    for (int i = 0; i < 300; i++) {
+	Table::Handle h;
+	t.alloc(h)->id = i;
+	hs.push_back(h);
+    }
+    for (int i = 0; i < 300; i += 3)
+	t.free(hs[i]);
+    for (int i = 0; i < 300; i++)
+	CHECK(i % 3 == 0 ? !t.get(hs[i]) : t.get(hs[i])->id == i);
+    for (int i = 0; i < 300; i += 3) {
+	Table::Handle h;
+	t.alloc(h)->id = 1000 + i;
+	CHECK(h != hs[i] && !t.get(hs[i]));
+	hs[i] = h;
+    }
+    for (int i = 0; i < 300; i++)
+	CHECK(t.get(hs[i])->id == (i % 3 == 0 ? 1000 + i : i));
+    CHECK(t.size() == 301 && Conn::live == 301);
+    return 0;
+}
+
+static int
+check_demux(ErrorHandler *errh)
+{
+    Table t;
+    Table::Handle a, b;
+    Conn *ca = t.alloc(a), *cb = t.alloc(b);
+    XID local = sid(1), remote = sid(2), other = sid(3);
+
+    // a connection and a bound socket on the same local XID
+    t.bind(local, remote, a);
+    t.bind(local, XID(), b);
+    CHECK(t.lookup(local, remote) == ca);
+    CHECK(t.lookup(local, XID()) == cb);
+    CHECK(!t.lookup(local, other) && !t.lookup(remote, local));
+
+    // rebinding a key moves it; freeing its old owner leaves it alone
+    t.bind(local, remote, b);
+    CHECK(t.lookup(local, remote) == cb);
+    t.free(a);
+    CHECK(t.lookup(local, remote) == cb);
+    t.bind(local, other, a);
+    CHECK(!t.lookup(local, other));
+
+    // freeing the owner drops every key it holds
+    t.free(b);
+    CHECK(!t.lookup(local, remote) && !t.lookup(local, XID()));
+    CHECK(t.size() == 0);
+    return 0;
+}
+
+static int
+check_rehash(ErrorHandler *errh)
+{
+    enum { NCONN = 400, KEYS = 8 };
+    Table t;
+    Table::Handle h[NCONN];
+
+    // grow well past the first table
+    for (int i = 0; i < NCONN; i++) {
+	t.alloc(h[i])->id = i;
+	for (int k = 0; k < KEYS; k++)
+	    t.bind(sid(i), sid(100000 + k), h[i]);
+    }
+    for (int i = 0; i < NCONN; i++)
+	for (int k = 0; k < KEYS; k++) {
+	    Conn *c = t.lookup(sid(i), sid(100000 + k));
+	    CHECK(c && c->id == i);
+	}
+    CHECK(!t.lookup(sid(NCONN), sid(100000)));
+
+    // churn: erased buckets force rehashes at a steady size, and lookups
+    // must survive every one of them
+    for (int round = 0; round < 20; round++)
+	for (int i = round % 2; i < NCONN; i += 2) {
+	    t.free(h[i]);
+	    CHECK(!t.lookup(sid(i), sid(100000)));
+	    t.alloc(h[i])->id = i;
+	    for (int k = 0; k < KEYS; k++)
+		t.bind(sid(i), sid(100000 + k + round), h[i]);
+	}
+    for (int i = 0; i < NCONN; i++) {
+	// the last round to free and rebind i
+	int round = i % 2 ? 19 : 18;
+	CHECK(!t.lookup(sid(i), sid(100000 + round - 1)));
+	for (int k = 0; k < KEYS; k++) {
+	    Conn *c = t.lookup(sid(i), sid(100000 + k + round));
+	    CHECK(c && c->id == i);
+	}
+    }
+    CHECK(t.size() == NCONN);
+    return 0;
+}
+
+int
+XIAConnTableTest::initialize(ErrorHandler *errh)
+{
+    if (check_handles(errh) < 0 || check_demux(errh) < 0 || check_rehash(errh) < 0)
+	return -1;
+    // every table has been destroyed
+    if (Conn::live != 0)
+	return errh->error("%d objects outlived their table", Conn::live);
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(XIAConnTableTest)
@@ -0,0 +1,38 @@
+#ifndef CLICK_XIACONNTABLETEST_HH
+#define CLICK_XIACONNTABLETEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+XIAConnTableTest()
+
+=s test
+
+runs regression tests for XIA connection state
+
+=d
+
+XIAConnTableTest runs regression tests for XIAConnTable<T>, which holds
+XTRANSPORT's sockets and connections, at initialization time.  It checks
+that handles outlive their objects safely, including after a slot is
+reused, and that the port and demultiplexing indexes follow binds, rebinds,
+frees and rehashing.  It does not route packets.
+
+=a XIAExpiryWheelTest
+*/
+
+class XIAConnTableTest : public Element { public:
+
+    XIAConnTableTest();
+    ~XIAConnTableTest();
+
+    const char *class_name() const		{ return "XIAConnTableTest"; }
+
+    int initialize(ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
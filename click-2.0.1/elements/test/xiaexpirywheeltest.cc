@@ -0,0 +1,220 @@
+/*
+ * xiaexpirywheeltest.{cc,hh} -- regression tests for XIA timer wheels
+ */
+
+#include <click/config.h>
+#include "xiaexpirywheeltest.hh"
+#include <click/error.hh>
+#include <click/hashtable.hh>
+#include <elements/xia/xiaexpirywheel.hh>
+CLICK_DECLS
+
+XIAExpiryWheelTest::XIAExpiryWheelTest()
+{
+}
+
+XIAExpiryWheelTest::~XIAExpiryWheelTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
+
+typedef XIAExpiryWheel<int> Wheel;
+
+/* Advance @a w to @a now and check that exactly @a expect expired. */
+static int
+check_advance(Wheel &w, uint64_t now, const Vector<int> &expect, ErrorHandler *errh)
+{
+    Vector<int> expired;
+    w.advance(now, expired);
+    CHECK(w.now() == now);
+    HashTable<int, int> want;
+    for (int i = 0; i < expect.size(); i++)
+	want[expect[i]]++;
+    for (int i = 0; i < expired.size(); i++)
+	if (--want[expired[i]] < 0)
+	    return errh->error("%s:%d: key %d expired at %llu", __FILE__, __LINE__,
+			       expired[i], (unsigned long long) now);
+    for (HashTable<int, int>::iterator it = want.begin(); it; ++it)
+	if (it.value() > 0)
+	    return errh->error("%s:%d: key %d did not expire at %llu", __FILE__, __LINE__,
+			       it.key(), (unsigned long long) now);
+    return 0;
+}
+
+static int
+check_cascade(ErrorHandler *errh)
+{
+    // one deadline at and around each level's span, and some overflowing
+    static const uint64_t delays[] = {
+	1, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 262145,
+	(1 << 24) - 1, 1 << 24, (1 << 24) + 1, (3 << 24) + 7
+    };
+    enum { N = sizeof(delays) / sizeof(delays[0]) };
+    Wheel w;
+    Vector<int> none, one(1, 0);
+
+    for (int i = 0; i < N; i++)
+	w.schedule(i, 1000, delays[i]);
+    CHECK(w.size() == N && w.now() == 1000);
+    for (int i = 0; i < N; i++) {
+	if (check_advance(w, 1000 + delays[i] - 1, none, errh) < 0)
+	    return -1;
+	one[0] = i;
+	if (check_advance(w, 1000 + delays[i], one, errh) < 0)
+	    return -1;
+    }
+    CHECK(w.size() == 0);
+    // each deadline is placed at most once per level, plus once per turn
+    // of the top level it spends in the overflow list
+    CHECK(w.visits() <= 4 * N + 3);
+    // ticks on which nothing happens are skipped
+    CHECK(w.ticks() < 10 * N);
+    return 0;
+}
+
+static int
+check_next_tick(ErrorHandler *errh)
+{
+    Wheel w;
+    Vector<int> expired;
+    CHECK(w.next_tick() == Wheel::NEVER);
+
+    // a deadline in the lowest level is the next tick exactly
+    w.schedule(1, 0, 5);
+    CHECK(w.next_tick() == 5);
+
+    // a higher level's deadline is reported no later than it falls; the
+    // wheel can sleep until next_tick() without missing it
+    w.remove(1);
+    w.schedule(2, 0, 100000);
+    uint64_t t, steps = 0;
+    while ((t = w.next_tick()) != Wheel::NEVER) {
+	CHECK(t > w.now() && t <= 100000);
+	w.advance(t - 1, expired);
+	CHECK(expired.empty());
+	w.advance(t, expired);
+	steps++;
+    }
+    CHECK(expired.size() == 1 && expired[0] == 2 && w.now() == 100000);
+    CHECK(steps <= 4);
+    return 0;
+}
+
+static int
+check_cancel(ErrorHandler *errh)
+{
+    Wheel w;
+    Vector<int> expect;
+
+    // removed keys never expire
+    w.schedule(1, 0, 10);
+    w.schedule(2, 0, 10);
+    w.schedule(3, 0, 5000);
+    CHECK(w.remove(2) && !w.remove(2) && !w.remove(4));
+    CHECK(w.size() == 2 && !w.contains(2) && w.contains(3));
+    expect.push_back(1);
+    if (check_advance(w, 10, expect, errh) < 0)
+	return -1;
+    // even after cascading toward level 0
+    expect.clear();
+    if (check_advance(w, 4990, expect, errh) < 0)
+	return -1;
+    CHECK(w.remove(3));
+    if (check_advance(w, 6000, expect, errh) < 0)
+	return -1;
+    CHECK(w.size() == 0);
+
+    // rescheduling replaces the old deadline, later or earlier
+    w.schedule(5, 6000, 10);
+    w.schedule(5, 6000, 100);
+    w.schedule(6, 6000, 70000);
+    w.schedule(6, 6000, 20);
+    CHECK(w.size() == 2);
+    expect.push_back(6);
+    if (check_advance(w, 6020, expect, errh) < 0)
+	return -1;
+    expect[0] = 5;
+    if (check_advance(w, 6100, expect, errh) < 0)
+	return -1;
+
+    // a deadline already past expires on the next tick; an empty wheel
+    // jumps to the caller's time first
+    w.schedule(7, 6100, 0);
+    w.schedule(8, 5000, 10);
+    expect.clear();
+    if (check_advance(w, 6100, expect, errh) < 0)
+	return -1;
+    expect.push_back(7);
+    expect.push_back(8);
+    if (check_advance(w, 6101, expect, errh) < 0)
+	return -1;
+    w.schedule(9, 1 << 30, 1);
+    CHECK(w.now() == 1 << 30 && w.next_tick() == (1 << 30) + 1);
+    w.clear();
+    CHECK(w.size() == 0 && w.next_tick() == Wheel::NEVER);
+    return 0;
+}
+
+/* Random schedules, removals and jumps, against a table of deadlines. */
+static int
+check_model(ErrorHandler *errh)
+{
+    enum { KEYS = 500, OPS = 20000 };
+    Wheel w;
+    HashTable<int, uint64_t> model;
+    uint32_t r = 1;
+#define RAND() (r = r * 1103515245 + 12345, r >> 8)
+#define SPAN() ((uint64_t) 1 << (RAND() % 27))
+
+    for (int op = 0; op < OPS; op++) {
+	int key = RAND() % KEYS;
+	switch (RAND() % 4) {
+	case 0:
+	case 1: {
+	    // the caller's clock may run ahead of the wheel's
+	    uint64_t now = w.now() + (RAND() % 3 ? 0 : RAND() % 100);
+	    uint64_t delay = RAND() % SPAN();
+	    uint64_t base = model.empty() && now > w.now() ? now : w.now();
+	    uint64_t when = now + delay > base ? now + delay : base + 1;
+	    w.schedule(key, now, delay);
+	    model[key] = when;
+	    break;
+	}
+	case 2:
+	    CHECK(w.remove(key) == (model.erase(key) != 0));
+	    break;
+	case 3: {
+	    uint64_t next = w.next_tick(), now = w.now() + RAND() % SPAN();
+	    Vector<int> expect;
+	    for (HashTable<int, uint64_t>::iterator it = model.begin(); it; ++it) {
+		CHECK(it.value() >= next);
+		if (it.value() <= now)
+		    expect.push_back(it.key());
+	    }
+	    if (check_advance(w, now, expect, errh) < 0)
+		return -1;
+	    for (int i = 0; i < expect.size(); i++)
+		model.erase(expect[i]);
+	    break;
+	}
+	}
+	CHECK(w.size() == (int) model.size());
+    }
+#undef RAND
+#undef SPAN
+    return 0;
+}
+
+int
+XIAExpiryWheelTest::initialize(ErrorHandler *errh)
+{
+    if (check_cascade(errh) < 0 || check_next_tick(errh) < 0
+	|| check_cancel(errh) < 0 || check_model(errh) < 0)
+	return -1;
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(XIAExpiryWheelTest)
@@ -0,0 +1,40 @@
+#ifndef CLICK_XIAEXPIRYWHEELTEST_HH
+#define CLICK_XIAEXPIRYWHEELTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+XIAExpiryWheelTest()
+
+=s test
+
+runs regression tests for XIA timer wheels
+
+=d
+
+XIAExpiryWheelTest runs regression tests for XIAExpiryWheel<K>, which
+expires XIAContentModule's cached chunks and XTRANSPORT's socket timers, at
+initialization time.  It checks that deadlines expire on exactly their tick
+as they cascade between levels and out of the overflow list, that
+next_tick() never skips a deadline, and that removed and rescheduled keys
+do not expire at their old deadlines.  It also compares the wheel with a
+simple model under random operations.  It does not route packets.
+
+=a XIAConnTableTest
+*/
+
+class XIAExpiryWheelTest : public Element { public:
+
+    XIAExpiryWheelTest();
+    ~XIAExpiryWheelTest();
+
+    const char *class_name() const		{ return "XIAExpiryWheelTest"; }
+
+    int initialize(ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
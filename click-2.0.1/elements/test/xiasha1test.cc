@@ -0,0 +1,185 @@
+/*
+ * xiasha1test.{cc,hh} -- regression tests and benchmarks for CID hashing
+ */
+
+#include <click/config.h>
+#include "xiasha1test.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/timestamp.hh>
+#include <click/sha1_impl.hh>
+#include <elements/xia/xiasha1.hh>
+#include <stdio.h>
+CLICK_DECLS
+
+XIASHA1Test::XIASHA1Test()
+    : _benchmark(0), _chunk_size(65536)
+{
+}
+
+XIASHA1Test::~XIASHA1Test()
+{
+}
+
+int
+XIASHA1Test::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("BENCHMARK", _benchmark)
+	.read("CHUNK_SIZE", _chunk_size)
+	.complete() < 0)
+	return -1;
+    if (_chunk_size <= 0)
+	return errh->error("CHUNK_SIZE must be positive");
+    return 0;
+}
+
+static void
+old_digest(const unsigned char *data, size_t len, unsigned char *md)
+{
+    SHA1_ctx ctx;
+    SHA1_init(&ctx);
+    SHA1_update(&ctx, const_cast<unsigned char *>(data), len);
+    SHA1_final(md, &ctx);
+}
+
+int
+XIASHA1Test::check(ErrorHandler *errh)
+{
+    static const struct {
+	const char *text;
+	const char *hex;
+    } known[] = {
+	{ "", "da39a3ee5e6b4b0d3255bfef95601890afd80709" },
+	{ "abc", "a9993e364706816aba3e25717850c26c9cd0d89d" },
+	{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+	  "84983e441c3bd26ebaae4aa1f95129e5e54670f1" }
+    };
+    enum { MAXLEN = 4200, NMANY = 37 };
+
+    unsigned char *buf = new unsigned char[MAXLEN];
+    for (int i = 0; i < MAXLEN; i++)
+	buf[i] = click_random() & 0xFF;
+    unsigned char md[XIASHA1::DIGEST_LEN], expect[XIASHA1::DIGEST_LEN];
+    unsigned char many[NMANY][XIASHA1::DIGEST_LEN];
+    const unsigned char *data[NMANY];
+    size_t len[NMANY];
+    int errors = 0;
+
+    XIASHA1::reset_engine();
+    if (XIASHA1::engine() != (XIASHA1::supported(XIASHA1::SHANI) ? XIASHA1::SHANI : XIASHA1::SCALAR))
+	errors += errh->error("single-buffer engine is %s", XIASHA1::engine_name(XIASHA1::engine())) < 0;
+    if (XIASHA1::supported(XIASHA1::AVX2) && XIASHA1::batch_engine() != XIASHA1::AVX2)
+	errors += errh->error("batch engine is %s, not AVX2", XIASHA1::engine_name(XIASHA1::batch_engine())) < 0;
+
+    for (int e = 0; e < XIASHA1::NENGINES; e++) {
+	if (!XIASHA1::set_engine((XIASHA1::Engine) e))
+	    continue;
+	const char *name = XIASHA1::engine_name((XIASHA1::Engine) e);
+
+	for (size_t i = 0; i < sizeof(known) / sizeof(known[0]); i++) {
+	    XIASHA1::digest((const unsigned char *) known[i].text, strlen(known[i].text), md);
+	    if (XIASHA1::hex(md) != known[i].hex)
+		errors += errh->error("%s: bad digest for %<%s%>", name, known[i].text) < 0;
+	}
+
+	// every padding case, then a few long buffers
+	for (int l = 0; l < MAXLEN; l += (l < 300 ? 1 : 97)) {
+	    XIASHA1::digest(buf, l, md);
+	    old_digest(buf, l, expect);
+	    if (memcmp(md, expect, sizeof(md)) != 0)
+		errors += errh->error("%s: bad digest for %d bytes", name, l) < 0;
+	}
+
+	// lanes finish at different times
+	for (int i = 0; i < NMANY; i++) {
+	    len[i] = (i * 131 + (i % 5) * 1000) % MAXLEN;
+	    data[i] = buf + (i * 7) % (MAXLEN - len[i] + 1);
+	}
+	for (int n = 1; n <= NMANY; n += 6) {
+	    XIASHA1::digest_many(n, data, len, many);
+	    for (int i = 0; i < n; i++) {
+		old_digest(data[i], len[i], expect);
+		if (memcmp(many[i], expect, sizeof(expect)) != 0)
+		    errors += errh->error("%s: bad digest for buffer %d of %d (%d bytes)", name, i, n, (int) len[i]) < 0;
+	    }
+	}
+    }
+
+    delete[] buf;
+    return errors ? -1 : 0;
+}
+
+void
+XIASHA1Test::benchmark(ErrorHandler *errh)
+{
+    enum { BATCH = 8 };
+    unsigned char *buf = new unsigned char[BATCH * _chunk_size];
+    for (int i = 0; i < BATCH * _chunk_size; i++)
+	buf[i] = click_random() & 0xFF;
+    const unsigned char *data[BATCH];
+    size_t len[BATCH];
+    for (int i = 0; i < BATCH; i++) {
+	data[i] = buf + i * _chunk_size;
+	len[i] = _chunk_size;
+    }
+    unsigned char md[BATCH][XIASHA1::DIGEST_LEN];
+    char hex[XIASHA1::HEX_LEN + 1];
+    double mbytes = (double) _benchmark * _chunk_size / 1e6;
+
+    // what XTRANSPORT did
+    Timestamp start = Timestamp::now_steady();
+    for (int i = 0; i < _benchmark; i++) {
+	old_digest(data[i % BATCH], len[i % BATCH], md[0]);
+	for (int j = 0; j < XIASHA1::DIGEST_LEN; j++)
+	    sprintf(hex + 2 * j, "%02x", md[0][j]);
+    }
+    double base = (Timestamp::now_steady() - start).doubleval();
+    errh->message("SHA1_update: %.1f MB/s", mbytes / base);
+
+    for (int e = 0; e < XIASHA1::NENGINES; e++) {
+	if (!XIASHA1::set_engine((XIASHA1::Engine) e))
+	    continue;
+	start = Timestamp::now_steady();
+	for (int i = 0; i < _benchmark; i++) {
+	    XIASHA1::digest(data[i % BATCH], len[i % BATCH], md[0]);
+	    XIASHA1::hex(md[0], hex);
+	}
+	double one = (Timestamp::now_steady() - start).doubleval();
+
+	start = Timestamp::now_steady();
+	for (int i = 0; i < _benchmark; i += BATCH) {
+	    int n = _benchmark - i < BATCH ? _benchmark - i : BATCH;
+	    XIASHA1::digest_many(n, data, len, md);
+	    for (int j = 0; j < n; j++)
+		XIASHA1::hex(md[j], hex);
+	}
+	double batch = (Timestamp::now_steady() - start).doubleval();
+
+	errh->message("%s: %.1f MB/s one at a time (%.1fx), %.1f MB/s %d at a time (%.1fx)",
+		      XIASHA1::engine_name((XIASHA1::Engine) e),
+		      mbytes / one, base / one, mbytes / batch, (int) BATCH, base / batch);
+    }
+
+    delete[] buf;
+}
+
+int
+XIASHA1Test::initialize(ErrorHandler *errh)
+{
+    int r = check(errh);
+    if (r >= 0 && _benchmark > 0)
+	benchmark(errh);
+    XIASHA1::reset_engine();
+    if (_benchmark > 0)
+	errh->message("using %s one at a time, %s in batches",
+		      XIASHA1::engine_name(XIASHA1::engine()),
+		      XIASHA1::engine_name(XIASHA1::batch_engine()));
+    if (r >= 0)
+	errh->message("All tests pass!");
+    return r;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(XIASHA1)
+EXPORT_ELEMENT(XIASHA1Test)
@@ -0,0 +1,63 @@
+#ifndef CLICK_XIASHA1TEST_HH
+#define CLICK_XIASHA1TEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+XIASHA1Test([I<keywords> BENCHMARK, CHUNK_SIZE])
+
+=s test
+
+runs regression tests and benchmarks for CID hashing
+
+=d
+
+XIASHA1Test checks every SHA-1 engine XTRANSPORT can use for CIDs at
+initialization time: each engine this CPU runs must agree with known digests
+and with Click's SHA1_update, one buffer at a time and several at once, for
+buffers of many lengths.  It does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCHMARK
+
+Integer.  If positive, also hash BENCHMARK chunks with Click's SHA1_update,
+turning each digest into hex with sprintf as XTRANSPORT used to, and then with
+each engine, and print the throughput of each.  Default is 0 (don't
+benchmark).
+
+=item CHUNK_SIZE
+
+Integer.  Benchmark chunk size in bytes.  Default is 65536.
+
+=back
+
+=a XTRANSPORT, CryptoTest
+*/
+
+class XIASHA1Test : public Element { public:
+
+    XIASHA1Test();
+    ~XIASHA1Test();
+
+    const char *class_name() const		{ return "XIASHA1Test"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+
+  private:
+
+    int _benchmark;
+    int _chunk_size;
+
+    int check(ErrorHandler *errh);
+    void benchmark(ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,90 @@
+/*
+ * xiatinylfutest.{cc,hh} -- regression tests for XIA cache admission
+ */
+
+#include <click/config.h>
+#include "xiatinylfutest.hh"
+#include <click/error.hh>
+#include <elements/xia/xiatinylfu.hh>
+CLICK_DECLS
+
+XIATinyLFUTest::XIATinyLFUTest()
+{
+}
+
+XIATinyLFUTest::~XIATinyLFUTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
+
+static XID
+cid(uint32_t n)
+{
+    struct click_xia_xid x;
+    memset(&x, 0, sizeof(x));
+    x.type = htonl(CLICK_XIA_XID_TYPE_CID);
+    x.id[CLICK_XIA_XID_ID_LEN - 4] = n >> 24;
+    x.id[CLICK_XIA_XID_ID_LEN - 3] = n >> 16;
+    x.id[CLICK_XIA_XID_ID_LEN - 2] = n >> 8;
+    x.id[CLICK_XIA_XID_ID_LEN - 1] = n;
+    return XID(x);
+}
+
+int
+XIATinyLFUTest::initialize(ErrorHandler *errh)
+{
+    XIATinyLFU lfu;
+    XID hot = cid(0), warm = cid(1), once = cid(2), never = cid(3);
+
+    // off until configured: everything is unknown and nothing is admitted
+    CHECK(!lfu.enabled());
+    lfu.record(hot);
+    CHECK(lfu.estimate(hot) == 0);
+    CHECK(!lfu.admit(hot, never));
+
+    CHECK(lfu.configure(100) == 0);
+    CHECK(lfu.enabled());
+    for (int i = 0; i < 5; i++)
+	lfu.record(hot);
+    for (int i = 0; i < 3; i++)
+	lfu.record(warm);
+    lfu.record(once);
+
+    // the doorkeeper holds the first sighting, the sketch the rest
+    CHECK(lfu.estimate(never) == 0);
+    CHECK(lfu.estimate(once) == 1);
+    CHECK(lfu.estimate(warm) == 3);
+    CHECK(lfu.estimate(hot) == 5);
+
+    // a one-hit chunk does not displace a popular one, but the reverse holds
+    CHECK(lfu.admit(hot, warm) && lfu.admit(warm, once));
+    CHECK(!lfu.admit(once, hot) && !lfu.admit(once, once));
+
+    // counters saturate at 15
+    for (int i = 0; i < 30; i++)
+	lfu.record(warm);
+    CHECK(lfu.estimate(warm) == 16);
+
+    // a stream of one-hit chunks ages the estimator, which halves the
+    // counters and forgets the doorkeeper, without raising hot's estimate
+    uint32_t ages = lfu.ages();
+    for (uint32_t n = 100; lfu.ages() == ages; n++) {
+	lfu.record(cid(n));
+	CHECK(n < 100000);
+    }
+    CHECK(lfu.estimate(hot) >= 2 && lfu.estimate(hot) <= 3);
+    CHECK(lfu.estimate(warm) >= 7 && lfu.estimate(warm) <= 8);
+    CHECK(lfu.admit(warm, hot));
+
+    lfu.clear();
+    CHECK(lfu.estimate(hot) == 0 && lfu.ages() == 0);
+    CHECK(lfu.configure(0) == 0 && !lfu.enabled());
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(XIATinyLFU)
+EXPORT_ELEMENT(XIATinyLFUTest)
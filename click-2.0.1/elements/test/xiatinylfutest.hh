@@ -0,0 +1,37 @@
+#ifndef CLICK_XIATINYLFUTEST_HH
+#define CLICK_XIATINYLFUTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+XIATinyLFUTest()
+
+=s test
+
+runs regression tests for XIA cache admission
+
+=d
+
+XIATinyLFUTest runs regression tests for XIATinyLFU, the chunk popularity
+estimator behind XIAContentModule's cache admission, at initialization time.
+It checks estimates, admission decisions, and aging.  It does not route
+packets.
+
+=a XIACacheEvictorTest
+*/
+
+class XIATinyLFUTest : public Element { public:
+
+    XIATinyLFUTest();
+    ~XIATinyLFUTest();
+
+    const char *class_name() const		{ return "XIATinyLFUTest"; }
+
+    int initialize(ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,419 @@
+/*
+ * xidroutemaptest.{cc,hh} -- regression tests for XIA route storage
+ */
+
+#include <click/config.h>
+#include "xidroutemaptest.hh"
+#include <click/error.hh>
+#include <elements/xia/xidroutemap.hh>
+#if CLICK_USERLEVEL
+# include <click/userutils.hh>
+# include <stdio.h>
+# include <unistd.h>
+#endif
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+# include <pthread.h>
+#endif
+CLICK_DECLS
+
+XIDRouteMapTest::XIDRouteMapTest()
+{
+}
+
+XIDRouteMapTest::~XIDRouteMapTest()
+{
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test `%s' failed", __FILE__, __LINE__, #x);
+
+/* Distinct XIDs whose low-entropy ids exercise the hash's mixing. */
+static XID
+make_xid(uint32_t type, uint32_t n)
+{
+    struct click_xia_xid x;
+    memset(&x, 0, sizeof(x));
+    x.type = htonl(type);
+    x.id[CLICK_XIA_XID_ID_LEN - 4] = n >> 24;
+    x.id[CLICK_XIA_XID_ID_LEN - 3] = n >> 16;
+    x.id[CLICK_XIA_XID_ID_LEN - 2] = n >> 8;
+    x.id[CLICK_XIA_XID_ID_LEN - 1] = n;
+    return XID(x);
+}
+
+static int
+check_basic(ErrorHandler *errh)
+{
+    XIDRouteMap m;
+    XIDRouteMap::Route r;
+    XID a = make_xid(CLICK_XIA_XID_TYPE_AD, 1), b = make_xid(CLICK_XIA_XID_TYPE_AD, 2);
+    XID hid = make_xid(CLICK_XIA_XID_TYPE_HID, 1);
+
+    CHECK(m.size() == 0);
+    CHECK(!m.lookup(a, r));
+    CHECK(!m.lookup_default(r));
+
+    CHECK(m.insert(a, 1, 7, &hid) == 0);
+    CHECK(m.insert(b, 2, 0, 0) == 0);
+    CHECK(m.size() == 2);
+    CHECK(m.lookup(a, r) && r.port == 1 && r.flags == 7 && r.nexthop && *r.nexthop == hid);
+    CHECK(m.lookup(b, r) && r.port == 2 && r.flags == 0 && !r.nexthop);
+    CHECK(!m.lookup(hid, r));
+
+    // replacing keeps the size; refusing to replace changes nothing
+    CHECK(m.insert(b, 3, 0, &hid) == 0);
+    CHECK(m.size() == 2);
+    CHECK(m.lookup(b, r) && r.port == 3 && *r.nexthop == hid);
+    CHECK(m.insert(b, 4, 0, 0, false) == -EEXIST);
+    CHECK(m.lookup(b, r) && r.port == 3);
+
+    // ports must fit in a route's 16 bits
+    CHECK(m.insert(b, 32768, 0, 0) == -EINVAL);
+    CHECK(m.insert(hid, -32769, 0, 0) == -EINVAL);
+    CHECK(m.set_default(65536, 0, 0) == -EINVAL);
+    CHECK(m.size() == 2);
+    CHECK(m.lookup(b, r) && r.port == 3);
+    CHECK(!m.lookup_default(r));
+
+    // both routes share one interned next hop until the last goes away
+    CHECK(m.nexthop_count() == 1);
+    CHECK(m.remove(a) == 0);
+    CHECK(m.remove(a) == -ENOENT);
+    CHECK(!m.lookup(a, r));
+    CHECK(m.nexthop_count() == 1);
+    CHECK(m.insert(b, 3, 0, 0) == 0);
+    CHECK(m.nexthop_count() == 0);
+    CHECK(m.size() == 1);
+
+    CHECK(m.set_default(5, 0, &hid) == 0);
+    CHECK(m.lookup_default(r) && r.port == 5 && *r.nexthop == hid);
+    CHECK(m.set_default(-1, 0, 0) == 0);
+    CHECK(!m.lookup_default(r));
+
+    m.clear();
+    CHECK(m.size() == 0);
+    CHECK(!m.lookup(b, r));
+    return 0;
+}
+
+static int
+check_growth(ErrorHandler *errh)
+{
+    enum { N = 20000 };
+    XIDRouteMap m;
+    XIDRouteMap::Route r;
+    int cap = m.capacity();
+
+    for (int i = 0; i < N; i++)
+	CHECK(m.insert(make_xid(CLICK_XIA_XID_TYPE_AD, i), i % 1000, i, 0) == 0);
+    CHECK(m.size() == N);
+    CHECK(m.capacity() > cap);
+    CHECK((uint64_t) m.size() * 5 <= (uint64_t) m.capacity() * 4);
+    for (int i = 0; i < N; i++)
+	CHECK(m.lookup(make_xid(CLICK_XIA_XID_TYPE_AD, i), r) && r.port == i % 1000 && r.flags == (uint32_t) i);
+    CHECK(!m.lookup(make_xid(CLICK_XIA_XID_TYPE_HID, 0), r));
+
+    // removals must not cut off routes that probed past them
+    for (int i = 0; i < N; i += 2)
+	CHECK(m.remove(make_xid(CLICK_XIA_XID_TYPE_AD, i)) == 0);
+    CHECK(m.size() == N / 2);
+    for (int i = 0; i < N; i++)
+	CHECK(m.lookup(make_xid(CLICK_XIA_XID_TYPE_AD, i), r) == (i % 2 == 1));
+
+    int n = 0;
+    m.acquire_write();
+    for (XIDRouteMap::const_iterator it = m.begin(); it; it++, n++)
+	CHECK(it.flags() % 2 == 1 && it.key() == make_xid(CLICK_XIA_XID_TYPE_AD, it.flags()));
+    m.release_write();
+    CHECK(n == N / 2);
+
+    // reserve() grows ahead of time and never shrinks
+    cap = m.capacity();
+    CHECK(m.reserve(4 * N) == 0);
+    CHECK(m.capacity() >= 4 * N && m.capacity() > cap);
+    cap = m.capacity();
+    CHECK(m.reserve(1) == 0);
+    CHECK(m.capacity() == cap);
+    for (int i = 1; i < N; i += 2)
+	CHECK(m.lookup(make_xid(CLICK_XIA_XID_TYPE_AD, i), r));
+    return 0;
+}
+
+static int
+check_generation(ErrorHandler *errh)
+{
+    XIDRouteMap m, other;
+    XID a = make_xid(CLICK_XIA_XID_TYPE_AD, 1);
+    XID c = make_xid(CLICK_XIA_XID_TYPE_CID, 1);
+    uint32_t g = m.generation(), og = other.generation();
+    CHECK(g != 0);
+
+#define CHECK_BUMPED(x) do { CHECK(x); CHECK(m.generation() != g); g = m.generation(); } while (0)
+#define CHECK_SAME(x) do { CHECK(x); CHECK(m.generation() == g); } while (0)
+    CHECK_BUMPED(m.insert(a, 1, 0, 0) == 0);
+    CHECK_BUMPED(m.insert(a, 2, 0, 0) == 0);
+    CHECK_SAME(m.insert(a, 3, 0, 0, false) == -EEXIST);
+    CHECK_BUMPED(m.set_default(1, 0, 0) == 0);
+    CHECK_BUMPED(m.remove(a) == 0);
+    CHECK_SAME(m.remove(a) == -ENOENT);
+    CHECK_BUMPED((m.clear(), true));
+
+    // each map has its own generation
+    CHECK(other.generation() == og);
+
+    // local CID routes do not change a forwarding decision, others do,
+    // and so do local ones that shadow a forwarding default route
+    m.set_local_port(-2, -7);
+    CHECK_BUMPED(m.insert(c, -2, 0, 0) == 0);
+    CHECK_BUMPED(m.remove(c) == 0);
+    CHECK_BUMPED(m.set_default(-7, 0, 0) == 0);
+    CHECK_SAME(m.insert(c, -2, 0, 0) == 0);
+    CHECK_SAME(m.remove(c) == 0);
+    CHECK_BUMPED(m.insert(c, 1, 0, 0) == 0);
+    CHECK_BUMPED(m.insert(c, -2, 0, 0) == 0);
+    CHECK_SAME(m.remove(c) == 0);
+
+    // a bulk update bumps once
+    Vector<XID> xids;
+    for (int i = 2; i < 10; i++)
+	xids.push_back(make_xid(CLICK_XIA_XID_TYPE_AD, i));
+    CHECK(m.insert(xids, 1, 0, 0) == xids.size());
+    CHECK(m.generation() == g + 1);
+    g = m.generation();
+    CHECK(m.remove(xids) == xids.size());
+    CHECK(m.generation() == g + 1);
+    CHECK(other.generation() == og);
+#undef CHECK_BUMPED
+#undef CHECK_SAME
+    return 0;
+}
+
+#if CLICK_USERLEVEL && HAVE_MMAP
+static int
+check_snapshot(ErrorHandler *errh)
+{
+    enum { N = 3000 };
+    String dir = click_mktmpdir(errh);
+    if (!dir)
+	return -1;
+    String file = dir + "routes", bad = dir + "dup";
+    XIDRouteMap m, m2;
+    XIDRouteMap::Route r;
+    int result = -1;
+
+    for (int i = 0; i < N; i++) {
+	XID nh = make_xid(CLICK_XIA_XID_TYPE_HID, i % 10);
+	if (m.insert(make_xid(CLICK_XIA_XID_TYPE_AD, i), i % 1000, i, &nh) < 0)
+	    goto out;
+    }
+    m.set_default(7, 0, 0);
+    if (m.save(file) < 0) {
+	errh->error("cannot save %s", file.c_str());
+	goto out;
+    }
+
+    // one thread or several, the loaded map matches
+    for (int nthreads = 1; nthreads <= 4; nthreads += 3) {
+	m2.clear();
+	if (m2.load(file, nthreads) < 0 || m2.size() != N || m2.nexthop_count() != 10
+	    || !m2.lookup_default(r) || r.port != 7) {
+	    errh->error("%s:%d: snapshot load with %d threads failed", __FILE__, __LINE__, nthreads);
+	    goto out;
+	}
+	for (int i = 0; i < N; i++)
+	    if (!m2.lookup(make_xid(CLICK_XIA_XID_TYPE_AD, i), r) || r.port != i % 1000
+		|| r.flags != (uint32_t) i || *r.nexthop != make_xid(CLICK_XIA_XID_TYPE_HID, i % 10)) {
+		errh->error("%s:%d: route %d lost with %d threads", __FILE__, __LINE__, i, nthreads);
+		goto out;
+	    }
+    }
+
+    // a copy holds the same routes, naming next hops by position
+    {
+	Vector<XIDRouteMap::Entry> routes;
+	XIDRouteMap::Entry dflt;
+	Vector<XID> nexthops;
+	m2.copy(routes, dflt, nexthops);
+	if (routes.size() != N || nexthops.size() != 10 || dflt.port != 7 || dflt.nexthop != 0) {
+	    errh->error("%s:%d: copy has %d routes", __FILE__, __LINE__, routes.size());
+	    goto out;
+	}
+	for (int k = 0; k < routes.size(); k++) {
+	    const XIDRouteMap::Entry &e = routes[k];
+	    if (!m2.lookup(e.xid, r) || r.port != e.port || r.flags != e.flags
+		|| e.nexthop < 1 || e.nexthop > 10 || nexthops[e.nexthop - 1] != *r.nexthop) {
+		errh->error("%s:%d: copied route %d is wrong", __FILE__, __LINE__, k);
+		goto out;
+	    }
+	}
+    }
+
+    // a snapshot holding an XID twice is refused, leaving the map alone:
+    // copy the first route's XID over the last's (a 32-byte header, 24-byte
+    // XIDs and 36-byte route records)
+    {
+	String data = file_string(file, errh);
+	FILE *f = fopen(bad.c_str(), "wb");
+	if (!data || !f || data.length() != 32 + 10 * 24 + N * 36) {
+	    if (f)
+		fclose(f);
+	    errh->error("%s:%d: cannot make duplicate snapshot", __FILE__, __LINE__);
+	    goto out;
+	}
+	char *x = data.mutable_data();
+	memcpy(x + 32 + 10 * 24 + (N - 1) * 36, x + 32 + 10 * 24, 24);
+	fwrite(x, 1, data.length(), f);
+	fclose(f);
+	for (int nthreads = 1; nthreads <= 4; nthreads += 3)
+	    if (m2.load(bad, nthreads) != -EINVAL || m2.size() != N
+		|| !m2.lookup(make_xid(CLICK_XIA_XID_TYPE_AD, N - 1), r)) {
+		errh->error("%s:%d: duplicate XID accepted with %d threads", __FILE__, __LINE__, nthreads);
+		goto out;
+	    }
+    }
+    result = 0;
+
+  out:
+    unlink(file.c_str());
+    unlink(bad.c_str());
+    rmdir(dir.c_str());
+    return result;
+}
+#endif
+
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+namespace {
+enum { NSTABLE = 1000, NCHURN = 5000, NROUNDS = 4, MAX_READERS = 80 };
+
+struct Reader {
+    XIDRouteMap *m;
+    int id;
+    volatile bool *stop;
+    long limit;			// stop after this many lookups, if not 0
+    long lookups;
+    int errors;
+};
+
+inline XID stable_nexthop(int i)	{ return make_xid(CLICK_XIA_XID_TYPE_HID, i % 7); }
+inline XID churn_nexthop(int i)		{ return make_xid(CLICK_XIA_XID_TYPE_HID, 100 + i % 500); }
+}
+
+extern "C" {
+static void *
+route_reader(void *arg)
+{
+    Reader *rd = static_cast<Reader *>(arg);
+    XIDRouteMap::Route r;
+    uint32_t k = rd->id;
+    while (!*rd->stop && (!rd->limit || rd->lookups < rd->limit)) {
+	k = k * 1103515245 + 12345;
+	int i = (k >> 8) % NSTABLE, j = (k >> 8) % NCHURN;
+	rd->m->read_begin();
+	// stable routes never disappear, even while the table is rebuilt
+	if (!rd->m->lookup(make_xid(CLICK_XIA_XID_TYPE_AD, i), r)
+	    || r.port != i || !r.nexthop || *r.nexthop != stable_nexthop(i))
+	    rd->errors++;
+	// churning routes come and go, but are never half there
+	if (rd->m->lookup(make_xid(CLICK_XIA_XID_TYPE_SID, j), r)
+	    && (r.port != j % 1000 || !r.nexthop || *r.nexthop != churn_nexthop(j)))
+	    rd->errors++;
+	rd->m->read_end();
+	rd->lookups++;
+    }
+    return 0;
+}
+}
+
+/* Churn routes under @a nreaders reader threads.  With more readers than
+   XIAEpoch has slots, the last slot is shared. */
+static int
+check_concurrent(int nreaders, long limit, ErrorHandler *errh)
+{
+    XIDRouteMap m;
+    volatile bool stop = false;
+    Reader rd[MAX_READERS];
+    pthread_t tid[MAX_READERS];
+#if HAVE_MMAP
+    String dir = click_mktmpdir(errh);
+    if (!dir)
+	return -1;
+    String file = dir + "routes";
+#endif
+
+    for (int i = 0; i < NSTABLE; i++) {
+	XID nh = stable_nexthop(i);
+	CHECK(m.insert(make_xid(CLICK_XIA_XID_TYPE_AD, i), i, 0, &nh) == 0);
+    }
+#if HAVE_MMAP
+    CHECK(m.save(file) == 0);
+#endif
+    for (int t = 0; t < nreaders; t++) {
+	rd[t].m = &m;
+	rd[t].id = t + 1;
+	rd[t].stop = &stop;
+	rd[t].limit = limit;
+	rd[t].lookups = rd[t].errors = 0;
+	CHECK(pthread_create(&tid[t], 0, route_reader, &rd[t]) == 0);
+    }
+
+    // grow the table under the readers, then churn routes, replacing and
+    // releasing next hops, and force a few more rebuilds, some of them
+    // from a snapshot of the stable routes
+    int r = 0;
+    for (int round = 0; round < NROUNDS && r == 0; round++) {
+	for (int j = 0; j < NCHURN && r == 0; j++) {
+	    XID nh = churn_nexthop(j);
+	    r = m.insert(make_xid(CLICK_XIA_XID_TYPE_SID, j), j % 1000, 0, &nh);
+	}
+	if (r == 0 && round % 2)
+	    r = m.reserve(m.capacity() * 2);
+	for (int j = 0; j < NCHURN && r == 0; j++)
+	    r = m.remove(make_xid(CLICK_XIA_XID_TYPE_SID, j));
+#if HAVE_MMAP
+	if (r == 0)
+	    r = m.load(file, round % 2 ? 2 : 1);
+#endif
+    }
+#if HAVE_MMAP
+    unlink(file.c_str());
+    rmdir(dir.c_str());
+#endif
+
+    stop = true;
+    long lookups = 0;
+    int errors = 0;
+    for (int t = 0; t < nreaders; t++) {
+	pthread_join(tid[t], 0);
+	lookups += rd[t].lookups;
+	errors += rd[t].errors;
+    }
+    CHECK(r == 0);
+    CHECK(lookups > 0);
+    if (errors)
+	return errh->error("%d of %ld concurrent lookups went wrong", errors, lookups);
+    CHECK(m.size() == NSTABLE);
+    return 0;
+}
+#endif
+
+int
+XIDRouteMapTest::initialize(ErrorHandler *errh)
+{
+    if (check_basic(errh) < 0 || check_growth(errh) < 0 || check_generation(errh) < 0)
+	return -1;
+#if CLICK_USERLEVEL && HAVE_MMAP
+    if (check_snapshot(errh) < 0)
+	return -1;
+#endif
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    // a few busy readers, then more short-lived ones than there are
+    // reader slots
+    if (check_concurrent(3, 0, errh) < 0 || check_concurrent(MAX_READERS, 200, errh) < 0)
+	return -1;
+#endif
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(XIDRouteMap)
+EXPORT_ELEMENT(XIDRouteMapTest)
@@ -0,0 +1,40 @@
+#ifndef CLICK_XIDROUTEMAPTEST_HH
+#define CLICK_XIDROUTEMAPTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+XIDRouteMapTest()
+
+=s test
+
+runs regression tests for XIA route storage
+
+=d
+
+XIDRouteMapTest runs regression tests for XIDRouteMap, the route storage
+behind XIAXIDRouteTable, at initialization time: inserting, replacing and
+removing routes, the default route, interned next hops, growing the table,
+generation bumps, and saving and loading snapshots, including refusing one
+that holds an XID twice.  At userlevel with threads, it also checks that
+lookups running on other threads while routes change and the table grows
+always find the routes that stay put.  It does not route packets.
+
+=a XIAXIDRouteTable
+*/
+
+class XIDRouteMapTest : public Element { public:
+
+    XIDRouteMapTest();
+    ~XIDRouteMapTest();
+
+    const char *class_name() const		{ return "XIDRouteMapTest"; }
+
+    int initialize(ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -11,6 +11,7 @@ CLICK_DECLS
 
 MarkXIAHeader::MarkXIAHeader()
 {
+    _drops = 0;
 }
 
 MarkXIAHeader::~MarkXIAHeader()
@@ -26,16 +27,44 @@ MarkXIAHeader::configure(Vector<String> &conf, ErrorHandler *errh)
   		      cpEnd);
 }
 
+Packet *
+MarkXIAHeader::drop(Packet *p)
+{
+    if (_drops == 0)
+	click_chatter("%s: malformed XIA header", declaration().c_str());
+    _drops++;
+    checked_output_push(1, p);
+    return 0;
+}
+
 Packet *
 MarkXIAHeader::simple_action(Packet *p)
 {
+    if (p->length() < _offset + XIAHeader::hdr_size(0))
+	return drop(p);
+
     const click_xia *xiah = reinterpret_cast<const click_xia *>(p->data() + _offset);
+    if (xiah->dnode == 0 || xiah->last >= (int) xiah->dnode || xiah->last < -1)
+	return drop(p);
+
+    // also checks that the nodes fit in the packet
+    uint8_t nxt;
+    int payload = XIAHeader::parse_payload(xiah, p->length() - _offset, &nxt);
+    if (payload < 0)
+	return drop(p);
 
     p->set_xia_header(xiah, XIAHeader::hdr_size(xiah->dnode + xiah->snode));
+    XIAHeader::set_payload_anno(p, payload, nxt);
 
     return p;
 }
 
+void
+MarkXIAHeader::add_handlers()
+{
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(MarkXIAHeader)
 ELEMENT_MT_SAFE(MarkXIAHeader)
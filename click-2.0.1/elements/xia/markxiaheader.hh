@@ -1,6 +1,7 @@
 #ifndef CLICK_MARKXIAHEADER_HH
 #define CLICK_MARKXIAHEADER_HH
 #include <click/element.hh>
+#include <click/atomic.hh>
 CLICK_DECLS
 
 /*
@@ -15,7 +16,17 @@ CLICK_DECLS
  * Marks packets as XIA packets by setting the XIA Header location. The XIA 
  * header starts OFFSET bytes into the packet. Default OFFSET is 0.
  *
- * Does not check length fields for sanity or shorten packets to the XIA length.
+ * Also walks the extension header chain once and caches where the payload
+ * starts and its type in the packet's annotations, so later XIAHeader::payload()
+ * calls need not walk it again.
+ *
+ * Packets whose header does not fit in the packet, that have no destination
+ * node, whose last visited node is out of range, or whose extension header
+ * chain is malformed are sent to output 1 if it exists, and dropped otherwise.
+ * Does not check the payload length field or shorten packets to the XIA length.
+ *
+ * =h drops read-only
+ * Returns the number of malformed packets.
  *
  * =a MarkIPHeader */
 
@@ -26,13 +37,18 @@ class MarkXIAHeader : public Element {
     ~MarkXIAHeader();
   
     const char *class_name() const		{ return "MarkXIAHeader"; }
-    const char *port_count() const		{ return PORTS_1_1; }
+    const char *port_count() const		{ return PORTS_1_1X2; }
+    const char *processing() const		{ return PROCESSING_A_AH; }
     int configure(Vector<String> &, ErrorHandler *);
+    void add_handlers();
   
     Packet *simple_action(Packet *);
 
   private:
     int _offset;
+    atomic_uint32_t _drops;
+
+    Packet *drop(Packet *);
 };
 
 CLICK_ENDDECLS
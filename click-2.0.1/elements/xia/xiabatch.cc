@@ -0,0 +1,93 @@
+/*
+ * xiabatch.{cc,hh} -- base class for XIA elements that process packet batches
+ */
+
+#include <click/config.h>
+#include "xiabatch.hh"
+#include <click/glue.hh>
+CLICK_DECLS
+
+XIABatchElement::XIABatchElement()
+{
+}
+
+void *
+XIABatchElement::cast(const char *name)
+{
+    if (strcmp(name, "XIABatchElement") == 0)
+	return this;
+    return Element::cast(name);
+}
+
+int
+XIABatchElement::initialize(ErrorHandler *)
+{
+    // resolve once which outputs lead straight into a batch-aware element
+    _batch_next.assign(noutputs(), 0);
+    for (int i = 0; i < noutputs(); i++)
+	if (output_is_push(i) && output(i).element())
+	    _batch_next[i] = static_cast<XIABatchElement *>(output(i).element()->cast("XIABatchElement"));
+    return 0;
+}
+
+void
+XIABatchElement::push_batch(int port, Packet *head)
+{
+    while (head) {
+	Packet *next = head->next();
+	head->set_next(0);
+	push(port, head);
+	head = next;
+    }
+}
+
+void
+XIABatchElement::output_push_batch(int port, Packet *head) const
+{
+    if (!head)
+	return;
+    if (port < _batch_next.size() && _batch_next[port]) {
+	_batch_next[port]->push_batch(output(port).port(), head);
+	return;
+    }
+    while (head) {
+	Packet *next = head->next();
+	head->set_next(0);
+	output(port).push(head);
+	head = next;
+    }
+}
+
+/** @brief Push each of @a n packets to the output in @a ports.
+ *
+ * Packets bound for the same output are sent as one batch, in their original
+ * order.  A negative port kills the packet. */
+void
+XIABatchElement::output_push_sorted(Packet **pkts, const int *ports, int n) const
+{
+    assert(n <= MAX_BATCH);
+    bool done[MAX_BATCH];
+    memset(done, 0, n * sizeof(bool));
+
+    for (int i = 0; i < n; i++) {
+	if (done[i])
+	    continue;
+	int port = ports[i];
+	if (port < 0) {
+	    pkts[i]->kill();
+	    continue;
+	}
+	Packet *head = pkts[i], **tail = &pkts[i]->next();
+	for (int j = i + 1; j < n; j++)
+	    if (!done[j] && ports[j] == port) {
+		*tail = pkts[j];
+		tail = &pkts[j]->next();
+		done[j] = true;
+	    }
+	*tail = 0;
+	output_push_batch(port, head);
+    }
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(XIABatchElement)
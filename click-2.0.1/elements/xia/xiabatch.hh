@@ -0,0 +1,83 @@
+#ifndef CLICK_XIABATCH_HH
+#define CLICK_XIABATCH_HH
+#include <click/element.hh>
+#include <click/packet.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+ * XIABatchElement -- base class for XIA elements that process packet batches
+ *
+ * A batch is a null-terminated list of packets chained through
+ * Packet::next().  An element derived from XIABatchElement overrides
+ * push_batch() to handle a whole batch at once, which lets it prefetch
+ * headers and table entries for every packet before touching any of them,
+ * and costs one virtual call per batch instead of one per packet.
+ *
+ * Outputs are sent with output_push_batch().  If the downstream element is
+ * batch-aware the batch is handed over as is; otherwise the packets are
+ * unlinked and pushed one at a time, so batch-aware elements can be mixed
+ * freely with ordinary ones.  Conversely, the default push_batch() falls back
+ * to push(), and an ordinary push() into a batch-aware element still works.
+ *
+ * Subclasses that override initialize() must call
+ * XIABatchElement::initialize().
+ */
+
+class XIABatchElement : public Element { public:
+
+    enum { MAX_BATCH = 64 };
+
+    XIABatchElement();
+
+    void *cast(const char *name);
+    int initialize(ErrorHandler *errh);
+
+    virtual void push_batch(int port, Packet *head);
+
+    void output_push_batch(int port, Packet *head) const;
+    void output_push_sorted(Packet **pkts, const int *ports, int n) const;
+
+    static int take_batch(Packet *&head, Packet **pkts);
+    static Packet *make_batch(Packet **pkts, int n);
+
+  private:
+
+    Vector<XIABatchElement *> _batch_next;
+
+};
+
+
+/** @brief Unlink up to MAX_BATCH packets from the front of @a head.
+ *
+ * The packets are stored in @a pkts with their next pointers cleared, and
+ * @a head is advanced past them.  Returns the number of packets taken. */
+inline int
+XIABatchElement::take_batch(Packet *&head, Packet **pkts)
+{
+    int n = 0;
+    while (head && n < MAX_BATCH) {
+	Packet *next = head->next();
+	head->set_next(0);
+	pkts[n++] = head;
+	head = next;
+    }
+    return n;
+}
+
+/** @brief Chain @a n packets from @a pkts into a batch, skipping nulls. */
+inline Packet *
+XIABatchElement::make_batch(Packet **pkts, int n)
+{
+    Packet *head = 0, **tail = &head;
+    for (int i = 0; i < n; i++)
+	if (pkts[i]) {
+	    *tail = pkts[i];
+	    tail = &pkts[i]->next();
+	}
+    *tail = 0;
+    return head;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,84 @@
+/*
+ * xiabatchunqueue.{cc,hh} -- pull packets and push them downstream as batches
+ */
+
+#include <click/config.h>
+#include "xiabatchunqueue.hh"
+#include <click/glue.hh>
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/standard/scheduleinfo.hh>
+CLICK_DECLS
+
+XIABatchUnqueue::XIABatchUnqueue()
+    : _task(this)
+{
+}
+
+XIABatchUnqueue::~XIABatchUnqueue()
+{
+}
+
+int
+XIABatchUnqueue::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _burst = 32;
+    _active = true;
+
+    if (cp_va_kparse(conf, this, errh,
+		     "BURST", cpkP, cpInteger, &_burst,
+		     "ACTIVE", 0, cpBool, &_active,
+		     cpEnd) < 0)
+	return -1;
+
+    if (_burst < 1 || _burst > MAX_BATCH)
+	return errh->error("BURST must be between 1 and %d", (int) MAX_BATCH);
+    return 0;
+}
+
+int
+XIABatchUnqueue::initialize(ErrorHandler *errh)
+{
+    _count = 0;
+    ScheduleInfo::initialize_task(this, &_task, _active, errh);
+    _signal = Notifier::upstream_empty_signal(this, 0, &_task);
+    return XIABatchElement::initialize(errh);
+}
+
+bool
+XIABatchUnqueue::run_task(Task *)
+{
+    if (!_active)
+	return false;
+
+    Packet *pkts[MAX_BATCH];
+    int n = 0;
+    while (n < _burst) {
+	if (Packet *p = input(0).pull())
+	    pkts[n++] = p;
+	else
+	    break;
+    }
+
+    if (n) {
+	_count += n;
+	output_push_batch(0, make_batch(pkts, n));
+    }
+
+    if (n || _signal)
+	_task.fast_reschedule();
+    return n > 0;
+}
+
+void
+XIABatchUnqueue::add_handlers()
+{
+    add_data_handlers("active", Handler::OP_READ | Handler::CHECKBOX, &_active);
+    add_data_handlers("count", Handler::OP_READ, &_count);
+    add_task_handlers(&_task, &_signal);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(XIABatchUnqueue)
+ELEMENT_REQUIRES(XIABatchElement)
+ELEMENT_MT_SAFE(XIABatchUnqueue)
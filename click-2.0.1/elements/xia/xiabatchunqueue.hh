@@ -0,0 +1,63 @@
+#ifndef CLICK_XIABATCHUNQUEUE_HH
+#define CLICK_XIABATCHUNQUEUE_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/notifier.hh>
+#include "xiabatch.hh"
+CLICK_DECLS
+
+/*
+=c
+XIABatchUnqueue([BURST, I<keywords> ACTIVE])
+
+=s xia
+pull-to-push converter that emits packet batches
+
+=d
+Pulls up to BURST packets each time it is scheduled and pushes them out its
+single output as one batch.  If the downstream element is batch-aware (see
+XIASelectPath, XIAXIDTypeClassifier, XIAXIDRouteTable, XIACheckDest,
+XIANextHop and XIADecHLIM) the whole batch travels through the pipeline
+together; otherwise the packets are pushed one at a time, as with Unqueue.
+
+BURST defaults to 32 and may be at most 64.
+
+=h count read-only
+Returns the number of packets that have passed through.
+
+=h active read-only
+Same as the ACTIVE keyword.
+
+=e
+  FromDevice(eth0) -> Queue -> XIABatchUnqueue(32) -> XIAPacketRoute(...);
+
+=a Unqueue, XIAPacketRoute
+*/
+
+class XIABatchUnqueue : public XIABatchElement { public:
+
+    XIABatchUnqueue();
+    ~XIABatchUnqueue();
+
+    const char *class_name() const		{ return "XIABatchUnqueue"; }
+    const char *port_count() const		{ return PORTS_1_1; }
+    const char *processing() const		{ return PULL_TO_PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void add_handlers();
+
+    bool run_task(Task *);
+
+  private:
+
+    bool _active;
+    int _burst;
+    uint32_t _count;
+    Task _task;
+    NotifierSignal _signal;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -42,6 +42,15 @@ XIACache::configure(Vector<String> &conf, ErrorHandler *errh)
     int pkt_size=0;
 	int malicious=0;
     bool cache_content_from_network =true;
+    String policy_str = "LRU";
+    bool admission = false;
+    uint32_t admission_entries = 65536;
+    uint32_t pacing_rate = 0;
+    uint32_t pacing_burst = 0;
+    String disk_cache;
+    uint64_t disk_size = (uint64_t) 4 << 30;
+    uint32_t partial_timeout = 10000;
+    uint32_t idle_timeout = 300000;
 
     if (cp_va_kparse(conf, this, errh,
 		"LOCAL_ADDR", cpkP+cpkM, cpXIAPath, &local_addr,
@@ -49,9 +58,28 @@ XIACache::configure(Vector<String> &conf, ErrorHandler *errh)
 		"CACHE_CONTENT_FROM_NETWORK", cpkP, cpBool, &cache_content_from_network,
 		"PACKET_SIZE", 0, cpInteger, &pkt_size,
 		"MALICIOUS", 0, cpInteger, &malicious,
+		"POLICY", 0, cpWord, &policy_str,
+		"ADMISSION", 0, cpBool, &admission,
+		"ADMISSION_ENTRIES", 0, cpUnsigned, &admission_entries,
+		"PACING_RATE", 0, cpBandwidth, &pacing_rate,
+		"PACING_BURST", 0, cpUnsigned, &pacing_burst,
+		"DISK_CACHE", 0, cpFilename, &disk_cache,
+		"DISK_SIZE", 0, cpUnsigned64, &disk_size,
+		"PARTIAL_TIMEOUT", 0, cpSecondsAsMilli, &partial_timeout,
+		"IDLE_TIMEOUT", 0, cpSecondsAsMilli, &idle_timeout,
 		cpEnd) < 0)
 	return -1;   
 
+    XIACacheEvictor::Policy policy;
+    if (!XIACacheEvictor::parse_policy(policy_str, policy))
+	return errh->error("POLICY must be LRU, FIFO, CLOCK, S3FIFO or GDSF");
+    _content_module->set_policy(policy);
+    if (_content_module->set_admission(admission ? admission_entries : 0) < 0)
+	return errh->error("out of memory");
+    if (disk_cache && _content_module->set_store(disk_cache, disk_size, errh) < 0)
+	return -1;
+    _content_module->set_timeouts(partial_timeout, idle_timeout);
+
 	// Tell the content module whether or not it is malicious
 	_content_module->malicious = malicious;
 
@@ -64,6 +92,8 @@ XIACache::configure(Vector<String> &conf, ErrorHandler *errh)
     _local_hid = local_addr.xid(local_addr.destination_node());
 
     if (pkt_size) XIAContentModule::PKTSIZE= pkt_size;
+    // by default a response may start with a burst of eight packets
+    _content_module->set_pacing(pacing_rate, pacing_burst ? pacing_burst : 8 * XIAContentModule::PKTSIZE);
     _content_module->_cache_content_from_network = cache_content_from_network;
     /*
        std::cout<<"Route Table Name: "<<routing_table_name.c_str()<<std::endl;
@@ -88,6 +118,13 @@ XIACache::configure(Vector<String> &conf, ErrorHandler *errh)
 
 
 
+int
+XIACache::initialize(ErrorHandler *)
+{
+    _content_module->initialize(this);
+    return 0;
+}
+
 void XIACache::push(int port, Packet *p)
 {
 	
@@ -156,7 +193,7 @@ int XIACache::get_malicious()
 	return _content_module->malicious;
 }
 
-enum {H_MOVE, MALICIOUS};
+enum {H_MOVE, MALICIOUS, HIT_RATIO, ADMISSION_RATE, DISK_CHUNKS, DISK_BYTES, EXPIRY_PENDING, EXPIRY_VISITS, EXPIRY_MAX_VISITS};
 
 int XIACache::write_param(const String &conf, Element *e, void *vparam,
                 ErrorHandler *errh)
@@ -172,6 +209,7 @@ int XIACache::write_param(const String &conf, Element *e, void *vparam,
             f->_local_addr = local_addr;
             //click_chatter("%s",local_addr.unparse().c_str());
             f->_local_hid = local_addr.xid(local_addr.destination_node());
+            f->_content_module->local_addr_changed();
             
             
         } break;
@@ -193,6 +231,39 @@ XIACache::read_handler(Element *e, void *thunk)
 		case MALICIOUS:
 			return String(c->get_malicious());
 
+		case HIT_RATIO: {
+			XIAContentModule *cm = c->_content_module;
+			return String(cm->_requests ? (double) cm->_hits / cm->_requests : 0.);
+		}
+
+		case ADMISSION_RATE: {
+			XIAContentModule *cm = c->_content_module;
+			uint32_t decisions = cm->_admitted + cm->_rejected;
+			return String(decisions ? (double) cm->_admitted / decisions : 1.);
+		}
+
+		case DISK_CHUNKS:
+			return String(c->_content_module->_store.chunks());
+
+		case DISK_BYTES:
+			return String(c->_content_module->_store.bytes());
+
+		case EXPIRY_PENDING: {
+			XIAContentModule *cm = c->_content_module;
+			return String(cm->_partialExpiry.size() + cm->_contentExpiry.size());
+		}
+
+		case EXPIRY_VISITS: {
+			XIAContentModule *cm = c->_content_module;
+			return String(cm->_partialExpiry.visits() + cm->_contentExpiry.visits());
+		}
+
+		case EXPIRY_MAX_VISITS: {
+			XIAContentModule *cm = c->_content_module;
+			uint32_t p = cm->_partialExpiry.max_visits(), m = cm->_contentExpiry.max_visits();
+			return String(p > m ? p : m);
+		}
+
 		default:
 			return "<error>";
     }
@@ -202,6 +273,20 @@ void XIACache::add_handlers() {
     add_write_handler("local_addr", write_param, (void *)H_MOVE);
 	add_write_handler("malicious", write_param, (void*)MALICIOUS);
 	add_read_handler("malicious", read_handler, (void*)MALICIOUS);
+	add_data_handlers("requests", Handler::OP_READ, &_content_module->_requests);
+	add_data_handlers("hits", Handler::OP_READ, &_content_module->_hits);
+	add_data_handlers("admitted", Handler::OP_READ, &_content_module->_admitted);
+	add_data_handlers("rejected", Handler::OP_READ, &_content_module->_rejected);
+	add_read_handler("hit_ratio", read_handler, (void*)HIT_RATIO);
+	add_read_handler("admission_rate", read_handler, (void*)ADMISSION_RATE);
+	add_data_handlers("demoted", Handler::OP_READ, &_content_module->_demoted);
+	add_data_handlers("promoted", Handler::OP_READ, &_content_module->_promoted);
+	add_read_handler("disk_chunks", read_handler, (void*)DISK_CHUNKS);
+	add_read_handler("disk_bytes", read_handler, (void*)DISK_BYTES);
+	add_data_handlers("expired", Handler::OP_READ, &_content_module->_expired);
+	add_read_handler("expiry_pending", read_handler, (void*)EXPIRY_PENDING);
+	add_read_handler("expiry_visits", read_handler, (void*)EXPIRY_VISITS);
+	add_read_handler("expiry_max_visits", read_handler, (void*)EXPIRY_MAX_VISITS);
 }
 
 
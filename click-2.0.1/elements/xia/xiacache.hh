@@ -26,6 +26,21 @@ XIATransport:   input port[0]:  get CID request or reponse from network, should
 output[0] : if the cache has the chunk, it will serve the CID request by pushing chunk pkts to RouteEngine
 input port[1]:  connect with RPC, in server, the RPC will pushCID into cache before serve it.
 output port[1]: connect with RPC, in client, when a chunk is complete, cache will push it to RPC (higher level)
+
+Keywords:
+POLICY: router cache eviction policy, LRU (default), FIFO, CLOCK, S3FIFO or GDSF
+ADMISSION, ADMISSION_ENTRIES: admit chunks into a full router cache only if they look more
+    popular than the chunk they would evict, tracking about ADMISSION_ENTRIES chunks (65536)
+PACKET_SIZE: largest response packet to the network, headers included (1024)
+PACING_RATE, PACING_BURST: send each response to the network at PACING_RATE, in bursts of up
+    to PACING_BURST bytes (eight packets).  By default responses are not paced.
+DISK_CACHE, DISK_SIZE: keep chunks evicted from memory in a log of DISK_SIZE bytes (4GB) in
+    the file DISK_CACHE, and read them back when requested.  The chunks in the file are
+    served again after a restart.
+PARTIAL_TIMEOUT: drop a partial chunk nobody filled for this long (10s)
+IDLE_TIMEOUT: drop a cached chunk nobody requested for this long (5min); 0 keeps chunks
+    until they are evicted.  Chunks put by local applications only expire with the TTL
+    of their cache slice.
 */
 
 class XIAContentModule;    
@@ -38,6 +53,7 @@ class XIACache : public Element {
     const char *port_count() const		{ return "2/2"; }
     const char *processing() const		{ return PUSH; }
     int configure(Vector<String> &, ErrorHandler *);         
+    int initialize(ErrorHandler *);
     void push(int port, Packet *);            
     XID local_hid() { return _local_hid; };
     XIAPath local_addr() { return _local_addr; };
@@ -0,0 +1,380 @@
+/*
+ * xiacacheevictor.{cc,hh} -- eviction order for cached chunks
+ */
+
+#include <click/config.h>
+#include "xiacacheevictor.hh"
+CLICK_DECLS
+
+static const char * const policy_names[] = {
+    "LRU", "FIFO", "CLOCK", "S3FIFO", "GDSF"
+};
+
+XIACacheEvictor::XIACacheEvictor(Policy policy)
+    : _policy(policy), _count(0), _bytes(0), _small_bytes(0), _inflation(0)
+{
+    for (int q = 0; q < NQUEUES; q++)
+	_queue_count[q] = 0;
+}
+
+XIACacheEvictor::~XIACacheEvictor()
+{
+    clear();
+}
+
+bool
+XIACacheEvictor::parse_policy(const String &str, Policy &policy)
+{
+    String name = str.upper();
+    for (int i = 0; i <= GDSF; i++)
+	if (name == policy_names[i]) {
+	    policy = (Policy) i;
+	    return true;
+	}
+    return false;
+}
+
+const char *
+XIACacheEvictor::policy_name(Policy policy)
+{
+    return policy_names[policy];
+}
+
+void
+XIACacheEvictor::clear()
+{
+    for (HashTable<XID, Entry *>::iterator it = _index.begin(); it != _index.end(); ++it)
+	delete it.value();
+    _index.clear();
+    for (int q = 0; q < NQUEUES; q++) {
+	_queue[q].__clear();
+	_queue_count[q] = 0;
+    }
+    _heap.clear();
+    _count = 0;
+    _bytes = _small_bytes = 0;
+    _inflation = 0;
+}
+
+inline XIACacheEvictor::Entry *
+XIACacheEvictor::find(const XID &xid) const
+{
+    Entry *e = _index.get(xid);
+    return e && e->queue != GHOST ? e : 0;
+}
+
+bool
+XIACacheEvictor::contains(const XID &xid) const
+{
+    return find(xid) != 0;
+}
+
+inline void
+XIACacheEvictor::unlink(Entry *e)
+{
+    _queue[e->queue].erase(e);
+    _queue_count[e->queue]--;
+    if (e->queue == SMALL)
+	_small_bytes -= e->size;
+}
+
+inline void
+XIACacheEvictor::push(Entry *e, int queue)
+{
+    e->queue = queue;
+    _queue[queue].push_back(e);
+    _queue_count[queue]++;
+    if (queue == SMALL)
+	_small_bytes += e->size;
+}
+
+void
+XIACacheEvictor::drop(Entry *e)
+{
+    // forget a resident chunk entirely
+    if (_policy == GDSF)
+	heap_remove(e);
+    else
+	unlink(e);
+    _count--;
+    _bytes -= e->size;
+    _index.erase(e->xid);
+    delete e;
+}
+
+void
+XIACacheEvictor::make_ghost(Entry *e)
+{
+    // an S3FIFO victim from the small queue: keep its name, not its bytes
+    _count--;
+    _bytes -= e->size;
+    push(e, GHOST);
+
+    // remember about as many ghosts as the main queue holds chunks
+    while (_queue_count[GHOST] > _queue_count[MAIN] + 1) {
+	Entry *g = _queue[GHOST].front();
+	unlink(g);
+	_index.erase(g->xid);
+	delete g;
+    }
+}
+
+uint64_t
+XIACacheEvictor::gdsf_priority(const Entry *e) const
+{
+    // L + hits / size in 32.32 fixed point; cost is taken to be 1
+    uint64_t hits = e->hits < 0x7FFFFFFF ? e->hits : 0x7FFFFFFF;
+    return _inflation + (hits << GDSF_SHIFT) / (e->size ? e->size : 1);
+}
+
+inline void
+XIACacheEvictor::heap_place(Entry *e, int i)
+{
+    _heap[i] = e;
+    e->heap_index = i;
+}
+
+void
+XIACacheEvictor::heap_up(int i)
+{
+    Entry *e = _heap[i];
+    while (i > 0) {
+	int parent = (i - 1) / 2;
+	if (_heap[parent]->priority <= e->priority)
+	    break;
+	heap_place(_heap[parent], i);
+	i = parent;
+    }
+    heap_place(e, i);
+}
+
+void
+XIACacheEvictor::heap_down(int i)
+{
+    Entry *e = _heap[i];
+    int n = _heap.size();
+    while (1) {
+	int child = 2 * i + 1;
+	if (child >= n)
+	    break;
+	if (child + 1 < n && _heap[child + 1]->priority < _heap[child]->priority)
+	    child++;
+	if (e->priority <= _heap[child]->priority)
+	    break;
+	heap_place(_heap[child], i);
+	i = child;
+    }
+    heap_place(e, i);
+}
+
+void
+XIACacheEvictor::heap_remove(Entry *e)
+{
+    int i = e->heap_index;
+    Entry *last = _heap.back();
+    _heap.pop_back();
+    if (last != e) {
+	heap_place(last, i);
+	heap_up(i);
+	heap_down(last->heap_index);
+    }
+}
+
+void
+XIACacheEvictor::insert(const XID &xid, uint32_t size)
+{
+    Entry *e = _index.get(xid);
+    if (e && e->queue != GHOST) {
+	_bytes = _bytes - e->size + size;
+	if (e->queue == SMALL)
+	    _small_bytes = _small_bytes - e->size + size;
+	e->size = size;
+	touch(xid);
+	return;
+    }
+
+    bool ghost = e != 0;
+    if (ghost)
+	unlink(e);
+    else {
+	e = new Entry;
+	e->xid = xid;
+	_index.set(xid, e);
+    }
+    e->size = size;
+    e->freq = 0;
+    e->hits = 1;
+    _count++;
+    _bytes += size;
+
+    if (_policy == GDSF) {
+	e->queue = MAIN;
+	e->priority = gdsf_priority(e);
+	_heap.push_back(e);
+	heap_up(_heap.size() - 1);
+    } else if (_policy == S3FIFO && !ghost)
+	push(e, SMALL);
+    else
+	push(e, MAIN);
+}
+
+void
+XIACacheEvictor::touch(const XID &xid)
+{
+    Entry *e = find(xid);
+    if (!e)
+	return;
+    switch (_policy) {
+    case LRU:
+	_queue[MAIN].erase(e);
+	_queue[MAIN].push_back(e);
+	break;
+    case FIFO:
+	break;
+    case CLOCK:
+	e->freq = 1;
+	break;
+    case S3FIFO:
+	if (e->freq < MAX_FREQ)
+	    e->freq++;
+	break;
+    case GDSF:
+	e->hits++;
+	e->priority = gdsf_priority(e);
+	heap_down(e->heap_index);
+	break;
+    }
+}
+
+bool
+XIACacheEvictor::remove(const XID &xid)
+{
+    Entry *e = find(xid);
+    if (!e)
+	return false;
+    drop(e);
+    return true;
+}
+
+bool
+XIACacheEvictor::evict(XID &xid, uint32_t &size)
+{
+    if (!_count)
+	return false;
+
+    Entry *victim = 0;
+    switch (_policy) {
+    case LRU:
+    case FIFO:
+	victim = _queue[MAIN].front();
+	break;
+    case CLOCK:
+	// second chance: every pass clears a bit, so this ends within a lap
+	while (_queue[MAIN].front()->freq) {
+	    Entry *e = _queue[MAIN].front();
+	    e->freq = 0;
+	    _queue[MAIN].pop_front();
+	    _queue[MAIN].push_back(e);
+	}
+	victim = _queue[MAIN].front();
+	break;
+    case S3FIFO:
+	while (!victim) {
+	    if (_queue_count[SMALL]
+		&& (_small_bytes * 10 >= _bytes || !_queue_count[MAIN])) {
+		Entry *e = _queue[SMALL].front();
+		unlink(e);
+		if (e->freq > 1) {
+		    e->freq = 0;
+		    push(e, MAIN);
+		    continue;
+		}
+		xid = e->xid;
+		size = e->size;
+		make_ghost(e);
+		return true;
+	    }
+	    Entry *e = _queue[MAIN].front();
+	    if (e->freq) {
+		e->freq--;
+		_queue[MAIN].pop_front();
+		_queue[MAIN].push_back(e);
+	    } else
+		victim = e;
+	}
+	break;
+    case GDSF:
+	victim = _heap[0];
+	_inflation = victim->priority;
+	break;
+    }
+
+    xid = victim->xid;
+    size = victim->size;
+    drop(victim);
+    return true;
+}
+
+bool
+XIACacheEvictor::peek(XID &xid) const
+{
+    if (!_count)
+	return false;
+    if (_policy == GDSF)
+	xid = _heap[0]->xid;
+    else if (_policy == S3FIFO && _queue_count[SMALL]
+	     && (_small_bytes * 10 >= _bytes || !_queue_count[MAIN]))
+	xid = _queue[SMALL].front()->xid;
+    else
+	xid = _queue[MAIN].front()->xid;
+    return true;
+}
+
+void
+XIACacheEvictor::set_policy(Policy policy)
+{
+    if (policy == _policy)
+	return;
+
+    // collect resident chunks in their current order, forgetting ghosts
+    Vector<Entry *> order;
+    if (_policy == GDSF)
+	// heap order is not priority order; pop it
+	while (_heap.size()) {
+	    Entry *e = _heap[0];
+	    heap_remove(e);
+	    order.push_back(e);
+	}
+    else
+	for (int q = SMALL; q <= MAIN; q++)
+	    while (_queue_count[q]) {
+		Entry *e = _queue[q].front();
+		unlink(e);
+		order.push_back(e);
+	    }
+    while (_queue_count[GHOST]) {
+	Entry *g = _queue[GHOST].front();
+	unlink(g);
+	_index.erase(g->xid);
+	delete g;
+    }
+    _heap.clear();
+    _small_bytes = 0;
+    _inflation = 0;
+
+    _policy = policy;
+    for (int i = 0; i < order.size(); i++) {
+	Entry *e = order[i];
+	e->freq = 0;
+	if (policy == GDSF) {
+	    e->queue = MAIN;
+	    e->priority = gdsf_priority(e);
+	    _heap.push_back(e);
+	    heap_up(_heap.size() - 1);
+	} else
+	    push(e, MAIN);
+    }
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(XIACacheEvictor)
@@ -0,0 +1,129 @@
+#ifndef CLICK_XIACACHEEVICTOR_HH
+#define CLICK_XIACACHEEVICTOR_HH
+#include <click/glue.hh>
+#include <click/hashtable.hh>
+#include <click/list.hh>
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <click/xid.hh>
+CLICK_DECLS
+
+/*
+ * XIACacheEvictor -- eviction order for cached chunks
+ *
+ * Tracks a set of chunks by CID and size and picks the next one to evict.
+ * The evictor does not own the chunks: callers insert() a chunk when they
+ * cache it, touch() it on every hit, remove() it when they drop it for their
+ * own reasons, and call evict() when they need room.
+ *
+ * Policies:
+ *
+ *   LRU      least recently inserted or touched first.
+ *   FIFO     oldest insertion first; hits do not matter.
+ *   CLOCK    FIFO with a reference bit: a chunk hit since the hand last
+ *	      passed it is skipped once.
+ *   S3FIFO   new chunks enter a small FIFO holding about 10% of the bytes;
+ *	      chunks hit more than once there move to the main FIFO, others
+ *	      are evicted and remembered as ghosts, and a ghost that comes back
+ *	      goes straight to the main FIFO.  The main FIFO gives chunks with
+ *	      hits another round (see Yang et al., SOSP 2023).
+ *   GDSF     GreedyDual-Size-Frequency: the chunk with the lowest
+ *	      L + hits / size goes first, where L is the priority of the last
+ *	      victim, so small popular chunks stay and large cold ones leave.
+ *
+ * Every operation takes constant time, except under GDSF, where the
+ * priority heap makes insert, touch, remove and evict logarithmic.  CLOCK
+ * and S3FIFO evictions are constant amortized.
+ *
+ * XIACacheEvictor is used by XIAContentModule; it is not an element.
+ */
+
+class XIACacheEvictor { public:
+
+    enum Policy { LRU = 0, FIFO, CLOCK, S3FIFO, GDSF };
+
+    XIACacheEvictor(Policy policy = LRU);
+    ~XIACacheEvictor();
+
+    /** @brief Parse a policy name (case insensitive).  Returns false if
+     * @a str names no policy. */
+    static bool parse_policy(const String &str, Policy &policy);
+    static const char *policy_name(Policy policy);
+
+    /** @brief Change the policy.  Chunks already tracked are kept in their
+     * current eviction order. */
+    void set_policy(Policy policy);
+    Policy policy() const		{ return _policy; }
+
+    int size() const			{ return _count; }
+    uint64_t bytes() const		{ return _bytes; }
+    bool contains(const XID &xid) const;
+
+    /** @brief Start tracking chunk @a xid of @a size bytes.  A chunk that
+     * is already tracked is updated to @a size and counts as a hit. */
+    void insert(const XID &xid, uint32_t size);
+    void touch(const XID &xid);
+    /** @brief Stop tracking @a xid.  Returns false if it was not tracked. */
+    bool remove(const XID &xid);
+
+    /** @brief Choose a victim, stop tracking it and return it in @a xid
+     * and @a size.  Returns false if nothing is tracked. */
+    bool evict(XID &xid, uint32_t &size);
+
+    /** @brief Return the chunk evict() would look at next, without changing
+     * anything.  Returns false if nothing is tracked.
+     *
+     * Under LRU, FIFO and GDSF this is the next victim.  CLOCK and S3FIFO
+     * may still give it another round. */
+    bool peek(XID &xid) const;
+
+    void clear();
+
+  private:
+
+    enum { SMALL = 0, MAIN, GHOST, NQUEUES };
+    enum { MAX_FREQ = 3, GDSF_SHIFT = 32 };
+
+    struct Entry {
+	XID xid;
+	uint32_t size;
+	uint8_t queue;		// S3FIFO queue; MAIN for the other policies
+	uint8_t freq;		// CLOCK reference bit, S3FIFO hit count
+	uint32_t hits;		// GDSF
+	uint64_t priority;	// GDSF
+	int heap_index;		// GDSF
+	List_member<Entry> link;
+    };
+
+    typedef List<Entry, &Entry::link> EntryList;
+
+    Policy _policy;
+    HashTable<XID, Entry *> _index;	// resident chunks and ghosts
+    EntryList _queue[NQUEUES];
+    int _queue_count[NQUEUES];
+    int _count;				// resident chunks
+    uint64_t _bytes;
+    uint64_t _small_bytes;
+
+    Vector<Entry *> _heap;		// GDSF min-heap on priority
+    uint64_t _inflation;		// GDSF L
+
+    Entry *find(const XID &xid) const;
+    void unlink(Entry *e);
+    void push(Entry *e, int queue);
+    void drop(Entry *e);
+    void make_ghost(Entry *e);
+
+    uint64_t gdsf_priority(const Entry *e) const;
+    void heap_place(Entry *e, int i);
+    void heap_up(int i);
+    void heap_down(int i);
+    void heap_remove(Entry *e);
+
+    XIACacheEvictor(const XIACacheEvictor &);
+    XIACacheEvictor &operator=(const XIACacheEvictor &);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -23,22 +23,7 @@ XIACheckDest::push(int, Packet *p)
 {
     const struct click_xia* hdr = p->xia_header();
 
-	// commented out for microbenchmarks
-    /*
-    if (!hdr)
-    {
-        p->kill();
-        return;
-    }
-
-    if (hdr->last >= (int)hdr->dnode)
-    {
-        // invalid packet
-        click_chatter("packet killed due to invalid last pointer\n");
-        p->kill();
-        return;
-    }
-    */
+    // MarkXIAHeader has already checked last against dnode
 
 	// The definition of the destination is the node without any outgoing edge,
 	// but we can also determine if the last visited node is pointing to the last node in the destination DAG
@@ -49,6 +34,22 @@ XIACheckDest::push(int, Packet *p)
         output(1).push(p);
 }
 
+void
+XIACheckDest::push_batch(int, Packet *head)
+{
+    Packet *pkts[MAX_BATCH];
+    int ports[MAX_BATCH];
+    while (head) {
+        int n = take_batch(head, pkts);
+        for (int i = 0; i < n; i++) {
+            const struct click_xia* hdr = pkts[i]->xia_header();
+            ports[i] = hdr->last == (int)hdr->dnode - 1 ? 0 : 1;
+        }
+        output_push_sorted(pkts, ports, n);
+    }
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(XIACheckDest)
+ELEMENT_REQUIRES(XIABatchElement)
 ELEMENT_MT_SAFE(XIACheckDest)
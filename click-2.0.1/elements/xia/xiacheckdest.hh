@@ -4,6 +4,7 @@
 #include <click/hashtable.hh>
 #include <clicknet/xia.h>
 #include <click/xid.hh>
+#include "xiabatch.hh"
 CLICK_DECLS
 
 /*
@@ -25,7 +26,7 @@ or port 1 otherwise.
 =a 
 */
 
-class XIACheckDest : public Element { public:
+class XIACheckDest : public XIABatchElement { public:
 
     XIACheckDest();
     ~XIACheckDest();
@@ -35,6 +36,7 @@ class XIACheckDest : public Element { public:
     const char *processing() const		{ return PUSH; }
 
     void push(int port, Packet *);
+    void push_batch(int port, Packet *head);
 
   protected:
     int lookup(Packet *);
@@ -0,0 +1,476 @@
+/*
+ * xiachunkstore.{cc,hh} -- on-disk second tier for the router content cache
+ */
+
+#include <click/config.h>
+#include "xiachunkstore.hh"
+#include "xiacontentmodule.hh"
+#include <click/error.hh>
+#if CLICK_USERLEVEL
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+# if HAVE_MMAP
+#  include <sys/mman.h>
+# endif
+#endif
+CLICK_DECLS
+
+/*
+ * File format, in host byte order:
+ *
+ *   Superblock, padded to SUPERBLOCK bytes
+ *   the log: capacity bytes of records, each starting at a multiple of ALIGN
+ *
+ * A record is a RecordHeader followed by the chunk.  Records are written
+ * data first, header last, and a record counts only if both checksums match,
+ * so a torn write or a half-overwritten record is skipped on recovery.
+ */
+struct XIAChunkStore::Superblock {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t align;
+    uint64_t capacity;
+};
+
+struct XIAChunkStore::RecordHeader {
+    char magic[4];
+    uint32_t length;
+    uint64_t seq;
+    struct click_xia_xid xid;
+    uint64_t data_hash;
+    uint64_t header_hash;		// of the fields above
+};
+
+static const char superblock_magic[4] = {'X', 'C', 'S', 'T'};
+static const char record_magic[4] = {'X', 'C', 'R', 'D'};
+static const uint32_t byte_order_mark = 0x01020304;
+
+static uint64_t
+hash_bytes(const unsigned char *p, size_t n)
+{
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ n;
+    for (; n >= 8; p += 8, n -= 8) {
+	uint64_t w;
+	memcpy(&w, p, 8);
+	h = (h ^ w) * 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 29;
+    }
+    for (; n; p++, n--)
+	h = (h ^ *p) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 32);
+}
+
+inline uint64_t
+XIAChunkStore::header_hash(const RecordHeader *h)
+{
+    return hash_bytes(reinterpret_cast<const unsigned char *>(h),
+		      offsetof(RecordHeader, header_hash));
+}
+
+inline uint64_t
+XIAChunkStore::record_size(uint32_t length)
+{
+    uint64_t size = sizeof(RecordHeader) + (uint64_t) length;
+    return (size + ALIGN - 1) & ~((uint64_t) ALIGN - 1);
+}
+
+XIAChunkStore::XIAChunkStore()
+    : _fd(-1), _map(0), _map_len(0), _log(0), _capacity(0), _head(0),
+      _seq(1), _bytes(0), _fetching(0)
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    _running = _stop = false;
+#endif
+}
+
+XIAChunkStore::~XIAChunkStore()
+{
+    close();
+}
+
+int
+XIAChunkStore::open(const String &filename, uint64_t capacity, ErrorHandler *errh)
+{
+    close();
+#if CLICK_USERLEVEL && HAVE_MMAP
+    capacity &= ~((uint64_t) ALIGN - 1);
+    if (capacity < ALIGN)
+	return errh->error("%s: store too small", filename.c_str());
+
+    int fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+	return errh->error("%s: %s", filename.c_str(), strerror(errno));
+
+    // a file of another size or format starts over, zeroed
+    size_t len = SUPERBLOCK + capacity;
+    struct stat st;
+    Superblock sb;
+    bool fresh = fstat(fd, &st) < 0 || (uint64_t) st.st_size != len
+	|| pread(fd, &sb, sizeof(sb), 0) != (ssize_t) sizeof(sb)
+	|| memcmp(sb.magic, superblock_magic, 4) != 0 || sb.version != VERSION
+	|| sb.byte_order != byte_order_mark || sb.align != ALIGN
+	|| sb.capacity != capacity;
+    if (fresh && st.st_size)
+	errh->warning("%s: not a chunk store of this size, starting over", filename.c_str());
+    if (fresh && (ftruncate(fd, 0) < 0 || ftruncate(fd, len) < 0)) {
+	int err = errno;
+	::close(fd);
+	return errh->error("%s: %s", filename.c_str(), strerror(err));
+    }
+
+    void *map = mmap(0, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+	int err = errno;
+	::close(fd);
+	return errh->error("%s: %s", filename.c_str(), strerror(err));
+    }
+    _fd = fd;
+    _map = reinterpret_cast<unsigned char *>(map);
+    _map_len = len;
+    _log = _map + SUPERBLOCK;
+    _capacity = capacity;
+
+    if (fresh) {
+	memcpy(sb.magic, superblock_magic, 4);
+	sb.version = VERSION;
+	sb.byte_order = byte_order_mark;
+	sb.align = ALIGN;
+	sb.capacity = capacity;
+	memcpy(_map, &sb, sizeof(sb));
+    } else
+	recover();
+
+# if HAVE_MULTITHREAD
+    pthread_mutex_init(&_mutex, 0);
+    pthread_cond_init(&_cond, 0);
+    _stop = false;
+    _running = pthread_create(&_worker, 0, worker, this) == 0;
+    if (!_running) {
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_mutex);
+    }
+# endif
+    return 0;
+#else
+    (void) capacity;
+    return errh->error("%s: chunk stores need user-level Click with mmap", filename.c_str());
+#endif
+}
+
+void
+XIAChunkStore::close()
+{
+    if (!_log)
+	return;
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    if (_running) {
+	pthread_mutex_lock(&_mutex);
+	_stop = true;
+	pthread_cond_signal(&_cond);
+	pthread_mutex_unlock(&_mutex);
+	pthread_join(_worker, 0);
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_mutex);
+	_running = false;
+    }
+#endif
+    // the worker finished every write; reads nobody will poll are dropped
+    while (_done.size()) {
+	delete _done.front().chunk;
+	_done.pop_front();
+    }
+#if CLICK_USERLEVEL && HAVE_MMAP
+    munmap(_map, _map_len);
+    ::close(_fd);
+#endif
+    while (!_order.empty()) {
+	Record *r = _order.front();
+	_order.pop_front();
+	delete r;
+    }
+    _index.clear();
+    _fd = -1;
+    _map = _log = 0;
+    _capacity = _head = _bytes = 0;
+    _fetching = 0;
+}
+
+bool
+XIAChunkStore::valid_header(const RecordHeader *h, uint64_t offset) const
+{
+    return memcmp(h->magic, record_magic, 4) == 0
+	&& h->length <= _capacity
+	&& offset + record_size(h->length) <= _capacity
+	&& h->header_hash == header_hash(h);
+}
+
+int
+XIAChunkStore::compare_records(const void *a, const void *b, void *thunk)
+{
+    // log order, starting at the write head
+    uint64_t head = *reinterpret_cast<const uint64_t *>(thunk);
+    uint64_t ao = (*reinterpret_cast<Record * const *>(a))->offset;
+    uint64_t bo = (*reinterpret_cast<Record * const *>(b))->offset;
+    ao += ao < head ? (uint64_t) 1 << 63 : 0;
+    bo += bo < head ? (uint64_t) 1 << 63 : 0;
+    return ao < bo ? -1 : ao > bo;
+}
+
+void
+XIAChunkStore::recover()
+{
+    // find every intact record; the newest one ends where writing resumes
+    Vector<Record *> found;
+    Record *newest = 0;
+    for (uint64_t off = 0; off + sizeof(RecordHeader) <= _capacity; ) {
+	const RecordHeader *h = reinterpret_cast<const RecordHeader *>(_log + off);
+	if (!valid_header(h, off)
+	    || hash_bytes(_log + off + sizeof(RecordHeader), h->length) != h->data_hash) {
+	    off += ALIGN;
+	    continue;
+	}
+	Record *r = new Record;
+	r->xid = XID(h->xid);
+	r->offset = off;
+	r->size = record_size(h->length);
+	r->length = h->length;
+	r->seq = h->seq;
+	r->live = false;
+	found.push_back(r);
+	if (!newest || r->seq > newest->seq)
+	    newest = r;
+	off += r->size;
+    }
+    if (!newest)
+	return;
+    _head = newest->offset + newest->size;
+    if (_head == _capacity)
+	_head = 0;
+    _seq = newest->seq + 1;
+
+    click_qsort(found.begin(), found.size(), sizeof(Record *), compare_records, &_head);
+    for (int i = 0; i < found.size(); i++) {
+	Record *r = found[i];
+	_order.push_back(r);
+	Record *old = _index.get(r->xid);
+	if (old && old->seq > r->seq)
+	    continue;
+	if (old) {
+	    old->live = false;
+	    _bytes -= old->length;
+	}
+	r->live = true;
+	_index.set(r->xid, r);
+	_bytes += r->length;
+    }
+}
+
+void
+XIAChunkStore::list(Vector<XID> &xids) const
+{
+    for (HashTable<XID, Record *>::const_iterator it = _index.begin(); it != _index.end(); ++it)
+	xids.push_back(it.key());
+}
+
+void
+XIAChunkStore::forget(Record *r)
+{
+    if (r->live) {
+	_index.erase(r->xid);
+	_bytes -= r->length;
+	r->live = false;
+    }
+}
+
+void
+XIAChunkStore::drop_front(Vector<XID> &dropped)
+{
+    Record *r = _order.front();
+    _order.pop_front();
+    if (r->live)
+	dropped.push_back(r->xid);
+    forget(r);
+    delete r;
+}
+
+bool
+XIAChunkStore::store(CChunk *chunk, Vector<XID> &dropped)
+{
+    XID xid = chunk->id();
+    if (!_log || !chunk->full())
+	return false;
+    if (contains(xid)) {
+	// chunks are named by their content, so the stored copy will do
+	delete chunk;
+	return true;
+    }
+    uint64_t size = record_size(chunk->GetSize());
+    if (size > _capacity)
+	return false;
+
+    // overwrite the oldest records, wrapping around at the end of the log
+    if (_head + size > _capacity) {
+	while (!_order.empty() && _order.front()->offset >= _head)
+	    drop_front(dropped);
+	_head = 0;
+    }
+    while (!_order.empty() && _order.front()->offset >= _head
+	   && _order.front()->offset < _head + size)
+	drop_front(dropped);
+
+    Record *r = new Record;
+    r->xid = xid;
+    r->offset = _head;
+    r->size = size;
+    r->length = chunk->GetSize();
+    r->seq = _seq++;
+    r->live = true;
+    _order.push_back(r);
+    _index.set(xid, r);
+    _bytes += r->length;
+    _head += size;
+    if (_head == _capacity)
+	_head = 0;
+
+    // the worker must not share the chunk's strings with this thread
+    chunk->response = ChunkResponseTemplate();
+    Job job;
+    job.op = J_WRITE;
+    job.xid = xid;
+    job.offset = r->offset;
+    job.length = r->length;
+    job.seq = r->seq;
+    job.chunk = chunk;
+    submit(job);
+    return true;
+}
+
+bool
+XIAChunkStore::fetch(const XID &xid)
+{
+    Record *r = _index.get(xid);
+    if (!r)
+	return false;
+    Job job;
+    job.op = J_READ;
+    job.xid = xid;
+    job.offset = r->offset;
+    job.length = r->length;
+    job.seq = r->seq;
+    job.chunk = 0;
+    _fetching++;
+    submit(job);
+    return true;
+}
+
+bool
+XIAChunkStore::poll(XID &xid, CChunk *&chunk)
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    if (_running)
+	pthread_mutex_lock(&_mutex);
+#endif
+    bool found = _done.size() != 0;
+    Job job;
+    if (found) {
+	job = _done.front();
+	_done.pop_front();
+    }
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    if (_running)
+	pthread_mutex_unlock(&_mutex);
+#endif
+    if (!found)
+	return false;
+
+    _fetching--;
+    xid = job.xid;
+    chunk = job.chunk;
+    if (!chunk) {
+	Record *r = _index.get(xid);
+	if (r && r->seq == job.seq)
+	    forget(r);
+    }
+    return true;
+}
+
+void
+XIAChunkStore::submit(const Job &job)
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    if (_running) {
+	pthread_mutex_lock(&_mutex);
+	_jobs.push_back(job);
+	pthread_cond_signal(&_cond);
+	pthread_mutex_unlock(&_mutex);
+	return;
+    }
+#endif
+    Job j = job;
+    run(j);
+    if (j.op == J_READ)
+	_done.push_back(j);
+}
+
+/* Do one job.  Runs on the worker thread, if any, and touches only the log
+   and the job. */
+void
+XIAChunkStore::run(Job &job)
+{
+    RecordHeader *h = reinterpret_cast<RecordHeader *>(_log + job.offset);
+    unsigned char *data = _log + job.offset + sizeof(RecordHeader);
+
+    if (job.op == J_WRITE) {
+	CChunk *chunk = job.chunk;
+	memset(h, 0, sizeof(RecordHeader));
+	chunk->copy(data);
+	memcpy(h->magic, record_magic, 4);
+	h->length = job.length;
+	h->seq = job.seq;
+	h->xid = job.xid.xid();
+	h->data_hash = hash_bytes(data, job.length);
+	h->header_hash = header_hash(h);
+	job.chunk = 0;
+	delete chunk;
+	return;
+    }
+
+    // the record may have been overwritten since the read was queued
+    job.chunk = 0;
+    if (!valid_header(h, job.offset) || h->seq != job.seq || h->length != job.length
+	|| XID(h->xid) != job.xid || hash_bytes(data, job.length) != h->data_hash)
+	return;
+    CChunk *chunk = new CChunk(job.xid, job.length, XIAContentModule::segmentSize());
+    chunk->fill(data, 0, job.length);
+    job.chunk = chunk;
+}
+
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+void *
+XIAChunkStore::worker(void *arg)
+{
+    XIAChunkStore *s = static_cast<XIAChunkStore *>(arg);
+    pthread_mutex_lock(&s->_mutex);
+    while (1) {
+	while (!s->_jobs.size() && !s->_stop)
+	    pthread_cond_wait(&s->_cond, &s->_mutex);
+	if (!s->_jobs.size())
+	    break;
+	Job job = s->_jobs.front();
+	s->_jobs.pop_front();
+	pthread_mutex_unlock(&s->_mutex);
+	s->run(job);
+	pthread_mutex_lock(&s->_mutex);
+	if (job.op == J_READ)
+	    s->_done.push_back(job);
+    }
+    pthread_mutex_unlock(&s->_mutex);
+    return 0;
+}
+#endif
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(XIAChunkStore)
@@ -0,0 +1,137 @@
+#ifndef CLICK_XIACHUNKSTORE_HH
+#define CLICK_XIACHUNKSTORE_HH
+#include <click/glue.hh>
+#include <click/hashtable.hh>
+#include <click/list.hh>
+#include <click/dequeue.hh>
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <click/xid.hh>
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+# include <pthread.h>
+#endif
+CLICK_DECLS
+class CChunk;
+class ErrorHandler;
+
+/*
+ * XIAChunkStore -- on-disk second tier for the router content cache
+ *
+ * Chunks evicted from memory are appended to a circular log in a
+ * memory-mapped file, and an in-memory index maps each CID to its record.
+ * When the log wraps, the oldest records are overwritten and forgotten, so
+ * the disk tier evicts in FIFO order.  Every record carries a sequence
+ * number and checksums of its header and data; open() rebuilds the index
+ * by scanning the log, so a warm cache survives a restart.
+ *
+ * Disk I/O runs on a worker thread when Click is built with threads, so the
+ * caller never waits for the disk: store() hands a chunk over and returns,
+ * and fetch() queues a read whose result poll() returns later.  Everything
+ * else, the index included, belongs to the caller's thread.
+ *
+ * XIAChunkStore is used by XIAContentModule; it is not an element.
+ */
+
+class XIAChunkStore { public:
+
+    XIAChunkStore();
+    ~XIAChunkStore();
+
+    /** @brief Open the store in @a filename, creating it with room for
+     * @a capacity bytes of records if it does not hold a store of that
+     * size, and recover the chunks it holds.  Returns 0 or a negative
+     * error, reported to @a errh. */
+    int open(const String &filename, uint64_t capacity, ErrorHandler *errh);
+    /** @brief Finish queued writes and close the store. */
+    void close();
+    bool is_open() const		{ return _log != 0; }
+
+    bool contains(const XID &xid) const	{ return _index.get(xid) != 0; }
+    int chunks() const			{ return _index.size(); }
+    uint64_t bytes() const		{ return _bytes; }
+    uint64_t capacity() const		{ return _capacity; }
+    /** @brief Append the stored CIDs to @a xids. */
+    void list(Vector<XID> &xids) const;
+
+    /** @brief Append @a chunk to the log and take it over.  CIDs whose
+     * records were overwritten to make room are appended to @a dropped.
+     * Returns false, leaving @a chunk with the caller, if it does not fit. */
+    bool store(CChunk *chunk, Vector<XID> &dropped);
+
+    /** @brief Start reading @a xid back.  Returns false if it is not
+     * stored. */
+    bool fetch(const XID &xid);
+    /** @brief Return a finished fetch: @a chunk is the chunk, or null if
+     * its record turned out to be lost, in which case the CID is no longer
+     * stored.  Returns false if no fetch has finished. */
+    bool poll(XID &xid, CChunk *&chunk);
+    int fetching() const		{ return _fetching; }
+
+  private:
+
+    enum { ALIGN = 512, SUPERBLOCK = 4096, VERSION = 1 };
+
+    struct Superblock;
+    struct RecordHeader;
+
+    struct Record {
+	XID xid;
+	uint64_t offset;		// in the log
+	uint32_t size;			// log bytes, header and padding included
+	uint32_t length;		// chunk bytes
+	uint64_t seq;
+	bool live;			// the CID's current record
+	List_member<Record> link;
+    };
+    typedef List<Record, &Record::link> RecordList;
+
+    enum { J_WRITE, J_READ };
+    struct Job {
+	int op;
+	XID xid;
+	uint64_t offset;
+	uint32_t length;
+	uint64_t seq;
+	CChunk *chunk;			// to write, or read
+    };
+
+    int _fd;
+    unsigned char *_map;
+    size_t _map_len;
+    unsigned char *_log;		// _map + SUPERBLOCK
+    uint64_t _capacity;
+    uint64_t _head;			// next write offset
+    uint64_t _seq;
+    uint64_t _bytes;
+    HashTable<XID, Record *> _index;	// live records
+    RecordList _order;			// records from _head on, in log order
+    int _fetching;
+
+    DEQueue<Job> _jobs;
+    DEQueue<Job> _done;
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    pthread_t _worker;
+    pthread_mutex_t _mutex;
+    pthread_cond_t _cond;
+    bool _running;
+    bool _stop;
+    static void *worker(void *);
+#endif
+
+    void recover();
+    void drop_front(Vector<XID> &dropped);
+    void forget(Record *r);
+    void submit(const Job &job);
+    void run(Job &job);
+    bool valid_header(const RecordHeader *h, uint64_t offset) const;
+    static int compare_records(const void *, const void *, void *);
+    static inline uint64_t header_hash(const RecordHeader *h);
+    static inline uint64_t record_size(uint32_t length);
+
+    XIAChunkStore(const XIAChunkStore &);
+    XIAChunkStore &operator=(const XIAChunkStore &);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,235 @@
+/*
+ * xiacongestion.{cc,hh} -- congestion control for XSOCK_STREAM connections
+ */
+
+#include <click/config.h>
+#include "xiacongestion.hh"
+#include <click/straccum.hh>
+#include <math.h>
+CLICK_DECLS
+
+static const char * const algorithm_names[] = { "newreno", "cubic" };
+
+XIACongestionControl *
+XIACongestionControl::make(Algorithm algorithm, uint32_t max_window, const Timestamp &initial_rto)
+{
+    if (algorithm == CUBIC)
+	return new XIACubic(max_window, initial_rto);
+    return new XIANewReno(max_window, initial_rto);
+}
+
+bool
+XIACongestionControl::parse(const String &str, Algorithm &algorithm)
+{
+    for (int a = 0; a < NALGORITHMS; a++)
+	if (str.equals(algorithm_names[a], -1)) {
+	    algorithm = (Algorithm) a;
+	    return true;
+	}
+    return false;
+}
+
+const char *
+XIACongestionControl::algorithm_name(Algorithm algorithm)
+{
+    return algorithm >= 0 && algorithm < NALGORITHMS ? algorithm_names[algorithm] : "unknown";
+}
+
+XIACongestionControl::XIACongestionControl(uint32_t max_window, const Timestamp &initial_rto)
+    : _cwnd(INITIAL_WINDOW), _ssthresh(max_window), _cwnd_cnt(0),
+      _max_window(max_window), _initial_rto(initial_rto), _have_rtt(false),
+      _backoff(0), _timing(false), _timed_seq(0), _recovering(false),
+      _recover(0), _dupacks(0), _retransmits(0), _fast_retransmits(0),
+      _timeouts(0)
+{
+    if (_cwnd > _max_window)
+	_cwnd = _max_window;
+}
+
+Timestamp
+XIACongestionControl::rto() const
+{
+    Timestamp rto = _initial_rto;
+    if (_have_rtt) {
+	rto = _srtt + _rttvar * 4;
+	if (rto < Timestamp::make_msec(MIN_RTO_MSEC))
+	    rto = Timestamp::make_msec(MIN_RTO_MSEC);
+    }
+    rto = rto * (1 << _backoff);
+    if (rto > Timestamp::make_msec(MAX_RTO_MSEC))
+	rto = Timestamp::make_msec(MAX_RTO_MSEC);
+    return rto;
+}
+
+void
+XIACongestionControl::sample(const Timestamp &rtt)
+{
+    if (!_have_rtt) {
+	_srtt = rtt;
+	_rttvar = rtt / 2;
+	_have_rtt = true;
+    } else {
+	Timestamp delta = _srtt > rtt ? _srtt - rtt : rtt - _srtt;
+	_rttvar = (_rttvar * 3 + delta) / 4;
+	_srtt = (_srtt * 7 + rtt) / 8;
+    }
+}
+
+XIACongestionControl::Action
+XIACongestionControl::ack(uint32_t ackno, uint32_t base, uint32_t high, const Timestamp &now)
+{
+    if (ackno > base && ackno <= high) {
+	if (_timing && ackno > _timed_seq) {
+	    sample(now - _timed_at);
+	    _timing = false;
+	}
+	_backoff = 0;
+	_dupacks = 0;
+
+	if (_recovering) {
+	    // a partial ACK means the next hole was lost as well
+	    if (ackno < _recover)
+		return RETRANSMIT;
+	    _recovering = false;
+	    _cwnd = _ssthresh;
+	    return NONE;
+	}
+
+	uint32_t acked = ackno - base;
+	if (_cwnd < _ssthresh) {
+	    uint32_t n = _ssthresh - _cwnd < acked ? _ssthresh - _cwnd : acked;
+	    _cwnd += n;
+	    acked -= n;
+	}
+	if (acked)
+	    increase(acked, now);
+	if (_cwnd > _max_window)
+	    _cwnd = _max_window;
+
+    } else if (ackno == base && high > base) {
+	if (++_dupacks == DUPACK_THRESHOLD && !_recovering && ackno >= _recover) {
+	    reduce(high - base, now);
+	    _recovering = true;
+	    _recover = high;
+	    _cwnd_cnt = 0;
+	    _fast_retransmits++;
+	    return RETRANSMIT;
+	}
+    }
+    return NONE;
+}
+
+void
+XIACongestionControl::timeout(uint32_t base, uint32_t high, const Timestamp &now)
+{
+    _timeouts++;
+    // only the first timeout for a packet says anything about the window
+    if (_backoff == 0)
+	reduce(high - base, now);
+    if (_backoff < MAX_BACKOFF)
+	_backoff++;
+    _cwnd = 1;
+    _cwnd_cnt = 0;
+    _recovering = false;
+    _recover = high;
+    _dupacks = 0;
+    _timing = false;
+}
+
+String
+XIACongestionControl::unparse() const
+{
+    StringAccum sa;
+    sa << algorithm_name(algorithm())
+       << " cwnd " << _cwnd << " ssthresh " << _ssthresh
+       << " srtt " << _srtt << " rttvar " << _rttvar << " rto " << rto()
+       << " retransmits " << _retransmits
+       << " fast_retransmits " << _fast_retransmits
+       << " timeouts " << _timeouts;
+    return sa.take_string();
+}
+
+
+void
+XIANewReno::increase(uint32_t acked, const Timestamp &)
+{
+    _cwnd_cnt += acked;
+    if (_cwnd_cnt >= _cwnd) {
+	_cwnd_cnt -= _cwnd;
+	_cwnd++;
+    }
+}
+
+void
+XIANewReno::reduce(uint32_t flight, const Timestamp &)
+{
+    _ssthresh = flight / 2 > 2 ? flight / 2 : 2;
+    _cwnd = _ssthresh;
+}
+
+
+#define CUBIC_C		0.4
+#define CUBIC_BETA	0.7
+
+XIACubic::XIACubic(uint32_t max_window, const Timestamp &initial_rto)
+    : XIACongestionControl(max_window, initial_rto),
+      _w_max(0), _w_est(0), _origin(0), _k(0)
+{
+}
+
+void
+XIACubic::increase(uint32_t acked, const Timestamp &now)
+{
+    if (!_epoch) {
+	_epoch = now;
+	if (_cwnd < _w_max) {
+	    _k = cbrt((_w_max - _cwnd) / CUBIC_C);
+	    _origin = _w_max;
+	} else {
+	    _k = 0;
+	    _origin = _cwnd;
+	}
+	_w_est = _cwnd;
+    }
+
+    // where the curve will be one RTT from now
+    double t = (now - _epoch + srtt()).doubleval() - _k;
+    double target = _origin + CUBIC_C * t * t * t;
+
+    // never slower than NewReno
+    _w_est += 3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) * acked / _cwnd;
+    if (target < _w_est)
+	target = _w_est;
+
+    // grow by one packet every cnt acked packets, and by at most half a
+    // window per RTT
+    uint32_t cnt = 100 * _cwnd;
+    if (target > _cwnd) {
+	cnt = (uint32_t) (_cwnd / (target - _cwnd));
+	if (cnt < 2)
+	    cnt = 2;
+    }
+    _cwnd_cnt += acked;
+    if (_cwnd_cnt >= cnt) {
+	_cwnd += _cwnd_cnt / cnt;
+	_cwnd_cnt %= cnt;
+    }
+}
+
+void
+XIACubic::reduce(uint32_t, const Timestamp &)
+{
+    _epoch = Timestamp();
+    // fast convergence: yield to newer flows that are still growing
+    if (_cwnd < _w_max)
+	_w_max = _cwnd * (1 + CUBIC_BETA) / 2;
+    else
+	_w_max = _cwnd;
+    _ssthresh = (uint32_t) (_cwnd * CUBIC_BETA);
+    if (_ssthresh < 2)
+	_ssthresh = 2;
+    _cwnd = _ssthresh;
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(XIACongestionControl)
@@ -0,0 +1,175 @@
+#ifndef CLICK_XIACONGESTION_HH
+#define CLICK_XIACONGESTION_HH
+#include <click/glue.hh>
+#include <click/string.hh>
+#include <click/timestamp.hh>
+CLICK_DECLS
+
+/*
+ * XIACongestionControl -- congestion control for XSOCK_STREAM connections
+ *
+ * One controller per connection decides how many data packets may be
+ * outstanding and when the oldest of them should be retransmitted.
+ * Windows count packets, as XTRANSPORT's sequence numbers do.
+ *
+ * The base class does everything but grow and shrink the window:
+ *
+ *   RTT      one packet at a time is timed (never a retransmitted one), and
+ *            each sample updates SRTT and RTTVAR as in RFC 6298.  The RTO is
+ *            SRTT + 4 RTTVAR, at least 200 ms, doubled on each timeout.
+ *   ACKs     new data grows the window, in slow start below ssthresh and by
+ *            the algorithm's rule above it.  The third duplicate ACK starts
+ *            fast recovery, which lasts until everything outstanding at the
+ *            loss has been acked (RFC 6582).  The oldest packet is resent
+ *            at once; XTRANSPORT resends the other holes the receiver's
+ *            SACK blocks reveal as the window allows (RFC 6675).
+ *   timeout  the window falls to one packet and the sender goes back to
+ *            the oldest unacked packet.
+ *
+ * Subclasses supply increase() and reduce():
+ *
+ *   NEWRENO  one packet per window of ACKs; halve on loss.
+ *   CUBIC    RFC 8312: the window follows a cubic curve in the time since
+ *            the last loss, centered on the window at that loss, never
+ *            growing slower than NewReno would; multiply by 0.7 on loss.
+ *
+ * XIACongestionControl is used by XTRANSPORT; it is not an element.
+ */
+
+class XIACongestionControl { public:
+
+    enum Algorithm { NEWRENO = 0, CUBIC, NALGORITHMS };
+    enum { INITIAL_WINDOW = 10, DUPACK_THRESHOLD = 3, MAX_BACKOFF = 6,
+	   MIN_RTO_MSEC = 200, MAX_RTO_MSEC = 60000 };
+    enum Action { NONE = 0, RETRANSMIT };
+
+    /** @brief Return a new controller running @a algorithm, whose window
+     * never exceeds @a max_window packets and whose RTO is @a initial_rto
+     * until the first RTT sample. */
+    static XIACongestionControl *make(Algorithm algorithm, uint32_t max_window,
+				      const Timestamp &initial_rto);
+    static bool parse(const String &str, Algorithm &algorithm);
+    static const char *algorithm_name(Algorithm algorithm);
+
+    virtual ~XIACongestionControl()	{ }
+    virtual Algorithm algorithm() const = 0;
+
+    uint32_t cwnd() const		{ return _cwnd; }
+    uint32_t ssthresh() const		{ return _ssthresh; }
+    /** @brief Return the number of packets that may be in the network. */
+    uint32_t window() const {
+	return _cwnd < _max_window ? _cwnd : _max_window;
+    }
+    bool recovering() const		{ return _recovering; }
+
+    const Timestamp &srtt() const	{ return _srtt; }
+    const Timestamp &rttvar() const	{ return _rttvar; }
+    Timestamp rto() const;
+
+    /** @brief Note that new packet @a seq left at @a now. */
+    void sent(uint32_t seq, const Timestamp &now) {
+	if (!_timing) {
+	    _timing = true;
+	    _timed_seq = seq;
+	    _timed_at = now;
+	}
+    }
+    /** @brief Note that a packet was sent again. */
+    void retransmitted() {
+	_retransmits++;
+	_timing = false;
+    }
+
+    /** @brief Process cumulative ACK @a ackno, received at @a now, with
+     * packets [@a base, @a high) outstanding.  Returns RETRANSMIT if packet
+     * @a ackno should be resent now. */
+    Action ack(uint32_t ackno, uint32_t base, uint32_t high, const Timestamp &now);
+    /** @brief Process a retransmission timeout at @a now, with packets
+     * [@a base, @a high) outstanding.  The caller resends from @a base. */
+    void timeout(uint32_t base, uint32_t high, const Timestamp &now);
+
+    uint32_t retransmits() const	{ return _retransmits; }
+    uint32_t fast_retransmits() const	{ return _fast_retransmits; }
+    uint32_t timeouts() const		{ return _timeouts; }
+
+    /** @brief Return the window, RTT, and counters as "name value" pairs. */
+    String unparse() const;
+
+  protected:
+
+    XIACongestionControl(uint32_t max_window, const Timestamp &initial_rto);
+
+    /** @brief Grow _cwnd in congestion avoidance, @a acked more packets
+     * having been acked at @a now. */
+    virtual void increase(uint32_t acked, const Timestamp &now) = 0;
+    /** @brief Respond to a loss at @a now with @a flight packets
+     * outstanding, setting _ssthresh and _cwnd. */
+    virtual void reduce(uint32_t flight, const Timestamp &now) = 0;
+
+    uint32_t _cwnd;
+    uint32_t _ssthresh;
+    uint32_t _cwnd_cnt;		// packets acked toward the next increase
+    uint32_t _max_window;
+
+  private:
+
+    Timestamp _srtt;
+    Timestamp _rttvar;
+    Timestamp _initial_rto;
+    bool _have_rtt;
+    int _backoff;
+
+    bool _timing;
+    uint32_t _timed_seq;
+    Timestamp _timed_at;
+
+    bool _recovering;
+    uint32_t _recover;		// high when recovery or the last timeout began
+    uint32_t _dupacks;
+
+    uint32_t _retransmits;
+    uint32_t _fast_retransmits;
+    uint32_t _timeouts;
+
+    void sample(const Timestamp &rtt);
+
+};
+
+class XIANewReno : public XIACongestionControl { public:
+
+    XIANewReno(uint32_t max_window, const Timestamp &initial_rto)
+	: XIACongestionControl(max_window, initial_rto) {
+    }
+
+    Algorithm algorithm() const		{ return NEWRENO; }
+
+  protected:
+
+    void increase(uint32_t acked, const Timestamp &now);
+    void reduce(uint32_t flight, const Timestamp &now);
+
+};
+
+class XIACubic : public XIACongestionControl { public:
+
+    XIACubic(uint32_t max_window, const Timestamp &initial_rto);
+
+    Algorithm algorithm() const		{ return CUBIC; }
+
+  protected:
+
+    void increase(uint32_t acked, const Timestamp &now);
+    void reduce(uint32_t flight, const Timestamp &now);
+
+  private:
+
+    double _w_max;		// window at the last loss
+    double _w_est;		// what NewReno's window would be
+    double _origin;		// window the curve is centered on
+    double _k;			// seconds from the epoch to _origin
+    Timestamp _epoch;		// start of this congestion avoidance period
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,291 @@
+#ifndef CLICK_XIACONNTABLE_HH
+#define CLICK_XIACONNTABLE_HH
+#include <click/glue.hh>
+#include <click/hashtable.hh>
+#include <click/vector.hh>
+#include <click/xid.hh>
+#include <click/xidpair.hh>
+CLICK_DECLS
+
+/*
+ * XIAConnTable<T> -- connection state for XTRANSPORT
+ *
+ * Holds one T per socket or connection.  Ts live in a slab of 64-entry
+ * chunks: they are constructed in place, never moved or copied, and are
+ * named by a Handle.  A Handle carries its slot's generation, so once a T
+ * is freed its old Handle finds nothing, even after the slot is reused.
+ *
+ * Two indexes lead to a T.  API ports map to Handles.  Received packets are
+ * demultiplexed by (local XID, remote XID) in one open-addressed hash table
+ * kept at most half full, so a lookup normally takes one probe: a stream
+ * connection is keyed by its two SIDs, a chunk request by the local SID and
+ * the CID, and a bound socket by its XID and the null XID.  A T's keys are
+ * dropped when it is freed.
+ *
+ * XIAConnTable is used by XTRANSPORT; it is not an element.
+ */
+
+template <typename T>
+class XIAConnTable { public:
+
+    typedef uint32_t Handle;		// 0 names nothing
+
+    XIAConnTable();
+    ~XIAConnTable();
+
+    int size() const			{ return _size; }
+
+    /** @brief Construct a new T, returning it and setting @a h to its
+     * handle. */
+    T *alloc(Handle &h);
+    /** @brief Destroy @a h's T and forget its demultiplexing keys.  Ports
+     * that map to @a h map to nothing from now on. */
+    void free(Handle h);
+    /** @brief Return @a h's T, or null if it was freed. */
+    T *get(Handle h) const;
+
+    void set_port(unsigned short port, Handle h)	{ _ports.set(port, h); }
+    void erase_port(unsigned short port)		{ _ports.erase(port); }
+    Handle port_handle(unsigned short port) const	{ return _ports.get(port); }
+    T *port(unsigned short port) const		{ return get(_ports.get(port)); }
+    const HashTable<unsigned short, Handle> &ports() const { return _ports; }
+
+    /** @brief Deliver packets from @a remote to @a local to @a h's T,
+     * replacing any earlier mapping.  A null @a remote matches a bound
+     * socket. */
+    void bind(const XID &local, const XID &remote, Handle h);
+    /** @brief Return the T packets from @a remote to @a local go to, or
+     * null. */
+    T *lookup(const XID &local, const XID &remote) const;
+
+  private:
+
+    enum { CHUNK_BITS = 6, CHUNK = 1 << CHUNK_BITS,
+	   INDEX_BITS = 20, INDEX_MASK = (1 << INDEX_BITS) - 1,
+	   GEN_MASK = (1 << (32 - INDEX_BITS)) - 1,
+	   MIN_BUCKETS = 64 };
+    static const Handle DELETED = ~(Handle) 0;
+
+    struct Slot {
+	union {
+	    char data[sizeof(T)];
+	    void *align_p;
+	    uint64_t align_i;
+	    double align_d;
+	} u;
+	Vector<XIDpair> keys;		// bound to this slot
+	uint32_t gen;
+	int next_free;
+	bool live;
+    };
+
+    struct Bucket {
+	XIDpair key;
+	Handle h;			// 0 if empty, DELETED if erased
+    };
+
+    Vector<Slot *> _chunks;
+    int _free;
+    int _size;
+
+    HashTable<unsigned short, Handle> _ports;
+
+    Bucket *_buckets;
+    uint32_t _nbuckets;			// a power of 2
+    uint32_t _nkeys;
+    uint32_t _nused;			// keys and DELETED buckets
+
+    Slot *slot(int index) const {
+	return &_chunks[index >> CHUNK_BITS][index & (CHUNK - 1)];
+    }
+    static T *object(Slot *s) {
+	return reinterpret_cast<T *>(s->u.data);
+    }
+    Slot *live_slot(Handle h) const;
+
+    uint32_t bucket_of(const XIDpair &key) const {
+	return (key.hashcode() * 2654435761U) & (_nbuckets - 1);
+    }
+    int find(const XIDpair &key) const;
+    void erase_key(const XIDpair &key, Handle h);
+    void rehash(uint32_t nbuckets);
+
+    XIAConnTable(const XIAConnTable<T> &);
+    XIAConnTable<T> &operator=(const XIAConnTable<T> &);
+
+};
+
+template <typename T>
+XIAConnTable<T>::XIAConnTable()
+    : _free(-1), _size(0), _nbuckets(MIN_BUCKETS), _nkeys(0), _nused(0)
+{
+    _buckets = new Bucket[_nbuckets];
+    for (uint32_t i = 0; i < _nbuckets; i++)
+	_buckets[i].h = 0;
+}
+
+template <typename T>
+XIAConnTable<T>::~XIAConnTable()
+{
+    for (int i = 0; i < _chunks.size() * CHUNK; i++)
+	if (slot(i)->live)
+	    object(slot(i))->~T();
+    for (int c = 0; c < _chunks.size(); c++)
+	delete[] _chunks[c];
+    delete[] _buckets;
+}
+
+template <typename T>
+T *
+XIAConnTable<T>::alloc(Handle &h)
+{
+    if (_free < 0) {
+	int base = _chunks.size() * CHUNK;
+	// the last index would let a handle equal DELETED
+	assert(base + CHUNK < INDEX_MASK);
+	_chunks.push_back(new Slot[CHUNK]);
+	for (int i = CHUNK - 1; i >= 0; i--) {
+	    Slot *s = slot(base + i);
+	    s->gen = 0;
+	    s->live = false;
+	    s->next_free = _free;
+	    _free = base + i;
+	}
+    }
+
+    int index = _free;
+    Slot *s = slot(index);
+    _free = s->next_free;
+    s->live = true;
+    _size++;
+    h = (s->gen << INDEX_BITS) | (index + 1);
+    return new((void *) s->u.data) T();
+}
+
+template <typename T>
+typename XIAConnTable<T>::Slot *
+XIAConnTable<T>::live_slot(Handle h) const
+{
+    int index = (int) (h & INDEX_MASK) - 1;
+    if (index < 0 || index >= _chunks.size() * CHUNK)
+	return 0;
+    Slot *s = slot(index);
+    if (!s->live || s->gen != (h >> INDEX_BITS))
+	return 0;
+    return s;
+}
+
+template <typename T>
+T *
+XIAConnTable<T>::get(Handle h) const
+{
+    Slot *s = live_slot(h);
+    return s ? object(s) : 0;
+}
+
+template <typename T>
+void
+XIAConnTable<T>::free(Handle h)
+{
+    Slot *s = live_slot(h);
+    if (!s)
+	return;
+    for (int i = 0; i < s->keys.size(); i++)
+	erase_key(s->keys[i], h);
+    s->keys.clear();
+    object(s)->~T();
+    s->live = false;
+    s->gen = (s->gen + 1) & GEN_MASK;
+    s->next_free = _free;
+    _free = (h & INDEX_MASK) - 1;
+    _size--;
+}
+
+/* Return the bucket holding @a key, or -1. */
+template <typename T>
+int
+XIAConnTable<T>::find(const XIDpair &key) const
+{
+    for (uint32_t i = bucket_of(key); _buckets[i].h; i = (i + 1) & (_nbuckets - 1))
+	if (_buckets[i].h != DELETED && _buckets[i].key == key)
+	    return i;
+    return -1;
+}
+
+template <typename T>
+void
+XIAConnTable<T>::rehash(uint32_t nbuckets)
+{
+    Bucket *old = _buckets;
+    uint32_t nold = _nbuckets;
+    _buckets = new Bucket[nbuckets];
+    _nbuckets = nbuckets;
+    for (uint32_t i = 0; i < _nbuckets; i++)
+	_buckets[i].h = 0;
+    for (uint32_t i = 0; i < nold; i++)
+	if (old[i].h && old[i].h != DELETED) {
+	    uint32_t j = bucket_of(old[i].key);
+	    while (_buckets[j].h)
+		j = (j + 1) & (_nbuckets - 1);
+	    _buckets[j] = old[i];
+	}
+    _nused = _nkeys;
+    delete[] old;
+}
+
+template <typename T>
+void
+XIAConnTable<T>::bind(const XID &local, const XID &remote, Handle h)
+{
+    Slot *s = live_slot(h);
+    if (!s)
+	return;
+    XIDpair key(local, remote);
+
+    int i = find(key);
+    if (i >= 0) {
+	if (_buckets[i].h == h)
+	    return;
+	_buckets[i].h = h;
+    } else {
+	// keep the table at most half full, counting erased buckets
+	if ((_nused + 1) * 2 > _nbuckets) {
+	    uint32_t n = MIN_BUCKETS;
+	    while ((_nkeys + 1) * 4 > n)
+		n *= 2;
+	    rehash(n);
+	}
+	uint32_t j = bucket_of(key);
+	while (_buckets[j].h && _buckets[j].h != DELETED)
+	    j = (j + 1) & (_nbuckets - 1);
+	if (!_buckets[j].h)
+	    _nused++;
+	_buckets[j].key = key;
+	_buckets[j].h = h;
+	_nkeys++;
+    }
+    s->keys.push_back(key);
+}
+
+/* Erase @a key if it still leads to @a h. */
+template <typename T>
+void
+XIAConnTable<T>::erase_key(const XIDpair &key, Handle h)
+{
+    int i = find(key);
+    if (i >= 0 && _buckets[i].h == h) {
+	_buckets[i].h = DELETED;
+	_nkeys--;
+    }
+}
+
+template <typename T>
+T *
+XIAConnTable<T>::lookup(const XID &local, const XID &remote) const
+{
+    int i = find(XIDpair(local, remote));
+    return i >= 0 ? get(_buckets[i].h) : 0;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -2,15 +2,26 @@
 #include <click/xiacontentheader.hh>
 #include <click/config.h>
 #include <click/glue.hh>
+#include <click/straccum.hh>
+// last: its XSOCK_ macros clash with TransportHeader
+#include "../../../api/include/Xsocket.h"	// cache slice policies
 CLICK_DECLS
 
 #define CACHE_DEBUG 1
 
 unsigned int XIAContentModule::PKTSIZE = PACKETSIZE;
+const XIARouteData XIAContentModule::localRoute = { DESTINED_FOR_LOCALHOST, 0, 0 };
 XIAContentModule::XIAContentModule(XIATransport *transport)
+    : _pacer(pacerHook, this), _promoter(promoterHook, this), _expirer(expiryHook, this)
 {
     _transport = transport;
-    _timer=0;
+    usedSize=0;
+    _requests=_hits=_admitted=_rejected=0;
+    _pacingRate=_pacingBurst=0;
+    _addrVersion=0;
+    _demoted=_promoted=0;
+    _expired=0;
+    set_timeouts(10000, 300000);
 }
 
 XIAContentModule::~XIAContentModule()
@@ -21,14 +32,21 @@ XIAContentModule::~XIAContentModule()
         chunk=it->second;
         delete chunk;
     }
-    for(it=_oldPartial.begin(); it!=_oldPartial.end(); it++) {
-        chunk=it->second;
-        delete chunk;
-    }
     for(it=_contentTable.begin(); it!=_contentTable.end(); it++) {
         chunk=it->second;
         delete chunk;
     }
+    HashTable<int, cacheMeta*>::iterator cmit;
+    for(cmit=_cacheMetaTable.begin(); cmit!=_cacheMetaTable.end(); cmit++)
+        delete cmit->second->order;
+    for(HashTable<XID, Vector<Packet *> >::iterator wit=_waiting.begin(); wit!=_waiting.end(); wit++)
+        for(int i=0; i<wit->second.size(); i++)
+            wit->second[i]->kill();
+    while(!_trains.empty()) {
+        ChunkTrain *t=_trains.front();
+        _trains.pop_front();
+        delete t;
+    }
 }
 
 Packet * XIAContentModule::makeChunkResponse(CChunk * chunk, Packet *p_in)
@@ -45,7 +63,9 @@ Packet * XIAContentModule::makeChunkResponse(CChunk * chunk, Packet *p_in)
 
     uint16_t hdrsize = encap.hdr_size()+ contenth.hlen();
     //build packet
-    WritablePacket *p = Packet::make(hdrsize, chunk->GetPayload() , chunk->GetSize(), 20 );
+    WritablePacket *p = chunk->chunk_packet(hdrsize);
+    if(!p)
+        return 0;
 
     p=contenth.encap(p);		// add XIA header
     p=encap.encap( p, false );
@@ -84,7 +104,9 @@ Packet * XIAContentModule::makeChunkPush(CChunk * chunk, Packet *p_in)
     
     uint16_t hdrsize = encap.hdr_size()+ contenth.hlen();
     //build packet
-    WritablePacket *p = Packet::make(hdrsize, chunk->GetPayload() , chunk->GetSize(), 20 );
+    WritablePacket *p = chunk->chunk_packet(hdrsize);
+    if(!p)
+        return 0;
 
     p=contenth.encap(p);		// add XIA header
     p=encap.encap( p, false );
@@ -147,11 +169,15 @@ void XIAContentModule::process_request(Packet *p, const XID & srcHID, const XID
         ContentHeader ch(p);
         if(it!=_contentTable.end() && (content[dstCID]=1)  /* This is an intended assignemnt */
                 && (ch.opcode()==ContentHeader::OP_REQUEST)) { /* Filter out redundant request for RPT reliability */
+            HashTable<int, cacheMeta*>::iterator cmit;
+            for(cmit=_cacheMetaTable.begin(); cmit!=_cacheMetaTable.end(); cmit++)
+                cmit->second->order->touch(dstCID);
+            scheduleContent(it->first);
+
             XIAHeaderEncap encap;
             XIAHeader hdr(p);
 
             XIAPath srcPath, dstPath;
-            char* pl=it->second->GetPayload();
             unsigned int s=it->second->GetSize();
 
             handle_t s_dummy=srcPath.add_node(XID());
@@ -159,7 +185,8 @@ void XIAContentModule::process_request(Packet *p, const XID & srcHID, const XID
             srcPath.add_edge(s_dummy, s_cid);
 
             handle_t d_dummy=dstPath.add_node(XID());
-            XID	_destination_xid = hdr.src_path().xid(hdr.src_path().destination_node());   //Find the last node of the source, it can be a HID or SID
+            XIAPathView src_view = hdr.src_path_view();
+            XID	_destination_xid = src_view.xid(src_view.destination_node());   //Find the last node of the source, it can be a HID or SID
             handle_t d_xid=dstPath.add_node(_destination_xid);
             dstPath.add_edge(d_dummy, d_xid);
 
@@ -171,13 +198,15 @@ void XIAContentModule::process_request(Packet *p, const XID & srcHID, const XID
             ContentHeaderEncap  contenth(0, 0, 0, s);
 
             uint16_t hdrsize = encap.hdr_size()+ contenth.hlen();
-            WritablePacket *newp = Packet::make(hdrsize, pl , s, 20 );
+            WritablePacket *newp = it->second->chunk_packet(hdrsize);
 
-            newp=contenth.encap(newp);
-            newp=encap.encap( newp, false );	      // add XIA header
+            if(newp) {
+                newp=contenth.encap(newp);
+                newp=encap.encap( newp, false );	      // add XIA header
 	    
 // 	    click_chatter("Found in my local cache! CID: %s, Local Address: %s\n", dstCID.unparse().c_str(),  _transport->local_hid().unparse().c_str());
-            _transport->checked_output_push(1 , newp);
+                _transport->checked_output_push(1 , newp);
+            }
             //std::cout<<"In client"<<std::endl;
             //std::cout<<"payload: "<<pl<<std::endl;
             //std::cout<<"have pushed out"<<std::endl;
@@ -187,45 +216,17 @@ void XIAContentModule::process_request(Packet *p, const XID & srcHID, const XID
     }
 #endif
     // server, router
+    _requests++;
+    _admission.record(dstCID);
     if(it!=_contentTable.end()) {
         //std::cout<<"look up cache in router or server"<<std::endl;
-        XIAHeaderEncap encap;
-        XIAHeader hdr(p);
-        XIAPath myown_source;  // AD:HID:CID add_node, add_edge
-        char* pl=it->second->GetPayload();
-        //std::cout<<"payload: "<<pl<<std::endl;
-        unsigned int s=it->second->GetSize();
-        //std::cout<<"chunk size: "<<s<<std::endl;
-        myown_source = _transport->local_addr();
-        handle_t _cid=myown_source.add_node(dstCID);
-        myown_source.add_edge(myown_source.source_node(), _cid);
-        myown_source.add_edge(myown_source.destination_node(), _cid);
-        myown_source.set_destination_node(_cid);
-
-        encap.set_src_path(myown_source);
-        encap.set_dst_path(hdr.src_path());
-        encap.set_nxt(CLICK_XIA_NXT_CID);
-
-        // add content header   dataoffset
-        unsigned int cp=0;
-        ContentHeaderEncap  dummy_contenth(0, 0, 0, 0);
-
-        while(cp < s) {
-            uint16_t hdrsize = encap.hdr_size()+ dummy_contenth.hlen();
-            int l= (s-cp) < (PKTSIZE - hdrsize) ? (s-cp) : (PKTSIZE - hdrsize);
-            ContentHeaderEncap  contenth(0, cp, l, s);
-            //build packet
-            WritablePacket *newp = Packet::make(hdrsize, pl + cp , l, 20 );
-            newp=contenth.encap(newp);
-            encap.set_plen(l);	// add XIA header
-            newp=encap.encap( newp, false );
-// 	    click_chatter("Found in router cache! CID: %s, Local Address: %s\n", dstCID.unparse().c_str(),  _transport->local_hid().unparse().c_str());
-	    
-            _transport->checked_output_push(0 , newp);
-            //std::cout<<"have pushed out"<<std::endl;
-            cp += l;
-        }
-        p->kill();
+        _hits++;
+        _contentOrder.touch(it->first);
+        scheduleContent(it->first);
+        serveChunk(p, it->first, it->second, dstCID);
+    } else if(_store.contains(dstCID)) {
+        // on disk: answer once it is back in memory
+        waitForChunk(p, dstCID);
     } else { //printf("dstID is not found in cache, pkt killed\n");
         //std::cout<<"not found, kill pkt"<<std::endl;
 		click_chatter("no content found\n");
@@ -248,49 +249,68 @@ void XIAContentModule::cache_incoming_forward(Packet *p, const XID& srcCID)
     it=_contentTable.find(srcCID);
     if (it!=_contentTable.end()) {  //already in contentTable
         content[it->first]=1;
+        _contentOrder.touch(it->first);
+        scheduleContent(it->first);
     } else {
         it=_partialTable.find(srcCID);
         if(it!=_partialTable.end()) { //found in partialTable
-            partial[it->first]=1;
             CChunk *chunk=it->second;
             chunk->fill(payload, offset, length);
+            chunk->lastFill=Timestamp::recent();
             if(chunk->full()) {
                 _contentTable[srcCID]=chunk;
+                prepareResponse(chunk, srcCID);
                 content[srcCID]=1;
                 addRoute(srcCID);
-                partial.erase(it->first);
                 _partialTable.erase(it);
+                _partialOrder.remove(srcCID);
+                _partialExpiry.remove(srcCID);
+                _contentOrder.insert(srcCID, chunk->GetSize());
+                scheduleContent(srcCID);
+            } else {
+                _partialOrder.touch(srcCID);
+                schedulePartial(srcCID);
             }
         } else {                     //first pkt of a chunk
-            CChunk *chunk=new CChunk(srcCID, chunkSize);
-            chunk->fill(payload, offset, length);//  allocate space for new chunk
-            MakeSpace(chunkSize);  //lru
-
-            if(chunk->full()) {
-                _contentTable[srcCID]=chunk;
-                content[srcCID]=1;
-                //modify routing table	  //add
-                addRoute(srcCID);
+            // admission decides once per chunk: a new transfer starts at
+            // offset 0, and the rest of a rejected one is dropped
+            if(offset==0) {
+                _admission.record(srcCID);
+                _rejectedExpiry.remove(srcCID);
+            } else if(_rejectedExpiry.contains(srcCID)) {
+                _rejectedExpiry.schedule(srcCID, expiryTick(Timestamp::recent()), _partialTimeout);
+                p->kill();
+                return;
+            }
+            if(!admit(srcCID, chunkSize)) {
+                _rejected++;
+                if(_rejectedExpiry.size() < MAX_REJECTED) {
+                    _rejectedExpiry.schedule(srcCID, expiryTick(Timestamp::recent()), _partialTimeout);
+                    scheduleExpirer();
+                }
             } else {
-                _partialTable[srcCID]=chunk;
-                partial[srcCID]=1;
+                _admitted++;
+                MakeSpace(chunkSize);
+                CChunk *chunk=new CChunk(srcCID, chunkSize, segmentSize());
+                chunk->fill(payload, offset, length);//  allocate space for new chunk
+                chunk->lastFill=Timestamp::recent();
+
+                if(chunk->full()) {
+                    _contentTable[srcCID]=chunk;
+                    prepareResponse(chunk, srcCID);
+                    content[srcCID]=1;
+                    //modify routing table	  //add
+                    addRoute(srcCID);
+                    _contentOrder.insert(srcCID, chunkSize);
+                    scheduleContent(srcCID);
+                } else {
+                    _partialTable[srcCID]=chunk;
+                    _partialOrder.insert(srcCID, chunkSize);
+                    schedulePartial(srcCID);
+                }
+                usedSize += chunkSize;
             }
-            usedSize += chunkSize;
-        }
-    }
-    //lru refresh
-    //printf("lru refresh\n");
-    //std::cout<<timer<<std::endl;
-    _timer++;
-    if(_timer>=REFRESH) {
-        HashTable<XID,int>::iterator iter;
-        for(iter=content.begin(); iter!=content.end(); iter++) {
-            iter->second=0;
-        }
-        for(iter=partial.begin(); iter!=partial.end(); iter++) {
-            iter->second=0;
         }
-        _timer=0;
     }
     p->kill();
     //printf("end: dstHID is not myself\n");
@@ -312,7 +332,7 @@ void XIAContentModule::cache_incoming_local(Packet* p, const XID& srcCID, bool l
     uint32_t cachePolicy=ch.cachePolicy();
     uint32_t ttl=ch.ttl();
 
-    HashTable<XID,CChunk*>::iterator it,oit;
+    HashTable<XID,CChunk*>::iterator it;
     bool chunkFull=false;
     CChunk* chunk;
 #ifdef CLIENTCACHE
@@ -324,13 +344,13 @@ void XIAContentModule::cache_incoming_local(Packet* p, const XID& srcCID, bool l
         cm->maxSize=cacheSize;
         cm->policy=cachePolicy;
         cm->contentMetaTable=new HashTable<XID, struct contentMeta*>();
+        cm->order=new XIACacheEvictor(cachePolicy & POLICY_FIFO ? XIACacheEvictor::FIFO : XIACacheEvictor::LRU);
         _cacheMetaTable[contextID]=cm;
         if(CACHE_DEBUG){
             click_chatter("Create new cacheMeta struct for id[%d]\n", contextID);
         }
     }
         HashTable<XID,CChunk*>::iterator cit;
-        _timer++;
         cit=_contentTable.find(srcCID);
         if(cit!=_contentTable.end()) { // content exists alreaady
 // 	  click_chatter("Found the Chunk! Push: %d Put:%d\n", pushcid, local_putcid);
@@ -345,21 +365,13 @@ void XIAContentModule::cache_incoming_local(Packet* p, const XID& srcCID, bool l
 		  _transport->checked_output_push(1 , newp);
 	      }else
 		click_chatter("Why is a partial chunk in contentTable?\n");
-
-	      if(_timer>=REFRESH) {
-                _timer = 0;
-                cache_management();
-		}
 	      
 	    }else{
-	      if (!local_putcid)
+	      if (!local_putcid) {
 		  content[srcCID]=1;
-	      p->kill();
-
-	      if(_timer>=REFRESH) {
-		  _timer = 0;
-		  cache_management();
+		  scheduleContent(srcCID);
 	      }
+	      p->kill();
 	      return;
 	    }
         }
@@ -373,26 +385,17 @@ void XIAContentModule::cache_incoming_local(Packet* p, const XID& srcCID, bool l
         if(chunk->full()) {
             chunkFull=true;
             _partialTable.erase(it);
-        }
-    } else {
-        oit=_oldPartial.find(srcCID);
-        if(oit!=_oldPartial.end()) { //already in old partial table
-            chunk=oit->second;
-            chunk->fill(payload, offset, length);
-            _oldPartial.erase(oit);
-            if(chunk->full()) {
-                chunkFull=true;
-            } else {
-                _partialTable[srcCID]=chunk;
-            }
-        } else {			//first pkt to the client
-            chunk=new CChunk(srcCID, chunkSize);
-            chunk->fill(payload, offset, length);
-            if(chunk->full()){
-                chunkFull=true;
-            }else{
-                _partialTable[srcCID]=chunk;
-            }
+            _partialExpiry.remove(srcCID);
+        } else
+            schedulePartial(srcCID);
+    } else {			//first pkt to the client
+        chunk=new CChunk(srcCID, chunkSize, segmentSize());
+        chunk->fill(payload, offset, length);
+        if(chunk->full()){
+            chunkFull=true;
+        }else{
+            _partialTable[srcCID]=chunk;
+            schedulePartial(srcCID);
         }
     }
     if(chunkFull) { //have built the whole chunk pkt
@@ -407,15 +410,21 @@ void XIAContentModule::cache_incoming_local(Packet* p, const XID& srcCID, bool l
 #ifdef CLIENTCACHE
         if (local_putcid || _cache_content_from_network) {
             struct cacheMeta *cm= _cacheMetaTable[contextID];
+            HashTable <XID, struct contentMeta*> *cmTable=cm->contentMetaTable;
+            struct contentMeta *ctm=cmTable->get(srcCID);
+            if (ctm)
+                cm->curSize-=ctm->chunkSize;
+            else
+                ctm=(struct contentMeta *)malloc(sizeof(contentMeta));
             cm->curSize+=chunkSize;
-            struct contentMeta *ctm=(struct contentMeta *)malloc(sizeof(contentMeta));
             ctm->chunkSize=chunkSize;
             ctm->ttl=ttl;
             gettimeofday(&(ctm->timestamp),NULL);
-            HashTable <XID, struct contentMeta*> *cmTable=cm->contentMetaTable;
             (*cmTable)[srcCID]=ctm;
+            cm->order->insert(srcCID, chunkSize);
             
             _contentTable[srcCID]=chunk;
+            prepareResponse(chunk, srcCID);
             if (local_putcid) {
                 assert(ContentHeader::OP_LOCAL_PUTCID>1);
                 content[srcCID]= ContentHeader::OP_LOCAL_PUTCID;
@@ -424,6 +433,7 @@ void XIAContentModule::cache_incoming_local(Packet* p, const XID& srcCID, bool l
             }
 
             addRoute(srcCID);
+            scheduleContent(srcCID);
             applyLocalCachePolicy(contextID);
         } else {
             if (CACHE_DEBUG)
@@ -434,12 +444,6 @@ void XIAContentModule::cache_incoming_local(Packet* p, const XID& srcCID, bool l
         delete chunk;
 #endif
     }
-    if(_timer>=REFRESH) {
-        _timer=0;
-        //trigger cache_management();
-        cache_management();
-    }
-
 
     p->kill();
 }
@@ -447,136 +451,43 @@ void XIAContentModule::cache_incoming_local(Packet* p, const XID& srcCID, bool l
 /** 
  * @brief Clean up local cache based on policy 
  *
+ * Evicts the slice's chunks in the order of its policy (POLICY_LRU or
+ * POLICY_FIFO) until it is back under its maximum size.
+ *
  * @returns Void
  */ 
 void XIAContentModule::applyLocalCachePolicy(int contextID){
 #ifdef CLIENTCACHE
     struct cacheMeta *cm=_cacheMetaTable[contextID];
-    switch(cm->policy){
-    case POLICY_FIFO:
     if(CACHE_DEBUG){
         click_chatter("Cache Size %d/%d\n", cm->curSize, cm->maxSize);
     }
-    if(cm->maxSize!=0 && cm->curSize>cm->maxSize){
-        bool done=false;
-        HashTable<XID, struct contentMeta*> *cmTable=cm->contentMetaTable;
-        /* Remove expired content until curSize < maxSize */
-        struct contentMeta *cPtr;
-        int chunkSize;
-        HashTable<XID,CChunk*>::iterator cit;
-        cit=_contentTable.begin();
-        while(cit!=_contentTable.end()) {
-            int contentType=content[cit->first];
-            if(contentType == ContentHeader::OP_LOCAL_PUTCID){
-                cPtr=(*cmTable)[cit->first];
-                if(isExpiredContent(cPtr)){
-                    chunkSize=cPtr->chunkSize;
-                    cm->curSize-=chunkSize;
-                    cmTable->erase(cit->first);
-                    content.erase(cit->first);
-                    if(CACHE_DEBUG){
-                    click_chatter("RM [%s] Size: %d\n", cit->first.unparse().c_str(), 
-                            chunkSize);
-                    }
-                    _contentTable.erase(cit);
-                    free(cPtr);
-                    if(cm->curSize < cm->maxSize){
-                        done=true;                        
-                        break;
-                    }
-                }       
-            }
-            cit++;
-        }
-        /* Remove old but active contents to make space for new one */
-        if(!done){
-            while(cm->curSize>cm->maxSize){
-                const XID *minID=findOldestContent(contextID);
-                if(minID!=NULL){
-                    const XID tmp=*minID;
-                    cPtr=(*cmTable)[tmp];
-                    chunkSize=cPtr->chunkSize;
-                    cm->curSize-=chunkSize;
-                    cmTable->erase(tmp);
-                    content.erase(tmp);
-                    if(CACHE_DEBUG){
-                    click_chatter("RM [%s] Size: %d\n", _contentTable.find(tmp)->first.unparse().c_str(), 
-                            chunkSize);
-                    }
-                    _contentTable.erase(tmp);
-                    free(cPtr);
-                }
-            }
+    XID victim;
+    uint32_t chunkSize;
+    while(cm->maxSize!=0 && cm->curSize>cm->maxSize
+          && cm->order->evict(victim, chunkSize)) {
+        if(CACHE_DEBUG){
+            click_chatter("RM [%s] Size: %d\n", victim.unparse().c_str(), chunkSize);
         }
-    }
-    break;
-        default:
-    break;
+        dropContent(victim);
     }
 #endif
 }
 
-/**
- * @brief check if a content is expired
- * 
- * @returns True if it is expired
- */
-bool XIAContentModule::isExpiredContent(struct contentMeta* cm){
-    int ttl=cm->ttl;
-    struct timeval *thisTime=&(cm->timestamp);    
-    struct timeval curTime;
-    gettimeofday(&curTime,NULL);
-    if(thisTime->tv_sec+ttl >= curTime.tv_sec){
-        return true;
-    }else{
-        return false;
-    }
-}
-
-const XID* XIAContentModule::findOldestContent(int contextID){
-    struct cacheMeta *cm=_cacheMetaTable[contextID];
-    HashTable<XID,CChunk*>::iterator cit;
-    cit=_contentTable.begin();
-    const XID *minID=NULL;
-    struct timeval minTime;
-    gettimeofday(&minTime, NULL);
-    HashTable<XID, struct contentMeta*>* cmTable=cm->contentMetaTable;
-    struct contentMeta *cPtr;
-    while(cit!=_contentTable.end()) {
-        int contentType=content[cit->first];
-        if(contentType == ContentHeader::OP_LOCAL_PUTCID){
-            cPtr=(*cmTable)[cit->first];
-            if(cPtr->timestamp.tv_sec<=minTime.tv_sec){
-                minTime=cPtr->timestamp;
-                minID=&(cit->first);
-            }
-        }
-        cit++;
-    }
-    return minID;
-}
-
 void XIAContentModule::cache_incoming_remove(Packet *p, const XID& srcCID){
     XIAHeader xhdr(p); 
     ContentHeader ch(p);
 
 	uint32_t contextID=ch.contextID();
-    struct cacheMeta *cm=_cacheMetaTable[contextID];
+    struct cacheMeta *cm=_cacheMetaTable.get(contextID);
     if(cm!=NULL){
-        HashTable<XID, struct contentMeta*> *cmTable=cm->contentMetaTable;
-        struct contentMeta* cPtr=(*cmTable)[srcCID];
+        struct contentMeta* cPtr=cm->contentMetaTable->get(srcCID);
         if(cPtr!=NULL){
-            int chunkSize=cPtr->chunkSize;
-            cm->curSize-=chunkSize;
-            cmTable->erase(srcCID);
-            content.erase(srcCID);
             if(CACHE_DEBUG){
-            click_chatter("RMCID Request [%s] Size: %d\n", _contentTable.find(srcCID)->first.unparse().c_str(), 
-                            chunkSize);
+            click_chatter("RMCID Request [%s] Size: %d\n", srcCID.unparse().c_str(), 
+                            cPtr->chunkSize);
             }
-            delRoute(srcCID);
-            _contentTable.erase(srcCID);
-            free(cPtr);
+            dropContent(srcCID);
             if(CACHE_DEBUG){
             click_chatter("Cache Size %d/%d\n", cm->curSize, cm->maxSize);
             }
@@ -585,42 +496,6 @@ void XIAContentModule::cache_incoming_remove(Packet *p, const XID& srcCID){
     
 }
 
-void XIAContentModule::cache_management()
-{
-    HashTable<XID,CChunk*>::iterator cit;
-    HashTable<XID,CChunk*>::iterator it;
-    CChunk *chunk = NULL;
-
-    for(it=_oldPartial.begin(); it!=_oldPartial.end(); it++) {
-        chunk=it->second;
-        if (CACHE_DEBUG)
-            click_chatter("oldPartial %s delete CID %s",_transport->local_hid().unparse().c_str(), chunk->id().unparse().c_str());
-        delete chunk;
-    }
-    _oldPartial.clear();
-    _oldPartial=_partialTable;
-    /* Never delete chunk in the _partialTable here
-       because the chunks are still used in the _oldPartialTable
-       This have created a bug before.  */
-    _partialTable.clear();
-#ifdef CLIENTCACHE
-    cit=_contentTable.begin();
-    while(cit!=_contentTable.end()) {
-        int contentType=content[cit->first];
-        if( contentType == 0 ) {
-            HashTable<XID, CChunk*>::iterator pit=cit;
-            _oldPartial[pit->first]=pit->second;
-            delRoute(pit->first);
-            content.erase(pit->first);
-            _contentTable.erase(pit);
-        }else if(contentType != ContentHeader::OP_LOCAL_PUTCID){
-            content[cit->first]=0;
-        }
-        cit++;
-    }
-#endif
-}
-
 /* source ID is the content */
 void XIAContentModule::cache_incoming(Packet *p, const XID& srcCID, const XID& dstHID, int /*port*/)
 {
@@ -650,192 +525,648 @@ void XIAContentModule::cache_incoming(Packet *p, const XID& srcCID, const XID& d
 	}
 }
 
-int
-XIAContentModule::MakeSpace(int chunkSize)
+/* Answer request @a p with @a chunk, stored under @a key, as @a cid. */
+void
+XIAContentModule::serveChunk(Packet *p, const XID &key, CChunk *chunk, const XID &cid)
 {
-    while( usedSize + chunkSize > MAXSIZE) {
-        HashTable<XID,int>::iterator i;
-        for(i=partial.begin(); i!=partial.end(); i++)
-            if(i->second==0)
-                break;
+    XIAHeader hdr(p);
+    ChunkTrain *t=new ChunkTrain;
+    if(!responseHeader(chunk, cid, hdr, t->header)) {
+        delete t;
+        p->kill();
+        return;
+    }
+
+    // the chunk goes out one stored segment per packet, paced if asked
+    t->cid=key;
+    t->next=0;
+    t->tokens=_pacingBurst;
+    t->refilled=Timestamp::now();
+    if(runTrain(t, t->refilled))
+        delete t;
+    else {
+        _trains.push_back(t);
+        if(!_pacer.scheduled())
+            schedulePacer(t->refilled);
+    }
+    p->kill();
+}
 
+/* Build chunk->response, the parts of every response carrying @a chunk
+   as @a cid. */
+bool
+XIAContentModule::prepareResponse(CChunk *chunk, const XID &cid)
+{
+    ChunkResponseTemplate &t=chunk->response;
+    XIAHeaderEncap encap;
+    XIAPath myown_source;  // AD:HID:CID add_node, add_edge
+    myown_source = _transport->local_addr();
+    if(!myown_source.is_valid()) {
+        // no address yet: try again when serving
+        t=ChunkResponseTemplate();
+        return false;
+    }
+    handle_t _cid=myown_source.add_node(cid);
+    myown_source.add_edge(myown_source.source_node(), _cid);
+    myown_source.add_edge(myown_source.destination_node(), _cid);
+    myown_source.set_destination_node(_cid);
+
+    // the destination is a stand-in for the requester's nodes
+    encap.set_src_path(myown_source);
+    encap.set_dst_path(myown_source);
+    encap.set_nxt(CLICK_XIA_NXT_CID);
+    const struct click_xia *xh=encap.hdr();
+    t.fixed=String(reinterpret_cast<const char *>(xh), sizeof(struct click_xia));
+    t.source=String(reinterpret_cast<const char *>(xh->node + xh->dnode),
+                    xh->snode*sizeof(struct click_xia_xid_node));
 
-        if(i!=partial.end()) {
-            HashTable<XID,CChunk*>::iterator iter = _partialTable.find(i->first);
-            usedSize-=iter->second->GetSize();
+    // offset and length are patched for every segment
+    ContentHeaderEncap  contenth(0, 0, 0, chunk->GetSize());
+    WritablePacket *p = Packet::make(contenth.hlen(), 0, 0, 0);
+    if(!p || !(p=contenth.encap(p))) {
+        t=ChunkResponseTemplate();
+        return false;
+    }
+    t.content=String(reinterpret_cast<const char *>(p->data()), p->length());
+    XIAGenericExtHeader ext(reinterpret_cast<const struct click_xia_ext *>(p->data()));
+    t.chunkOffsetPos=ext.value(ContentHeader::CHUNK_OFFSET) - p->data();
+    t.lengthPos=ext.value(ContentHeader::LENGTH) - p->data();
+    t.cid=cid;
+    t.addrVersion=_addrVersion;
+    p->kill();
+    return true;
+}
 
-            CChunk *t=iter->second;
+/* Fill @a h with the headers for answering @a request with @a cid: the
+   chunk's prebuilt parts around the request's source nodes. */
+bool
+XIAContentModule::responseHeader(CChunk *chunk, const XID &cid, const XIAHeader &request, ChunkResponseHeader &h)
+{
+    ChunkResponseTemplate &t=chunk->response;
+    if(!t.fixed || t.cid!=cid || t.addrVersion!=_addrVersion)
+        if(!prepareResponse(chunk, cid))
+            return false;
+
+    const struct click_xia *xh=request.hdr();
+    int dnode=xh->snode;
+    int snode=t.source.length()/sizeof(struct click_xia_xid_node);
+    if(dnode==0 || dnode+snode>255)
+        return false;
 
-            _partialTable.erase(iter);
-            partial.erase(i);
+    h.xiaLen=XIAHeader::hdr_size(dnode+snode);
+    StringAccum sa(h.xiaLen + t.content.length());
+    sa << t.fixed;
+    sa.append(reinterpret_cast<const char *>(xh->node + xh->dnode),
+              dnode*sizeof(struct click_xia_xid_node));
+    sa << t.source << t.content;
+    if(!sa.data())
+        return false;
+    struct click_xia *rh=reinterpret_cast<struct click_xia *>(sa.data());
+    rh->dnode=dnode;
+    rh->snode=snode;
+    h.bytes=sa.take_string();
+    h.chunkOffsetPos=h.xiaLen + t.chunkOffsetPos;
+    h.lengthPos=h.xiaLen + t.lengthPos;
+    return true;
+}
 
-            delete t;
-            continue;
-        }
+/* Send what the train's token bucket allows.  Returns true when the train
+   is done: every segment went out, or the chunk is gone. */
+bool
+XIAContentModule::runTrain(ChunkTrain *t, const Timestamp &now)
+{
+    CChunk *chunk=_contentTable.get(t->cid);
+    if(!chunk)
+        return true;
 
-        for(i=content.begin(); i!=content.end(); i++) {
-            if(i->second==0)
-                break;
+    if(_pacingRate) {
+        int64_t earned=(int64_t) _pacingRate * (now - t->refilled).usecval() / 1000000;
+        if(earned>0) {
+            t->tokens+=earned;
+            if(t->tokens>_pacingBurst)
+                t->tokens=_pacingBurst;
+            t->refilled=now;
         }
+    }
 
-        if(i!=content.end()) {
-            HashTable<XID,CChunk*>::iterator iter=_contentTable.find(i->first);
-            usedSize-=iter->second->GetSize();
-            // modify the routin table	     //delete
-            delRoute(iter->first);
-            CChunk *t=iter->second;
-            _contentTable.erase(iter);
-            content.erase(i);
-            delete t;
-            continue;
-        }
+    const ChunkResponseHeader &h=t->header;
+    uint32_t hlen=h.bytes.length();
+    while(t->next<chunk->segments()) {
+        int i=t->next;
+        uint32_t cp=chunk->segment_offset(i);
+        uint16_t l=chunk->segment_length(i);
+        // a full bucket always sends, even if the burst is below a packet
+        if(_pacingRate && t->tokens<(int64_t) (hlen+l) && t->tokens<(int64_t) _pacingBurst)
+            return false;
+
+        WritablePacket *p=chunk->segment_packet(i, hlen);
+        if(!p || !(p=p->push(hlen)))
+            return true;
+        memcpy(p->data(), h.bytes.data(), hlen);
+        struct click_xia *xh=reinterpret_cast<struct click_xia *>(p->data());
+        xh->plen=htons(l);
+        memcpy(p->data()+h.chunkOffsetPos, &cp, sizeof(cp));
+        memcpy(p->data()+h.lengthPos, &l, sizeof(l));
+        p->set_xia_header(xh, h.xiaLen);
+        p->timestamp_anno()=now;
+        _transport->checked_output_push(0 , p);
+
+        t->next++;
+        t->tokens-=hlen+l;
+    }
+    return true;
+}
+
+void
+XIAContentModule::schedulePacer(const Timestamp &now)
+{
+    // wake up when the first train can afford a full segment
+    if(_trains.empty())
+        return;
+    Timestamp when;
+    int64_t cost=segmentSize()+CChunk::SEGMENT_HEADROOM;
+    if(cost>_pacingBurst)
+        cost=_pacingBurst;
+    for(TrainList::iterator it=_trains.begin(); it!=_trains.end(); ++it) {
+        int64_t need=cost - it->tokens;
+        Timestamp ready=it->refilled + Timestamp::make_usec(need>0 ? need*1000000/_pacingRate : 0);
+        if(it==_trains.begin() || ready<when)
+            when=ready;
+    }
+    _pacer.schedule_at(when<now ? now : when);
+}
 
-        HashTable<XID,CChunk*>::iterator iter=_partialTable.begin();
-        if(iter!=_partialTable.end()) {
-            usedSize-=iter->second->GetSize();
-            CChunk *t=iter->second;
-            _partialTable.erase(iter);
-            partial.erase(i);
+void
+XIAContentModule::pacerHook(Timer *, void *thunk)
+{
+    XIAContentModule *cm=static_cast<XIAContentModule *>(thunk);
+    Timestamp now=Timestamp::now();
+    for(TrainList::iterator it=cm->_trains.begin(); it!=cm->_trains.end(); ) {
+        ChunkTrain *t=it.get();
+        if(cm->runTrain(t, now)) {
+            it=cm->_trains.erase(it);
             delete t;
+        } else
+            ++it;
+    }
+    cm->schedulePacer(now);
+}
+
+int
+XIAContentModule::set_admission(uint32_t entries)
+{
+    return _admission.configure(entries);
+}
+
+bool
+XIAContentModule::admit(const XID &cid, int chunkSize)
+{
+    // while there is room, or without admission control, everything gets in
+    XID victim;
+    if(!_admission.enabled() || usedSize + chunkSize <= MAXSIZE
+       || !_contentOrder.peek(victim))
+        return true;
+    return _admission.admit(cid, victim);
+}
+
+int
+XIAContentModule::MakeSpace(int chunkSize)
+{
+    XID victim;
+    uint32_t size;
+    while( usedSize + chunkSize > MAXSIZE) {
+        // partial chunks nobody filled for half their timeout go first,
+        // then complete chunks in policy order, then any partial chunk
+        CChunk *oldest=0;
+        if(_partialOrder.peek(victim))
+            oldest=_partialTable.get(victim);
+        if(oldest && (Timestamp::recent() - oldest->lastFill).msecval() >= (Timestamp::value_type) _partialTimeout*EXPIRY_TICK/2) {
+            _partialOrder.remove(victim);
+            evictPartial(victim);
+        } else if(_contentOrder.evict(victim, size)) {
+            usedSize-=size;
+            if(!demoteContent(victim))
+                dropContent(victim);
+        } else if(_partialOrder.evict(victim, size)) {
+            evictPartial(victim);
+        } else
+            break;
+    }
+    return 0;
+}
+
+void
+XIAContentModule::evictPartial(const XID &cid)
+{
+    HashTable<XID,CChunk*>::iterator it=_partialTable.find(cid);
+    if(it==_partialTable.end())
+        return;
+    CChunk *chunk=it->second;
+    usedSize-=chunk->GetSize();
+    _partialTable.erase(it);
+    _partialExpiry.remove(cid);
+    delete chunk;
+}
+
+/* Take a cached chunk out of the router cache and every cache slice, without
+   touching the chunk itself. */
+void
+XIAContentModule::untrackContent(const XID &cid)
+{
+    CChunk *chunk=_contentTable.get(cid);
+    if(chunk && _contentOrder.remove(cid))
+        usedSize-=chunk->GetSize();
+    _contentExpiry.remove(cid);
+
+    HashTable<int, cacheMeta*>::iterator cmit;
+    for(cmit=_cacheMetaTable.begin(); cmit!=_cacheMetaTable.end(); cmit++) {
+        struct cacheMeta *cm=cmit->second;
+        if(!cm)
             continue;
+        struct contentMeta *cPtr=cm->contentMetaTable->get(cid);
+        if(cPtr) {
+            cm->curSize-=cPtr->chunkSize;
+            cm->contentMetaTable->erase(cid);
+            cm->order->remove(cid);
+            free(cPtr);
         }
+    }
+}
 
-        iter=_contentTable.begin();
-        usedSize-=iter->second->GetSize();
-        //modify routing table	   //delete
+void
+XIAContentModule::dropContent(const XID &cid)
+{
+    untrackContent(cid);
+    HashTable<XID,CChunk*>::iterator it=_contentTable.find(cid);
+    if(it==_contentTable.end())
+        return;
+    CChunk *chunk=it->second;
+    if(!_store.contains(cid))
+        delRoute(cid);
+    content.erase(cid);
+    _contentTable.erase(it);
+    delete chunk;
+}
 
-        delRoute(iter->first);
-        CChunk *t=iter->second;
-        _contentTable.erase(iter);
-        content.erase(iter->first);
-        delete t;
+/* Move a chunk the router cache evicted to the disk tier.  Its route stays,
+   so requests for it still come here. */
+bool
+XIAContentModule::demoteContent(const XID &cid)
+{
+    HashTable<XID,CChunk*>::iterator it=_contentTable.find(cid);
+    if(!_store.is_open() || it==_contentTable.end())
+        return false;
+    untrackContent(cid);
+    Vector<XID> dropped;
+    if(!_store.store(it->second, dropped))
+        return false;
+    content.erase(cid);
+    _contentTable.erase(it);
+    _demoted++;
+    forgetStored(dropped);
+    return true;
+}
+
+/* The disk tier overwrote these chunks. */
+void
+XIAContentModule::forgetStored(const Vector<XID> &cids)
+{
+    Vector<XID> unrouted;
+    for(int i=0; i<cids.size(); i++)
+        if(!_contentTable.get(cids[i]) && !_waiting.get_pointer(cids[i]))
+            unrouted.push_back(cids[i]);
+    if(unrouted.size())
+        _routeTable->erase(unrouted);
+}
+
+void
+XIAContentModule::waitForChunk(Packet *p, const XID &cid)
+{
+    Vector<Packet *> &waiting=_waiting[cid];
+    if(waiting.size()>=MAX_WAITING || !_promoter.initialized()) {
+        p->kill();
+        return;
     }
-    return 0;
+    if(waiting.empty()) {
+        _store.fetch(cid);
+        if(!_promoter.scheduled())
+            _promoter.schedule_now();
+    }
+    waiting.push_back(p);
 }
 
-CPart::CPart(unsigned int off, unsigned int len)
+/* Put a chunk read back from disk into the router cache and answer the
+   requests that waited for it. */
+void
+XIAContentModule::promote(const XID &cid, CChunk *chunk)
 {
-    offset=off;
-    length=len;
+    Vector<Packet *> waiting;
+    HashTable<XID, Vector<Packet *> >::iterator wit=_waiting.find(cid);
+    if(wit!=_waiting.end()) {
+        waiting.swap(wit->second);
+        _waiting.erase(wit);
+    }
+
+    if(CChunk *have=_contentTable.get(cid)) {
+        // it came back from the network meanwhile
+        delete chunk;
+        chunk=have;
+    } else if(chunk) {
+        // in the table first, so the route survives what MakeSpace demotes
+        _contentTable[cid]=chunk;
+        prepareResponse(chunk, cid);
+        content[cid]=1;
+        MakeSpace(chunk->GetSize());
+        _contentOrder.insert(cid, chunk->GetSize());
+        usedSize+=chunk->GetSize();
+        scheduleContent(cid);
+        _promoted++;
+    } else if(!_store.contains(cid))
+        delRoute(cid);
+
+    for(int i=0; i<waiting.size(); i++)
+        if(chunk) {
+            _hits++;
+            _contentOrder.touch(cid);
+            serveChunk(waiting[i], cid, chunk, cid);
+        } else
+            waiting[i]->kill();
 }
 
-CChunk::CChunk(XID _xid, int chunkSize): deleted(false)
+void
+XIAContentModule::promoterHook(Timer *timer, void *thunk)
 {
-    size=chunkSize;
-    complete=false;
-    payload=new char[size];
-    xid=_xid;
+    XIAContentModule *cm=static_cast<XIAContentModule *>(thunk);
+    XID cid;
+    CChunk *chunk;
+    while(cm->_store.poll(cid, chunk))
+        cm->promote(cid, chunk);
+    // reads still on their way
+    if(cm->_store.fetching())
+        timer->schedule_after_msec(1);
 }
 
-CChunk::~CChunk()
+void
+XIAContentModule::set_timeouts(uint32_t partial, uint32_t idle)
 {
-    /* TODO: Memory leak prevention -- CPartList has to be deallocated */
-    delete payload;
+    _partialTimeout=(partial + EXPIRY_TICK - 1)/EXPIRY_TICK;
+    if(!_partialTimeout)
+        _partialTimeout=1;
+    _idleTimeout=(idle + EXPIRY_TICK - 1)/EXPIRY_TICK;
 }
 
-void CChunk::Merge(CPartList::iterator it)
+/* Partial chunk @a cid was just filled: give it another timeout. */
+void
+XIAContentModule::schedulePartial(const XID &cid)
 {
-    //std::cout<<"enter Merge: offset is "<< it->offset <<std::endl;
-    CPartList::iterator post_it;
-    post_it=it;
-    post_it++;
+    _partialExpiry.schedule(cid, expiryTick(Timestamp::recent()), _partialTimeout);
+    scheduleExpirer();
+}
 
-    while(1) {
-        if(post_it==parts.end()) break;
-        if(post_it->v.offset > it->v.offset+it->v.length) {
-            break;
-        } else {
-            unsigned int l=it->v.offset+it->v.length;
-            unsigned int _l=post_it->v.offset+post_it->v.length;
-            if(l>_l) {
-                CPartListNode *n = post_it.get();
-                parts.erase(post_it);
-                delete n;
-            } else {
-                it->v.length= _l - it->v.offset;
-                CPartListNode *n = post_it.get();
-                parts.erase(post_it);
-                delete n;
-            }
-            post_it=it;
-            post_it++;
+/* Cached chunk @a cid was just stored or requested.  It expires when it has
+   been idle for the idle timeout, or when the TTL of a cache slice holding
+   it runs out, whichever comes first.  Chunks local applications put are
+   kept while idle. */
+void
+XIAContentModule::scheduleContent(const XID &cid)
+{
+    uint64_t now=expiryTick(Timestamp::recent());
+    uint64_t when=~(uint64_t) 0;
+    if(_idleTimeout && content.get(cid)!=ContentHeader::OP_LOCAL_PUTCID)
+        when=now+_idleTimeout;
+    HashTable<int, cacheMeta*>::iterator cmit;
+    for(cmit=_cacheMetaTable.begin(); cmit!=_cacheMetaTable.end(); cmit++) {
+        struct contentMeta *ctm=cmit->second->contentMetaTable->get(cid);
+        // a TTL of 0 is forever
+        if(ctm && ctm->ttl>0) {
+            uint64_t expires=expiryTick(Timestamp(ctm->timestamp) + Timestamp(ctm->ttl));
+            if(expires<when)
+                when=expires;
         }
     }
+    if(when==~(uint64_t) 0)
+        _contentExpiry.remove(cid);
+    else {
+        _contentExpiry.schedule(cid, now, when>now ? when-now : 0);
+        scheduleExpirer();
+    }
 }
 
-int
-CChunk::fill(const unsigned char *_payload, unsigned int offset, unsigned int length)
+void
+XIAContentModule::scheduleExpirer()
 {
-    //  std::cout<<"enter fill, payload is "<<_payload<<std::endl;
-
-    CPartList::iterator it, post_it;
-    CPart p(offset, length);
-    char *off = payload + offset ;
-
-    for( it=parts.begin(); it!=parts.end(); it++ ) {
-        if(it->v.offset > offset)break;
-    }
-    if(it==parts.end()) {  //end
-        if(it==parts.begin()) { //empty
-            //std::cout<<"push back"<<std::endl;
-            memcpy(off, _payload, length);
-            parts.push_back(new CPartListNode(p));
-        } else {            //not empty
-            it--;
-            if( it->v.offset + it->v.length < offset + length) {
-                memcpy(off, _payload, length);
-                //std::cout<<"off is "<<off<<std::endl;
-                //std::cout<<"push back"<<std::endl;
-                parts.push_back(new CPartListNode(p));
-                Merge(it);
-            }
+    if(_expirer.initialized() && !_expirer.scheduled()
+       && (_partialExpiry.size() || _contentExpiry.size() || _rejectedExpiry.size()))
+        _expirer.schedule_after_msec(EXPIRY_TICK);
+}
+
+void
+XIAContentModule::expirePartial(const XID &cid)
+{
+    HashTable<XID,CChunk*>::iterator it=_partialTable.find(cid);
+    if(it==_partialTable.end())
+        return;
+    CChunk *chunk=it->second;
+    // only router partials count against the cache
+    if(_partialOrder.remove(cid))
+        usedSize-=chunk->GetSize();
+    _partialTable.erase(it);
+    delete chunk;
+    _expired++;
+}
+
+/* Each tick drops only the chunks whose time is up. */
+void
+XIAContentModule::expiryHook(Timer *, void *thunk)
+{
+    XIAContentModule *cm=static_cast<XIAContentModule *>(thunk);
+    uint64_t now=expiryTick(Timestamp::now());
+    Vector<XID> expired;
+
+    cm->_partialExpiry.advance(now, expired);
+    for(int i=0; i<expired.size(); i++)
+        cm->expirePartial(expired[i]);
+
+    // forgetting a rejected chunk is all there is to do
+    expired.clear();
+    cm->_rejectedExpiry.advance(now, expired);
+
+    expired.clear();
+    cm->_contentExpiry.advance(now, expired);
+    for(int i=0; i<expired.size(); i++)
+        if(cm->_contentTable.get(expired[i])) {
+            if(!cm->demoteContent(expired[i]))
+                cm->dropContent(expired[i]);
+            cm->_expired++;
         }
-    } else { //not end
-        if(it==parts.begin()) { //begin
-            memcpy(off, _payload, length);
-            //std::cout<<"push front"<<std::endl;
-            parts.push_front(new CPartListNode(p));
-            it=parts.begin();
-            Merge(it);
-        } else {	//not begin
-            it--;
-            if(offset <= it->v.offset + it->v.length ) { //overlap with previous interval
-                if( offset+length <= it->v.offset + it->v.length ) { //cover
-                } else { //not cover
-                    memcpy(off, _payload, length);
-                    it->v.length = (offset+length) - it->v.offset;
-                    Merge(it);
-                }
-            } else { // not overlap with previous interval
-                memcpy(off,_payload, length);
-                //std::cout<<"insert"<<std::endl;
-                parts.insert(post_it, new CPartListNode(p));
-                post_it=it;
-                post_it++;
-                Merge(post_it);
-            }
+
+    cm->scheduleExpirer();
+}
+
+int
+XIAContentModule::set_store(const String &filename, uint64_t size, ErrorHandler *errh)
+{
+    return _store.open(filename, size, errh);
+}
+
+void
+XIAContentModule::initialize(Element *owner)
+{
+    _pacer.initialize(owner);
+    _promoter.initialize(owner);
+    _expirer.initialize(owner);
+    scheduleExpirer();
+
+    // requests for chunks recovered from disk should come here
+    Vector<XID> stored;
+    _store.list(stored);
+    _routeTable->insert(stored, localRoute, false);
+    if(stored.size())
+        click_chatter("Recovered %d chunks from disk", stored.size());
+}
+
+CChunk::CChunk(XID _xid, int chunkSize, unsigned int segmentSize)
+{
+    xid=_xid;
+    size=chunkSize;
+    filled=0;
+    segment_size=segmentSize ? segmentSize : 1;
+    nsegments=(size + segment_size - 1)/segment_size;
+
+    // refcount, then per segment: Segment, headroom, data; the last
+    // segment is only as long as it needs to be
+    size_t len=HEADER;
+    if(nsegments)
+        len+=(nsegments-1)*(HEADER + SEGMENT_HEADROOM + segment_size)
+            + HEADER + SEGMENT_HEADROOM + segment_length(nsegments-1);
+    buffer=new unsigned char[len];
+    atomic_uint32_t *refcount=reinterpret_cast<atomic_uint32_t *>(buffer);
+    *refcount=1;
+    for(int i=0; i<nsegments; i++) {
+        Segment *seg=reinterpret_cast<Segment *>(segment_data(i) - SEGMENT_HEADROOM - HEADER);
+        seg->refcount=refcount;
+        seg->busy=0;
+    }
+}
+
+CChunk::~CChunk()
+{
+    release(reinterpret_cast<atomic_uint32_t *>(buffer));
+}
+
+void
+CChunk::release(atomic_uint32_t *refcount)
+{
+    if(refcount->dec_and_test())
+        delete[] reinterpret_cast<unsigned char *>(refcount);
+}
+
+void
+CChunk::segment_destructor(unsigned char *head, size_t)
+{
+    Segment *seg=reinterpret_cast<Segment *>(head - HEADER);
+    seg->busy=0;
+    release(seg->refcount);
+}
+
+unsigned int
+CChunk::segment_length(int i) const
+{
+    unsigned int off=segment_offset(i);
+    return size-off < segment_size ? size-off : segment_size;
+}
+
+WritablePacket *
+CChunk::segment_packet(int i, uint32_t headroom)
+{
+    unsigned char *data=segment_data(i);
+    unsigned int len=segment_length(i);
+#if CLICK_USERLEVEL
+    Segment *seg=reinterpret_cast<Segment *>(data - SEGMENT_HEADROOM - HEADER);
+    if(headroom<=SEGMENT_HEADROOM && seg->busy.compare_swap(0, 1)==0) {
+        WritablePacket *p=Packet::make(data - SEGMENT_HEADROOM, SEGMENT_HEADROOM + len, segment_destructor);
+        if(!p) {
+            seg->busy=0;
+            return 0;
         }
+        ++*seg->refcount;
+        p->pull(SEGMENT_HEADROOM);
+        return p;
     }
-    //  std::cout<<"leave fill: list size is "<<parts.size()<<std::endl;
-    return 0;
+#endif
+    // headers do not fit, or the segment is still in flight
+    return Packet::make(headroom, data, len, 20);
 }
 
+WritablePacket *
+CChunk::chunk_packet(uint32_t headroom)
+{
+    if(nsegments==1)
+        return segment_packet(0, headroom);
+    WritablePacket *p=Packet::make(headroom, 0, size, 20);
+    if(!p)
+        return 0;
+    copy(p->data());
+    return p;
+}
 
-bool
-CChunk::full()
+void
+CChunk::copy(unsigned char *dst) const
 {
-    if(complete==true) return true;
+    for(int i=0; i<nsegments; i++)
+        memcpy(dst+segment_offset(i), segment_data(i), segment_length(i));
+}
 
-    CPartList::iterator it;
-    it= parts.begin();
+int
+CChunk::fill(const unsigned char *_payload, unsigned int offset, unsigned int length)
+{
+    if(full())
+        return 0;
+    if(offset>size)
+        return -EINVAL;
+    if(length>size-offset)
+        length=size-offset;
+    if(!length)
+        return 0;
+    unsigned int end=offset+length;
+
+    // copy into the segments the range spans
+    for(unsigned int off=offset; off<end; ) {
+        int i=off/segment_size;
+        unsigned int segoff=off-segment_offset(i);
+        unsigned int l=segment_length(i)-segoff;
+        if(l>end-off)
+            l=end-off;
+        memcpy(segment_data(i)+segoff, _payload+(off-offset), l);
+        off+=l;
+    }
 
-    if( it->v.offset==0 && it->v.length==size) {
-        complete=true;
-        return true;
+    // merge [offset, end) into the sorted, disjoint filled ranges
+    int n=parts.size(), i=0, j;
+    while(i<n && parts[i].end<offset)
+        i++;
+    unsigned int lo=offset, hi=end, merged=0;
+    for(j=i; j<n && parts[j].offset<=end; j++) {
+        if(parts[j].offset<lo)
+            lo=parts[j].offset;
+        if(parts[j].end>hi)
+            hi=parts[j].end;
+        merged+=parts[j].end-parts[j].offset;
+    }
+    Part p={lo, hi};
+    if(j==i)
+        parts.insert(parts.begin()+i, p);
+    else {
+        parts[i]=p;
+        parts.erase(parts.begin()+i+1, parts.begin()+j);
     }
-    return false;
+    filled+=(hi-lo)-merged;
+    if(full())
+        parts.clear();
+    return 0;
 }
 
 CLICK_ENDDECLS
 //ELEMENT_REQUIRES(userlevel)
+ELEMENT_REQUIRES(XIACacheEvictor XIATinyLFU XIAChunkStore)
 ELEMENT_PROVIDES(XIAContentModule)
@@ -4,66 +4,132 @@
 #include <click/packet.hh>
 #include <click/xid.hh>
 #include <click/list.hh>
+#include <click/atomic.hh>
+#include <click/vector.hh>
+#include <click/timer.hh>
+#include <click/timestamp.hh>
 #include <clicknet/xia.h>
 #include <click/hashtable.hh>
 #include <click/xiapath.hh>
+#include <click/xiaheader.hh>
 #include <map>
 
 #include "xiaxidroutetable.hh"
 #include "xiatransport.hh"
+#include "xiacacheevictor.hh"
+#include "xiatinylfu.hh"
+#include "xiachunkstore.hh"
+#include "xiaexpirywheel.hh"
 
 #define CACHESIZE 1024*1024*1024    //only for router cache (endhost cahe is virtually unlimited, but is periodically refreshed)
 #define CLIENTCACHE
 #define PACKETSIZE 1024		
 
-#define POLICY_FIFO 1
-
 #define HASH_KEYSIZE 20
 
 CLICK_DECLS
 class XIAContentModule;
 class XIATransport;
 
-class CPart{
-    public: 
-	CPart(unsigned int,unsigned int);
-	~CPart(){}
-	unsigned int offset;
-	unsigned int length;
-};
+/* The parts of every response carrying a chunk, built when the chunk is
+   cached.  A response splices the request's source nodes in between. */
+struct ChunkResponseTemplate {
+    String fixed;		// XIA header without its nodes
+    String source;		// our nodes, with the CID as the intent
+    String content;		// content header
+    uint16_t chunkOffsetPos;	// where CHUNK_OFFSET's value is in content
+    uint16_t lengthPos;		// where LENGTH's value is in content
+    XID cid;			// the CID the responses carry
+    unsigned int addrVersion;
 
-struct CPartListNode {
-	CPart v;
- 	List_member<CPartListNode> link;
-	CPartListNode(CPart p) : v(p) {}
+    ChunkResponseTemplate() : chunkOffsetPos(0), lengthPos(0), addrVersion(0) {}
 };
 
-typedef List<CPartListNode, &CPartListNode::link> CPartList;
+/* Headers of the responses to one request, patched with each segment's
+   offset and length. */
+struct ChunkResponseHeader {
+    String bytes;		// XIA header, then the content header
+    uint16_t xiaLen;
+    uint16_t chunkOffsetPos;	// where CHUNK_OFFSET's value is in bytes
+    uint16_t lengthPos;		// where LENGTH's value is in bytes
+
+    ChunkResponseHeader() : xiaLen(0), chunkOffsetPos(0), lengthPos(0) {}
+};
 
+/*
+ * A chunk is stored in fixed-size segments, each with room in front of it
+ * for the headers of a response packet.  Serving a segment wraps it in a
+ * packet without copying the payload; the segment is marked busy until
+ * that packet dies, and a second request meanwhile gets a copy.  The chunk
+ * memory outlives the CChunk while any of its segments are in flight.
+ */
 class CChunk{
     public:
-	CChunk(XID, int);
+	CChunk(XID, int, unsigned int segment_size);
 	~CChunk();
 	int fill(const unsigned char* , unsigned int, unsigned int);
-	bool full();
-	unsigned int GetSize()
+	bool full() const
 	{
-	    return size;
+	    return filled==size;
 	}
-	char* GetPayload()
+	unsigned int GetSize()
 	{
-	    return payload;
+	    return size;
 	}
 	XID id() { return xid; };
+
+	int segments() const { return nsegments; }
+	unsigned int segment_offset(int i) const { return i*segment_size; }
+	unsigned int segment_length(int i) const;
+	/** @brief Return segment @a i as a packet with @a headroom bytes free
+	 * in front of it, without copying it if possible. */
+	WritablePacket *segment_packet(int i, uint32_t headroom);
+	/** @brief Return the whole chunk as one packet. */
+	WritablePacket *chunk_packet(uint32_t headroom);
+	/** @brief Copy the whole chunk to @a dst. */
+	void copy(unsigned char *dst) const;
+
+	enum { SEGMENT_HEADROOM = 240 };
+
+	Timestamp lastFill;	// when a partial chunk was last filled (router cache)
+	ChunkResponseTemplate response;	// router cache response headers
     private:
+	struct Part {
+	    unsigned int offset;
+	    unsigned int end;
+	};
+	struct Segment {
+	    atomic_uint32_t *refcount;	// shared by the chunk and its packets
+	    atomic_uint32_t busy;
+	};
+	enum { HEADER = 16 };	// room for the refcount or a Segment
+
 	XID xid;
-	bool complete;
 	unsigned int size;
-	char* payload;
-	CPartList parts; 
-	bool deleted;
+	unsigned int filled;
+	unsigned int segment_size;
+	int nsegments;
+	unsigned char *buffer;
+	Vector<Part> parts;	// filled ranges, until the chunk is full
 
-	void Merge(CPartList::iterator);
+	unsigned char *segment_data(int i) const {
+	    return buffer + HEADER + i*(HEADER + SEGMENT_HEADROOM + segment_size) + HEADER + SEGMENT_HEADROOM;
+	}
+	static void release(atomic_uint32_t *refcount);
+	static void segment_destructor(unsigned char *, size_t);
+
+	CChunk(const CChunk &);
+	CChunk &operator=(const CChunk &);
+};
+
+/* A router cache response still being sent. */
+struct ChunkTrain {
+    XID cid;
+    ChunkResponseHeader header;
+    int next;			// next segment to send
+    int64_t tokens;		// token bucket, in bytes
+    Timestamp refilled;
+    List_member<ChunkTrain> link;
 };
 
 /* Client local cache*/
@@ -78,12 +144,14 @@ struct cacheMeta{
     int maxSize;
     int policy;
     HashTable <XID, struct contentMeta*> *contentMetaTable;
+    XIACacheEvictor *order;	// eviction order of the slice's chunks
 };
 
 
 class XIAContentModule {
     friend class XIATransport;
     friend class XIACache;
+    friend class XIAChunkStore;
     public:
     typedef XIAPath::handle_t handle_t;        
     XIAContentModule(XIATransport* transport);
@@ -93,11 +161,35 @@ class XIAContentModule {
 
 	int malicious; // Respond to CID requests with bad data if set to 1
 
+    /** @brief Set the eviction policy of the router cache. */
+    void set_policy(XIACacheEvictor::Policy policy) { _contentOrder.set_policy(policy); }
+    XIACacheEvictor::Policy policy() const { return _contentOrder.policy(); }
+
+    /** @brief Admit forwarded chunks into a full router cache only if they
+     * look more popular than the chunk they would evict.  @a entries sizes
+     * the frequency estimator; 0 turns admission control off. */
+    int set_admission(uint32_t entries);
+
+    /** @brief Pace each router cache response at @a rate bytes per second
+     * with bursts of up to @a burst bytes; a @a rate of 0 sends responses
+     * at once.  Pacing needs initialize(). */
+    void set_pacing(uint32_t rate, uint32_t burst) { _pacingRate=rate; _pacingBurst=burst; }
+    void initialize(Element *owner);
+    /** @brief Keep chunks the router cache evicts in a store of @a size
+     * bytes in @a filename, and recover the chunks it already holds. */
+    int set_store(const String &filename, uint64_t size, ErrorHandler *errh);
+    /** @brief Note that the local address changed, so response headers
+     * built for the old one are not reused. */
+    void local_addr_changed() { _addrVersion++; }
+    /** @brief Drop partial chunks not filled for @a partial milliseconds,
+     * and cached chunks not requested for @a idle milliseconds; an @a idle
+     * of 0 keeps them until they are evicted.  Expiry needs initialize(). */
+    void set_timeouts(uint32_t partial, uint32_t idle);
+
     protected:
     void cache_incoming_local(Packet *p, const XID& srcCID, bool local_putcid, bool pushcid);
     void cache_incoming_forward(Packet *p, const XID& srcCID);
     void cache_incoming_remove(Packet *p, const XID& srcCID);
-    void cache_management();
     private:
     XIATransport* _transport;
     XIAPath _local_addr;
@@ -105,40 +197,96 @@ class XIAContentModule {
     bool _cache_content_from_network;
     HashTable<XID,CChunk*> _partialTable;
     HashTable<XID, CChunk*>_contentTable;
-    HashTable<XID, CChunk*>_oldPartial; /* only used in client. When refresh timer is
-	fired,  _oldPartial is cleared and everything in _partialTable goes to _oldPartial.
-	It takes two timers to clear on-going partial chunk transfers.  */
 
     HashTable<int, cacheMeta*> _cacheMetaTable;
     
     unsigned int usedSize;
     static const unsigned int MAXSIZE=CACHESIZE;
     static unsigned int PKTSIZE;    
-    //lru    
-    static const int REFRESH=1000000;
-    int _timer;
-    HashTable<XID, int> partial;
+    // payload per stored segment, leaving room for headers within PKTSIZE
+    static unsigned int segmentSize() {
+	return PKTSIZE > 2*CChunk::SEGMENT_HEADROOM ? PKTSIZE - CChunk::SEGMENT_HEADROOM : PKTSIZE/2;
+    }
     HashTable<XID, int> content;   
+
+    // router cache eviction order; chunks counted in usedSize are in one
+    // of these
+    XIACacheEvictor _contentOrder;
+    XIACacheEvictor _partialOrder;	// least recently filled first
+    XIATinyLFU _admission;
+
+    // router cache statistics
+    uint32_t _requests;
+    uint32_t _hits;
+    uint32_t _admitted;
+    uint32_t _rejected;
+
+    // router cache responses in flight
+    typedef List<ChunkTrain, &ChunkTrain::link> TrainList;
+    TrainList _trains;
+    Timer _pacer;
+    uint32_t _pacingRate;
+    uint32_t _pacingBurst;
+    unsigned int _addrVersion;
+    bool prepareResponse(CChunk *chunk, const XID &cid);
+    bool responseHeader(CChunk *chunk, const XID &cid, const XIAHeader &request, ChunkResponseHeader &h);
+    bool runTrain(ChunkTrain *t, const Timestamp &now);
+    void schedulePacer(const Timestamp &now);
+    static void pacerHook(Timer *, void *);
+
+    // disk tier: evicted chunks go there, and come back when requested
+    enum { MAX_WAITING = 64 };
+    XIAChunkStore _store;
+    HashTable<XID, Vector<Packet *> > _waiting;	// requests for chunks being read
+    Timer _promoter;
+    uint32_t _demoted;
+    uint32_t _promoted;
+    void serveChunk(Packet *p, const XID &key, CChunk *chunk, const XID &cid);
+    bool demoteContent(const XID &);
+    void forgetStored(const Vector<XID> &);
+    void waitForChunk(Packet *p, const XID &);
+    void promote(const XID &, CChunk *);
+    static void promoterHook(Timer *, void *);
+
+    // expiry: partial chunks time out when nobody fills them, cached chunks
+    // when nobody requests them or their cache slice's TTL runs out;
+    // chunks admission turned away are remembered as long as a partial chunk
+    // would be, so the rest of their packets are dropped without a new vote
+    enum { EXPIRY_TICK = 100 };		// msec
+    enum { MAX_REJECTED = 1024 };
+    XIAExpiryWheel<XID> _partialExpiry;
+    XIAExpiryWheel<XID> _contentExpiry;
+    XIAExpiryWheel<XID> _rejectedExpiry;
+    Timer _expirer;
+    uint32_t _partialTimeout;		// ticks
+    uint32_t _idleTimeout;		// ticks, 0 for never
+    uint32_t _expired;
+    static uint64_t expiryTick(const Timestamp &t) { return t.msecval() / EXPIRY_TICK; }
+    void schedulePartial(const XID &);
+    void scheduleContent(const XID &);
+    void scheduleExpirer();
+    void expirePartial(const XID &);
+    static void expiryHook(Timer *, void *);
+
     Packet *makeChunkResponse(CChunk * chunk, Packet *p_in);
     Packet *makeChunkPush(CChunk * chunk, Packet *p_in);
     int MakeSpace(int);    
+    bool admit(const XID &, int);
+    void evictPartial(const XID &);
+    void untrackContent(const XID &);
+    void dropContent(const XID &);
 
     //Cache Policy
     void applyLocalCachePolicy(int);
-    const XID* findOldestContent(int);
-    bool isExpiredContent(struct contentMeta* cm);
 
     //modify routing table
+    static const XIARouteData localRoute;
     void addRoute(const XID &cid) {
-	String cmd=cid.unparse() + " " + String(DESTINED_FOR_LOCALHOST);
-	click_chatter("Add route %s", cid.unparse().c_str());
-	HandlerCall::call_write(_routeTable, "add", cmd);
+	_routeTable->insert(cid, localRoute, false);
     } 
 
     void delRoute(const XID &cid) {
-	String cmd= cid.unparse();
-	click_chatter("Del route %s", cid.unparse().c_str());
-	HandlerCall::call_write(_routeTable, "remove", cmd);
+	_routeTable->erase(cid);
     }    
 };
 
@@ -53,6 +53,19 @@ XIADecHLIM::simple_action(Packet *p)
     }
 }
 
+void
+XIADecHLIM::push_batch(int, Packet *head)
+{
+	Packet *pkts[MAX_BATCH];
+	while (head) {
+		int n = take_batch(head, pkts);
+		// expired packets leave through output 1 one at a time
+		for (int i = 0; i < n; i++)
+			pkts[i] = simple_action(pkts[i]);
+		output_push_batch(0, make_batch(pkts, n));
+	}
+}
+
 void
 XIADecHLIM::add_handlers()
 {
@@ -62,4 +75,5 @@ XIADecHLIM::add_handlers()
 
 CLICK_ENDDECLS
 EXPORT_ELEMENT(XIADecHLIM)
+ELEMENT_REQUIRES(XIABatchElement)
 ELEMENT_MT_SAFE(XIADecHLIM)
@@ -4,6 +4,7 @@
 #include <click/glue.hh>
 #include <click/atomic.hh>
 #include "xiaxidroutetable.hh"
+#include "xiabatch.hh"
 CLICK_DECLS
 
 /*
@@ -36,7 +37,7 @@ CLICK_DECLS
  * =a DecIPTTL 
  */
 
-class XIADecHLIM : public Element { public:
+class XIADecHLIM : public XIABatchElement { public:
 
     XIADecHLIM();
     ~XIADecHLIM();
@@ -49,6 +50,7 @@ class XIADecHLIM : public Element { public:
     void add_handlers();
 
     Packet *simple_action(Packet *);
+    void push_batch(int port, Packet *head);
 
 private:
     atomic_uint32_t _drops;
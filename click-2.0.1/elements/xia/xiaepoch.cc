@@ -0,0 +1,100 @@
+/*
+ * xiaepoch.{cc,hh} -- epoch-based reclamation for lock-free readers
+ */
+
+#include <click/config.h>
+#include "xiaepoch.hh"
+CLICK_DECLS
+
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+__thread int XIAEpoch::_thread_reader;
+atomic_uint32_t XIAEpoch::_nreaders;
+
+int
+XIAEpoch::assign_reader()
+{
+    uint32_t n = _nreaders.fetch_and_add(1);
+    int r = n < SHARED_READER ? n : SHARED_READER;
+    _thread_reader = r + 1;
+    return r;
+}
+#endif
+
+XIAEpoch::XIAEpoch()
+    : _global(1)
+{
+    memset(_readers, 0, sizeof(_readers));
+}
+
+XIAEpoch::~XIAEpoch()
+{
+    // no reader can be running by the time the owner is destroyed
+    for (int i = 0; i < _limbo.size(); i++)
+	_limbo[i].f(_limbo[i].object, _limbo[i].thunk);
+}
+
+void
+XIAEpoch::shared_read_begin()
+{
+    // the threads sharing this slot keep it at the oldest epoch any of them
+    // entered with, which only delays reclamation
+    _shared_lock.acquire();
+    Reader &r = _readers[SHARED_READER];
+    if (r.depth++ == 0)
+	r.epoch = _global;
+    _shared_lock.release();
+    click_fence();
+}
+
+void
+XIAEpoch::shared_read_end()
+{
+    click_fence();
+    _shared_lock.acquire();
+    Reader &r = _readers[SHARED_READER];
+    if (--r.depth == 0)
+	r.epoch = 0;
+    _shared_lock.release();
+}
+
+void
+XIAEpoch::retire(void *object, Reclaimer f, void *thunk)
+{
+    Retired r;
+    r.object = object;
+    r.f = f;
+    r.thunk = thunk;
+
+    // the object was unlinked before this point; readers that start after
+    // the epoch advances cannot reach it
+    click_fence();
+    r.epoch = _global;
+    _limbo.push_back(r);
+    _global = r.epoch + 1;
+    click_fence();
+}
+
+void
+XIAEpoch::reclaim()
+{
+    if (!_limbo.size())
+	return;
+
+    uint32_t oldest = _global;
+    for (int i = 0; i < NREADERS; i++) {
+	uint32_t e = _readers[i].epoch;
+	if (e && e < oldest)
+	    oldest = e;
+    }
+
+    int j = 0;
+    for (int i = 0; i < _limbo.size(); i++)
+	if (_limbo[i].epoch < oldest)
+	    _limbo[i].f(_limbo[i].object, _limbo[i].thunk);
+	else
+	    _limbo[j++] = _limbo[i];
+    _limbo.resize(j);
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(XIAEpoch)
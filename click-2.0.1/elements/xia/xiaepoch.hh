@@ -0,0 +1,141 @@
+#ifndef CLICK_XIAEPOCH_HH
+#define CLICK_XIAEPOCH_HH
+#include <click/glue.hh>
+#include <click/sync.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+ * XIAEpoch -- epoch-based reclamation for lock-free readers
+ *
+ * Readers bracket every access to shared state with read_begin() and
+ * read_end().  These only touch the calling thread's own reader slot, never
+ * a lock.  Slots are handed out to threads on first use and are shared by
+ * every XIAEpoch; should more threads read than there are slots, the extra
+ * threads share the last slot and update it under a lock.  A writer
+ * that unlinks an object hands it to retire(); the object is freed by a
+ * later reclaim() once every reader that could still be looking at it has
+ * left its read section (a grace period).
+ *
+ * Writers must be serialized by the caller.  Read sections nest.
+ */
+
+class XIAEpoch { public:
+
+    typedef void (*Reclaimer)(void *object, void *thunk);
+
+    XIAEpoch();
+    ~XIAEpoch();
+
+    inline void read_begin();
+    inline void read_end();
+
+    void retire(void *object, Reclaimer f, void *thunk = 0);
+    void reclaim();
+    int pending() const			{ return _limbo.size(); }
+
+  private:
+
+#if CLICK_LINUXMODULE
+    enum { NREADERS = NUM_CLICK_CPUS };
+#else
+    enum { NREADERS = 64 };
+#endif
+    enum { SHARED_READER = NREADERS - 1 };
+
+    struct Reader {
+	volatile uint32_t epoch;	// 0 when outside a read section
+	uint32_t depth;
+    }
+#if CLICK_LINUXMODULE
+    ____cacheline_aligned_in_smp;
+#else
+    __attribute__ ((aligned (64)));
+#endif
+
+    struct Retired {
+	void *object;
+	Reclaimer f;
+	void *thunk;
+	uint32_t epoch;
+    };
+
+    Reader _readers[NREADERS];
+    volatile uint32_t _global;
+    Vector<Retired> _limbo;
+    Spinlock _shared_lock;		// guards _readers[SHARED_READER]
+
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    static __thread int _thread_reader;	// slot + 1, or 0 if none yet
+    static atomic_uint32_t _nreaders;
+    static int assign_reader();
+#endif
+    static inline int current_reader();
+    void shared_read_begin();
+    void shared_read_end();
+
+    XIAEpoch(const XIAEpoch &);
+    XIAEpoch &operator=(const XIAEpoch &);
+};
+
+
+/** @brief Order earlier loads before later loads.
+ *
+ * Loads are not reordered with other loads on x86, so only the compiler
+ * needs to be fenced there. */
+inline void
+xia_read_barrier()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    click_compiler_fence();
+#else
+    click_fence();
+#endif
+}
+
+inline int
+XIAEpoch::current_reader()
+{
+#if CLICK_LINUXMODULE
+    return click_current_processor() % NREADERS;
+#elif CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    int r = _thread_reader;
+    return likely(r) ? r - 1 : assign_reader();
+#else
+    return 0;
+#endif
+}
+
+inline void
+XIAEpoch::read_begin()
+{
+    int i = current_reader();
+    if (unlikely(i == SHARED_READER)) {
+	shared_read_begin();
+	return;
+    }
+    Reader &r = _readers[i];
+    if (r.depth++ == 0) {
+	r.epoch = _global;
+	// publish the epoch before reading any shared pointer
+	click_fence();
+    }
+}
+
+inline void
+XIAEpoch::read_end()
+{
+    int i = current_reader();
+    if (unlikely(i == SHARED_READER)) {
+	shared_read_end();
+	return;
+    }
+    Reader &r = _readers[i];
+    if (--r.depth == 0) {
+	click_fence();
+	r.epoch = 0;
+    }
+}
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,255 @@
+#ifndef CLICK_XIAEXPIRYWHEEL_HH
+#define CLICK_XIAEXPIRYWHEEL_HH
+#include <click/glue.hh>
+#include <click/hashtable.hh>
+#include <click/list.hh>
+#include <click/vector.hh>
+#include <click/xid.hh>
+CLICK_DECLS
+
+/*
+ * XIAExpiryWheel<K> -- deadlines for cached chunks and socket timers
+ *
+ * Tracks one deadline per key, in ticks of the caller's choosing, and
+ * returns the keys whose deadlines have passed as the caller advances the
+ * wheel.  The wheel is hierarchical: four levels of 64 slots, each slot of
+ * a level spanning a whole turn of the level below.  A deadline sits in the
+ * lowest level whose current turn contains it, and moves down a level when
+ * that turn comes around, so each deadline is touched at most four times
+ * before it expires, however many keys are tracked.  Deadlines more than
+ * 2^24 ticks away wait in an overflow list that is revisited once per turn
+ * of the top level.
+ *
+ * schedule() and remove() take constant time.  advance() costs one step
+ * per tick on which a deadline expires or moves down a level, plus one
+ * visit per such deadline; visits() and max_visits() report that work.
+ * next_tick() says when that next happens, so a caller can sleep until then.
+ *
+ * K must be usable as a HashTable key.  XIAContentModule keys its wheels
+ * by CID, XTRANSPORT by socket and timer kind.  XIAExpiryWheel is not an
+ * element.
+ */
+
+template <typename K>
+class XIAExpiryWheel { public:
+
+    XIAExpiryWheel();
+    ~XIAExpiryWheel();
+
+    int size() const			{ return _index.size(); }
+    bool contains(const K &key) const	{ return _index.get(key) != 0; }
+    uint64_t now() const		{ return _now; }
+
+    /** @brief Expire @a key @a delay ticks after tick @a now, replacing its
+     * earlier deadline, if any.  An empty wheel first jumps to @a now. */
+    void schedule(const K &key, uint64_t now, uint64_t delay);
+    /** @brief Forget @a key's deadline.  Returns false if it had none. */
+    bool remove(const K &key);
+
+    /** @brief Move the wheel to tick @a now, appending the keys whose
+     * deadlines passed to @a expired.  They are no longer tracked. */
+    void advance(uint64_t now, Vector<K> &expired);
+    /** @brief Return the first tick on which advance() will expire a
+     * deadline or move one down a level, or NEVER if the wheel is empty.
+     * No deadline passes before it. */
+    uint64_t next_tick() const;
+
+    void clear();
+
+    uint64_t ticks() const		{ return _ticks; }
+    uint64_t visits() const		{ return _visits; }
+    uint32_t max_visits() const		{ return _max_visits; }
+
+    static const uint64_t NEVER = ~(uint64_t) 0;
+
+  private:
+
+    enum { LEVEL_BITS = 6, SLOTS = 1 << LEVEL_BITS, LEVELS = 4 };
+
+    struct Entry {
+	K key;
+	uint64_t when;
+	List_member<Entry> link;
+	List<Entry, &Entry::link> *slot;	// the list holding it
+    };
+    typedef List<Entry, &Entry::link> EntryList;
+
+    HashTable<K, Entry *> _index;
+    EntryList _slots[LEVELS][SLOTS];
+    EntryList _overflow;		// beyond the top level's turn
+    uint64_t _now;
+
+    uint64_t _ticks;
+    uint64_t _visits;
+    uint32_t _max_visits;		// in one tick
+
+    void place(Entry *e);
+    void cascade(EntryList &slot, uint32_t &visits);
+    void tick(Vector<K> &expired);
+
+    XIAExpiryWheel(const XIAExpiryWheel<K> &);
+    XIAExpiryWheel<K> &operator=(const XIAExpiryWheel<K> &);
+
+};
+
+template <typename K>
+XIAExpiryWheel<K>::XIAExpiryWheel()
+    : _now(0), _ticks(0), _visits(0), _max_visits(0)
+{
+}
+
+template <typename K>
+XIAExpiryWheel<K>::~XIAExpiryWheel()
+{
+    clear();
+}
+
+template <typename K>
+void
+XIAExpiryWheel<K>::clear()
+{
+    for (typename HashTable<K, Entry *>::iterator it = _index.begin(); it != _index.end(); ++it)
+	delete it.value();
+    _index.clear();
+    for (int l = 0; l < LEVELS; l++)
+	for (int s = 0; s < SLOTS; s++)
+	    _slots[l][s].__clear();
+    _overflow.__clear();
+}
+
+/* Put @a e in the lowest level whose current turn holds its deadline: the
+   level of the highest bit in which the deadline and _now differ. */
+template <typename K>
+void
+XIAExpiryWheel<K>::place(Entry *e)
+{
+    uint64_t diff = e->when ^ _now;
+    int level = 0;
+    while (level < LEVELS && diff >= SLOTS) {
+	diff >>= LEVEL_BITS;
+	level++;
+    }
+    if (level == LEVELS)
+	e->slot = &_overflow;
+    else
+	e->slot = &_slots[level][(e->when >> (level * LEVEL_BITS)) & (SLOTS - 1)];
+    e->slot->push_back(e);
+}
+
+template <typename K>
+void
+XIAExpiryWheel<K>::schedule(const K &key, uint64_t now, uint64_t delay)
+{
+    if (_index.empty() && now > _now)
+	_now = now;
+    uint64_t when = now + delay;
+    // the current tick is done
+    if (when <= _now)
+	when = _now + 1;
+
+    Entry *&e = _index[key];
+    if (e)
+	e->slot->erase(e);
+    else {
+	e = new Entry;
+	e->key = key;
+    }
+    e->when = when;
+    place(e);
+}
+
+template <typename K>
+bool
+XIAExpiryWheel<K>::remove(const K &key)
+{
+    typename HashTable<K, Entry *>::iterator it = _index.find(key);
+    if (it == _index.end())
+	return false;
+    Entry *e = it.value();
+    e->slot->erase(e);
+    _index.erase(it);
+    delete e;
+    return true;
+}
+
+template <typename K>
+void
+XIAExpiryWheel<K>::cascade(EntryList &slot, uint32_t &visits)
+{
+    EntryList moving;
+    moving.swap(slot);
+    while (Entry *e = moving.front()) {
+	moving.pop_front();
+	place(e);
+	visits++;
+    }
+}
+
+template <typename K>
+void
+XIAExpiryWheel<K>::tick(Vector<K> &expired)
+{
+    _now++;
+    _ticks++;
+    uint32_t visits = 0;
+
+    // when a level's turn ends, spread the next slot of each level above
+    // over the levels below, top level first
+    int top = 0;
+    while (top < LEVELS && (_now & (((uint64_t) 1 << ((top + 1) * LEVEL_BITS)) - 1)) == 0)
+	top++;
+    if (top == LEVELS)
+	cascade(_overflow, visits);
+    for (int level = (top < LEVELS ? top : LEVELS - 1); level > 0; level--)
+	cascade(_slots[level][(_now >> (level * LEVEL_BITS)) & (SLOTS - 1)], visits);
+
+    EntryList &slot = _slots[0][_now & (SLOTS - 1)];
+    while (Entry *e = slot.front()) {
+	slot.pop_front();
+	expired.push_back(e->key);
+	_index.erase(e->key);
+	delete e;
+	visits++;
+    }
+
+    _visits += visits;
+    if (visits > _max_visits)
+	_max_visits = visits;
+}
+
+/* The deadlines in a level sit in the slots after _now's in that level's
+   current turn, and each slot is emptied on the first tick of its span. */
+template <typename K>
+uint64_t
+XIAExpiryWheel<K>::next_tick() const
+{
+    if (_index.empty())
+	return NEVER;
+    for (int level = 0; level < LEVELS; level++) {
+	int shift = level * LEVEL_BITS;
+	uint64_t turn = _now >> (shift + LEVEL_BITS);
+	for (int s = ((_now >> shift) & (SLOTS - 1)) + 1; s < SLOTS; s++)
+	    if (!_slots[level][s].empty())
+		return ((turn << LEVEL_BITS) + s) << shift;
+    }
+    return ((_now >> (LEVELS * LEVEL_BITS)) + 1) << (LEVELS * LEVEL_BITS);
+}
+
+template <typename K>
+void
+XIAExpiryWheel<K>::advance(uint64_t now, Vector<K> &expired)
+{
+    while (_now < now) {
+	// skip the ticks on which nothing happens
+	uint64_t next = next_tick();
+	if (next > now) {
+	    _now = now;
+	    break;
+	}
+	_now = next - 1;
+	tick(expired);
+    }
+}
+
+CLICK_ENDDECLS
+#endif
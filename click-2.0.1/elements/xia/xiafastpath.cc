@@ -3,17 +3,48 @@
  */
 #include <click/config.h>
 #include "xiafastpath.hh"
+#include "xiaxidroutetable.hh"
+#include "xiaforwardengine.hh"
 #include <click/glue.hh>
 #include <click/error.hh>
 #include <click/nameinfo.hh>
 #include <click/confparse.hh>
-#include <clicknet/xia.h>
-#include <click/xiaheader.hh>
+#include <click/packet_anno.hh>
+#include <click/xid.hh>
+#include <click/router.hh>
+#include <click/routervisitor.hh>
 CLICK_DECLS
 
-XIAFastPath::XIAFastPath() : _offset(0)
+namespace {
+/* Collects the route tables reachable downstream, through an
+   XIAForwardEngine too. */
+class RouteTableTracker : public RouterVisitor { public:
+    RouteTableTracker(Vector<XIAXIDRouteTable *> &tables)
+	: _tables(tables) {
+    }
+    bool visit(Element *e, bool, int, Element *, int, int) {
+	if (XIAXIDRouteTable *t = static_cast<XIAXIDRouteTable *>(e->cast("XIAXIDRouteTable")))
+	    add(t);
+	else if (XIAForwardEngine *f = static_cast<XIAForwardEngine *>(e->cast("XIAForwardEngine")))
+	    for (int i = 0; i < f->ntables(); i++)
+		add(f->table(i));
+	return true;
+    }
+  private:
+    Vector<XIAXIDRouteTable *> &_tables;
+    void add(XIAXIDRouteTable *t) {
+	for (int i = 0; i < _tables.size(); i++)
+	    if (_tables[i] == t)
+		return;
+	_tables.push_back(t);
+    }
+};
+}
+
+XIAFastPath::XIAFastPath() : _bucket_size(0)
 {
     memset(_buckets, 0, sizeof(struct bucket*) * NUM_CLICK_CPUS);
+    memset(_stats, 0, sizeof(_stats));
 }
 
 XIAFastPath::~XIAFastPath()
@@ -24,92 +55,257 @@ XIAFastPath::~XIAFastPath()
 }
 
 int
-XIAFastPath::initialize(ErrorHandler *)
+XIAFastPath::initialize(ErrorHandler *errh)
 {
+    RouteTableTracker tracker(_tables);
+    router()->visit_downstream(this, 0, &tracker);
+    if (!_tables.size())
+        return errh->error("no XIAXIDRouteTable downstream of output 0");
+
     for (int i = 0; i < NUM_CLICK_CPUS; i++) {
         _buckets[i] = new struct bucket[_bucket_size];
+        if (!_buckets[i])
+            return errh->error("out of memory");
         memset(_buckets[i], 0, _bucket_size * sizeof(struct bucket));
     }
     return 0;
 }
 
-const uint8_t* XIAFastPath::getkey(Packet *p)
+inline int
+XIAFastPath::thread_id()
 {
-    return XIAHeader(p).payload() + _offset;
+// FIXME: this treats OSX as non-threaded
+#if HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+#if CLICK_USERLEVEL
+    return click_current_thread_id;
+#else
+    return click_current_processor();
+#endif
+#else
+    return 0;
+#endif
 }
 
-void XIAFastPath::update_cacheline(struct bucket *buck, const uint8_t *key, int port)
+/* The routes a decision may depend on are unchanged as long as this is. */
+inline uint32_t
+XIAFastPath::generation() const
 {
-    int empty = 0;
-    uint8_t max_counter = -1;
-    for (int i = 0; i < ASSOCIATIVITY; i++) {
-		if (max_counter< buck->counter[i]) {
-			max_counter = buck->counter[i];
-			empty = i;
-		}
-		buck->counter[i]++;
+    uint32_t g = 0;
+    for (int i = 0; i < _tables.size(); i++)
+        g += _tables[i]->generation();
+    // 0 means "no generation"
+    return g ? g : 1;
+}
+
+static inline uint64_t
+mix_xid(uint64_t h, const struct click_xia_xid &xid)
+{
+    const uint32_t *w = reinterpret_cast<const uint32_t *>(&xid);
+    for (int i = 0; i < 6; i += 2) {
+        uint64_t k = ((uint64_t) w[i] << 32) | w[i + 1];
+        k *= 0x87C37B91114253D5ULL;
+        k = (k << 31) | (k >> 33);
+        h ^= k * 0x4CF5AD432745937FULL;
+        h = ((h << 27) | (h >> 37)) * 5 + 0x52DCE729;
+    }
+    return h;
+}
+
+uint64_t
+XIAFastPath::getkey(const struct click_xia *hdr)
+{
+    // the decision depends on where the packet is (the last visited node,
+    // or the start of the DAG) and on every XID its edges lead to, in order
+    static const struct click_xia_xid no_xid = { 0, { 0 } };
+    bool start = hdr->last < 0;
+    int last = start ? hdr->last + hdr->dnode : hdr->last;
+    uint64_t h = start ? 0x9E3779B97F4A7C15ULL : 0;
+
+    // at the start the edges live in the destination node's slot
+    const struct click_xia_xid_node &node = hdr->node[last];
+    h = mix_xid(h, start ? no_xid : node.xid);
+    for (int i = 0; i < CLICK_XIA_XID_EDGE_NUM; i++) {
+        int idx = node.edge[i].idx;
+        if (idx == CLICK_XIA_XID_EDGE_UNUSED || idx >= hdr->dnode)
+            h = mix_xid(h, no_xid);
+        else
+            h = mix_xid(h, hdr->node[idx].xid);
     }
+
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    return h ^ (h >> 33);
+}
+
+void XIAFastPath::update_cacheline(struct bucket *buck, uint64_t key, Packet *p, int port)
+{
+    int empty = -1;
+    uint8_t max_counter = 0;
+    for (int i = 0; i < ASSOCIATIVITY; i++)
+        if (buck->item[i].generation && buck->item[i].key == key) {
+            empty = i;
+            break;
+        }
+    if (empty < 0)
+        for (int i = 0; i < ASSOCIATIVITY; i++) {
+            if (!buck->item[i].generation) {
+                empty = i;
+                break;
+            }
+            if (empty < 0 || max_counter < buck->counter[i]) {
+                max_counter = buck->counter[i];
+                empty = i;
+            }
+        }
+    for (int i = 0; i < ASSOCIATIVITY; i++)
+        if (buck->counter[i] != 0xFF)
+            buck->counter[i]++;
     buck->counter[empty] = 0;
-    memcpy(buck->item[empty].key, key, KEYSIZE);
-    buck->item[empty].port = port;
+
+    struct item &it = buck->item[empty];
+    it.key = key;
+    it.generation = XIA_FASTPATH_GEN_ANNO(p);
+    it.paint = XIA_PAINT_ANNO(p);
+    it.port = port;
+    it.path = XIA_NEXT_PATH_ANNO(p);
+    it.nexthop = *XIA_NEXT_HOP_NEIGHBOR_ANNO(p);
+    it.has_nexthop = it.nexthop.type != 0;
 }
 
-int XIAFastPath::lookup(struct bucket *buck,  const uint8_t *key)
+struct XIAFastPath::item *
+XIAFastPath::lookup(struct bucket *buck, uint64_t key, struct stats &st)
 {
-    int port = 0;
-    for (int i = 0;i < ASSOCIATIVITY; i++) {
-	if (memcmp(key, buck->item[i].key, KEYSIZE) == 0) {
-	    port = buck->item[i].port;
-	    buck->counter[i]=0;
-	} else 
-	    buck->counter[i]++;
-   }
-   return port; 
+    for (int i = 0; i < ASSOCIATIVITY; i++) {
+        struct item &it = buck->item[i];
+        if (it.generation && it.key == key) {
+            if (it.generation != generation()) {
+                // routes changed since this was recorded
+                it.generation = 0;
+                st.invalidations++;
+                return 0;
+            }
+            buck->counter[i] = 0;
+            return &it;
+        }
+    }
+    return 0;
+}
+
+Packet *
+XIAFastPath::apply(const struct item *it, Packet *p_in)
+{
+    // what the routing graph would have done: paint, annotate, XIADecHLIM
+    WritablePacket *p = p_in->uniqueify();
+    if (!p)
+        return 0;
+    p->xia_header()->hlim--;
+    SET_XIA_PAINT_ANNO(p, it->paint);
+    SET_XIA_NEXT_PATH_ANNO(p, it->path);
+    if (it->has_nexthop)
+        p->set_nexthop_neighbor_xid_anno(XID(it->nexthop));
+    return p;
 }
 
 int XIAFastPath::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    int offset = 0;
     int bucket_size = 0;
     if (cp_va_kparse(conf, this, errh,
-                   "KEY_OFFSET", 0, cpInteger, &offset,
                    "BUCKET_SIZE", cpkM, cpInteger, &bucket_size,
                    cpEnd) < 0)
         return -1;
- 
-   _bucket_size = bucket_size;  
-   _offset = offset;
+
+   if (bucket_size <= 0)
+       return errh->error("BUCKET_SIZE must be positive");
+   _bucket_size = bucket_size;
+
+   XID bcast;
+   bcast.parse(BHID);
+   _bcast_xid = bcast.xid();
    return 0;
 }
 
 void XIAFastPath::push(int port, Packet * p)
 {
-// FIXME: this treats OSX as non-threaded
-#if HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
-#if CLICK_USERLEVEL
-    int thread_id = click_current_thread_id;
-#else
-    int thread_id = click_current_processor();
-#endif
-#else
-    int thread_id = 0;
-#endif
-
-    const uint8_t *key = getkey(p);
- 
-    uint32_t index = *(uint32_t*)key % _bucket_size;
-    //click_chatter("fastpath_key %02x%02x%02x%02x, bucket_index %u", key[0], key[1], key[2],  key[3], index);
+    int tid = thread_id();
+    struct stats &st = _stats[tid];
+    const struct click_xia *hdr = p->xia_header();
+    uint64_t key = getkey(hdr);
+    struct bucket *buck = &_buckets[tid][key % _bucket_size];
 
     if (port==0) {
-		int outport = lookup(&_buckets[thread_id][index], key);
-		output(outport).push(p);
+        struct item *it = lookup(buck, key, st);
+        // leave hop-limit expiry and redirects to the routing graph
+        if (it && hdr->hlim > 1 && it->paint != XIA_PAINT_ANNO(p)) {
+            st.hits++;
+            int outport = it->port;
+            if ((p = apply(it, p)))
+                output(outport).push(p);
+            return;
+        }
+        st.misses++;
+        SET_XIA_FASTPATH_GEN_ANNO(p, generation());
+        output(0).push(p);
     } else {
-		// Cache result
-		update_cacheline(&_buckets[thread_id][index], key, port);
-		output(port).push(p);
+        // Cache result, unless the packet did not come through a miss, was
+        // a broadcast copy, or fell back past a CID or SID
+        int last = hdr->last;
+        if (last < 0)
+            last += hdr->dnode;
+        const struct click_xia_xid_edge *edge = hdr->node[last].edge;
+        int path = XIA_NEXT_PATH_ANNO(p) % CLICK_XIA_XID_EDGE_NUM;
+        int idx = edge[path].idx;
+        bool cache = idx == CLICK_XIA_XID_EDGE_UNUSED || idx >= hdr->dnode
+            || memcmp(&hdr->node[idx].xid, &_bcast_xid, sizeof(_bcast_xid)) != 0;
+        for (int i = 0; i < path && cache; i++) {
+            int skipped = edge[i].idx;
+            if (skipped != CLICK_XIA_XID_EDGE_UNUSED && skipped < hdr->dnode) {
+                uint32_t type = ntohl(hdr->node[skipped].xid.type);
+                cache = type != CLICK_XIA_XID_TYPE_CID && type != CLICK_XIA_XID_TYPE_SID;
+            }
+        }
+        if (XIA_FASTPATH_GEN_ANNO(p) && XIA_PAINT_ANNO(p) >= 0 && cache)
+            update_cacheline(buck, key, p, port);
+        SET_XIA_FASTPATH_GEN_ANNO(p, 0);
+        output(port).push(p);
     }
 }
 
+String
+XIAFastPath::read_handler(Element *e, void *thunk)
+{
+    XIAFastPath *fp = static_cast<XIAFastPath *>(e);
+    uint32_t sum = 0;
+    for (int i = 0; i < NUM_CLICK_CPUS; i++)
+        switch ((intptr_t) thunk) {
+        case 0: sum += fp->_stats[i].hits; break;
+        case 1: sum += fp->_stats[i].misses; break;
+        default: sum += fp->_stats[i].invalidations; break;
+        }
+    return String(sum);
+}
+
+int
+XIAFastPath::clear_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    XIAFastPath *fp = static_cast<XIAFastPath *>(e);
+    for (int i = 0; i < NUM_CLICK_CPUS; i++)
+        if (fp->_buckets[i])
+            memset(fp->_buckets[i], 0, fp->_bucket_size * sizeof(struct bucket));
+    return 0;
+}
+
+void
+XIAFastPath::add_handlers()
+{
+    add_read_handler("hits", read_handler, 0);
+    add_read_handler("misses", read_handler, 1);
+    add_read_handler("invalidations", read_handler, 2);
+    add_write_handler("clear", clear_handler, 0, Handler::BUTTON);
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(XIAFastPath)
+ELEMENT_REQUIRES(XIAXIDRouteTable)
 ELEMENT_MT_SAFE(XIAFastPath)
@@ -1,41 +1,66 @@
 #ifndef CLICK_FASTPATH_HH
 #define CLICK_FASTPATH_HH
 #include <click/element.hh>
+#include <click/vector.hh>
+#include <clicknet/xia.h>
 
 /*
 =c
-XIAFastPath()
+XIAFastPath(BUCKET_SIZE)
 
 =s ip
 caches the forwarding result of partial DAG addresses (the last node and next nodes from it)
 
-=e
+=d
+Input 0 takes packets to route.  A packet whose partial DAG (the last visited
+node and the XIDs its edges lead to) is in the cache gets the cached decision
+applied -- XIA paint, next-path and next-hop annotations, and a hop-limit
+decrement -- and leaves on the cached output.  Any other packet leaves on
+output 0, towards the full routing graph.
 
-*/
+Packets that the routing graph decided to forward come back on input N (N >=
+1), which records the decision and sends them out output N.  A later packet
+with the same partial DAG then skips the routing graph and leaves on output N
+directly.
 
-// the size of the hash key for partial DAG addreseses
-#define KEYSIZE 20
+Entries are keyed on a 64-bit hash of the partial DAG and stamped with the
+route generations of the XIAXIDRouteTable elements downstream of output 0,
+including those an XIAForwardEngine uses.  A table's generation changes when
+its routes do, so a stale entry is never used; it is dropped the next time it
+is looked up.  Packets whose hop limit is about to expire, packets that would
+be sent back out the port they came in on (the routing graph sends a redirect
+for those) and broadcasts always take the full routing graph.  Neither are
+packets recorded that fell back past a CID or SID: the routes that deliver
+CIDs and SIDs locally change without touching the generation.
 
-// the number of items per hash bucket
-#define ASSOCIATIVITY 2
+Each thread has its own BUCKET_SIZE buckets of two entries.
 
-struct item {
-    uint8_t key[KEYSIZE];
-    uint8_t port;
-};
+=h hits read-only
+Packets forwarded from the cache.
 
-struct bucket {
-    struct item item[ASSOCIATIVITY];
-    uint8_t counter[ASSOCIATIVITY];
-} 
-#if CLICK_LINUXMODULE
-____cacheline_aligned_in_smp;
-#else
-__attribute__ ((aligned (64)));
-#endif
+=h misses read-only
+Packets sent to the routing graph.
 
+=h invalidations read-only
+Entries found stale because routes had changed.
+
+=h clear write-only
+Drops every entry.
+
+=e
+  fp :: XIAFastPath(BUCKET_SIZE 512);
+  input -> fp -> rt :: RouteEngine(...);
+  rt[0] -> [1]fp[1] -> output;
+
+=a XIAXIDRouteTable
+*/
+
+// the number of items per hash bucket
+#define ASSOCIATIVITY 2
 
 CLICK_DECLS
+class XIAXIDRouteTable;
+
 class XIAFastPath : public Element { public:
 
     XIAFastPath();
@@ -46,17 +71,57 @@ class XIAFastPath : public Element { public:
 
     void push(int, Packet *);
     int configure(Vector<String> &conf, ErrorHandler *errh);
-   
     int initialize(ErrorHandler *);
+    void add_handlers();
 
   private:
+
+    struct item {
+	uint64_t key;
+	uint32_t generation;		// 0 if the item is empty
+	int16_t paint;
+	uint8_t port;
+	uint8_t path;
+	uint8_t has_nexthop;
+	struct click_xia_xid nexthop;
+    };
+
+    struct bucket {
+	struct item item[ASSOCIATIVITY];
+	uint8_t counter[ASSOCIATIVITY];
+    }
+#if CLICK_LINUXMODULE
+    ____cacheline_aligned_in_smp;
+#else
+    __attribute__ ((aligned (64)));
+#endif
+
+    struct stats {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t invalidations;
+    }
+#if CLICK_LINUXMODULE
+    ____cacheline_aligned_in_smp;
+#else
+    __attribute__ ((aligned (64)));
+#endif
+
     struct bucket* _buckets[NUM_CLICK_CPUS];
+    struct stats _stats[NUM_CLICK_CPUS];
     uint32_t _bucket_size;
-    int32_t _offset;
-    
-    void update_cacheline(struct bucket *buck, const uint8_t *key, int port);
-    const uint8_t *getkey(Packet *p);
-    int lookup(struct bucket *buck,  const uint8_t *key);
+    struct click_xia_xid _bcast_xid;
+    Vector<XIAXIDRouteTable *> _tables;
+
+    static inline int thread_id();
+    inline uint32_t generation() const;
+    static uint64_t getkey(const struct click_xia *hdr);
+    void update_cacheline(struct bucket *buck, uint64_t key, Packet *p, int port);
+    struct item *lookup(struct bucket *buck, uint64_t key, struct stats &st);
+    Packet *apply(const struct item *it, Packet *p);
+
+    static String read_handler(Element *e, void *thunk);
+    static int clear_handler(const String &, Element *e, void *, ErrorHandler *);
 };
 CLICK_ENDDECLS
 #endif
@@ -0,0 +1,222 @@
+/*
+ * xiaforwardengine.{cc,hh} -- forward XIA packets through the DAG in one element
+ */
+
+#include <click/config.h>
+#include "xiaforwardengine.hh"
+#include <click/glue.hh>
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+XIAForwardEngine::XIAForwardEngine()
+    : _ntables(0)
+{
+    _forwarded = _delivered = _fallbacks = _unreachable = 0;
+}
+
+XIAForwardEngine::~XIAForwardEngine()
+{
+}
+
+int
+XIAForwardEngine::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    for (int i = 0; i < conf.size(); i++) {
+        String str_copy = conf[i];
+        String type_str = cp_shift_spacevec(str_copy);
+        String table_str = cp_shift_spacevec(str_copy);
+        String flag_str = cp_shift_spacevec(str_copy);
+
+        if (_ntables == MAX_TABLES)
+            return errh->error("too many route tables (at most %d)", (int) MAX_TABLES);
+
+        TableEntry &t = _tables[_ntables];
+        if (!cp_xid_type(type_str, &t.type))
+            return errh->error("unrecognized XID type: ", type_str.c_str());
+        if (find_table(t.type))
+            return errh->error("duplicate XID type: ", type_str.c_str());
+
+        Element *e = cp_element(table_str, this, errh);
+        if (!e)
+            return -1;
+        t.table = static_cast<XIAXIDRouteTable *>(e->cast("XIAXIDRouteTable"));
+        if (!t.table)
+            return errh->error("%s is not an XIAXIDRouteTable", table_str.c_str());
+
+        if (flag_str == "SERVICE")
+            t.service = true;
+        else if (!flag_str)
+            t.service = false;
+        else
+            return errh->error("unrecognized flag: ", flag_str.c_str());
+        if (str_copy)
+            return errh->error("too many arguments: ", conf[i].c_str());
+
+        _ntables++;
+    }
+    return 0;
+}
+
+inline const XIAForwardEngine::TableEntry *
+XIAForwardEngine::find_table(uint32_t type) const
+{
+    for (int i = 0; i < _ntables; i++)
+        if (_tables[i].type == type)
+            return &_tables[i];
+    return 0;
+}
+
+void
+XIAForwardEngine::push(int port, Packet *p)
+{
+    if (port == 0) {
+        // arriving from the network: content passing by goes to the cache too
+        const struct click_xia* hdr = p->xia_header();
+        if (hdr->node[hdr->dnode + hdr->snode - 1].xid.type == htonl(CLICK_XIA_XID_TYPE_CID))
+            if (Packet *q = p->clone())
+                output(OUT_CACHE).push(q);
+    }
+    forward(p);
+}
+
+void
+XIAForwardEngine::send_forward(Packet *p)
+{
+    // what XIADecHLIM does after the route table
+    if (p->xia_header()->hlim <= 1) {
+        output(OUT_XCMP).push(p);
+        return;
+    }
+    WritablePacket *q = p->uniqueify();
+    if (!q)
+        return;
+    q->xia_header()->hlim--;
+    _forwarded++;
+    output(OUT_FORWARD).push(q);
+}
+
+void
+XIAForwardEngine::deliver(Packet *p)
+{
+    const struct click_xia* hdr = p->xia_header();
+    SET_XIA_PAINT_ANNO(p, DESTINED_FOR_LOCALHOST);
+    _delivered++;
+    if (hdr->node[hdr->dnode - 1].xid.type == htonl(CLICK_XIA_XID_TYPE_CID))
+        output(OUT_CACHE).push(p);
+    else
+        output(OUT_LOCAL).push(p);
+}
+
+void
+XIAForwardEngine::forward(Packet *p)
+{
+    int path = 0;
+    int local_hops = 0;
+
+    while (path < CLICK_XIA_XID_EDGE_NUM) {
+        SET_XIA_NEXT_PATH_ANNO(p, path);
+
+        const struct click_xia* hdr = p->xia_header();
+        int last = hdr->last;
+        if (last < 0)
+            last += hdr->dnode;
+        const struct click_xia_xid_edge& edge = hdr->node[last].edge[path];
+
+        // an unused edge or an XID type we do not route is a dead end, just
+        // as when XIAXIDTypeClassifier falls through to its last output
+        if (edge.idx == CLICK_XIA_XID_EDGE_UNUSED || edge.idx >= hdr->dnode)
+            break;
+        const TableEntry *t = find_table(hdr->node[edge.idx].xid.type);
+        if (!t)
+            break;
+
+        if (!t->table->get_enabled()) {
+            path++;
+            _fallbacks++;
+            continue;
+        }
+
+        int in_ether_port = XIA_PAINT_ANNO(p);
+        if (in_ether_port == REDIRECT) {
+            t->table->process_xcmp_redirect(p);
+            p->kill();
+            return;
+        }
+
+        int port = t->table->lookup_route(in_ether_port, p);
+
+        if (port == in_ether_port && in_ether_port != DESTINED_FOR_LOCALHOST && in_ether_port != DESTINED_FOR_DISCARD) {
+            // tell XCMP the packet is leaving the way it came
+            if (Packet *q = p->clone()) {
+                SET_XIA_PAINT_ANNO(q, (XIA_PAINT_ANNO(q) + TOTAL_SPECIAL_CASES) * -1);
+                output(OUT_XCMP).push(q);
+            }
+        }
+
+        if (port >= 0) {
+            SET_XIA_PAINT_ANNO(p, port);
+            send_forward(p);
+            return;
+        } else if (port == DESTINED_FOR_LOCALHOST) {
+            // we own the next node: advance the last pointer (XIANextHop)
+            int idx = edge.idx;
+            WritablePacket *q = p->uniqueify();
+            if (!q)
+                return;
+            struct click_xia* whdr = q->xia_header();
+            whdr->node[last].edge[path].visited = 1;
+            whdr->last = idx;
+            p = q;
+
+            if (t->service || idx == whdr->dnode - 1) {
+                deliver(p);
+                return;
+            }
+
+            // an intermediate node: start over from its first edge, but
+            // never walk more nodes than the DAG has
+            if (++local_hops > whdr->dnode)
+                break;
+            path = 0;
+        } else if (port == DESTINED_FOR_DHCP) {
+            if (t->service) {
+                SET_XIA_PAINT_ANNO(p, port);
+                output(OUT_DHCP).push(p);
+            } else
+                p->kill();
+            return;
+        } else if (port == DESTINED_FOR_BROADCAST) {
+            for (int i = 0; i <= t->table->num_ports(); i++)
+                if (Packet *q = p->clone()) {
+                    SET_XIA_PAINT_ANNO(q, i);
+                    send_forward(q);
+                }
+            p->kill();
+            return;
+        } else {
+            // no route on this edge: try the next fallback
+            path++;
+            _fallbacks++;
+        }
+    }
+
+    _unreachable++;
+    SET_XIA_PAINT_ANNO(p, UNREACHABLE);
+    output(OUT_XCMP).push(p);
+}
+
+void
+XIAForwardEngine::add_handlers()
+{
+    add_data_handlers("forwarded", Handler::OP_READ, &_forwarded);
+    add_data_handlers("delivered", Handler::OP_READ, &_delivered);
+    add_data_handlers("fallbacks", Handler::OP_READ, &_fallbacks);
+    add_data_handlers("unreachable", Handler::OP_READ, &_unreachable);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(XIAForwardEngine)
+ELEMENT_REQUIRES(XIAXIDRouteTable)
+ELEMENT_MT_SAFE(XIAForwardEngine)
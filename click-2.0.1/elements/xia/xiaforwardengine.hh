@@ -0,0 +1,106 @@
+#ifndef CLICK_XIAFORWARDENGINE_HH
+#define CLICK_XIAFORWARDENGINE_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <clicknet/xia.h>
+#include "xiaxidroutetable.hh"
+CLICK_DECLS
+
+/*
+=c
+XIAForwardEngine(TYPE TABLE [SERVICE], ...)
+
+=s xia
+forwards XIA packets through the whole DAG in a single element
+
+=d
+Performs the work of RouteEngine's element graph (XIASelectPath,
+XIAXIDTypeClassifier, XIAXIDRouteTable, XIANextHop, XIACheckDest and
+XIADecHLIM) in one loop.  Fallback edges and intermediate nodes that this
+router owns are handled in place instead of by pushing the packet back around
+the graph.
+
+Each argument binds an XID type to the XIAXIDRouteTable that holds its
+routes, for example "AD rt_AD".  The tables keep their handlers, so route
+daemons update them exactly as before; they need not be connected to
+anything.  Types marked SERVICE (normally SID) are delivered locally as soon
+as their table says so, without the destination check, and are the only ones
+that may be sent to the DHCP output.  A next XID of any other type makes the
+router try the next fallback edge.
+
+Input 0 takes packets arriving from the network: those whose source is a CID
+are also copied to output 2 for caching.  Input 1 takes packets originating
+at this node, and packets coming back from XCMP.
+
+Output 0 emits packets to forward, painted with their outgoing port and with
+the hop limit decremented.  Packets that have reached their destination leave
+on output 2 if the destination is a CID and on output 1 otherwise.  Output 3
+is the DHCP output.  Output 4 carries packets that XCMP must handle: redirect
+notices, packets no path could route (painted UNREACHABLE), and packets whose
+hop limit expired.
+
+=h forwarded read-only
+Packets emitted on output 0.
+
+=h delivered read-only
+Packets delivered locally on outputs 1 and 2.
+
+=h fallbacks read-only
+Fallback edges tried after the first path failed.
+
+=h unreachable read-only
+Packets no path could route.
+
+=e
+  fwd :: XIAForwardEngine(AD rt_AD, HID rt_HID, SID rt_SID SERVICE, CID rt_CID, IP rt_IP);
+  fwd[4] -> XCMP($local_addr) -> [1]fwd;
+
+=a RouteEngine, XIAXIDRouteTable
+*/
+
+class XIAForwardEngine : public Element { public:
+
+    XIAForwardEngine();
+    ~XIAForwardEngine();
+
+    const char *class_name() const		{ return "XIAForwardEngine"; }
+    const char *port_count() const		{ return "2/5"; }
+    const char *processing() const		{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    void add_handlers();
+
+    void push(int port, Packet *);
+
+    // used directly by XIAFastPath
+    int ntables() const				{ return _ntables; }
+    XIAXIDRouteTable *table(int i) const	{ return _tables[i].table; }
+
+  private:
+
+    enum { MAX_TABLES = 16 };
+    enum { OUT_FORWARD = 0, OUT_LOCAL, OUT_CACHE, OUT_DHCP, OUT_XCMP };
+
+    struct TableEntry {
+	uint32_t type;
+	XIAXIDRouteTable *table;
+	bool service;
+    };
+
+    TableEntry _tables[MAX_TABLES];
+    int _ntables;
+
+    atomic_uint32_t _forwarded;
+    atomic_uint32_t _delivered;
+    atomic_uint32_t _fallbacks;
+    atomic_uint32_t _unreachable;
+
+    inline const TableEntry *find_table(uint32_t type) const;
+    void forward(Packet *p);
+    void send_forward(Packet *p);
+    void deliver(Packet *p);
+
+};
+
+CLICK_ENDDECLS
+#endif
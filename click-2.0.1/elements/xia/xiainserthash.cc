@@ -4,7 +4,6 @@
 
 #include <click/config.h>
 #include "xiainserthash.hh"
-#include "xiafastpath.hh"
 #include <click/error.hh>
 #include <click/confparse.hh>
 #include <click/packet_anno.hh>
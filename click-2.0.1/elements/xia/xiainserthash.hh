@@ -1,7 +1,9 @@
 #ifndef CLICK_INSERTHASH_HH
 #define CLICK_INSERTHASH_HH
 #include <click/element.hh>
-#include "xiafastpath.hh"
+
+// the size of the inserted hash (a SHA-1 digest)
+#define KEYSIZE 20
 
 /*
 =c
@@ -18,10 +18,12 @@ XIANextHop::~XIANextHop()
 {
 }
 
-void
-XIANextHop::push(int, Packet *p_in)
+inline WritablePacket *
+XIANextHop::advance(Packet *p_in)
 {
     WritablePacket* p = p_in->uniqueify();
+    if (!p)
+        return 0;
 
     struct click_xia* hdr = p->xia_header();
 
@@ -37,9 +39,30 @@ XIANextHop::push(int, Packet *p_in)
     hdr->last = current_edge.idx;
     current_edge.visited = 1;
 
-    output(0).push(p);
+    return p;
+}
+
+void
+XIANextHop::push(int, Packet *p_in)
+{
+    if (WritablePacket *p = advance(p_in))
+        output(0).push(p);
+}
+
+void
+XIANextHop::push_batch(int, Packet *head)
+{
+    Packet *pkts[MAX_BATCH];
+    while (head) {
+        int n = take_batch(head, pkts);
+        // uniqueify may hand back a different packet, or none
+        for (int i = 0; i < n; i++)
+            pkts[i] = advance(pkts[i]);
+        output_push_batch(0, make_batch(pkts, n));
+    }
 }
 
 CLICK_ENDDECLS
 EXPORT_ELEMENT(XIANextHop)
+ELEMENT_REQUIRES(XIABatchElement)
 ELEMENT_MT_SAFE(XIANextHop)
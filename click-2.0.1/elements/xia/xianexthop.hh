@@ -3,6 +3,7 @@
 #include <click/element.hh>
 #include <click/hashtable.hh>
 #include <clicknet/xia.h>
+#include "xiabatch.hh"
 CLICK_DECLS
 
 /*
@@ -23,7 +24,7 @@ XIANextHop()
 =a StaticXIDLookup
 */
 
-class XIANextHop : public Element { public:
+class XIANextHop : public XIABatchElement { public:
 
     XIANextHop();
     ~XIANextHop();
@@ -33,6 +34,10 @@ class XIANextHop : public Element { public:
     const char *processing() const		{ return PUSH; }
 
     void push(int port, Packet *);
+    void push_batch(int port, Packet *head);
+
+  private:
+    static inline WritablePacket *advance(Packet *);
 };
 
 CLICK_ENDDECLS
@@ -59,6 +59,30 @@ XIASelectPath::push(int, Packet *p)
     }
 }
 
+void
+XIASelectPath::push_batch(int, Packet *head)
+{
+    if (_first) {
+        for (Packet *p = head; p; p = p->next())
+            SET_XIA_NEXT_PATH_ANNO(p, 0);
+        output_push_batch(0, head);
+        return;
+    }
+
+    Packet *pkts[MAX_BATCH];
+    int ports[MAX_BATCH];
+    while (head) {
+        int n = take_batch(head, pkts);
+        for (int i = 0; i < n; i++) {
+            int next = XIA_NEXT_PATH_ANNO(pkts[i]) + 1;
+            SET_XIA_NEXT_PATH_ANNO(pkts[i], next);
+            ports[i] = next < CLICK_XIA_XID_EDGE_NUM ? 0 : 1;
+        }
+        output_push_sorted(pkts, ports, n);
+    }
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(XIASelectPath)
+ELEMENT_REQUIRES(XIABatchElement)
 ELEMENT_MT_SAFE(XIASelectPath)
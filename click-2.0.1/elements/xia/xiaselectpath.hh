@@ -3,6 +3,7 @@
 #include <click/element.hh>
 #include <click/glue.hh>
 #include <click/atomic.hh>
+#include "xiabatch.hh"
 CLICK_DECLS
 
 /*
@@ -21,7 +22,7 @@ CLICK_DECLS
  * =a
  */
 
-class XIASelectPath : public Element { public:
+class XIASelectPath : public XIABatchElement { public:
 
     XIASelectPath();
     ~XIASelectPath();
@@ -33,6 +34,7 @@ class XIASelectPath : public Element { public:
     int configure(Vector<String> &conf, ErrorHandler *errh);
 
     void push(int port, Packet *);
+    void push_batch(int port, Packet *head);
 
   private:
     bool _first;
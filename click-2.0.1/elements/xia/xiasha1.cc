@@ -0,0 +1,419 @@
+/*
+ * xiasha1.{cc,hh} -- SHA-1 for content IDs
+ */
+
+#include <click/config.h>
+#include "xiasha1.hh"
+#if CLICK_USERLEVEL && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && __GNUC__ >= 5
+# define XIASHA1_X86 1
+# include <immintrin.h>
+# include <cpuid.h>
+#endif
+CLICK_DECLS
+
+int XIASHA1::_engine = -1;
+int XIASHA1::_batch_engine = -1;
+
+static const uint32_t sha1_init[5] = {
+    0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+static inline uint32_t
+load_be32(const unsigned char *p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline void
+store_be32(unsigned char *p, uint32_t x)
+{
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+/* The final one or two blocks of a @a len byte message whose last
+   @a len % 64 bytes are at @a rest.  Returns the number of blocks. */
+static int
+sha1_tail(unsigned char *tail, const unsigned char *rest, size_t len)
+{
+    size_t r = len % XIASHA1::BLOCK_LEN;
+    int blocks = r + 9 <= XIASHA1::BLOCK_LEN ? 1 : 2;
+    memcpy(tail, rest, r);
+    tail[r] = 0x80;
+    memset(tail + r + 1, 0, blocks * XIASHA1::BLOCK_LEN - r - 1);
+    uint64_t bits = (uint64_t) len << 3;
+    store_be32(tail + blocks * XIASHA1::BLOCK_LEN - 8, bits >> 32);
+    store_be32(tail + blocks * XIASHA1::BLOCK_LEN - 4, bits);
+    return blocks;
+}
+
+
+/* The 80 rounds, on one state word per lane: V is uint32_t for the scalar
+   engine and a GCC vector for the multi-buffer ones.  The rotate is a
+   macro so that it expands inside each engine's own target: an 8-lane
+   vector passed to a function compiled without AVX would change ABI. */
+
+#define SHA1_ROL(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+#define SHA1_ROUND(f, k)					\
+    do {							\
+	if (i >= 16)						\
+	    w[i & 15] = SHA1_ROL(w[(i + 13) & 15] ^ w[(i + 8) & 15] \
+				 ^ w[(i + 2) & 15] ^ w[i & 15], 1); \
+	V t = SHA1_ROL(a, 5) + (f) + e + (uint32_t) (k) + w[i & 15]; \
+	e = d;							\
+	d = c;							\
+	c = SHA1_ROL(b, 30);					\
+	b = a;							\
+	a = t;							\
+    } while (0)
+
+template <typename V>
+static inline __attribute__((always_inline)) void
+sha1_rounds(V *h, V *w)
+{
+    V a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    int i;
+    for (i = 0; i < 20; i++)
+	SHA1_ROUND(d ^ (b & (c ^ d)), 0x5A827999);
+    for (; i < 40; i++)
+	SHA1_ROUND(b ^ c ^ d, 0x6ED9EBA1);
+    for (; i < 60; i++)
+	SHA1_ROUND((b & c) | (d & (b | c)), 0x8F1BBCDC);
+    for (; i < 80; i++)
+	SHA1_ROUND(b ^ c ^ d, 0xCA62C1D6);
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+#undef SHA1_ROUND
+#undef SHA1_ROL
+
+static void
+compress_scalar(uint32_t *h, const unsigned char *p, size_t nblocks)
+{
+    for (; nblocks; nblocks--, p += XIASHA1::BLOCK_LEN) {
+	uint32_t w[16];
+	for (int i = 0; i < 16; i++)
+	    w[i] = load_be32(p + 4 * i);
+	sha1_rounds<uint32_t>(h, w);
+    }
+}
+
+
+#if XIASHA1_X86
+
+/* SHA-NI: four rounds per instruction.  Step k runs rounds 4k to 4k+3 on
+   message words 4k to 4k+3 (in m[k % 4]) and advances the schedule:
+   sha1msg1 starts words 4k+12 to 4k+15, the XOR adds words 4k-8 to 4k-5
+   to words 4k+8 to 4k+11, and sha1msg2 finishes words 4k+4 to 4k+7. */
+#define SHANI_STEP(k, ex, ey)						\
+    do {								\
+	ex = _mm_sha1nexte_epu32(ex, m[(k) % 4]);			\
+	ey = abcd;							\
+	if ((k) <= 18)							\
+	    m[((k) + 1) % 4] = _mm_sha1msg2_epu32(m[((k) + 1) % 4], m[(k) % 4]); \
+	abcd = _mm_sha1rnds4_epu32(abcd, ex, (k) / 5);			\
+	if ((k) <= 16)							\
+	    m[((k) + 3) % 4] = _mm_sha1msg1_epu32(m[((k) + 3) % 4], m[(k) % 4]); \
+	if ((k) <= 17)							\
+	    m[((k) + 2) % 4] = _mm_xor_si128(m[((k) + 2) % 4], m[(k) % 4]); \
+    } while (0)
+
+__attribute__((target("sha,sse4.1")))
+static void
+compress_shani(uint32_t *h, const unsigned char *p, size_t nblocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) h), 0x1B);
+    __m128i e0 = _mm_set_epi32(h[4], 0, 0, 0);
+    __m128i e1, m[4];
+
+    for (; nblocks; nblocks--, p += XIASHA1::BLOCK_LEN) {
+	__m128i abcd_save = abcd, e0_save = e0;
+	for (int j = 0; j < 4; j++)
+	    m[j] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 16 * j)), bswap);
+
+	// rounds 0-11 start the schedule
+	e0 = _mm_add_epi32(e0, m[0]);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+	e1 = _mm_sha1nexte_epu32(e1, m[1]);
+	e0 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+	m[0] = _mm_sha1msg1_epu32(m[0], m[1]);
+	e0 = _mm_sha1nexte_epu32(e0, m[2]);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+	m[1] = _mm_sha1msg1_epu32(m[1], m[2]);
+	m[0] = _mm_xor_si128(m[0], m[2]);
+
+	SHANI_STEP(3, e1, e0);
+	SHANI_STEP(4, e0, e1);
+	SHANI_STEP(5, e1, e0);
+	SHANI_STEP(6, e0, e1);
+	SHANI_STEP(7, e1, e0);
+	SHANI_STEP(8, e0, e1);
+	SHANI_STEP(9, e1, e0);
+	SHANI_STEP(10, e0, e1);
+	SHANI_STEP(11, e1, e0);
+	SHANI_STEP(12, e0, e1);
+	SHANI_STEP(13, e1, e0);
+	SHANI_STEP(14, e0, e1);
+	SHANI_STEP(15, e1, e0);
+	SHANI_STEP(16, e0, e1);
+	SHANI_STEP(17, e1, e0);
+	SHANI_STEP(18, e0, e1);
+	SHANI_STEP(19, e1, e0);
+
+	e0 = _mm_sha1nexte_epu32(e0, e0_save);
+	abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *) h, _mm_shuffle_epi32(abcd, 0x1B));
+    h[4] = _mm_extract_epi32(e0, 3);
+}
+
+#undef SHANI_STEP
+
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+typedef uint32_t v8u32 __attribute__((vector_size(32)));
+
+/* One block for each of four lanes.  st[j] holds state word j of every
+   lane. */
+static void
+compress_x4(v4u32 *st, const unsigned char * const *blk)
+{
+    v4u32 w[16];
+    for (int i = 0; i < 16; i++)
+	for (int l = 0; l < 4; l++)
+	    w[i][l] = load_be32(blk[l] + 4 * i);
+    sha1_rounds<v4u32>(st, w);
+}
+
+/* One block for each of eight lanes: load each lane's block as two rows
+   of eight words, then transpose the rows into one vector per word. */
+__attribute__((target("avx2")))
+static void
+compress_x8(v8u32 *st, const unsigned char * const *blk)
+{
+    const __m256i bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+					  12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    v8u32 w[16];
+    for (int half = 0; half < 2; half++) {
+	__m256i r[8], t[8], u[8];
+	for (int l = 0; l < 8; l++)
+	    r[l] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (blk[l] + 32 * half)), bswap);
+	for (int l = 0; l < 8; l += 2) {
+	    t[l] = _mm256_unpacklo_epi32(r[l], r[l + 1]);
+	    t[l + 1] = _mm256_unpackhi_epi32(r[l], r[l + 1]);
+	}
+	for (int l = 0; l < 8; l += 4) {
+	    u[l] = _mm256_unpacklo_epi64(t[l], t[l + 2]);
+	    u[l + 1] = _mm256_unpackhi_epi64(t[l], t[l + 2]);
+	    u[l + 2] = _mm256_unpacklo_epi64(t[l + 1], t[l + 3]);
+	    u[l + 3] = _mm256_unpackhi_epi64(t[l + 1], t[l + 3]);
+	}
+	for (int j = 0; j < 4; j++) {
+	    w[8 * half + j] = (v8u32) _mm256_permute2x128_si256(u[j], u[j + 4], 0x20);
+	    w[8 * half + j + 4] = (v8u32) _mm256_permute2x128_si256(u[j], u[j + 4], 0x31);
+	}
+    }
+    sha1_rounds<v8u32>(st, w);
+}
+
+/* Hash the buffers through LANES lanes, starting the next buffer in a
+   lane as soon as the lane is done with its last one. */
+template <typename V, int LANES>
+static inline __attribute__((always_inline)) void
+digest_lanes(void (*compress)(V *, const unsigned char * const *),
+	     int n, const unsigned char * const *data, const size_t *len,
+	     unsigned char (*md)[XIASHA1::DIGEST_LEN])
+{
+    static const unsigned char idle[XIASHA1::BLOCK_LEN] = { 0 };
+    struct Lane {
+	int job;		// -1 when idle
+	size_t block;
+	size_t data_blocks;
+	size_t blocks;
+	unsigned char tail[2 * XIASHA1::BLOCK_LEN];
+    } lane[LANES];
+    V st[5];
+    const unsigned char *blk[LANES];
+    int next = 0, active = 0;
+
+    for (int l = 0; l < LANES; l++)
+	lane[l].job = -1;
+    while (1) {
+	for (int l = 0; l < LANES; l++)
+	    if (lane[l].job < 0 && next < n) {
+		Lane &ln = lane[l];
+		ln.job = next++;
+		ln.block = 0;
+		ln.data_blocks = len[ln.job] / XIASHA1::BLOCK_LEN;
+		ln.blocks = ln.data_blocks
+		    + sha1_tail(ln.tail, data[ln.job] + ln.data_blocks * XIASHA1::BLOCK_LEN, len[ln.job]);
+		for (int j = 0; j < 5; j++)
+		    st[j][l] = sha1_init[j];
+		active++;
+	    }
+	if (!active)
+	    break;
+
+	for (int l = 0; l < LANES; l++) {
+	    Lane &ln = lane[l];
+	    if (ln.job < 0)
+		blk[l] = idle;
+	    else if (ln.block < ln.data_blocks)
+		blk[l] = data[ln.job] + ln.block * XIASHA1::BLOCK_LEN;
+	    else
+		blk[l] = ln.tail + (ln.block - ln.data_blocks) * XIASHA1::BLOCK_LEN;
+	}
+	compress(st, blk);
+
+	for (int l = 0; l < LANES; l++) {
+	    Lane &ln = lane[l];
+	    if (ln.job >= 0 && ++ln.block == ln.blocks) {
+		for (int j = 0; j < 5; j++)
+		    store_be32(md[ln.job] + 4 * j, st[j][l]);
+		ln.job = -1;
+		active--;
+	    }
+	}
+    }
+}
+
+__attribute__((target("avx2")))
+static void
+digest_x8(int n, const unsigned char * const *data, const size_t *len,
+	  unsigned char (*md)[XIASHA1::DIGEST_LEN])
+{
+    digest_lanes<v8u32, 8>(compress_x8, n, data, len, md);
+}
+
+static void
+digest_x4(int n, const unsigned char * const *data, const size_t *len,
+	  unsigned char (*md)[XIASHA1::DIGEST_LEN])
+{
+    digest_lanes<v4u32, 4>(compress_x4, n, data, len, md);
+}
+
+#endif
+
+
+void
+XIASHA1::detect()
+{
+    // SHA-NI is fastest for one buffer, but AVX2's eight lanes beat it
+    // on batches; four SSE2 lanes do not.
+    static const Engine batch_order[] = { AVX2, SHANI, SSE2 };
+    _batch_engine = SCALAR;
+    for (size_t i = 0; i < sizeof(batch_order) / sizeof(batch_order[0]); i++)
+	if (supported(batch_order[i])) {
+	    _batch_engine = batch_order[i];
+	    break;
+	}
+    _engine = supported(SHANI) ? SHANI : SCALAR;
+}
+
+bool
+XIASHA1::supported(Engine e)
+{
+#if XIASHA1_X86
+    __builtin_cpu_init();
+    switch (e) {
+    case SCALAR:
+    case SSE2:
+	return true;
+    case AVX2:
+	return __builtin_cpu_supports("avx2");
+    case SHANI: {
+	unsigned a, b, c, d;
+	if (__get_cpuid_max(0, 0) < 7 || !__builtin_cpu_supports("sse4.1"))
+	    return false;
+	__cpuid_count(7, 0, a, b, c, d);
+	return (b >> 29) & 1;
+    }
+    default:
+	return false;
+    }
+#else
+    return e == SCALAR;
+#endif
+}
+
+bool
+XIASHA1::set_engine(Engine e)
+{
+    if (e < 0 || e >= NENGINES || !supported(e))
+	return false;
+    _engine = _batch_engine = e;
+    return true;
+}
+
+const char *
+XIASHA1::engine_name(Engine e)
+{
+    static const char * const names[] = { "SCALAR", "SSE2", "AVX2", "SHANI" };
+    return e >= 0 && e < NENGINES ? names[e] : "?";
+}
+
+void
+XIASHA1::digest(const unsigned char *data, size_t len, unsigned char *md)
+{
+    void (*compress)(uint32_t *, const unsigned char *, size_t) = compress_scalar;
+#if XIASHA1_X86
+    if (engine() == SHANI)
+	compress = compress_shani;
+#endif
+    uint32_t h[5];
+    memcpy(h, sha1_init, sizeof(h));
+    size_t blocks = len / BLOCK_LEN;
+    compress(h, data, blocks);
+    unsigned char tail[2 * BLOCK_LEN];
+    compress(h, tail, sha1_tail(tail, data + blocks * BLOCK_LEN, len));
+    for (int j = 0; j < 5; j++)
+	store_be32(md + 4 * j, h[j]);
+}
+
+void
+XIASHA1::digest_many(int n, const unsigned char * const *data, const size_t *len,
+		     unsigned char (*md)[DIGEST_LEN])
+{
+#if XIASHA1_X86
+    Engine e = batch_engine();
+    if (n > 1 && e == AVX2)
+	return digest_x8(n, data, len, md);
+    else if (n > 1 && e == SSE2)
+	return digest_x4(n, data, len, md);
+#endif
+    for (int i = 0; i < n; i++)
+	digest(data[i], len[i], md[i]);
+}
+
+void
+XIASHA1::hex(const unsigned char *md, char *out)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < DIGEST_LEN; i++) {
+	*out++ = digits[md[i] >> 4];
+	*out++ = digits[md[i] & 15];
+    }
+}
+
+String
+XIASHA1::hex(const unsigned char *md)
+{
+    String s = String::make_garbage(HEX_LEN);
+    if (char *x = s.mutable_data())
+	hex(md, x);
+    return s;
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(XIASHA1)
@@ -0,0 +1,66 @@
+#ifndef CLICK_XIASHA1_HH
+#define CLICK_XIASHA1_HH
+#include <click/glue.hh>
+#include <click/string.hh>
+CLICK_DECLS
+
+/*
+ * XIASHA1 -- SHA-1 for content IDs
+ *
+ * A CID is the SHA-1 of its chunk, so publishing and verifying chunks is
+ * mostly hashing.  XIASHA1 picks the fastest SHA-1s this CPU runs, once:
+ *
+ *   SHANI    the x86 SHA extensions, one buffer at a time.
+ *   AVX2     eight buffers at once, one per 32-bit lane.
+ *   SSE2     four buffers at once.
+ *   SCALAR   portable C, one buffer at a time.
+ *
+ * digest() hashes one buffer, with SHA-NI if the CPU has it and in C
+ * otherwise.  digest_many() hashes several, preferring AVX2, then SHA-NI,
+ * then SSE2: eight lanes of AVX2 outrun SHA-NI's one buffer at a time.
+ * The multi-buffer engines keep every lane busy by starting the next
+ * buffer in a lane as soon as the lane's current one is done, so buffers
+ * of different lengths mix well.
+ * SIMD engines exist only at userlevel on x86 with GCC 5 or newer.
+ *
+ * XIASHA1 is used by XTRANSPORT; it is not an element.
+ */
+
+class XIASHA1 { public:
+
+    enum { DIGEST_LEN = 20, BLOCK_LEN = 64, HEX_LEN = 2 * DIGEST_LEN };
+    enum Engine { SCALAR = 0, SSE2, AVX2, SHANI, NENGINES };
+
+    static void digest(const unsigned char *data, size_t len, unsigned char *md);
+    /** @brief Hash the @a n buffers @a data[i] of @a len[i] bytes into
+     * @a md[i]. */
+    static void digest_many(int n, const unsigned char * const *data, const size_t *len,
+			    unsigned char (*md)[DIGEST_LEN]);
+
+    /** @brief Write @a md as HEX_LEN lowercase hex digits, without a
+     * terminator, to @a out. */
+    static void hex(const unsigned char *md, char *out);
+    static String hex(const unsigned char *md);
+
+    /** @brief Return the engine digest() uses. */
+    static Engine engine()		{ if (_engine < 0) detect(); return (Engine) _engine; }
+    /** @brief Return the engine digest_many() uses. */
+    static Engine batch_engine()	{ if (_engine < 0) detect(); return (Engine) _batch_engine; }
+    static const char *engine_name(Engine e);
+    static bool supported(Engine e);
+    /** @brief Use engine @a e for digest() and digest_many() from now on,
+     * for testing.  Returns false, changing nothing, if this CPU cannot
+     * run it.  reset_engine() goes back to the fastest engines. */
+    static bool set_engine(Engine e);
+    static void reset_engine()		{ _engine = -1; }
+
+  private:
+
+    static int _engine;
+    static int _batch_engine;
+    static void detect();
+
+};
+
+CLICK_ENDDECLS
+#endif
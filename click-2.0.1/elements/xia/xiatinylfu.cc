@@ -0,0 +1,152 @@
+/*
+ * xiatinylfu.{cc,hh} -- approximate chunk popularity for cache admission
+ */
+
+#include <click/config.h>
+#include "xiatinylfu.hh"
+CLICK_DECLS
+
+XIATinyLFU::XIATinyLFU()
+    : _table(0), _mask(0), _doorkeeper(0), _dk_mask(0),
+      _samples(0), _sample_size(0), _ages(0)
+{
+}
+
+XIATinyLFU::~XIATinyLFU()
+{
+    delete[] _table;
+    delete[] _doorkeeper;
+}
+
+int
+XIATinyLFU::configure(uint32_t entries)
+{
+    if (entries == 0) {
+	delete[] _table;
+	delete[] _doorkeeper;
+	_table = _doorkeeper = 0;
+	return 0;
+    }
+
+    // 16 counters and 8 doorkeeper bits per expected entry
+    uint32_t words = 8;
+    while (words < entries && words < (1U << 26))
+	words <<= 1;
+    uint64_t *table = new uint64_t[words];
+    uint64_t *doorkeeper = new uint64_t[words / 8];
+    if (!table || !doorkeeper) {
+	delete[] table;
+	delete[] doorkeeper;
+	return -ENOMEM;
+    }
+
+    delete[] _table;
+    delete[] _doorkeeper;
+    _table = table;
+    _mask = words * 16 - 1;
+    _doorkeeper = doorkeeper;
+    _dk_mask = words * 8 - 1;
+    _sample_size = words * 10;
+    clear();
+    return 0;
+}
+
+void
+XIATinyLFU::clear()
+{
+    if (!_table)
+	return;
+    memset(_table, 0, (_mask + 1) / 2);
+    memset(_doorkeeper, 0, (_dk_mask + 1) / 8);
+    _samples = 0;
+    _ages = 0;
+}
+
+inline uint32_t
+XIATinyLFU::index(uint64_t h, int i) const
+{
+    // double hashing: row i probes h1 + i * h2
+    uint32_t h1 = h, h2 = (h >> 32) | 1;
+    return (h1 + i * h2) & _mask;
+}
+
+inline int
+XIATinyLFU::counter(uint32_t index) const
+{
+    return (_table[index >> 4] >> ((index & 15) * 4)) & MAX_COUNT;
+}
+
+bool
+XIATinyLFU::doorkeeper_set(uint64_t h)
+{
+    // returns true if the CID was already there
+    uint32_t b1 = (h >> 7) & _dk_mask, b2 = (h >> 41) & _dk_mask;
+    uint64_t m1 = 1ULL << (b1 & 63), m2 = 1ULL << (b2 & 63);
+    bool present = (_doorkeeper[b1 >> 6] & m1) && (_doorkeeper[b2 >> 6] & m2);
+    _doorkeeper[b1 >> 6] |= m1;
+    _doorkeeper[b2 >> 6] |= m2;
+    return present;
+}
+
+bool
+XIATinyLFU::doorkeeper_test(uint64_t h) const
+{
+    uint32_t b1 = (h >> 7) & _dk_mask, b2 = (h >> 41) & _dk_mask;
+    return (_doorkeeper[b1 >> 6] & (1ULL << (b1 & 63)))
+	&& (_doorkeeper[b2 >> 6] & (1ULL << (b2 & 63)));
+}
+
+void
+XIATinyLFU::record(const XID &xid)
+{
+    if (!_table)
+	return;
+    uint64_t h = hash(xid);
+
+    if (doorkeeper_set(h)) {
+	// conservative update: raise only the counters at the minimum
+	uint32_t idx[DEPTH];
+	int min = MAX_COUNT;
+	for (int i = 0; i < DEPTH; i++) {
+	    idx[i] = index(h, i);
+	    int c = counter(idx[i]);
+	    if (c < min)
+		min = c;
+	}
+	if (min < MAX_COUNT)
+	    for (int i = 0; i < DEPTH; i++)
+		if (counter(idx[i]) == min)
+		    _table[idx[i] >> 4] += 1ULL << ((idx[i] & 15) * 4);
+    }
+
+    if (++_samples >= _sample_size)
+	age();
+}
+
+int
+XIATinyLFU::estimate(const XID &xid) const
+{
+    if (!_table)
+	return 0;
+    uint64_t h = hash(xid);
+    int min = MAX_COUNT;
+    for (int i = 0; i < DEPTH; i++) {
+	int c = counter(index(h, i));
+	if (c < min)
+	    min = c;
+    }
+    return min + doorkeeper_test(h);
+}
+
+void
+XIATinyLFU::age()
+{
+    for (uint32_t i = 0; i <= _mask >> 4; i++)
+	_table[i] = (_table[i] >> 1) & 0x7777777777777777ULL;
+    memset(_doorkeeper, 0, (_dk_mask + 1) / 8);
+    _samples /= 2;
+    _ages++;
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(XIATinyLFU)
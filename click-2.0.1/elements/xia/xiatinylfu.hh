@@ -0,0 +1,87 @@
+#ifndef CLICK_XIATINYLFU_HH
+#define CLICK_XIATINYLFU_HH
+#include <click/glue.hh>
+#include <click/xid.hh>
+CLICK_DECLS
+
+/*
+ * XIATinyLFU -- approximate chunk popularity for cache admission
+ *
+ * A TinyLFU frequency estimator (Einziger et al., ACM ToS 2017).  Every
+ * access to a CID is recorded; estimate() returns about how often the CID
+ * was seen recently.  A cache admits a new chunk only if it is estimated to
+ * be more popular than the chunk it would evict, which keeps one-hit
+ * traffic, such as a large download streaming through a router, from
+ * flushing popular chunks.
+ *
+ * Frequencies live in a count-min sketch of 4-bit counters, four per CID,
+ * sixteen to a 64-bit word.  A doorkeeper Bloom filter absorbs the first
+ * sighting of each CID, so one-hit CIDs never reach the sketch.  After
+ * every ten accesses per expected entry the estimator ages: all counters
+ * are halved and the doorkeeper is cleared, so popularity fades.
+ *
+ * XIATinyLFU is used by XIAContentModule; it is not an element.
+ */
+
+class XIATinyLFU { public:
+
+    XIATinyLFU();
+    ~XIATinyLFU();
+
+    /** @brief Size the estimator for a cache of about @a entries chunks and
+     * reset it; 0 turns it off.  Returns 0 or -ENOMEM. */
+    int configure(uint32_t entries);
+    bool enabled() const		{ return _table != 0; }
+
+    void record(const XID &xid);
+    int estimate(const XID &xid) const;
+
+    /** @brief Return true if @a candidate should replace @a victim. */
+    bool admit(const XID &candidate, const XID &victim) const {
+	return estimate(candidate) > estimate(victim);
+    }
+
+    uint32_t ages() const		{ return _ages; }
+    void clear();
+
+  private:
+
+    enum { DEPTH = 4, MAX_COUNT = 15 };
+
+    uint64_t *_table;		// 16 four-bit counters per word
+    uint32_t _mask;		// counters - 1
+    uint64_t *_doorkeeper;
+    uint32_t _dk_mask;		// doorkeeper bits - 1
+    uint32_t _samples;
+    uint32_t _sample_size;
+    uint32_t _ages;
+
+    static inline uint64_t hash(const XID &xid);
+    inline uint32_t index(uint64_t h, int i) const;
+    inline int counter(uint32_t index) const;
+    bool doorkeeper_set(uint64_t h);
+    bool doorkeeper_test(uint64_t h) const;
+    void age();
+
+    XIATinyLFU(const XIATinyLFU &);
+    XIATinyLFU &operator=(const XIATinyLFU &);
+
+};
+
+inline uint64_t
+XIATinyLFU::hash(const XID &xid)
+{
+    const uint32_t *w = reinterpret_cast<const uint32_t *>(xid.data());
+    uint64_t a = ((uint64_t) w[1] << 32) | w[2];
+    uint64_t b = ((uint64_t) w[3] << 32) | w[4];
+    uint64_t c = ((uint64_t) w[5] << 32) | w[0];
+    uint64_t h = a * 0xC2B2AE3D27D4EB4FULL
+	^ b * 0x165667B19E3779F9ULL
+	^ c * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    return h ^ (h >> 29);
+}
+
+CLICK_ENDDECLS
+#endif
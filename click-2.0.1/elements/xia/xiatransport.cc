@@ -31,13 +31,20 @@ XIATransport::configure(Vector<String> &conf, ErrorHandler *errh)
     Element* routing_table_elem;
     XIAPath local_addr;
     bool cache_content_from_network =true;
+    String policy_str = "LRU";
 
     if (cp_va_kparse(conf, this, errh,
 		"LOCAL_ADDR", cpkP+cpkM, cpXIAPath, &local_addr,
 		"ROUTETABLENAME", cpkP+cpkM, cpElement, &routing_table_elem,
 		"CACHE_CONTENT_FROM_NETWORK", cpkP, cpBool, &cache_content_from_network,
+		"POLICY", 0, cpWord, &policy_str,
 		cpEnd) < 0)
 	return -1;   
+
+    XIACacheEvictor::Policy policy;
+    if (!XIACacheEvictor::parse_policy(policy_str, policy))
+	return errh->error("POLICY must be LRU, FIFO, CLOCK, S3FIFO or GDSF");
+    _content_module->set_policy(policy);
 #if USERLEVEL
     _content_module->_routeTable = dynamic_cast<XIAXIDRouteTable*>(routing_table_elem);
 #else
@@ -68,6 +75,13 @@ XIATransport::configure(Vector<String> &conf, ErrorHandler *errh)
     return 0;
 }
 
+int
+XIATransport::initialize(ErrorHandler *)
+{
+    _content_module->initialize(this);
+    return 0;
+}
+
 //TODO: remove
 static void say(const char *fmt, ...)
 {
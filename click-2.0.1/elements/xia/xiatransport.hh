@@ -38,6 +38,7 @@ class XIATransport : public Element {
     const char *port_count() const		{ return "2/2"; }
     const char *processing() const		{ return PUSH; }
     int configure(Vector<String> &, ErrorHandler *);         
+    int initialize(ErrorHandler *);
     void push(int port, Packet *);            
     XID local_hid() { return _local_hid; };
     XIAPath local_addr() { return _local_addr; };
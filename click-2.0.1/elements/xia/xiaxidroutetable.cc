@@ -9,19 +9,19 @@
 #include <click/confparse.hh>
 #include <click/packet_anno.hh>
 #include <click/xiaheader.hh>
+#include <click/straccum.hh>
 #if CLICK_USERLEVEL
 #include <fstream>
 #include <stdlib.h>
 #endif
 CLICK_DECLS
 
-XIAXIDRouteTable::XIAXIDRouteTable(): _drops(0)
+XIAXIDRouteTable::XIAXIDRouteTable(): _drops(0), _update_task(this)
 {
 }
 
 XIAXIDRouteTable::~XIAXIDRouteTable()
 {
-	_rts.clear();
 }
 
 int
@@ -32,9 +32,8 @@ XIAXIDRouteTable::configure(Vector<String> &conf, ErrorHandler *errh)
 	_principal_type_enabled = 1;
 	_num_ports = 0;
 
-    _rtdata.port = -1;
-    _rtdata.flags = 0;
-    _rtdata.nexthop = NULL;
+    _rts.set_default(-1, 0, NULL);
+    _rts.set_local_port(DESTINED_FOR_LOCALHOST, FALLBACK);
 
     XIAPath local_addr;
 
@@ -53,10 +52,19 @@ XIAXIDRouteTable::configure(Vector<String> &conf, ErrorHandler *errh)
 	return 0;
 }
 
+int
+XIAXIDRouteTable::initialize(ErrorHandler *errh)
+{
+    _update_task.initialize(this, false);
+    return XIABatchElement::initialize(errh);
+}
+
 int
 XIAXIDRouteTable::set_enabled(int e)
 {
 	_principal_type_enabled = e;
+	// decisions cached against the old setting are no longer valid
+	_rts.bump_generation();
 	return 0;
 }
 
@@ -75,6 +83,8 @@ XIAXIDRouteTable::add_handlers()
 	add_write_handler("remove", remove_handler, 0);
 	add_write_handler("load", load_routes_handler, 0);
 	add_write_handler("generate", generate_routes_handler, 0);
+	add_write_handler("save", save_routes_handler, 0);
+	add_write_handler("load_binary", load_binary_handler, 0);
 	add_data_handlers("drops", Handler::OP_READ, &_drops);
 	add_read_handler("list", list_routes_handler, 0);
 	add_write_handler("enabled", write_handler, (void *)PRINCIPAL_TYPE_ENABLED);
@@ -111,27 +121,53 @@ String
 XIAXIDRouteTable::list_routes_handler(Element *e, void * /*thunk */)
 {
 	XIAXIDRouteTable* table = static_cast<XIAXIDRouteTable*>(e);
-	XIARouteData *xrd = &table->_rtdata;
+
+	// a consistent copy; writers are only held off while it is taken
+	Vector<XIDRouteMap::Entry> routes;
+	XIDRouteMap::Entry dflt;
+	Vector<XID> nexthops;
+	table->_rts.copy(routes, dflt, nexthops);
 
 	// get the default route
-	String tbl = "-," + String(xrd->port) + "," + 
-		(xrd->nexthop != NULL ? xrd->nexthop->unparse() : "") + "," + 
-		String(xrd->flags) + "\n";
+	StringAccum sa;
+	sa << "-," << dflt.port << ","
+	   << (dflt.nexthop ? nexthops[dflt.nexthop - 1].unparse() : String()) << ","
+	   << dflt.flags << "\n";
 
 	// get the rest
-	HashTable<XID, XIARouteData *>::iterator it = table->_rts.begin();
-	while (it != table->_rts.end()) {
-		String xid = it.key().unparse();
-		
-		xrd = (XIARouteData *)it.value();
-
-		tbl += xid + ","; 
-		tbl += String(xrd->port) + ",";
-		tbl += (xrd->nexthop != NULL ? xrd->nexthop->unparse() : "") + ",";
-		tbl += String(xrd->flags) + "\n";
-		it++;
+	for (int i = 0; i < routes.size(); i++) {
+		const XIDRouteMap::Entry &r = routes[i];
+		sa << r.xid.unparse() << "," << r.port << ","
+		   << (r.nexthop ? nexthops[r.nexthop - 1].unparse() : String()) << ","
+		   << r.flags << "\n";
 	}
-	return tbl;
+	return sa.take_string();
+}
+
+int
+XIAXIDRouteTable::insert(const XID &xid, const XIARouteData &rd, bool replace)
+{
+	return _rts.insert(xid, rd.port, rd.flags, rd.nexthop, replace);
+}
+
+int
+XIAXIDRouteTable::erase(const XID &xid)
+{
+	return _rts.remove(xid);
+}
+
+int
+XIAXIDRouteTable::insert(const Vector<XID> &xids, const XIARouteData &rd, bool replace)
+{
+	// if this fails, insert() grows the table as it goes
+	_rts.reserve(_rts.size() + xids.size());
+	return _rts.insert(xids, rd.port, rd.flags, rd.nexthop, replace);
+}
+
+int
+XIAXIDRouteTable::erase(const Vector<XID> &xids)
+{
+	return _rts.remove(xids);
 }
 
 int
@@ -168,7 +204,8 @@ XIAXIDRouteTable::set_handler4(const String &conf, Element *e, void *thunk, Erro
 	int port = 0;
 	unsigned flags = 0;
 	String xid_str;
-	XID *nexthop = NULL;
+	XID nexthop;
+	bool has_nexthop = false;
 
 	cp_argvec(conf, args);
 
@@ -186,39 +223,33 @@ XIAXIDRouteTable::set_handler4(const String &conf, Element *e, void *thunk, Erro
 	}
 
 	if (args.size() >= 3 && args[2].length() > 0) {
-	    String nxthop = args[2];
-		nexthop = new XID;
-		cp_xid(nxthop, nexthop, e);
-		//nexthop = new XID(args[2]);
-		if (!nexthop->valid()) {
-			delete nexthop;
+		cp_xid(args[2], &nexthop, e);
+		if (!nexthop.valid())
 			return errh->error("invalid next hop xid: ", conf.c_str());
-		}
+		has_nexthop = true;
 	}
 
 	if (xid_str == "-") {
-		if (add_mode && table->_rtdata.port != -1)
+		XIDRouteMap::Route dflt;
+		table->_rts.acquire_write();
+		if (add_mode && table->_rts.lookup_default(dflt)) {
+			table->_rts.release_write();
 			return errh->error("duplicate default route: ", xid_str.c_str());
-		table->_rtdata.port= port;
-		table->_rtdata.flags = flags;
-		table->_rtdata.nexthop = nexthop;
+		}
+		int r = table->_rts.set_default(port, flags, has_nexthop ? &nexthop : NULL);
+		table->_rts.release_write();
+		if (r < 0)
+			return errh->error("could not add route: ", conf.c_str());
 	} else {
-		 XID xid;
-		if (!cp_xid(xid_str, &xid, e)) {
-			if (nexthop) delete nexthop;
+		XID xid;
+		if (!cp_xid(xid_str, &xid, e))
 			return errh->error("invalid XID: ", xid_str.c_str());
-		}
-		if (add_mode && table->_rts.find(xid) != table->_rts.end()) {
-			if (nexthop) delete nexthop;
-			return errh->error("duplicate XID: ", xid_str.c_str());
-		}
 
-		XIARouteData *xrd = new XIARouteData();
-		
-		xrd->port = port;
-		xrd->flags = flags;
-		xrd->nexthop = nexthop;
-		table->_rts[xid] = xrd;
+		int r = table->_rts.insert(xid, port, flags, has_nexthop ? &nexthop : NULL, !add_mode);
+		if (r == -EEXIST)
+			return errh->error("duplicate XID: ", xid_str.c_str());
+		else if (r < 0)
+			return errh->error("could not add route: ", conf.c_str());
 	}
 
 	return 0;
@@ -236,26 +267,14 @@ XIAXIDRouteTable::remove_handler(const String &xid_str, Element *e, void *, Erro
 	}
 
 	if (xid_str == "-") {
-		table->_rtdata.port = -1;
-		table->_rtdata.flags = 0;
-		if (table->_rtdata.nexthop) {
-			delete table->_rtdata.nexthop;
-			table->_rtdata.nexthop = NULL;
-		}
+		table->_rts.set_default(-1, 0, NULL);
 
 	} else {
 		XID xid;
 		if (!cp_xid(xid_str, &xid, e))
 			return errh->error("invalid XID: ", xid_str.c_str());
-		HashTable<XID, XIARouteData*>::iterator it = table->_rts.find(xid);
-		if (it == table->_rts.end())
+		if (table->_rts.remove(xid) < 0)
 			return errh->error("nonexistent XID: ", xid_str.c_str());
-
-		XIARouteData *xrd = (XIARouteData*)it.value();
-
-		// FIXME: delete the nxthop xid if any
-		table->_rts.erase(it);
-		delete xrd;
 	}
 	return 0;
 }
@@ -327,6 +346,45 @@ XIAXIDRouteTable::load_routes_handler(const String &conf, Element *e, void *, Er
 #endif
 }
 
+int
+XIAXIDRouteTable::save_routes_handler(const String &conf, Element *e, void *, ErrorHandler *errh)
+{
+	XIAXIDRouteTable* table = static_cast<XIAXIDRouteTable*>(e);
+	String filename;
+	if (cp_va_space_kparse(conf, e, errh,
+			       "FILE", cpkP+cpkM, cpFilename, &filename,
+			       cpEnd) < 0)
+		return -1;
+
+	int r = table->_rts.save(filename);
+	if (r < 0)
+		return errh->error("%s: %s", filename.c_str(), strerror(-r));
+	return 0;
+}
+
+int
+XIAXIDRouteTable::load_binary_handler(const String &conf, Element *e, void *, ErrorHandler *errh)
+{
+	XIAXIDRouteTable* table = static_cast<XIAXIDRouteTable*>(e);
+	String filename;
+	int nthreads = 1;
+	if (cp_va_space_kparse(conf, e, errh,
+			       "FILE", cpkP+cpkM, cpFilename, &filename,
+			       "THREADS", cpkP, cpInteger, &nthreads,
+			       cpEnd) < 0)
+		return -1;
+	if (nthreads < 1)
+		return errh->error("THREADS must be positive");
+
+	int r = table->_rts.load(filename, nthreads);
+	if (r == -EINVAL)
+		return errh->error("%s: not a route snapshot", filename.c_str());
+	else if (r < 0)
+		return errh->error("%s: %s", filename.c_str(), strerror(-r));
+	click_chatter("loaded %d entries", table->_rts.size());
+	return 0;
+}
+
 int
 XIAXIDRouteTable::generate_routes_handler(const String &conf, Element *e, void *, ErrorHandler *errh)
 {
@@ -370,6 +428,9 @@ XIAXIDRouteTable::generate_routes_handler(const String &conf, Element *e, void *
 	
 	if (port<0) click_chatter("Random %d ports", -port);
 
+	if (table->_rts.reserve(table->_rts.size() + count) < 0)
+		return errh->error("out of memory for %d entries", count);
+
 	for (int i = 0; i < count; i++)
 	{
 		uint8_t* xid = xid_d.id;
@@ -399,9 +460,7 @@ XIAXIDRouteTable::generate_routes_handler(const String &conf, Element *e, void *
 		}
 
 		/* random generation from 0 to |port|-1 */
-		XIARouteData *xrd = new XIARouteData();
-		xrd->flags = 0;
-		xrd->nexthop = NULL;
+		int rport = port;
 
 		if (port<0) {
 #if CLICK_LINUXMODULE
@@ -410,13 +469,12 @@ XIAXIDRouteTable::generate_routes_handler(const String &conf, Element *e, void *
 			int random = rand();	
 #endif
 			random = random % (-port);
-			xrd->port = random;
+			rport = random;
 			if (i%5000 == 0) 
 				click_chatter("Random port for XID %s #%d: %d ",XID(xid_d).unparse_pretty(e).c_str(), i, random);
-		} else
-			xrd->port = port;
+		}
 
-		table->_rts[XID(xid_d)] = xrd;
+		table->_rts.insert(XID(xid_d), rport, 0, NULL);
 	}
 
 	click_chatter("generated %d entries", count);
@@ -424,23 +482,21 @@ XIAXIDRouteTable::generate_routes_handler(const String &conf, Element *e, void *
 }
 
 
-void
-XIAXIDRouteTable::push(int in_ether_port, Packet *p)
+int
+XIAXIDRouteTable::route(Packet *p)
 {
-    int port;
+    int port, in_ether_port;
 
 	in_ether_port = XIA_PAINT_ANNO(p);
 
-	if (!_principal_type_enabled) {
-		output(2).push(p);
-		return;
-	}
+	if (!_principal_type_enabled)
+		return 2;
 
     if(in_ether_port == REDIRECT) {
         // if this is an XCMP redirect packet
         process_xcmp_redirect(p);
         p->kill();
-        return;
+        return -1;
     } else {    
     	port = lookup_route(in_ether_port, p);
     }
@@ -453,14 +509,14 @@ XIAXIDRouteTable::push(int in_ether_port, Packet *p)
     }
     if (port >= 0) {
 	  SET_XIA_PAINT_ANNO(p,port);
-	  output(0).push(p);
+	  return 0;
 	}
 	else if (port == DESTINED_FOR_LOCALHOST) {
-	  output(1).push(p);
+	  return 1;
 	}
 	else if (port == DESTINED_FOR_DHCP) {
 	  SET_XIA_PAINT_ANNO(p,port);
-	  output(3).push(p);
+	  return 3;
 	}
 	else if (port == DESTINED_FOR_BROADCAST) {
 	  for(int i = 0; i <= _num_ports; i++) {
@@ -470,6 +526,7 @@ XIAXIDRouteTable::push(int in_ether_port, Packet *p)
 		output(0).push(q);
 	  }
 	  p->kill();
+	  return -1;
 	}
 	else {
 	  //SET_XIA_PAINT_ANNO(p,UNREACHABLE);
@@ -483,42 +540,147 @@ XIAXIDRouteTable::push(int in_ether_port, Packet *p)
 	  //if (_drops == 1)
       //      click_chatter("Dropping a packet with no match (last message)\n");
       //  p->kill();
-	  output(2).push(p);
+	  return 2;
+    }
+}
+
+void
+XIAXIDRouteTable::push(int, Packet *p)
+{
+    int out = route(p);
+    if (out >= 0)
+	output(out).push(p);
+}
+
+void
+XIAXIDRouteTable::push_batch(int, Packet *head)
+{
+    Packet *pkts[MAX_BATCH];
+    int ports[MAX_BATCH];
+    while (head) {
+	int n = take_batch(head, pkts);
+
+	// find every packet's next XID and start loading its bucket
+	for (int i = 0; i < n; i++) {
+	    const struct click_xia* hdr = pkts[i]->xia_header();
+	    int last = hdr->last;
+	    if (last < 0)
+		last += hdr->dnode;
+	    int idx = hdr->node[last].edge[XIA_NEXT_PATH_ANNO(pkts[i])].idx;
+	    if (idx != CLICK_XIA_XID_EDGE_UNUSED)
+		_rts.prefetch(hdr->node[idx].xid);
+	}
+
+	// one read section for the whole batch
+	int m = 0;
+	_rts.read_begin();
+	for (int i = 0; i < n; i++) {
+	    int out = route(pkts[i]);
+	    if (out >= 0) {
+		pkts[m] = pkts[i];
+		ports[m++] = out;
+	    }
+	}
+	_rts.read_end();
+
+	output_push_sorted(pkts, ports, m);
     }
 }
 
 int
 XIAXIDRouteTable::process_xcmp_redirect(Packet *p)
 {
-   XIAHeader hdr(p->xia_header());
+   XIAHeader hdr(p);
    const uint8_t *pay = hdr.payload();
-   XID *dest, *newroute;
-   dest = new XID((const struct click_xia_xid &)(pay[4]));
-   newroute = new XID((const struct click_xia_xid &)(pay[4+sizeof(struct click_xia_xid)]));
-
-   // route update (dst, out, newroute, )
-   HashTable<XID, XIARouteData*>::const_iterator it = _rts.find(*dest);
-   if (it != _rts.end()) {
-   	(*it).second->nexthop = newroute;
+   XID dest((const struct click_xia_xid &)(pay[4]));
+   XID newroute((const struct click_xia_xid &)(pay[4+sizeof(struct click_xia_xid)]));
+
+   // route update (dst, out, newroute, ), made off the data path
+   queue_update(dest, newroute, 0, true);
+   return -1;
+}
+
+void
+XIAXIDRouteTable::queue_update(const XID &xid, const XID &nexthop, int port, bool redirect)
+{
+    _updates_lock.acquire();
+    if (_updates.size() < MAX_UPDATES) {
+	RouteUpdate u;
+	u.xid = xid;
+	u.nexthop = nexthop;
+	u.port = port;
+	u.redirect = redirect;
+	_updates.push_back(u);
+    }
+    _updates_lock.release();
+    _update_task.reschedule();
+}
+
+bool
+XIAXIDRouteTable::run_task(Task *)
+{
+    Vector<RouteUpdate> updates;
+    _updates_lock.acquire();
+    updates.swap(_updates);
+    _updates_lock.release();
+
+    for (int i = 0; i < updates.size(); i++)
+	if (updates[i].redirect)
+	    redirect_route(updates[i].xid, updates[i].nexthop);
+	else
+	    learn_route(updates[i].xid, updates[i].port);
+    return updates.size() != 0;
+}
+
+/* Route @a xid, a neighbour heard on @a port, straight to it. */
+void
+XIAXIDRouteTable::learn_route(const XID &xid, int port)
+{
+    // the lookup and the update must not interleave with another writer
+    XIDRouteMap::Route r;
+    _rts.acquire_write();
+    if (_rts.lookup(xid, r)) {
+	if (r.port != port)
+	    // update the entry
+	    _rts.insert(xid, port, r.flags, r.nexthop);
+    } else
+	// Make a new entry for this newly discovered neighbor
+	_rts.insert(xid, port, 0, &xid);
+    _rts.release_write();
+}
+
+void
+XIAXIDRouteTable::redirect_route(const XID &dest, const XID &newroute)
+{
+   XIDRouteMap::Route r;
+   _rts.acquire_write();
+   if (_rts.lookup(dest, r)) {
+	_rts.insert(dest, r.port, r.flags, &newroute);
    } else {
        // Make a new entry for this XID
-       XIARouteData *xrd1 = new XIARouteData();
-
-       int port = _rtdata.port;
-       if(strstr(_local_addr.unparse().c_str(), dest->unparse().c_str())) {
+       _rts.lookup_default(r);
+       int port = r.port;
+       if(strstr(_local_addr.unparse().c_str(), dest.unparse().c_str())) {
            port = DESTINED_FOR_LOCALHOST;
        }
 
-       xrd1->port = port;
-       xrd1->nexthop = newroute;
-       _rts[*dest] = xrd1;
+       _rts.insert(dest, port, 0, &newroute);
    }
-   
-   return -1;
+   _rts.release_write();
 }
 
 int
 XIAXIDRouteTable::lookup_route(int in_ether_port, Packet *p)
+{
+    // route pointers are only valid inside the read section
+    _rts.read_begin();
+    int port = lookup_route_reader(in_ether_port, p);
+    _rts.read_end();
+    return port;
+}
+
+int
+XIAXIDRouteTable::lookup_route_reader(int in_ether_port, Packet *p)
 {
    const struct click_xia* hdr = p->xia_header();
    int last = hdr->last;
@@ -530,19 +692,19 @@ XIAXIDRouteTable::lookup_route(int in_ether_port, Packet *p)
    if (idx == CLICK_XIA_XID_EDGE_UNUSED)
    {
 	// unused edge -- use default route
-  	return _rtdata.port;
+	XIDRouteMap::Route r;
+	_rts.lookup_default(r);
+  	return r.port;
     }
 
     const struct click_xia_xid_node& node = hdr->node[idx];
 
-    XIAHeader xiah(p->xia_header());
-
     if (_bcast_xid == node.xid) {
     	// Broadcast packet
     	
-    	XIAPath source_path = xiah.src_path();
-    	source_path.remove_node(source_path.destination_node());
-    	XID source_hid = source_path.xid(source_path.destination_node());
+    	// the sender's HID is the node before the final (service) node
+    	XIAPathView source_path = XIAHeader(hdr).src_path_view();
+    	XID source_hid = source_path.xid(source_path.destination_node() - 1);
     	
     	if(_local_hid == source_hid) {
     	    	// Case 1. Outgoing broadcast packet: send it to port 7 (which will duplicate the packet and send each to every interface)
@@ -551,22 +713,9 @@ XIAXIDRouteTable::lookup_route(int in_ether_port, Packet *p)
     	} else {
     		// Case 2. Incoming broadcast packet: send it to port 4 (which eventually send the packet to upper layer)
     		// Also, mark the incoming (ethernet) interface number that connects to this neighbor
-    		HashTable<XID, XIARouteData*>::const_iterator it = _rts.find(source_hid);
-    		if (it != _rts.end())
-			  {
-				if ((*it).second->port != in_ether_port) {
-				  // update the entry
-				  (*it).second->port = in_ether_port;
-				}	
-			  }
-    		else
-			  {
-    			// Make a new entry for this newly discovered neighbor
-       			XIARouteData *xrd1 = new XIARouteData();
-				xrd1->port = in_ether_port;
-				xrd1->nexthop = new XID(source_hid);
-				_rts[source_hid] = xrd1;
-			  }
+    		XIDRouteMap::Route r;
+    		if (!_rts.lookup(source_hid, r) || r.port != in_ether_port)
+    			queue_update(source_hid, source_hid, in_ether_port, false);
     		return DESTINED_FOR_LOCALHOST;
     	}    	
 		// TODO: not sure what this should be??
@@ -575,28 +724,29 @@ XIAXIDRouteTable::lookup_route(int in_ether_port, Packet *p)
     
     } else {
     	// Unicast packet
-		HashTable<XID, XIARouteData*>::const_iterator it = _rts.find(node.xid);
-		if (it != _rts.end())
+		XIDRouteMap::Route r;
+		if (_rts.lookup(node.xid, r))
 		{
-			XIARouteData *xrd = (*it).second;
 			// check if outgoing packet
-			if(xrd->port != DESTINED_FOR_LOCALHOST && xrd->port != FALLBACK && xrd->nexthop != NULL) {
-				p->set_nexthop_neighbor_xid_anno(*(xrd->nexthop));
+			if(r.port != DESTINED_FOR_LOCALHOST && r.port != FALLBACK && r.nexthop != NULL) {
+				p->set_nexthop_neighbor_xid_anno(*r.nexthop);
 			}
-			return xrd->port;
+			return r.port;
 		}
 		else
 		{
 			// no match -- use default route
 			// check if outgoing packet
-			if(_rtdata.port != DESTINED_FOR_LOCALHOST && _rtdata.port != FALLBACK && _rtdata.nexthop != NULL) {
-				p->set_nexthop_neighbor_xid_anno(*(_rtdata.nexthop));
+			_rts.lookup_default(r);
+			if(r.port != DESTINED_FOR_LOCALHOST && r.port != FALLBACK && r.nexthop != NULL) {
+				p->set_nexthop_neighbor_xid_anno(*r.nexthop);
 			}
-			return _rtdata.port;
+			return r.port;
 		}
 	}
 }
 
 CLICK_ENDDECLS
 EXPORT_ELEMENT(XIAXIDRouteTable)
+ELEMENT_REQUIRES(XIDRouteMap XIAEpoch XIABatchElement)
 ELEMENT_MT_SAFE(XIAXIDRouteTable)
@@ -2,10 +2,14 @@
 #define CLICK_XIAXIDROUTETABLE_HH
 #include <click/element.hh>
 #include <click/hashtable.hh>
+#include <click/task.hh>
+#include <click/sync.hh>
 #include <clicknet/xia.h>
 #include <click/xid.hh>
 #include <click/xiapath.hh>
 #include "xcmp.hh"
+#include "xidroutemap.hh"
+#include "xiabatch.hh"
 CLICK_DECLS
 
 /*
@@ -25,6 +29,23 @@ It outputs AD0 packets to port 0, HID2 packets to port 1, and other packets to p
 If the packet has already arrived at the destination node, the packet will be destroyed,
 so use the XIACheckDest element before using this element.
 
+=h save write-only
+Write every route, and the default route, to the named file in a compact
+binary snapshot format.  The file is replaced atomically.  Userlevel only.
+
+=h load_binary write-only
+Takes a file name and an optional thread count, as in "FILE [THREADS]".
+Replaces every route, and the default route, with a snapshot written by
+C<save>.  The file is mapped into memory and the new table is built while the
+old one keeps routing packets, then swapped in at once.  With THREADS greater
+than 1, that many threads share the work.  Userlevel only.
+
+=n
+
+Routes learned from incoming broadcasts and from XCMP redirects are not
+written by the thread that forwards the packet.  They are queued, at most 256
+at a time, and a task installs them shortly afterwards.
+
 =a StaticIPLookup, IPRouteTable
 */
 
@@ -45,7 +66,7 @@ typedef struct {
 	XID *nexthop;
 } XIARouteData;
 
-class XIAXIDRouteTable : public Element { public:
+class XIAXIDRouteTable : public XIABatchElement { public:
 
     XIAXIDRouteTable();
     ~XIAXIDRouteTable();
@@ -55,32 +76,77 @@ class XIAXIDRouteTable : public Element { public:
     const char *processing() const		{ return PUSH; }
 
     int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
     void add_handlers();
 
+    bool run_task(Task *);
+
     void push(int in_ether_port, Packet *);
+    void push_batch(int port, Packet *head);
 
 	int set_enabled(int e);
 	int get_enabled();
 
-protected:
+    // used directly by XIAForwardEngine
+    int num_ports() const			{ return _num_ports; }
+    // used directly by XIAFastPath; see XIDRouteMap::generation()
+    uint32_t generation() const			{ return _rts.generation(); }
     int lookup_route(int in_ether_port, Packet *);
     int process_xcmp_redirect(Packet *);
 
+    // used directly by XIAContentModule and XTRANSPORT; the add, set and
+    // remove handlers are for external control
+    /** @brief Route @a xid as @a rd says.  An existing route for @a xid is
+     * replaced if @a replace is true, and left alone otherwise.  Returns 0
+     * or a negative errno, -EEXIST if the route was left alone. */
+    int insert(const XID &xid, const XIARouteData &rd, bool replace = true);
+    /** @brief Remove the route for @a xid.  Returns 0 or -ENOENT. */
+    int erase(const XID &xid);
+    /** @brief Route every XID in @a xids as @a rd says, growing the table
+     * at most once.  Returns how many routes were added or replaced. */
+    int insert(const Vector<XID> &xids, const XIARouteData &rd, bool replace = true);
+    /** @brief Remove the routes for @a xids.  Returns how many there
+     * were. */
+    int erase(const Vector<XID> &xids);
+
+protected:
+    int route(Packet *);
+    int lookup_route_reader(int in_ether_port, Packet *);
+
     static int set_handler(const String &conf, Element *e, void *thunk, ErrorHandler *errh);
     static int set_handler4(const String &conf, Element *e, void *thunk, ErrorHandler *errh);
     static int remove_handler(const String &conf, Element *e, void *, ErrorHandler *errh);
     static int load_routes_handler(const String &conf, Element *e, void *, ErrorHandler *errh);
     static int generate_routes_handler(const String &conf, Element *e, void *, ErrorHandler *errh);
+    static int save_routes_handler(const String &conf, Element *e, void *, ErrorHandler *errh);
+    static int load_binary_handler(const String &conf, Element *e, void *, ErrorHandler *errh);
 	static String read_handler(Element *e, void *thunk);
 	static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
 
     static String list_routes_handler(Element *e, void *thunk);
 
 private:
-	HashTable<XID, XIARouteData*> _rts;
-	XIARouteData _rtdata;
+    // a route change found on the data path, applied by _update_task
+    struct RouteUpdate {
+	XID xid;
+	XID nexthop;
+	int port;		// the neighbour's port, for a learned route
+	bool redirect;
+    };
+
+    enum { MAX_UPDATES = 256 };
+
+	XIDRouteMap _rts;
     uint32_t _drops;
 
+    Vector<RouteUpdate> _updates;
+    Spinlock _updates_lock;
+    Task _update_task;
+
+    void queue_update(const XID &xid, const XID &nexthop, int port, bool redirect);
+    void learn_route(const XID &xid, int port);
+    void redirect_route(const XID &dest, const XID &newroute);
+
 	int _principal_type_enabled;
     int _num_ports;
     XIAPath _local_addr;
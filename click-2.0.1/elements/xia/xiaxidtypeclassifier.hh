@@ -3,6 +3,8 @@
 #include <click/element.hh>
 #include <clicknet/xia.h>
 #include <click/vector.hh>
+#include "xiaxidtypematcher.hh"
+#include "xiabatch.hh"
 CLICK_DECLS
 
 /*
@@ -15,6 +17,9 @@ classifies XIA packets by the type of source/destination XID
 =d
 Classifies XIA packets by the type of source/destination XID.
 PATTERN is (src TYPE | dst TYPE | src_and_dst SRCTYPE DSTTYPE | src_or_dst SRCTYPE DSTTYPE | next NEXTTYPE | -).
+A packet goes to the output of the first pattern it matches.  The patterns are
+compiled into a lookup table by XID type at configuration time, so a packet
+costs the same to classify whatever the number of patterns.
 
 =e
 
@@ -24,7 +29,7 @@ It outputs packets from AD to port 0, HID packets destined for HID to port 1, an
 =a IPClassifier, IPFilter
 */
 
-class XIAXIDTypeClassifier : public Element { public:
+class XIAXIDTypeClassifier : public XIABatchElement { public:
 
     XIAXIDTypeClassifier();
     ~XIAXIDTypeClassifier();
@@ -36,19 +41,10 @@ class XIAXIDTypeClassifier : public Element { public:
     int configure(Vector<String> &, ErrorHandler *);
 
     void push(int port, Packet *);
-
-protected:
-    int match(Packet *);
-    struct pattern 
-    {
-        enum { SRC = 0, DST, SRC_AND_DST, SRC_OR_DST, NEXT, ANY } type;
-        uint32_t src_xid_type;
-        uint32_t dst_xid_type;
-        uint32_t next_xid_type;
-    };
+    void push_batch(int port, Packet *head);
 
 private:
-    Vector<struct pattern> _patterns;
+    XIAXIDTypeMatcher _matcher;
 };
 
 CLICK_ENDDECLS
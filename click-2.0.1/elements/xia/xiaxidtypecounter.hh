@@ -3,6 +3,7 @@
 #include <click/element.hh>
 #include <clicknet/xia.h>
 #include <click/vector.hh>
+#include "xiaxidtypematcher.hh"
 CLICK_DECLS
 
 /*
@@ -39,21 +40,13 @@ class XIAXIDTypeCounter : public Element { public:
     void add_handlers();
 
 protected:
-    int match(Packet *);
     String count_str();
-    struct pattern 
-    {
-        enum { SRC = 0, DST, SRC_AND_DST, SRC_OR_DST, NEXT, ANY } type;
-        uint32_t src_xid_type;
-        uint32_t dst_xid_type;
-        uint32_t next_xid_type;
-    };
 
 private:
     void count_stats(int cl);
     static String read_handler(Element *e, void *thunk);
 
-    Vector<struct pattern> _patterns;
+    XIAXIDTypeMatcher _matcher;
     uint32_t* _stats;
     int _size;
 };
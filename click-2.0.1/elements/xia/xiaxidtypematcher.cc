@@ -0,0 +1,210 @@
+/*
+ * xiaxidtypematcher.{cc,hh} -- compiled XID type patterns
+ */
+
+#include <click/config.h>
+#include "xiaxidtypematcher.hh"
+#include <click/error.hh>
+#include <click/confparse.hh>
+#include <click/xid.hh>
+CLICK_DECLS
+
+XIAXIDTypeMatcher::XIAXIDTypeMatcher()
+    : _compiled(false)
+{
+    memset(_fields, 0, sizeof(_fields));
+}
+
+int
+XIAXIDTypeMatcher::configure(const Vector<String> &conf, ErrorHandler *errh)
+{
+    _patterns.clear();
+    for (int i = 0; i < conf.size(); i++) {
+        String str_copy = conf[i];
+        String type_str = cp_shift_spacevec(str_copy);
+
+        struct pattern pat;
+        pat.src_xid_type = pat.dst_xid_type = pat.next_xid_type = 0;
+
+        if (type_str == "-")
+            pat.type = pattern::ANY;
+        else if (type_str == "src" || type_str == "dst" || type_str == "next") {
+            String xid_type_str = cp_shift_spacevec(str_copy);
+            uint32_t xid_type;
+            if (!cp_xid_type(xid_type_str, &xid_type))
+                return errh->error("unrecognized XID type: ", xid_type_str.c_str());
+
+            if (type_str == "src") {
+                pat.type = pattern::SRC;
+                pat.src_xid_type = xid_type;
+            }
+            else if (type_str == "dst") {
+                pat.type = pattern::DST;
+                pat.dst_xid_type = xid_type;
+            }
+            else {
+                pat.type = pattern::NEXT;
+                pat.next_xid_type = xid_type;
+            }
+        }
+        else if (type_str == "src_and_dst" || type_str == "src_or_dst") {
+            String xid_type_str = cp_shift_spacevec(str_copy);
+            uint32_t xid_type0;
+            if (!cp_xid_type(xid_type_str, &xid_type0))
+                return errh->error("unrecognized XID type: ", xid_type_str.c_str());
+
+            xid_type_str = cp_shift_spacevec(str_copy);
+            uint32_t xid_type1;
+            if (!cp_xid_type(xid_type_str, &xid_type1))
+                return errh->error("unrecognized XID type: ", xid_type_str.c_str());
+
+            if (type_str == "src_and_dst")
+                pat.type = pattern::SRC_AND_DST;
+            else
+                pat.type = pattern::SRC_OR_DST;
+            pat.src_xid_type = xid_type0;
+            pat.dst_xid_type = xid_type1;
+        }
+        else
+            return errh->error("unrecognized pattern type: ", type_str.c_str());
+
+        _patterns.push_back(pat);
+    }
+
+    if (compile() < 0)
+        return errh->error("out of memory");
+    return 0;
+}
+
+int
+XIAXIDTypeMatcher::add_class(int f, uint32_t xid_type)
+{
+    field &fl = _fields[f];
+    int c = classify(f, xid_type);
+    if (c)
+        return c;
+    uint8_t &slot = fl.cls[ntohl(xid_type) & 0xFF];
+    if (slot || fl.nclasses == MAX_CLASSES)
+        return -1;
+    fl.type[fl.nclasses] = xid_type;
+    slot = fl.nclasses;
+    return fl.nclasses++;
+}
+
+int
+XIAXIDTypeMatcher::evaluate(const int *cls, const int (*pcls)[NFIELDS]) const
+{
+    for (int i = 0; i < _patterns.size(); i++) {
+        bool src = cls[SRC] == pcls[i][SRC];
+        bool dst = cls[DST] == pcls[i][DST];
+        switch (_patterns[i].type) {
+            case pattern::SRC:
+                if (src)
+                    return i;
+                break;
+            case pattern::DST:
+                if (dst)
+                    return i;
+                break;
+            case pattern::SRC_AND_DST:
+                if (src && dst)
+                    return i;
+                break;
+            case pattern::SRC_OR_DST:
+                if (src || dst)
+                    return i;
+                break;
+            case pattern::NEXT:
+                if (cls[NEXT] == pcls[i][NEXT])
+                    return i;
+                break;
+            case pattern::ANY:
+                return i;
+        }
+    }
+    return -1;
+}
+
+int
+XIAXIDTypeMatcher::compile()
+{
+    memset(_fields, 0, sizeof(_fields));
+    for (int f = 0; f < NFIELDS; f++)
+        _fields[f].nclasses = 1;
+    _decision.clear();
+    _compiled = false;
+
+    // number the types each field is tested against; class 0 is "anything
+    // else", so no pattern refers to it
+    int (*pcls)[NFIELDS] = new int[_patterns.size() + 1][NFIELDS];
+    if (!pcls)
+        return -ENOMEM;
+    bool ok = true;
+    for (int i = 0; i < _patterns.size() && ok; i++) {
+        const struct pattern &pat = _patterns[i];
+        pcls[i][SRC] = pcls[i][DST] = pcls[i][NEXT] = -1;
+        if (pat.type == pattern::SRC || pat.type == pattern::SRC_AND_DST
+            || pat.type == pattern::SRC_OR_DST)
+            ok = (pcls[i][SRC] = add_class(SRC, pat.src_xid_type)) > 0;
+        if (ok && (pat.type == pattern::DST || pat.type == pattern::SRC_AND_DST
+                   || pat.type == pattern::SRC_OR_DST))
+            ok = (pcls[i][DST] = add_class(DST, pat.dst_xid_type)) > 0;
+        if (ok && pat.type == pattern::NEXT)
+            ok = (pcls[i][NEXT] = add_class(NEXT, pat.next_xid_type)) > 0;
+    }
+
+    int ns = _fields[SRC].nclasses, nd = _fields[DST].nclasses,
+        nn = _fields[NEXT].nclasses;
+    if (ok && ns * nd * nn <= MAX_DECISIONS) {
+        // resolve the pattern list for every combination of classes, in the
+        // same order match() folds the fields into an index
+        _decision.resize(ns * nd * nn);
+        int cls[NFIELDS];
+        for (cls[SRC] = 0; cls[SRC] < ns; cls[SRC]++)
+            for (cls[DST] = 0; cls[DST] < nd; cls[DST]++)
+                for (cls[NEXT] = 0; cls[NEXT] < nn; cls[NEXT]++)
+                    _decision[(cls[SRC] * nd + cls[DST]) * nn + cls[NEXT]]
+                        = evaluate(cls, pcls);
+        _compiled = true;
+    }
+
+    delete[] pcls;
+    return 0;
+}
+
+int
+XIAXIDTypeMatcher::match_slow(uint32_t src_xid_type, uint32_t dst_xid_type,
+                              uint32_t next_xid_type) const
+{
+    for (int i = 0; i < _patterns.size(); i++) {
+        const struct pattern& pat = _patterns[i];
+        switch (pat.type) {
+            case pattern::SRC:
+                if (src_xid_type == pat.src_xid_type)
+                    return i;
+                break;
+            case pattern::DST:
+                if (dst_xid_type == pat.dst_xid_type)
+                    return i;
+                break;
+            case pattern::SRC_AND_DST:
+                if (src_xid_type == pat.src_xid_type && dst_xid_type == pat.dst_xid_type)
+                    return i;
+                break;
+            case pattern::SRC_OR_DST:
+                if (src_xid_type == pat.src_xid_type || dst_xid_type == pat.dst_xid_type)
+                    return i;
+                break;
+            case pattern::NEXT:
+                if (next_xid_type == pat.next_xid_type)
+                    return i;
+                break;
+            case pattern::ANY:
+                return i;
+        }
+    }
+    return -1;
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(XIAXIDTypeMatcher)
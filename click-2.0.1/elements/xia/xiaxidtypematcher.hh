@@ -0,0 +1,123 @@
+#ifndef CLICK_XIAXIDTYPEMATCHER_HH
+#define CLICK_XIAXIDTYPEMATCHER_HH
+#include <click/glue.hh>
+#include <click/packet.hh>
+#include <click/packet_anno.hh>
+#include <click/vector.hh>
+#include <clicknet/xia.h>
+CLICK_DECLS
+class ErrorHandler;
+
+/*
+ * XIAXIDTypeMatcher -- compiled XID type patterns
+ *
+ * Holds the pattern list of XIAXIDTypeClassifier and XIAXIDTypeCounter:
+ * (src TYPE | dst TYPE | src_and_dst SRCTYPE DSTTYPE |
+ *  src_or_dst SRCTYPE DSTTYPE | next NEXTTYPE | -).
+ *
+ * At configure time every XID type a pattern mentions is given a small class
+ * number per header field (source, destination, next); class 0 stands for
+ * every other type.  A 256-entry table indexed by the low byte of the type
+ * maps a type to its class, and one more comparison confirms the full type.
+ * The pattern list is then evaluated once for every combination of classes,
+ * so match() costs a table load per field the patterns look at plus one load
+ * from the decision table, whatever the number of patterns.
+ *
+ * Pattern sets whose types collide in their low byte, or whose decision
+ * table would be unreasonably large, are matched by walking the patterns in
+ * order instead.
+ *
+ * XIAXIDTypeMatcher is not an element.
+ */
+
+class XIAXIDTypeMatcher { public:
+
+    XIAXIDTypeMatcher();
+
+    int configure(const Vector<String> &conf, ErrorHandler *errh);
+
+    int size() const			{ return _patterns.size(); }
+    bool compiled() const		{ return _compiled; }
+
+    /** @brief Return the index of the first pattern @a p matches, or -1. */
+    inline int match(Packet *p) const;
+
+  private:
+
+    enum { SRC = 0, DST, NEXT, NFIELDS };
+    enum { MAX_CLASSES = 256, MAX_DECISIONS = 65536 };
+
+    struct pattern {
+	enum { SRC = 0, DST, SRC_AND_DST, SRC_OR_DST, NEXT, ANY } type;
+	uint32_t src_xid_type;
+	uint32_t dst_xid_type;
+	uint32_t next_xid_type;
+    };
+
+    struct field {
+	uint8_t cls[256];		// low byte of host-order type -> class
+	uint32_t type[MAX_CLASSES];	// class -> network-order type
+	int nclasses;			// including class 0
+    };
+
+    Vector<pattern> _patterns;
+    field _fields[NFIELDS];
+    Vector<int16_t> _decision;
+    bool _compiled;
+
+    int add_class(int f, uint32_t xid_type);
+    inline int classify(int f, uint32_t xid_type) const;
+    int compile();
+    int evaluate(const int *cls, const int (*pcls)[NFIELDS]) const;
+    int match_slow(uint32_t src, uint32_t dst, uint32_t next) const;
+
+    static inline uint32_t next_type(Packet *p, const struct click_xia *hdr);
+
+};
+
+inline int
+XIAXIDTypeMatcher::classify(int f, uint32_t xid_type) const
+{
+    const field &fl = _fields[f];
+    int c = fl.cls[ntohl(xid_type) & 0xFF];
+    return fl.type[c] == xid_type ? c : 0;
+}
+
+inline uint32_t
+XIAXIDTypeMatcher::next_type(Packet *p, const struct click_xia *hdr)
+{
+    int last = hdr->last;
+    if (last < 0)
+	last += hdr->dnode;
+    int path = XIA_NEXT_PATH_ANNO(p);
+    if (path < CLICK_XIA_XID_EDGE_NUM) {
+	const struct click_xia_xid_edge &edge = hdr->node[last].edge[path];
+	if (edge.idx != CLICK_XIA_XID_EDGE_UNUSED && edge.idx < hdr->dnode)
+	    return hdr->node[edge.idx].xid.type;
+    }
+    return -1;
+}
+
+inline int
+XIAXIDTypeMatcher::match(Packet *p) const
+{
+    const struct click_xia *hdr = p->xia_header();
+
+    if (!_compiled)
+	return match_slow(hdr->node[hdr->dnode + hdr->snode - 1].xid.type,
+			  hdr->node[hdr->dnode - 1].xid.type,
+			  next_type(p, hdr));
+
+    // only look at the fields some pattern tests
+    int i = 0;
+    if (_fields[SRC].nclasses > 1)
+	i = classify(SRC, hdr->node[hdr->dnode + hdr->snode - 1].xid.type);
+    if (_fields[DST].nclasses > 1)
+	i = i * _fields[DST].nclasses + classify(DST, hdr->node[hdr->dnode - 1].xid.type);
+    if (_fields[NEXT].nclasses > 1)
+	i = i * _fields[NEXT].nclasses + classify(NEXT, next_type(p, hdr));
+    return _decision[i];
+}
+
+CLICK_ENDDECLS
+#endif
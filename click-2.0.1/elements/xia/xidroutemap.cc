@@ -0,0 +1,841 @@
+/*
+ * xidroutemap.{cc,hh} -- flat open-addressing XID route storage
+ */
+
+#include <click/config.h>
+#include "xidroutemap.hh"
+#include <click/glue.hh>
+#include <click/integers.hh>
+#if CLICK_USERLEVEL
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <stdio.h>
+# if HAVE_MMAP
+#  include <sys/mman.h>
+# endif
+# if HAVE_MULTITHREAD
+#  include <pthread.h>
+# endif
+#endif
+CLICK_DECLS
+
+/*
+ * Snapshot format.  Integers are in network byte order and XIDs are stored as
+ * they appear on the wire:
+ *
+ *   SnapshotHeader
+ *   nexthops * struct click_xia_xid
+ *   routes * SnapshotRoute
+ *
+ * Routes and the default route name their next hop by its 1-based position
+ * in the next-hop array; 0 means no next hop.  A snapshot never holds the
+ * same XID twice; load() rejects one that does.
+ */
+struct XIDRouteMap::SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t routes;
+    uint32_t nexthops;
+    int32_t default_port;
+    uint32_t default_flags;
+    uint32_t default_nexthop;
+    uint32_t reserved;
+};
+
+struct XIDRouteMap::SnapshotRoute {
+    struct click_xia_xid xid;
+    int32_t port;
+    uint32_t flags;
+    uint32_t nexthop;
+};
+
+static const char snapshot_magic[4] = { 'X', 'R', 'T', 'S' };
+
+struct XIDRouteMap::LoadJob {
+    Table *t;
+    const SnapshotRoute *recs;
+    uint64_t *h;
+    const int *nhmap;
+    uint32_t nroutes;
+    uint32_t nnexthops;
+    uint32_t begin, end;	// records this job hashes and checks
+    uint32_t lo, hi;		// buckets this job fills
+    Vector<uint32_t> uses;	// routes referring to each next hop
+    Vector<uint32_t> spill;	// records whose probe sequence leaves [lo, hi)
+    bool ok;			// false if a record is invalid or a duplicate
+};
+
+XIDRouteMap::XIDRouteMap()
+    : _generation(1), _local_port(NO_LOCAL_PORT),
+      _fallback_port(NO_LOCAL_PORT), _t(0), _size(0)
+{
+    memset(&_default, 0, sizeof(_default));
+    _default.slot[0].port = -1;
+    memset(_nh_chunks, 0, sizeof(_nh_chunks));
+    _nh_refs.push_back(0);	// index 0 means "no next hop"
+    _t = alloc_table(INITIAL_BUCKETS);
+}
+
+XIDRouteMap::~XIDRouteMap()
+{
+    // run pending reclaimers while the next-hop bookkeeping still exists
+    _epoch.reclaim();
+    free_table(_t, 0);
+    for (int i = 0; i < NH_NCHUNKS; i++)
+	delete[] _nh_chunks[i];
+}
+
+inline void
+XIDRouteMap::write_begin(Bucket &bk)
+{
+    bk.seq++;
+    click_fence();
+}
+
+inline void
+XIDRouteMap::write_end(Bucket &bk)
+{
+    click_fence();
+    bk.seq++;
+}
+
+void
+XIDRouteMap::bump_generation()
+{
+    // the change must be visible before the new generation is
+    click_fence();
+    atomic_uint32_t::inc(_generation);
+    // 0 means "no generation"
+    if (_generation == 0)
+	atomic_uint32_t::compare_swap(_generation, 0, 1);
+}
+
+XIDRouteMap::Table *
+XIDRouteMap::alloc_table(uint32_t nbuckets)
+{
+    // buckets must start on a cache line
+    size_t bytes = sizeof(Table) + nbuckets * sizeof(Bucket) + 63;
+    void *mem = CLICK_LALLOC(bytes);
+    XID *keys = new XID[nbuckets * SLOTS];
+    if (!mem || !keys) {
+	if (mem)
+	    CLICK_LFREE(mem, bytes);
+	delete[] keys;
+	return 0;
+    }
+    memset(mem, 0, bytes);
+    Table *t = reinterpret_cast<Table *>(mem);
+    t->buckets = reinterpret_cast<Bucket *>(((uintptr_t) (t + 1) + 63) & ~(uintptr_t) 63);
+    t->keys = keys;
+    t->mask = nbuckets - 1;
+    t->mem = mem;
+    return t;
+}
+
+void
+XIDRouteMap::free_table(void *table, void *)
+{
+    Table *t = reinterpret_cast<Table *>(table);
+    if (!t)
+	return;
+    delete[] t->keys;
+    CLICK_LFREE(t->mem, sizeof(Table) + (t->mask + 1) * sizeof(Bucket) + 63);
+}
+
+bool
+XIDRouteMap::find(const Table *t, const XID &xid, uint64_t h, uint32_t &b, int &s)
+{
+    // writer side: no bucket can change underneath us
+    uint32_t fp = h >> 32;
+    b = h & t->mask;
+    for (uint32_t n = 0; n <= t->mask; ++n) {
+	const Bucket &bk = t->buckets[b];
+	for (s = 0; s < SLOTS; ++s)
+	    if ((bk.used & (1 << s)) && bk.slot[s].fp == fp
+		&& t->keys[b * SLOTS + s] == xid)
+		return true;
+	if (!bk.overflow)
+	    return false;
+	b = (b + 1) & t->mask;
+    }
+    return false;
+}
+
+void
+XIDRouteMap::place(Table *t, const XID &xid, uint64_t h, const Slot &slot)
+{
+    uint32_t b = h & t->mask;
+    while (1) {
+	Bucket &bk = t->buckets[b];
+	if (bk.used != (1 << SLOTS) - 1) {
+	    int s = ffs_lsb((uint32_t) (uint8_t) ~bk.used) - 1;
+	    write_begin(bk);
+	    bk.slot[s] = slot;
+	    bk.slot[s].fp = h >> 32;
+	    t->keys[b * SLOTS + s] = xid;
+	    bk.used |= 1 << s;
+	    write_end(bk);
+	    return;
+	}
+	if (bk.overflow != OVERFLOW_SATURATED) {
+	    write_begin(bk);
+	    bk.overflow++;
+	    write_end(bk);
+	}
+	b = (b + 1) & t->mask;
+    }
+}
+
+int
+XIDRouteMap::rehash(uint32_t nbuckets)
+{
+    Table *old = _t;
+    Table *t = alloc_table(nbuckets);
+    if (!t)
+	return -ENOMEM;
+
+    for (uint32_t b = 0; b <= old->mask; b++)
+	for (int s = 0; s < SLOTS; s++)
+	    if (old->buckets[b].used & (1 << s)) {
+		const XID &key = old->keys[b * SLOTS + s];
+		place(t, key, hash(key), old->buckets[b].slot[s]);
+	    }
+
+    // readers still walking the old table see a consistent, if stale, copy
+    click_fence();
+    _t = t;
+    _epoch.retire(old, free_table);
+    return 0;
+}
+
+int
+XIDRouteMap::reserve(int n)
+{
+    // keep the table at most 80% full
+    _lock.acquire();
+    uint64_t want = ((uint64_t) n * 5 / 4 + SLOTS - 1) / SLOTS;
+    uint32_t nbuckets = _t->mask + 1;
+    while (nbuckets < want)
+	nbuckets <<= 1;
+    int r = 0;
+    if (nbuckets != _t->mask + 1)
+	r = rehash(nbuckets);
+    release_write();
+    return r;
+}
+
+int
+XIDRouteMap::intern(const XID *nh)
+{
+    if (!nh)
+	return NO_NEXTHOP;
+
+    HashTable<XID, int>::iterator it = _nh_index.find(*nh);
+    if (it != _nh_index.end()) {
+	_nh_refs[it.value()]++;
+	return it.value();
+    }
+
+    int index;
+    if (_nh_free.size()) {
+	index = _nh_free.back();
+	_nh_free.pop_back();
+    } else if (_nh_refs.size() <= MAX_NEXTHOPS) {
+	index = _nh_refs.size();
+	_nh_refs.push_back(0);
+    } else
+	return -ENOSPC;
+
+    XID *&chunk = _nh_chunks[index >> NH_CHUNK_SHIFT];
+    if (!chunk && !(chunk = new XID[NH_CHUNK])) {
+	_nh_free.push_back(index);
+	return -ENOMEM;
+    }
+    chunk[index & (NH_CHUNK - 1)] = *nh;
+    _nh_refs[index] = 1;
+    _nh_index.set(*nh, index);
+    return index;
+}
+
+void
+XIDRouteMap::free_nexthop(void *index, void *map)
+{
+    XIDRouteMap *m = reinterpret_cast<XIDRouteMap *>(map);
+    m->_nh_free.push_back((int) (intptr_t) index);
+}
+
+void
+XIDRouteMap::release(int index)
+{
+    if (index == NO_NEXTHOP || --_nh_refs[index] != 0)
+	return;
+    _nh_index.erase(*nexthop(index));
+    // a reader may still hold a pointer to this next hop
+    _epoch.retire((void *) (intptr_t) index, free_nexthop, this);
+}
+
+void
+XIDRouteMap::release_write()
+{
+    _epoch.reclaim();
+    _lock.release();
+}
+
+/* Add or replace the route for @a xid, setting @a bump if the generation
+   must change. */
+int
+XIDRouteMap::insert_route(const XID &xid, int port, uint32_t flags, const XID *nh, bool replace, bool &bump)
+{
+    if (!valid_port(port))
+	return -EINVAL;
+    uint64_t h = hash(xid);
+    uint32_t b;
+    int s, r = 0;
+
+    _lock.acquire();
+    bool exists = find(_t, xid, h, b, s);
+    if (exists && !replace) {
+	r = -EEXIST;
+	goto out;
+    }
+
+    int index;
+    if ((index = intern(nh)) < 0) {
+	r = index;
+	goto out;
+    }
+
+    if (exists) {
+	Bucket &bk = _t->buckets[b];
+	int old = bk.slot[s].nexthop;
+	if (!local(xid, port) || !local(xid, bk.slot[s].port))
+	    bump = true;
+	write_begin(bk);
+	bk.slot[s].port = port;
+	bk.slot[s].flags = flags;
+	bk.slot[s].nexthop = index;
+	write_end(bk);
+	release(old);
+	goto out;
+    }
+
+    if ((uint64_t) (_size + 1) * 5 > (uint64_t) capacity() * 4
+	&& rehash((_t->mask + 1) * 2) < 0) {
+	release(index);
+	r = -ENOMEM;
+	goto out;
+    }
+
+    {
+	Slot slot;
+	slot.port = port;
+	slot.flags = flags;
+	slot.nexthop = index;
+	place(_t, xid, h, slot);
+	_size++;
+	if (!local_shadow(xid, port))
+	    bump = true;
+    }
+
+  out:
+    release_write();
+    return r;
+}
+
+int
+XIDRouteMap::insert(const XID &xid, int port, uint32_t flags, const XID *nh, bool replace)
+{
+    bool bump = false;
+    int r = insert_route(xid, port, flags, nh, replace, bump);
+    if (bump)
+	bump_generation();
+    return r;
+}
+
+int
+XIDRouteMap::insert(const Vector<XID> &xids, int port, uint32_t flags, const XID *nh, bool replace)
+{
+    // the lock is taken per route, but a cached decision stamped partway
+    // through is still invalidated by the one bump at the end
+    bool bump = false;
+    int n = 0;
+    for (int i = 0; i < xids.size(); i++)
+	if (insert_route(xids[i], port, flags, nh, replace, bump) == 0)
+	    n++;
+    if (bump)
+	bump_generation();
+    return n;
+}
+
+int
+XIDRouteMap::set_default(int port, uint32_t flags, const XID *nh)
+{
+    if (!valid_port(port))
+	return -EINVAL;
+    _lock.acquire();
+    int index = intern(nh);
+    if (index < 0) {
+	release_write();
+	return index;
+    }
+    int old = _default.slot[0].nexthop;
+    write_begin(_default);
+    _default.slot[0].port = port;
+    _default.slot[0].flags = flags;
+    _default.slot[0].nexthop = index;
+    write_end(_default);
+    release(old);
+    bump_generation();
+    release_write();
+    return 0;
+}
+
+int
+XIDRouteMap::remove_route(const XID &xid, bool &bump)
+{
+    uint64_t h = hash(xid);
+    uint32_t b;
+    int s;
+
+    _lock.acquire();
+    if (!find(_t, xid, h, b, s)) {
+	release_write();
+	return -ENOENT;
+    }
+
+    Table *t = _t;
+    Bucket &bk = t->buckets[b];
+    int old = bk.slot[s].nexthop;
+    if (!local_shadow(xid, bk.slot[s].port))
+	bump = true;
+    write_begin(bk);
+    bk.used &= ~(1 << s);
+    write_end(bk);
+    release(old);
+    _size--;
+
+    // undo the overflow counts this entry left along its probe sequence
+    for (uint32_t i = h & t->mask; i != b; i = (i + 1) & t->mask)
+	if (t->buckets[i].overflow != OVERFLOW_SATURATED) {
+	    write_begin(t->buckets[i]);
+	    t->buckets[i].overflow--;
+	    write_end(t->buckets[i]);
+	}
+    release_write();
+    return 0;
+}
+
+int
+XIDRouteMap::remove(const XID &xid)
+{
+    bool bump = false;
+    int r = remove_route(xid, bump);
+    if (bump)
+	bump_generation();
+    return r;
+}
+
+int
+XIDRouteMap::remove(const Vector<XID> &xids)
+{
+    bool bump = false;
+    int n = 0;
+    for (int i = 0; i < xids.size(); i++)
+	if (remove_route(xids[i], bump) == 0)
+	    n++;
+    if (bump)
+	bump_generation();
+    return n;
+}
+
+/* Release the next hops held by @a old's routes, then retire @a old.  @a old
+   must already be replaced.  Writers only change the published table, so
+   its routes are counted without holding the lock. */
+void
+XIDRouteMap::drop_table(Table *old)
+{
+    Vector<uint32_t> uses(MAX_NEXTHOPS + 1, 0);
+    for (uint32_t b = 0; b <= old->mask; b++)
+	for (int s = 0; s < SLOTS; s++)
+	    if (old->buckets[b].used & (1 << s))
+		uses[old->buckets[b].slot[s].nexthop]++;
+
+    _lock.acquire();
+    for (int i = 1; i <= MAX_NEXTHOPS; i++)
+	if (uses[i]) {
+	    // release() drops the last of these references
+	    _nh_refs[i] -= uses[i] - 1;
+	    release(i);
+	}
+    _epoch.retire(old, free_table);
+    release_write();
+}
+
+void
+XIDRouteMap::clear()
+{
+    Table *t = alloc_table(INITIAL_BUCKETS);
+    if (!t)
+	return;
+    _lock.acquire();
+    Table *old = _t;
+    click_fence();
+    _t = t;
+    _size = 0;
+    bump_generation();
+    release_write();
+    drop_table(old);
+}
+
+void
+XIDRouteMap::copy(Vector<Entry> &routes, Entry &dflt, Vector<XID> &nexthops)
+{
+    routes.clear();
+    nexthops.clear();
+
+    _lock.acquire();
+
+    Vector<uint32_t> index(_nh_refs.size(), 0);
+    for (int i = 1; i < _nh_refs.size(); i++)
+	if (_nh_refs[i]) {
+	    nexthops.push_back(*nexthop(i));
+	    index[i] = nexthops.size();
+	}
+
+    dflt.port = _default.slot[0].port;
+    dflt.flags = _default.slot[0].flags;
+    dflt.nexthop = index[_default.slot[0].nexthop];
+
+    routes.reserve(_size);
+    const Table *t = _t;
+    for (uint32_t b = 0; b <= t->mask; b++)
+	for (int s = 0; s < SLOTS; s++)
+	    if (t->buckets[b].used & (1 << s)) {
+		const Slot &slot = t->buckets[b].slot[s];
+		Entry e;
+		e.xid = t->keys[b * SLOTS + s];
+		e.port = slot.port;
+		e.flags = slot.flags;
+		e.nexthop = index[slot.nexthop];
+		routes.push_back(e);
+	    }
+
+    release_write();
+}
+
+int
+XIDRouteMap::save(const String &filename)
+{
+#if CLICK_USERLEVEL
+    Vector<Entry> routes;
+    Entry dflt;
+    Vector<XID> nexthops;
+    copy(routes, dflt, nexthops);
+
+    String tmp = filename + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f)
+	return -errno;
+
+    SnapshotHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, snapshot_magic, sizeof(hdr.magic));
+    hdr.version = htonl(SNAPSHOT_VERSION);
+    hdr.routes = htonl(routes.size());
+    hdr.nexthops = htonl(nexthops.size());
+    hdr.default_port = htonl(dflt.port);
+    hdr.default_flags = htonl(dflt.flags);
+    hdr.default_nexthop = htonl(dflt.nexthop);
+    fwrite(&hdr, sizeof(hdr), 1, f);
+
+    for (int i = 0; i < nexthops.size(); i++)
+	fwrite(&nexthops[i].xid(), sizeof(struct click_xia_xid), 1, f);
+
+    for (int i = 0; i < routes.size(); i++) {
+	SnapshotRoute rec;
+	rec.xid = routes[i].xid.xid();
+	rec.port = htonl(routes[i].port);
+	rec.flags = htonl(routes[i].flags);
+	rec.nexthop = htonl(routes[i].nexthop);
+	fwrite(&rec, sizeof(rec), 1, f);
+    }
+
+    int r = ferror(f) ? -EIO : 0;
+    if (fclose(f) != 0 && r == 0)
+	r = -errno;
+    if (r == 0 && rename(tmp.c_str(), filename.c_str()) < 0)
+	r = -errno;
+    if (r < 0)
+	unlink(tmp.c_str());
+    return r;
+#else
+    (void) filename;
+    return -EOPNOTSUPP;
+#endif
+}
+
+int
+XIDRouteMap::load(const String &filename, int nthreads)
+{
+#if CLICK_USERLEVEL && HAVE_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+	return -errno;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+	int r = -errno;
+	close(fd);
+	return r;
+    }
+    size_t len = st.st_size;
+    if (len < sizeof(SnapshotHeader)) {
+	close(fd);
+	return -EINVAL;
+    }
+    void *data = mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+	return -errno;
+    // records are read front to back by every job
+    madvise(data, len, MADV_SEQUENTIAL);
+    int r = load_snapshot(reinterpret_cast<const unsigned char *>(data), len, nthreads);
+    munmap(data, len);
+    return r;
+#else
+    (void) filename, (void) nthreads;
+    return -EOPNOTSUPP;
+#endif
+}
+
+bool
+XIDRouteMap::place_within(Table *t, const XID &xid, uint64_t h, const Slot &slot, uint32_t end)
+{
+    // like place(), on a table no reader can see yet, but give up rather
+    // than probe into bucket @a end, which another job may be filling
+    uint32_t home = h & t->mask, b = home;
+    while (t->buckets[b].used == (1 << SLOTS) - 1)
+	if (++b == end)
+	    return false;
+    for (uint32_t i = home; i != b; i++)
+	if (t->buckets[i].overflow != OVERFLOW_SATURATED)
+	    t->buckets[i].overflow++;
+
+    Bucket &bk = t->buckets[b];
+    int s = ffs_lsb((uint32_t) (uint8_t) ~bk.used) - 1;
+    bk.slot[s] = slot;
+    bk.slot[s].fp = h >> 32;
+    t->keys[b * SLOTS + s] = xid;
+    bk.used |= 1 << s;
+    return true;
+}
+
+void *
+XIDRouteMap::load_hash(void *arg)
+{
+    LoadJob *j = reinterpret_cast<LoadJob *>(arg);
+    for (uint32_t i = j->begin; i < j->end; i++) {
+	const SnapshotRoute &rec = j->recs[i];
+	int32_t port = ntohl(rec.port);
+	uint32_t nh = ntohl(rec.nexthop);
+	if (!valid_port(port) || nh > j->nnexthops) {
+	    j->ok = false;
+	    break;
+	}
+	j->uses[nh]++;
+	j->h[i] = hash(XID(rec.xid));
+    }
+    return 0;
+}
+
+void *
+XIDRouteMap::load_place(void *arg)
+{
+    LoadJob *j = reinterpret_cast<LoadJob *>(arg);
+    for (uint32_t i = 0; i < j->nroutes; i++) {
+	uint32_t b = j->h[i] & j->t->mask;
+	if (b < j->lo || b >= j->hi)
+	    continue;
+	const SnapshotRoute &rec = j->recs[i];
+	XID xid(rec.xid);
+	// Copies of an XID share a home bucket, so this job sees them all.
+	// place_within() never overflows past hi, so neither does find().
+	int s;
+	if (find(j->t, xid, j->h[i], b, s)) {
+	    j->ok = false;
+	    break;
+	}
+	Slot slot;
+	slot.port = (int32_t) ntohl(rec.port);
+	slot.flags = ntohl(rec.flags);
+	slot.nexthop = j->nhmap[ntohl(rec.nexthop)];
+	if (!place_within(j->t, xid, j->h[i], slot, j->hi))
+	    j->spill.push_back(i);
+    }
+    return 0;
+}
+
+void
+XIDRouteMap::run_jobs(LoadJob *jobs, int n, void *(*f)(void *))
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    pthread_t tid[MAX_LOAD_THREADS];
+    bool started[MAX_LOAD_THREADS];
+    for (int i = 1; i < n; i++)
+	started[i] = pthread_create(&tid[i], 0, f, &jobs[i]) == 0;
+    f(&jobs[0]);
+    for (int i = 1; i < n; i++)
+	if (started[i])
+	    pthread_join(tid[i], 0);
+	else
+	    f(&jobs[i]);
+#else
+    for (int i = 0; i < n; i++)
+	f(&jobs[i]);
+#endif
+}
+
+int
+XIDRouteMap::load_snapshot(const unsigned char *data, size_t len, int nthreads)
+{
+    const SnapshotHeader *hdr = reinterpret_cast<const SnapshotHeader *>(data);
+    if (len < sizeof(*hdr) || memcmp(hdr->magic, snapshot_magic, sizeof(hdr->magic)) != 0
+	|| ntohl(hdr->version) != SNAPSHOT_VERSION)
+	return -EINVAL;
+    uint32_t nroutes = ntohl(hdr->routes), nnexthops = ntohl(hdr->nexthops);
+    uint32_t default_nh = ntohl(hdr->default_nexthop);
+    int32_t default_port = ntohl(hdr->default_port);
+    if (nroutes > MAX_SNAPSHOT_ROUTES || nnexthops > MAX_NEXTHOPS
+	|| default_nh > nnexthops || !valid_port(default_port)
+	|| len != sizeof(*hdr) + nnexthops * sizeof(struct click_xia_xid)
+		  + (uint64_t) nroutes * sizeof(SnapshotRoute))
+	return -EINVAL;
+    const struct click_xia_xid *nhs = reinterpret_cast<const struct click_xia_xid *>(hdr + 1);
+    const SnapshotRoute *recs = reinterpret_cast<const SnapshotRoute *>(nhs + nnexthops);
+
+    // the same 80% fill reserve() aims for
+    uint64_t want = ((uint64_t) nroutes * 5 / 4 + SLOTS - 1) / SLOTS;
+    uint32_t nbuckets = INITIAL_BUCKETS;
+    while (nbuckets < want)
+	nbuckets <<= 1;
+    if (nthreads < 1)
+	nthreads = 1;
+    if (nthreads > MAX_LOAD_THREADS)
+	nthreads = MAX_LOAD_THREADS;
+    if ((uint32_t) nthreads > nbuckets / INITIAL_BUCKETS)
+	nthreads = nbuckets / INITIAL_BUCKETS;
+
+    Table *t = alloc_table(nbuckets);
+    uint64_t *h = new uint64_t[nroutes ? nroutes : 1];
+    if (!t || !h) {
+	free_table(t, 0);
+	delete[] h;
+	return -ENOMEM;
+    }
+
+    // intern the next hops first, so the jobs can translate references;
+    // the references interning takes keep them alive while the lock is off
+    Vector<int> nhmap(nnexthops + 1, (int) NO_NEXTHOP);
+    int r = 0;
+    _lock.acquire();
+    for (uint32_t i = 0; i < nnexthops && r == 0; i++) {
+	XID nh(nhs[i]);
+	int index = intern(&nh);
+	if (index < 0)
+	    r = index;
+	else
+	    nhmap[i + 1] = index;
+    }
+    release_write();
+
+    // no reader or writer can see the new table yet, so build it unlocked
+    LoadJob jobs[MAX_LOAD_THREADS];
+    for (int i = 0; i < nthreads; i++) {
+	LoadJob &j = jobs[i];
+	j.t = t;
+	j.recs = recs;
+	j.h = h;
+	j.nhmap = nhmap.begin();
+	j.nroutes = nroutes;
+	j.nnexthops = nnexthops;
+	j.begin = (uint64_t) nroutes * i / nthreads;
+	j.end = (uint64_t) nroutes * (i + 1) / nthreads;
+	j.lo = (uint64_t) nbuckets * i / nthreads;
+	j.hi = (uint64_t) nbuckets * (i + 1) / nthreads;
+	j.uses.resize(nnexthops + 1, 0);
+	j.ok = true;
+    }
+
+    if (r == 0) {
+	run_jobs(jobs, nthreads, load_hash);
+	for (int i = 0; i < nthreads; i++)
+	    if (!jobs[i].ok)
+		r = -EINVAL;
+    }
+
+    if (r == 0) {
+	run_jobs(jobs, nthreads, load_place);
+	for (int i = 0; i < nthreads; i++)
+	    if (!jobs[i].ok)
+		r = -EINVAL;
+	// probe sequences that crossed into another job's buckets
+	for (int i = 0; i < nthreads && r == 0; i++)
+	    for (int k = 0; k < jobs[i].spill.size() && r == 0; k++) {
+		const SnapshotRoute &rec = recs[jobs[i].spill[k]];
+		XID xid(rec.xid);
+		uint64_t hk = h[jobs[i].spill[k]];
+		uint32_t b;
+		int s;
+		if (find(t, xid, hk, b, s)) {
+		    r = -EINVAL;
+		    break;
+		}
+		Slot slot;
+		slot.port = (int32_t) ntohl(rec.port);
+		slot.flags = ntohl(rec.flags);
+		slot.nexthop = nhmap[ntohl(rec.nexthop)];
+		place(t, xid, hk, slot);
+	    }
+    }
+
+    Table *old = 0;
+    _lock.acquire();
+    if (r == 0) {
+	for (uint32_t n = 1; n <= nnexthops; n++)
+	    for (int i = 0; i < nthreads; i++)
+		_nh_refs[nhmap[n]] += jobs[i].uses[n];
+	if (default_nh)
+	    _nh_refs[nhmap[default_nh]]++;
+
+	int old_default = _default.slot[0].nexthop;
+	write_begin(_default);
+	_default.slot[0].port = default_port;
+	_default.slot[0].flags = ntohl(hdr->default_flags);
+	_default.slot[0].nexthop = nhmap[default_nh];
+	write_end(_default);
+	release(old_default);
+
+	old = _t;
+	click_fence();
+	_t = t;
+	_size = nroutes;
+	t = 0;
+	bump_generation();
+    }
+
+    // drop the references interning took; used next hops keep theirs
+    for (uint32_t n = 1; n <= nnexthops; n++)
+	release(nhmap[n]);
+    release_write();
+
+    if (old)
+	drop_table(old);
+    free_table(t, 0);
+    delete[] h;
+    return r;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(XIAEpoch)
+ELEMENT_PROVIDES(XIDRouteMap)
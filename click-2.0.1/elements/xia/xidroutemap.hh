@@ -0,0 +1,379 @@
+#ifndef CLICK_XIDROUTEMAP_HH
+#define CLICK_XIDROUTEMAP_HH
+#include <click/glue.hh>
+#include <click/hashtable.hh>
+#include <click/sync.hh>
+#include <click/vector.hh>
+#include <click/xid.hh>
+#include "xiaepoch.hh"
+CLICK_DECLS
+
+/*
+ * XIDRouteMap -- flat open-addressing XID route storage
+ *
+ * Routes live in cache-line sized buckets.  A bucket holds up to SLOTS routes
+ * inline: a 32-bit fingerprint of the XID, the output port, the route flags
+ * and an index into an interned next-hop table.  Full XIDs are kept in a
+ * parallel key array that is only read when a fingerprint matches, so a
+ * successful lookup touches one bucket line and one key line.
+ *
+ * Collisions are resolved by linear probing over buckets.  Every bucket
+ * counts the entries that had to probe past it, so a lookup stops at the
+ * first bucket nothing has overflowed from.
+ *
+ * Concurrency: lookups never lock.  Callers bracket them with read_begin()
+ * and read_end(); results, including next-hop pointers, stay valid until
+ * read_end().  Each bucket carries a sequence number that writers make odd
+ * while they change the bucket, and readers retry a bucket whose sequence
+ * moved under them.  Writers are serialized by an internal lock, which is
+ * only ever held for table updates, never for file I/O or formatting.
+ * Growing the table builds a new bucket array and publishes it; the old
+ * array, like a released next-hop slot, is freed only after a grace period
+ * (see XIAEpoch).
+ *
+ * Snapshots: save() copies the routes under the lock and writes them to a
+ * compact binary file after releasing it.  load() maps such a file and
+ * builds a complete table from it off to the side, optionally hashing and
+ * placing routes on several threads, then takes the lock just long enough to
+ * publish it in place of the current one.  Readers see either all the old
+ * routes or all the new ones.
+ *
+ * XIDRouteMap is used by XIAXIDRouteTable; it is not an element.
+ */
+
+class XIDRouteMap { public:
+
+    enum { SLOTS = 5, NO_NEXTHOP = 0, MAX_NEXTHOPS = 65535 };
+
+    struct Route {
+	int port;
+	uint32_t flags;
+	const XID *nexthop;	// NULL if the route has no next hop
+    };
+
+    struct Entry {
+	XID xid;
+	int port;
+	uint32_t flags;
+	uint32_t nexthop;	// 1-based index into the copied next hops, or 0
+    };
+
+    XIDRouteMap();
+    ~XIDRouteMap();
+
+    /** @brief Return this map's route generation.
+     *
+     * The generation changes whenever a route changes, so a cached routing
+     * decision stamped with it can be checked for staleness later.  It is
+     * never 0.  See set_local_port() for the changes that leave it alone. */
+    uint32_t generation() const		{ return _generation; }
+    void bump_generation();
+
+    /** @brief Treat CID and SID routes to @a port as local deliveries.
+     *
+     * Replacing a route to @a port with another, or adding or removing one
+     * while the default route goes to @a port or @a fallback_port, leaves
+     * the generation alone.  Only decisions to forward a packet out a port
+     * are cached, and a cache must not hold one that fell back past a CID or
+     * SID, so no cached decision depends on these routes (see XIAFastPath). */
+    void set_local_port(int port, int fallback_port) {
+	_local_port = port;
+	_fallback_port = fallback_port;
+    }
+
+    int size() const			{ return _size; }
+    int capacity() const		{ return (_t->mask + 1) * SLOTS; }
+    int nexthop_count() const		{ return _nh_index.size(); }
+
+    inline void read_begin()		{ _epoch.read_begin(); }
+    inline void read_end()		{ _epoch.read_end(); }
+
+    inline bool lookup(const XID &xid, Route &route) const;
+    inline bool lookup_default(Route &route) const;
+    inline void prefetch(const XID &xid) const;
+
+    void acquire_write()		{ _lock.acquire(); }
+    void release_write();
+
+    /** @brief Route @a xid to @a port.  Returns -EINVAL if @a port does not
+     * fit in a route's 16 bits, and -EEXIST if @a xid has a route and
+     * @a replace is false. */
+    int insert(const XID &xid, int port, uint32_t flags, const XID *nexthop, bool replace = true);
+    int set_default(int port, uint32_t flags, const XID *nexthop);
+    int remove(const XID &xid);
+
+    /** @brief Route every XID in @a xids to @a port, bumping the generation
+     * at most once.  Returns how many routes were added or replaced. */
+    int insert(const Vector<XID> &xids, int port, uint32_t flags, const XID *nexthop, bool replace = true);
+    /** @brief Remove the routes for @a xids, bumping the generation at most
+     * once.  Returns how many there were. */
+    int remove(const Vector<XID> &xids);
+    int reserve(int n);
+    void clear();
+
+    /** @brief Copy every route into @a routes, the default route into
+     * @a dflt, and the next hops they use into @a nexthops.
+     *
+     * Writers are held off only while the routes are copied, so the copy is
+     * consistent and can be formatted or written out at leisure. */
+    void copy(Vector<Entry> &routes, Entry &dflt, Vector<XID> &nexthops);
+
+    /** @brief Write every route, and the default route, to @a filename.
+     *
+     * The file is written under a temporary name and renamed into place.
+     * Returns 0 or a negative errno.  Userlevel only. */
+    int save(const String &filename);
+
+    /** @brief Replace every route, and the default route, with the snapshot
+     * in @a filename.
+     *
+     * Up to @a nthreads threads hash and place the routes.  On error the
+     * current routes are left alone.  Returns 0 or a negative errno; -EINVAL
+     * means the file is not a valid snapshot.  Userlevel only. */
+    int load(const String &filename, int nthreads = 1);
+
+    class const_iterator;
+    inline const_iterator begin() const;
+
+  private:
+
+    struct Slot {
+	uint32_t fp;
+	int16_t port;
+	uint16_t nexthop;
+	uint32_t flags;
+    };
+
+    struct Bucket {
+	uint8_t used;		// bitmap of occupied slots
+	uint8_t overflow;	// entries that probed past this bucket (saturates)
+	volatile uint16_t seq;	// odd while a writer changes the bucket
+	Slot slot[SLOTS];
+    };
+
+    struct Table {
+	Bucket *buckets;
+	XID *keys;
+	uint32_t mask;
+	void *mem;
+    };
+
+    enum { NH_CHUNK_SHIFT = 8, NH_CHUNK = 1 << NH_CHUNK_SHIFT,
+	   NH_NCHUNKS = (MAX_NEXTHOPS + NH_CHUNK) / NH_CHUNK,
+	   INITIAL_BUCKETS = 8, OVERFLOW_SATURATED = 255 };
+
+    enum { SNAPSHOT_VERSION = 1, MAX_SNAPSHOT_ROUTES = 1 << 28,
+	   MAX_LOAD_THREADS = 16 };
+    struct SnapshotHeader;
+    struct SnapshotRoute;
+    struct LoadJob;
+
+    enum { NO_LOCAL_PORT = 0x7FFFFFFF };
+
+    volatile uint32_t _generation;
+    int _local_port;
+    int _fallback_port;
+
+    Table * volatile _t;
+    int _size;
+    Bucket _default;		// slot 0 holds the default route
+    Spinlock _lock;
+    mutable XIAEpoch _epoch;
+
+    // interned next hops; chunks never move once allocated
+    XID *_nh_chunks[NH_NCHUNKS];
+    Vector<uint32_t> _nh_refs;
+    Vector<int> _nh_free;
+    HashTable<XID, int> _nh_index;
+
+    static inline uint64_t hash(const XID &xid);
+    inline const XID *nexthop(int index) const;
+    static bool valid_port(int32_t port) {
+	return port >= -32768 && port <= 32767;
+    }
+    inline bool local(const XID &xid, int port) const;
+    inline bool local_shadow(const XID &xid, int port) const;
+    int insert_route(const XID &xid, int port, uint32_t flags, const XID *nh, bool replace, bool &bump);
+    int remove_route(const XID &xid, bool &bump);
+    static inline void write_begin(Bucket &bk);
+    static inline void write_end(Bucket &bk);
+    static bool find(const Table *t, const XID &xid, uint64_t h, uint32_t &b, int &s);
+    inline bool read_route(const Table *t, const XID &xid, uint64_t h, Route &route) const;
+
+    static Table *alloc_table(uint32_t nbuckets);
+    static void free_table(void *table, void *);
+    void place(Table *t, const XID &xid, uint64_t h, const Slot &slot);
+    int rehash(uint32_t nbuckets);
+    int intern(const XID *nexthop);
+    void release(int index);
+    static void free_nexthop(void *index, void *map);
+    void drop_table(Table *old);
+
+    int load_snapshot(const unsigned char *data, size_t len, int nthreads);
+    static bool place_within(Table *t, const XID &xid, uint64_t h, const Slot &slot, uint32_t end);
+    static void run_jobs(LoadJob *jobs, int n, void *(*f)(void *));
+    static void *load_hash(void *job);
+    static void *load_place(void *job);
+
+    XIDRouteMap(const XIDRouteMap &);
+    XIDRouteMap &operator=(const XIDRouteMap &);
+
+    friend class const_iterator;
+};
+
+/*
+ * Iteration is a writer-side operation: hold acquire_write() while an
+ * iterator is live.
+ */
+class XIDRouteMap::const_iterator { public:
+
+    operator bool() const		{ return _b <= _t->mask; }
+    const XID &key() const		{ return _t->keys[_b * SLOTS + _s]; }
+    int port() const			{ return slot().port; }
+    uint32_t flags() const		{ return slot().flags; }
+    const XID *nexthop() const		{ return _m->nexthop(slot().nexthop); }
+
+    void operator++(int) {
+	++_s;
+	advance();
+    }
+    void operator++() {
+	(*this)++;
+    }
+
+  private:
+
+    const XIDRouteMap *_m;
+    const Table *_t;
+    uint32_t _b;
+    int _s;
+
+    const_iterator(const XIDRouteMap *m)
+	: _m(m), _t(m->_t), _b(0), _s(0) {
+	advance();
+    }
+    const Slot &slot() const		{ return _t->buckets[_b].slot[_s]; }
+    void advance() {
+	for (; _b <= _t->mask; ++_b, _s = 0)
+	    for (; _s < SLOTS; ++_s)
+		if (_t->buckets[_b].used & (1 << _s))
+		    return;
+    }
+
+    friend class XIDRouteMap;
+};
+
+
+inline uint64_t
+XIDRouteMap::hash(const XID &xid)
+{
+    // XIDs are mostly cryptographic, but generated and hand-written ones are
+    // not, so mix every word of the identifier rather than picking one.
+    const uint32_t *w = reinterpret_cast<const uint32_t *>(xid.data());
+    uint64_t a = ((uint64_t) w[1] << 32) | w[2];
+    uint64_t b = ((uint64_t) w[3] << 32) | w[4];
+    uint64_t c = ((uint64_t) w[5] << 32) | w[0];
+    uint64_t h = a * 0x9E3779B97F4A7C15ULL
+	^ b * 0xC2B2AE3D27D4EB4FULL
+	^ c * 0x165667B19E3779F9ULL;
+    return h ^ (h >> 29);
+}
+
+inline const XID *
+XIDRouteMap::nexthop(int index) const
+{
+    if (index == NO_NEXTHOP)
+	return 0;
+    return &_nh_chunks[index >> NH_CHUNK_SHIFT][index & (NH_CHUNK - 1)];
+}
+
+inline bool
+XIDRouteMap::local(const XID &xid, int port) const
+{
+    uint32_t type = ntohl(xid.xid().type);
+    return port == _local_port
+	&& (type == CLICK_XIA_XID_TYPE_CID || type == CLICK_XIA_XID_TYPE_SID);
+}
+
+/* True if a local route for @a xid may appear or go away without changing
+   a cached decision: the default route would not forward it either. */
+inline bool
+XIDRouteMap::local_shadow(const XID &xid, int port) const
+{
+    int dport = _default.slot[0].port;
+    return local(xid, port)
+	&& (dport == _local_port || dport == _fallback_port);
+}
+
+inline bool
+XIDRouteMap::read_route(const Table *t, const XID &xid, uint64_t h, Route &route) const
+{
+    uint32_t fp = h >> 32;
+    uint32_t b = h & t->mask;
+    for (uint32_t n = 0; n <= t->mask; ++n) {
+	const Bucket &bk = t->buckets[b];
+	uint16_t seq;
+	bool found, more;
+	do {
+	    while ((seq = bk.seq) & 1)
+		click_compiler_fence();
+	    xia_read_barrier();
+	    found = false;
+	    for (int s = 0; s < SLOTS; ++s)
+		if ((bk.used & (1 << s)) && bk.slot[s].fp == fp
+		    && t->keys[b * SLOTS + s] == xid) {
+		    route.port = bk.slot[s].port;
+		    route.flags = bk.slot[s].flags;
+		    route.nexthop = nexthop(bk.slot[s].nexthop);
+		    found = true;
+		    break;
+		}
+	    more = bk.overflow != 0;
+	    xia_read_barrier();
+	} while (bk.seq != seq);
+	if (found)
+	    return true;
+	if (!more)
+	    return false;
+	b = (b + 1) & t->mask;
+    }
+    return false;
+}
+
+inline bool
+XIDRouteMap::lookup(const XID &xid, Route &route) const
+{
+    return read_route(_t, xid, hash(xid), route);
+}
+
+inline bool
+XIDRouteMap::lookup_default(Route &route) const
+{
+    uint16_t seq;
+    do {
+	while ((seq = _default.seq) & 1)
+	    click_compiler_fence();
+	xia_read_barrier();
+	route.port = _default.slot[0].port;
+	route.flags = _default.slot[0].flags;
+	route.nexthop = nexthop(_default.slot[0].nexthop);
+	xia_read_barrier();
+    } while (_default.seq != seq);
+    return route.port != -1;
+}
+
+inline void
+XIDRouteMap::prefetch(const XID &xid) const
+{
+    const Table *t = _t;
+    __builtin_prefetch(&t->buckets[hash(xid) & t->mask]);
+}
+
+inline XIDRouteMap::const_iterator
+XIDRouteMap::begin() const
+{
+    return const_iterator(this);
+}
+
+CLICK_ENDDECLS
+#endif
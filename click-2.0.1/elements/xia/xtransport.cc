@@ -7,16 +7,20 @@
 #include <click/packet_anno.hh>
 #include <click/packet.hh>
 #include <click/vector.hh>
+#include <click/straccum.hh>
 
 #include <click/xiacontentheader.hh>
 #include "xiatransport.hh"
 #include "xtransport.hh"
+#include "xiasha1.hh"
 #include <click/xiatransportheader.hh>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 /*
 ** FIXME:
 ** - why is xia_socket_msg in the class definition and not a local variable?
-** - implement a backoff delay on retransmits so we don't flood the connection
 ** - fix cid header size issue so we work correctly with the linux version
 ** - migrate from uisng printf and click_chatter to using the click ErrorHandler class
 ** - there are still some small memory leaks happening when stream sockets are created/used/closed
@@ -27,6 +31,8 @@
 
 CLICK_DECLS
 
+const XIARouteData XTRANSPORT::localRoute = { DESTINED_FOR_LOCALHOST, 0, 0 };
+
 XTRANSPORT::XTRANSPORT()
 	: _timer(this)
 {
@@ -36,6 +42,18 @@ XTRANSPORT::XTRANSPORT()
 
 	_ackdelay_ms = ACK_DELAY;
 	_teardown_wait_ms = TEARDOWN_DELAY;
+	_congestion = XIACongestionControl::NEWRENO;
+	_addr_version = 1;
+
+	TransportHeaderEncap *thdr = TransportHeaderEncap::MakeDATAHeader(0, 0, 0);
+	_data_thdr = String(reinterpret_cast<const char *>(thdr->hdr()), thdr->hlen());
+	TransportHeader data_thdr(thdr->hdr());
+	_data_seq_offset = data_thdr.value(TransportHeader::SEQ_NUM) - reinterpret_cast<const uint8_t *>(thdr->hdr());
+	_data_ack_offset = data_thdr.value(TransportHeader::ACK_NUM) - reinterpret_cast<const uint8_t *>(thdr->hdr());
+	delete thdr;
+	thdr = TransportHeaderEncap::MakeDGRAMHeader(0);
+	_dgram_thdr = String(reinterpret_cast<const char *>(thdr->hdr()), thdr->hlen());
+	delete thdr;
 
 //	pthread_mutexattr_init(&_lock_attr);
 //	pthread_mutexattr_settype(&_lock_attr, PTHREAD_MUTEX_RECURSIVE);
@@ -52,6 +70,7 @@ XTRANSPORT::configure(Vector<String> &conf, ErrorHandler *errh)
 	XID local_4id;
 	Element* routing_table_elem;
 	bool is_dual_stack_router;
+	String congestion;
 	_is_dual_stack_router = false;
 
 	if (cp_va_kparse(conf, this, errh,
@@ -59,9 +78,13 @@ XTRANSPORT::configure(Vector<String> &conf, ErrorHandler *errh)
 					 "LOCAL_4ID", cpkP + cpkM, cpXID, &local_4id,
 					 "ROUTETABLENAME", cpkP + cpkM, cpElement, &routing_table_elem,
 					 "IS_DUAL_STACK_ROUTER", 0, cpBool, &is_dual_stack_router,
+					 "CONGESTION", 0, cpWord, &congestion,
 					 cpEnd) < 0)
 		return -1;
 
+	if (congestion && !XIACongestionControl::parse(congestion, _congestion))
+		return errh->error("CONGESTION must be newreno or cubic");
+
 	_local_addr = local_addr;
 	_local_hid = local_addr.xid(local_addr.destination_node());
 	_local_4id = local_4id;
@@ -96,16 +119,15 @@ XTRANSPORT::configure(Vector<String> &conf, ErrorHandler *errh)
 
 XTRANSPORT::~XTRANSPORT()
 {
+	for (HashTable<unsigned short, uint32_t>::const_iterator it = _conns.ports().begin(); it != _conns.ports().end(); ++it)
+		if (DAGinfo *daginfo = _conns.get(it->second))
+			delete daginfo->cc;
+
 	//Clear all hashtable entries
-	XIDtoPort.clear();
 	XIDtoPushPort.clear();
-	portToDAGinfo.clear();
-	XIDpairToPort.clear();
 	XIDpairToConnectPending.clear();
 
-	hlim.clear();
 	xcmp_listeners.clear();
-	nxt_xport.clear();
 
 //	pthread_mutex_destroy(&_lock);
 //	pthread_mutexattr_destroy(&_lock_attr);
@@ -133,6 +155,37 @@ char *XTRANSPORT::random_xid(const char *type, char *buf)
 	return buf;
 }
 
+/*
+** Give _sport a new DAGinfo, in place of any it had.
+*/
+XTRANSPORT::DAGinfo *XTRANSPORT::new_daginfo(unsigned short _sport)
+{
+	_conns.free(_conns.port_handle(_sport));
+
+	uint32_t h;
+	DAGinfo *daginfo = _conns.alloc(h);
+	daginfo->handle = h;
+	daginfo->port = _sport;
+	_conns.set_port(_sport, h);
+	return daginfo;
+}
+
+void
+XTRANSPORT::set_timer(unsigned short port, TimerKind kind, const Timestamp &when, const XID &cid)
+{
+	uint64_t now = Timestamp::now().msecval();
+	uint64_t tick = (when.usecval() + 999) / 1000;
+	_timers.schedule(TimerKey(port, kind, cid), now, tick > now ? tick - now : 0);
+
+	Timestamp at = Timestamp::make_msec(tick);
+	if (! _timer.scheduled() || _timer.expiry() > at )
+		_timer.reschedule_at(at);
+}
+
+/*
+** Handle the socket timers that are due.  Each is a separate entry in
+** _timers, so this only touches the sockets with something to do.
+*/
 void
 XTRANSPORT::run_timer(Timer *timer)
 {
@@ -141,194 +194,243 @@ XTRANSPORT::run_timer(Timer *timer)
 	assert(timer == &_timer);
 
 	Timestamp now = Timestamp::now();
-	Timestamp earlist_pending_expiry = now;
+	Vector<TimerKey> expired;
+	_timers.advance(now.msecval(), expired);
 
 	WritablePacket *copy;
 
-	bool tear_down;
+	for (int i = 0; i < expired.size(); i++) {
+		unsigned short _sport = expired[i].port;
+		DAGinfo *daginfo = _conns.port(_sport);
+		if (!daginfo)
+			continue;
 
-	for (HashTable<unsigned short, DAGinfo>::iterator iter = portToDAGinfo.begin(); iter != portToDAGinfo.end(); ++iter ) {
-		unsigned short _sport = iter->first;
-		DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
-		tear_down = false;
+		switch (expired[i].kind) {
+		case SYN_TIMER:
+			if (!daginfo->synack_waiting)
+				break;
+			//click_chatter("Timer: synack waiting\n");
 
-		// check if pending
-		if (daginfo->timer_on == true) {
-			// check if synack waiting
-			if (daginfo->synack_waiting == true && daginfo->expiry <= now ) {
-				//click_chatter("Timer: synack waiting\n");
-		
-				if (daginfo->num_connect_tries <= MAX_CONNECT_TRIES) {
+			if (daginfo->num_connect_tries <= MAX_CONNECT_TRIES) {
 
-					//click_chatter("Timer: SYN RETRANSMIT! \n");
-					copy = copy_packet(daginfo->syn_pkt, daginfo);
-					// retransmit syn
-					XIAHeader xiah(copy);
-					// click_chatter("Timer: (%s) send=%s  len=%d \n\n", (_local_addr.unparse()).c_str(), (char *)xiah.payload(), xiah.plen());
-					output(NETWORK_PORT).push(copy);
+				//click_chatter("Timer: SYN RETRANSMIT! \n");
+				copy = copy_packet(daginfo->syn_pkt, daginfo);
+				// retransmit syn
+				XIAHeader xiah(copy);
+				// click_chatter("Timer: (%s) send=%s  len=%d \n\n", (_local_addr.unparse()).c_str(), (char *)xiah.payload(), xiah.plen());
+				output(NETWORK_PORT).push(copy);
 
-					daginfo->timer_on = true;
-					daginfo->synack_waiting = true;
-					daginfo->expiry = now + Timestamp::make_msec(_ackdelay_ms);
-					daginfo->num_connect_tries++;
+				set_timer(_sport, SYN_TIMER, now + Timestamp::make_msec(_ackdelay_ms));
+				daginfo->num_connect_tries++;
 
-				} else {
-					// Stop sending the connection request & Report the failure to the application
-					daginfo->timer_on = false;
-					daginfo->synack_waiting = false;
-
-					String str = String("^Connection-failed^");
-					WritablePacket *ppp = WritablePacket::make (256, str.c_str(), str.length(), 0);
+			} else {
+				// Stop sending the connection request & Report the failure to the application
+				daginfo->synack_waiting = false;
 
+				String str = String("^Connection-failed^");
+				WritablePacket *ppp = WritablePacket::make (256, str.c_str(), str.length(), 0);
 
-					//_errh->debug("Timer: Sent packet to socket with port %d", _sport);
-					output(API_PORT).push(UDPIPPrep(ppp, _sport));
-				}
 
-			} else if (daginfo->dataack_waiting == true && daginfo->expiry <= now ) {
+				//_errh->debug("Timer: Sent packet to socket with port %d", _sport);
+				output(API_PORT).push(UDPIPPrep(ppp, _sport));
+			}
+			break;
 
-				// adding check to see if anything was retransmitted. We can get in here with
-				// no packets in the daginfo->sent_pkt array waiting to go and will stay here forever
-				bool retransmit_sent = false;
+		case DATA_TIMER:
+			if (!daginfo->dataack_waiting)
+				break;
 
-				if (daginfo->num_retransmit_tries < MAX_RETRANSMIT_TRIES) {
+			if (daginfo->base != daginfo->high_seqnum && daginfo->num_retransmit_tries < MAX_RETRANSMIT_TRIES) {
 
 				//click_chatter("Timer: DATA RETRANSMIT at from (%s) from_port=%d base=%d next_seq=%d \n\n", (_local_addr.unparse()).c_str(), _sport, daginfo->base, daginfo->next_seqnum );
-		
-					// retransmit data
-					for (unsigned int i = daginfo->base; i < daginfo->next_seqnum; i++) {
-						if (daginfo->sent_pkt[i % MAX_WIN_SIZE] != NULL) {
-							copy = copy_packet(daginfo->sent_pkt[i % MAX_WIN_SIZE], daginfo);
-							XIAHeader xiah(copy);
-							//click_chatter("Timer: (%s) send=%s  len=%d \n\n", (_local_addr.unparse()).c_str(), (char *)xiah.payload(), xiah.plen());
-							//click_chatter("pusing the retransmit pkt\n");
-							output(NETWORK_PORT).push(copy);
-							retransmit_sent = true;
-						}
-					}
-				} else {
-					//click_chatter("retransmit counter exceeded\n");
-					// FIXME what cleanup should happen here?
-					// should we do a NAK?
-				}
 
-				if (retransmit_sent) {
-					//click_chatter("resetting retransmit timer for %d\n", _sport);
-					daginfo->timer_on = true;
-					daginfo->dataack_waiting = true;
-					daginfo-> num_retransmit_tries++;
-					daginfo->expiry = now + Timestamp::make_msec(_ackdelay_ms);
-				} else {
-					//click_chatter("terminating retransmit timer for %d\n", _sport);
-					daginfo->timer_on = false;
-					daginfo->dataack_waiting = false;
-					daginfo->num_retransmit_tries = 0;
-				}
+				// go back to the oldest unacked packet; the congestion
+				// window (now one packet) decides how fast we resend
+				daginfo->cc->timeout(daginfo->base, daginfo->high_seqnum, now);
+				daginfo->next_seqnum = daginfo->base;
+				daginfo->rexmit_next = daginfo->base;
+				// the receiver may have dropped what it SACKed
+				// (RFC 2018 section 8), so resend it all
+				memset(daginfo->sacked, 0, sizeof(daginfo->sacked));
+				daginfo->sack_high = daginfo->base;
+				daginfo->pipe = 0;
+				daginfo->num_retransmit_tries++;
+				set_timer(_sport, DATA_TIMER, now + daginfo->cc->rto());
+				TransmitPending(daginfo);
 
-			} else if (daginfo->teardown_waiting == true && daginfo->teardown_expiry <= now) {
-				tear_down = true;
-				daginfo->timer_on = false;
-				portToActive.set(_sport, false);
-
-				//XID source_xid = portToDAGinfo.get(_sport).xid;
-
-				// this check for -1 prevents a segfault cause by bad XIDs
-				// it may happen in other cases, but opening a XSOCK_STREAM socket, calling
-				// XreadLocalHostAddr and then closing the socket without doing anything else will
-				// cause the problem
-				// TODO: make sure that -1 is the only condition that will cause us to get a bad XID
-				if (daginfo->src_path.destination_node() != -1) {
-					XID source_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
-					if (!daginfo->isAcceptSocket) {
-
-						//click_chatter("deleting route %s from port %d\n", source_xid.unparse().c_str(), _sport);
-						delRoute(source_xid);
-						XIDtoPort.erase(source_xid);
-					}
+			} else {
+				// nothing is outstanding, or the retransmit counter was exceeded
+				// FIXME what cleanup should happen in the second case?
+				// should we do a NAK?
+				//click_chatter("terminating retransmit timer for %d\n", _sport);
+				daginfo->dataack_waiting = false;
+				daginfo->num_retransmit_tries = 0;
+			}
+			break;
+
+		case ACK_TIMER:
+			// send the ACK a receiver held back
+			if (daginfo->ack_pending)
+				SendACK(daginfo);
+			break;
+
+		case TEARDOWN_TIMER:
+			if (!daginfo->teardown_waiting)
+				break;
+
+			// this check for -1 prevents a segfault cause by bad XIDs
+			// it may happen in other cases, but opening a XSOCK_STREAM socket, calling
+			// XreadLocalHostAddr and then closing the socket without doing anything else will
+			// cause the problem
+			// TODO: make sure that -1 is the only condition that will cause us to get a bad XID
+			if (daginfo->src_path.destination_node() != -1) {
+				XID source_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
+				if (!daginfo->isAcceptSocket) {
+
+					//click_chatter("deleting route %s from port %d\n", source_xid.unparse().c_str(), _sport);
+					delRoute(source_xid);
 				}
+			}
 
-				portToDAGinfo.erase(_sport);
-				portToActive.erase(_sport);
-				hlim.erase(_sport);
-
-				nxt_xport.erase(_sport);
-				xcmp_listeners.remove(_sport);
-				for (int i = 0; i < MAX_WIN_SIZE; i++) {
-					if (daginfo->sent_pkt[i] != NULL) {
-						daginfo->sent_pkt[i]->kill();
-						daginfo->sent_pkt[i] = NULL;
-					}
+			for (int i = 0; i < MAX_WIN_SIZE; i++) {
+				if (daginfo->sent_pkt[i] != NULL) {
+					daginfo->sent_pkt[i]->kill();
+					daginfo->sent_pkt[i] = NULL;
 				}
 			}
-		}
-
-		if (tear_down == false) {
-
-			// find the (next) earlist expiry
-			if (daginfo->timer_on == true && daginfo->expiry > now && ( daginfo->expiry < earlist_pending_expiry || earlist_pending_expiry == now ) ) {
-				earlist_pending_expiry = daginfo->expiry;
+			while (WritablePacket *p = daginfo->send_head) {
+				daginfo->send_head = static_cast<WritablePacket *>(p->next());
+				p->kill();
 			}
-			if (daginfo->timer_on == true && daginfo->teardown_expiry > now && ( daginfo->teardown_expiry < earlist_pending_expiry || earlist_pending_expiry == now ) ) {
-				earlist_pending_expiry = daginfo->teardown_expiry;
+			for (int i = 0; i < MAX_WIN_SIZE; i++) {
+				if (daginfo->recv_pkt[i] != NULL) {
+					daginfo->recv_pkt[i]->kill();
+					daginfo->recv_pkt[i] = NULL;
+				}
 			}
+			delete daginfo->cc;
 
+			// a socket reusing the port must not inherit the timers
+			cancel_timer(_sport, SYN_TIMER);
+			cancel_timer(_sport, DATA_TIMER);
+			cancel_timer(_sport, ACK_TIMER);
+			for (HashTable<XID, WritablePacket*>::iterator it = daginfo->XIDtoCIDreqPkt.begin(); it != daginfo->XIDtoCIDreqPkt.end(); ++it)
+				cancel_timer(_sport, CID_TIMER, it->first);
 
-			// check for CID request cases
-			for (HashTable<XID, bool>::iterator it = daginfo->XIDtoTimerOn.begin(); it != daginfo->XIDtoTimerOn.end(); ++it ) {
-				XID requested_cid = it->first;
-				bool timer_on = it->second;
-
-				HashTable<XID, Timestamp>::iterator it2;
-				it2 = daginfo->XIDtoExpiryTime.find(requested_cid);
-				Timestamp cid_req_expiry = it2->second;
-
-				if (timer_on == true && cid_req_expiry <= now) {
-					//click_chatter("CID-REQ RETRANSMIT! \n");
-					//retransmit cid-request
-					HashTable<XID, WritablePacket*>::iterator it3;
-					it3 = daginfo->XIDtoCIDreqPkt.find(requested_cid);
-					copy = copy_cid_req_packet(it3->second, daginfo);
-					XIAHeader xiah(copy);
-					//click_chatter("\n\n (%s) send=%s  len=%d \n\n", (_local_addr.unparse()).c_str(), (char *)xiah.payload(), xiah.plen());
-					output(NETWORK_PORT).push(copy);
-
-					cid_req_expiry  = Timestamp::now() + Timestamp::make_msec(_ackdelay_ms);
-					daginfo->XIDtoExpiryTime.set(requested_cid, cid_req_expiry);
-					daginfo->XIDtoTimerOn.set(requested_cid, true);
-				}
-
-				if (timer_on == true && cid_req_expiry > now && ( cid_req_expiry < earlist_pending_expiry || earlist_pending_expiry == now ) ) {
-					earlist_pending_expiry = cid_req_expiry;
-				}
-			}
+			xcmp_listeners.remove(_sport);
 
-			portToDAGinfo.set(_sport, *daginfo);
+			// packets for its XIDs find nothing from now on
+			_conns.erase_port(_sport);
+			_conns.free(daginfo->handle);
+			break;
+
+		case CID_TIMER: {
+			HashTable<XID, WritablePacket*>::iterator it = daginfo->XIDtoCIDreqPkt.find(expired[i].cid);
+			if (it == daginfo->XIDtoCIDreqPkt.end())
+				break;
+
+			//click_chatter("CID-REQ RETRANSMIT! \n");
+			//retransmit cid-request
+			copy = copy_cid_req_packet(it->second, daginfo);
+			XIAHeader xiah(copy);
+			//click_chatter("\n\n (%s) send=%s  len=%d \n\n", (_local_addr.unparse()).c_str(), (char *)xiah.payload(), xiah.plen());
+			output(NETWORK_PORT).push(copy);
+
+			set_timer(_sport, CID_TIMER, now + Timestamp::make_msec(_ackdelay_ms), expired[i].cid);
+			break;
+		}
 		}
 	}
 
 	// Set the next timer
-	if (earlist_pending_expiry > now) {
-		_timer.reschedule_at(earlist_pending_expiry);
-	}
+	uint64_t next = _timers.next_tick();
+	if (next != XIAExpiryWheel<TimerKey>::NEVER)
+		_timer.reschedule_at(Timestamp::make_msec(next));
 
 //	pthread_mutex_unlock(&_lock);
 }
 
-void
-XTRANSPORT::copy_common(DAGinfo *daginfo, XIAHeader &xiahdr, XIAHeaderEncap &xiah) {  
+/*
+** Make the source DAG of daginfo _local_addr:XID, where XID is its last
+** node, if _local_addr changed since the last call (Client Mobility) or the
+** socket was bound to just an SID.  Returns true if src_path changed.
+*/
+bool XTRANSPORT::refresh_src_path(DAGinfo *daginfo)
+{
+	if (daginfo->src_version == _addr_version && daginfo->full_src_dag)
+		return false;
+	daginfo->src_version = _addr_version;
+	daginfo->full_src_dag = true;
+	if (!daginfo->src_path.is_valid())
+		return false;
 
-	//Recalculate source path
-	XID	source_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
-	String str_local_addr = _local_addr.unparse_re() + " " + source_xid.unparse();
-	//Make source DAG _local_addr:SID
-	String dagstr = daginfo->src_path.unparse_re();
+	XID source_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
+	daginfo->src_path.parse_re(_local_addr.unparse_re() + " " + source_xid.unparse());
+	daginfo->tmpl_valid = false;
+	return true;
+}
 
-	//Client Mobility...
-	if (dagstr.length() != 0 && dagstr != str_local_addr) {
-		//Moved!
-		// 1. Update 'daginfo->src_path'
-		daginfo->src_path.parse_re(str_local_addr);
+/*
+** Return the XIA header of the stream on daginfo's DATA and ACK packets,
+** rebuilding it first if its source or destination DAG or its hop limit
+** changed.  Otherwise no DAG is parsed or unparsed.
+*/
+const XIAHeaderEncap &XTRANSPORT::stream_header(DAGinfo *daginfo)
+{
+	refresh_src_path(daginfo);
+	if (!daginfo->tmpl_valid || daginfo->tmpl_ddag.length()) {
+		daginfo->tmpl_ddag = String();
+		daginfo->tmpl.set_nxt(CLICK_XIA_NXT_TRN);
+		daginfo->tmpl.set_last(LAST_NODE_DEFAULT);
+		daginfo->tmpl.set_hlim(daginfo->hlim);
+		daginfo->tmpl.set_dst_path(daginfo->dst_path);
+		daginfo->tmpl.set_src_path(daginfo->src_path);
+		daginfo->tmpl_valid = true;
+		_errh->debug("XSEND: (%d) sending to %s, from %s\n", daginfo->port, daginfo->dst_path.unparse_re().c_str(), daginfo->src_path.unparse_re().c_str());
 	}
+	return daginfo->tmpl;
+}
+
+/*
+** Build DATA packet seq of the stream on daginfo, carrying len bytes of
+** data: copies of its XIA header and the DATA transport header, with the
+** sequence numbers and payload length filled in.
+*/
+WritablePacket *XTRANSPORT::stream_packet(DAGinfo *daginfo, const void *data, uint32_t len, uint32_t seq, uint32_t ack)
+{
+	const XIAHeaderEncap &xiah = stream_header(daginfo);
+
+	WritablePacket *p = WritablePacket::make(256, data, len, 20);
+	p = p->push(_data_thdr.length());
+	memcpy(p->data(), _data_thdr.data(), _data_thdr.length());
+	memcpy(p->data() + _data_seq_offset, &seq, sizeof(seq));
+	memcpy(p->data() + _data_ack_offset, &ack, sizeof(ack));
+	SET_XIA_PAYLOAD_OFFSET_ANNO(p, 0);
+
+	return xiah.encap(p, true);
+}
+
+/*
+** Follow the peer of the stream on daginfo if xiah, a packet from it, came
+** from a new DAG (Client Mobility).  While the peer stays put its DAG is
+** only compared, node for node, with the destination in daginfo->tmpl.
+*/
+void XTRANSPORT::update_peer(DAGinfo *daginfo, const XIAHeader &xiah)
+{
+	const click_xia *h = xiah.hdr();
+	const click_xia *t = daginfo->tmpl.hdr();
+	if (daginfo->tmpl_valid && h->snode == t->dnode
+		&& memcmp(h->node + h->dnode, t->node, t->dnode * sizeof(click_xia_xid_node)) == 0)
+		return;
+
+	daginfo->dst_path = xiah.src_path();
+	daginfo->tmpl_valid = false;
+}
+
+void
+XTRANSPORT::copy_common(DAGinfo *daginfo, XIAHeader &xiahdr, XIAHeaderEncap &xiah) {  
+
+	refresh_src_path(daginfo);
 
 	xiah.set_nxt(xiahdr.nxt());
 	xiah.set_last(xiahdr.last());
@@ -342,10 +444,14 @@ WritablePacket *
 XTRANSPORT::copy_packet(Packet *p, DAGinfo *daginfo) {  
 
 	XIAHeader xiahdr(p);
+	TransportHeader thdr(p);
+
+	if (thdr.pkt_info() == TransportHeader::DATA)
+		return stream_packet(daginfo, thdr.payload(), xiahdr.plen() - thdr.hlen(), thdr.seq_num(), thdr.ack_num());
+
 	XIAHeaderEncap xiah;
 	copy_common(daginfo, xiahdr, xiah);
 
-	TransportHeader thdr(p);
 	TransportHeaderEncap *new_thdr = new TransportHeaderEncap(thdr.type(), thdr.pkt_info(), thdr.seq_num(), thdr.ack_num(), thdr.length());
 
 	WritablePacket *copy = WritablePacket::make(256, thdr.payload(), xiahdr.plen() - thdr.hlen(), 20);
@@ -473,6 +579,9 @@ void XTRANSPORT::ProcessAPIPacket(WritablePacket *p_in)
 	case xia::XPUTCHUNK:
 		XputChunk(_sport);
 		break;
+	case xia::XPUTCHUNKS:
+		XputChunks(_sport);
+		break;
 	case xia::XGETPEERNAME:
 		Xgetpeername(_sport);
 		break;
@@ -500,20 +609,24 @@ void XTRANSPORT::ProcessNetworkPacket(WritablePacket *p_in)
 
 
 	//Extract the SID/CID
-	XIAHeader xiah(p_in->xia_header());
-	XIAPath dst_path = xiah.dst_path();
+	XIAHeader xiah(p_in);
 	XID _destination_xid(xiah.hdr()->node[xiah.last()].xid);
 	//TODO:In case of stream use source AND destination XID to find port, if not found use source. No TCP like protocol exists though
 	//TODO:pass dag back to recvfrom. But what format?
 
-	XIAPath src_path = xiah.src_path();
-	XID	_source_xid = src_path.xid(src_path.destination_node());
+	// full XIAPaths are only built below where a reply or connection needs them
+	XIAPathView src_view = xiah.src_path_view();
+	XID	_source_xid = src_view.xid(src_view.destination_node());
 	
 // 	click_chatter("NetworkPacket, Src: %s, Dest: %s", xiah.dst_path().unparse().c_str(), xiah.src_path().unparse().c_str());
 
-	unsigned short _dport = XIDtoPort.get(_destination_xid);  // This is to be updated for the XSOCK_STREAM type connections below
+	// the socket bound to the destination; this is to be updated for the XSOCK_STREAM type connections below
+	DAGinfo *daginfo = _conns.lookup(_destination_xid, XID());
+	unsigned short _dport = daginfo ? daginfo->port : 0;
 
 	bool sendToApplication = true;
+	Vector<Packet *> ready;	// stream packets that were waiting for this one
+	DAGinfo *ack_daginfo = NULL;	// stream to ACK once the data is delivered
 	//String pld((char *)xiah.payload(), xiah.plen());
 	//click_chatter("\n\n 1. (%s) Received=%s  len=%d \n\n", (_local_addr.unparse()).c_str(), pld.c_str(), xiah.plen());
 
@@ -556,6 +669,8 @@ void XTRANSPORT::ProcessNetworkPacket(WritablePacket *p_in)
 		if (thdr.pkt_info() == TransportHeader::SYN) {
 			//click_chatter("syn dport = %d\n", _dport);
 			// Connection request from client...
+			XIAPath dst_path = xiah.dst_path();
+			XIAPath src_path = xiah.src_path();
 
 			// First, check if this request is already in the pending queue
 			XIDpair xid_pair;
@@ -579,28 +694,26 @@ void XTRANSPORT::ProcessNetworkPacket(WritablePacket *p_in)
 				//	   3. Notify the api of SYN reception
 
 				//1. Prepare new DAGinfo for this connection
-				DAGinfo daginfo;
-				daginfo.port = -1; // just for now. This will be updated via Xaccept call
+				uint32_t h;
+				DAGinfo *pending = _conns.alloc(h);
+				pending->handle = h;
+				pending->port = -1; // just for now. This will be updated via Xaccept call
 
-				daginfo.sock_type = 0; // 0: Reliable transport, 1: Unreliable transport
+				pending->sock_type = 0; // 0: Reliable transport, 1: Unreliable transport
 
-				daginfo.dst_path = src_path;
-				daginfo.src_path = dst_path;
-				daginfo.isConnected = true;
-				daginfo.initialized = true;
-				daginfo.nxt = LAST_NODE_DEFAULT;
-				daginfo.last = LAST_NODE_DEFAULT;
-				daginfo.hlim = HLIM_DEFAULT;
-				daginfo.seq_num = 0;
-				daginfo.ack_num = 0;
+				pending->dst_path = src_path;
+				pending->src_path = dst_path;
+				pending->isConnected = true;
+				pending->initialized = true;
+				pending->last = LAST_NODE_DEFAULT;
+				pending->seq_num = 0;
+				pending->ack_num = 0;
 
-				pending_connection_buf.push(daginfo);
+				pending_connection_buf.push(h);
 
 				// Mark these src & dst XID pair
 				XIDpairToConnectPending.set(xid_pair, true);
 
-				//portToDAGinfo.set(-1, daginfo);	// just for now. This will be updated via Xaccept call
-
 			} else {
 				// If already in the pending queue, just send back SYNACK to the requester
 			
@@ -647,88 +760,75 @@ void XTRANSPORT::ProcessNetworkPacket(WritablePacket *p_in)
 			//   Done below (via port#5005)
 
 		} else if (thdr.pkt_info() == TransportHeader::SYNACK) {
-			XIDpair xid_pair;
-			xid_pair.set_src(_destination_xid);
-			xid_pair.set_dst(_source_xid);
+			// Get the connection from both XIDs
+			daginfo = _conns.lookup(_destination_xid, _source_xid);
+			_dport = daginfo ? daginfo->port : 0;
 
-			// Get the dst port from XIDpair table
-			_dport = XIDpairToPort.get(xid_pair);
+			if (!daginfo) {
+				sendToApplication = false;
 
-			DAGinfo *daginfo = portToDAGinfo.get_pointer(_dport);
+			} else {
+				if(!daginfo->synack_waiting) {
+					// Fix for synack storm sending messages up to the API
+					// still need to fix the root cause, but this prevents the API from 
+					// getting multiple connection granted messages
+					sendToApplication = false;
+				}
 
-			if(!daginfo->synack_waiting) {
-				// Fix for synack storm sending messages up to the API
-				// still need to fix the root cause, but this prevents the API from 
-				// getting multiple connection granted messages
-				sendToApplication = false;
+				// Clear timer
+				daginfo->synack_waiting = false;
+				cancel_timer(_dport, SYN_TIMER);
 			}
 
-			// Clear timer
-			daginfo->timer_on = false;
-			daginfo->synack_waiting = false;
-			//daginfo->expiry = Timestamp::now() + Timestamp::make_msec(_ackdelay_ms);
-
 		} else if (thdr.pkt_info() == TransportHeader::DATA) {
-			XIDpair xid_pair;
-			xid_pair.set_src(_destination_xid);
-			xid_pair.set_dst(_source_xid);
-
-			// Get the dst port from XIDpair table
-			_dport = XIDpairToPort.get(xid_pair);
+			// Get the connection from both XIDs
+			daginfo = _conns.lookup(_destination_xid, _source_xid);
+			_dport = daginfo ? daginfo->port : 0;
 
 			//click_chatter("(%s) my_sport=%d  my_sid=%s  his_sid=%s\n", (_local_addr.unparse()).c_str(),  _dport,  _destination_xid.unparse().c_str(), _source_xid.unparse().c_str());
-			HashTable<unsigned short, bool>::iterator it1;
-			it1 = portToActive.find(_dport);
+			if (daginfo) {
+				uint32_t seq = thdr.seq_num();
+				bool ack_now = true;
 
-			if(it1 != portToActive.end() ) {
-
-				DAGinfo *daginfo = portToDAGinfo.get_pointer(_dport);
-
-				if (thdr.seq_num() == daginfo->expected_seqnum) {
+				if (seq == daginfo->expected_seqnum) {
 					daginfo->expected_seqnum++;
 					//click_chatter("(%s) Accept Received data (now expected seq=%d)\n", (_local_addr.unparse()).c_str(), daginfo->expected_seqnum);
-				} else {
-					sendToApplication = false;
-					click_chatter("expected sequence # %d, received %d\n", daginfo->expected_seqnum, thdr.seq_num());
-					click_chatter("(%s) Discarded Received data\n", (_local_addr.unparse()).c_str());
-				}
-
-				portToDAGinfo.set(_dport, *daginfo);
-			
-				//In case of Client Mobility...	 Update 'daginfo->dst_path'
-				daginfo->dst_path = src_path;		
-
-				// send the cumulative ACK to the sender
-				//Add XIA headers
-				XIAHeaderEncap xiah_new;
-				xiah_new.set_nxt(CLICK_XIA_NXT_TRN);
-				xiah_new.set_last(LAST_NODE_DEFAULT);
-				xiah_new.set_hlim(HLIM_DEFAULT);
-				xiah_new.set_dst_path(src_path);
-				xiah_new.set_src_path(dst_path);
-
-				const char* dummy = "cumulative_ACK";
-				WritablePacket *just_payload_part = WritablePacket::make(256, dummy, strlen(dummy), 0);
 
-				WritablePacket *p = NULL;
-
-				xiah_new.set_plen(strlen(dummy));
-				//click_chatter("Sent packet to network");
+					// the packets it was holding up follow it to the application
+					while (Packet *q = daginfo->recv_pkt[daginfo->expected_seqnum % MAX_WIN_SIZE]) {
+						daginfo->recv_pkt[daginfo->expected_seqnum % MAX_WIN_SIZE] = NULL;
+						ready.push_back(q);
+						daginfo->expected_seqnum++;
+					}
 
-				TransportHeaderEncap *thdr_new = TransportHeaderEncap::MakeACKHeader( 0, daginfo->expected_seqnum, 0); // #seq, #ack, length
-				p = thdr_new->encap(just_payload_part);
+					// ACK every second packet, unless a hole was just filled
+					// or is still open
+					if (ready.empty() && daginfo->recv_high <= daginfo->expected_seqnum)
+						ack_now = ++daginfo->unacked >= 2;
 
-				thdr_new->update();
-				xiah_new.set_plen(strlen(dummy) + thdr_new->hlen()); // XIA payload = transport header + transport-layer data
+				} else if (seq > daginfo->expected_seqnum && seq - daginfo->expected_seqnum < MAX_WIN_SIZE) {
+					// hold it until the packets before it arrive
+					sendToApplication = false;
+					if (!daginfo->recv_pkt[seq % MAX_WIN_SIZE])
+						daginfo->recv_pkt[seq % MAX_WIN_SIZE] = p_in->clone();
+					if (seq >= daginfo->recv_high)
+						daginfo->recv_high = seq + 1;
+					daginfo->recv_last = seq;
 
-				p = xiah_new.encap(p, false);
-				delete thdr_new;
+				} else {
+					// a duplicate, or too far ahead to hold
+					sendToApplication = false;
+				}
 
-				XIAHeader xiah1(p);
-				String pld((char *)xiah1.payload(), xiah1.plen());
-				//click_chatter("\n\n (%s) send=%s  len=%d \n\n", (_local_addr.unparse()).c_str(), pld.c_str(), xiah1.plen());
+				//In case of Client Mobility...	 Update 'daginfo->dst_path'
+				update_peer(daginfo, xiah);
 
-				output(NETWORK_PORT).push(p);
+				if (ack_now)
+					ack_daginfo = daginfo;
+				else if (!daginfo->ack_pending) {
+					daginfo->ack_pending = true;
+					set_timer(_dport, ACK_TIMER, Timestamp::now() + Timestamp::make_msec(DELAYED_ACK_DELAY));
+				}
 
 			} else {
 				click_chatter("destination port not found: %d\n", _dport);
@@ -738,62 +838,102 @@ void XTRANSPORT::ProcessNetworkPacket(WritablePacket *p_in)
 		} else if (thdr.pkt_info() == TransportHeader::ACK) {
 			sendToApplication = false;
 
-			XIDpair xid_pair;
-			xid_pair.set_src(_destination_xid);
-			xid_pair.set_dst(_source_xid);
-
-			// Get the dst port from XIDpair table
-			_dport = XIDpairToPort.get(xid_pair);
+			// Get the connection from both XIDs
+			daginfo = _conns.lookup(_destination_xid, _source_xid);
+			_dport = daginfo ? daginfo->port : 0;
 
-			HashTable<unsigned short, bool>::iterator it1;
-			it1 = portToActive.find(_dport);
-
-			if(it1 != portToActive.end() ) {
-				DAGinfo *daginfo = portToDAGinfo.get_pointer(_dport);
-			
+			if (daginfo) {
 				//In case of Client Mobility...	 Update 'daginfo->dst_path'
-				daginfo->dst_path = src_path;					
+				update_peer(daginfo, xiah);
+
+				uint32_t ack = thdr.ack_num();
+
+				// ignore stale ACKs, and ACKs for data we never sent
+				if (daginfo->cc && ack >= daginfo->base && ack <= daginfo->high_seqnum) {
+					Timestamp now = Timestamp::now();
+
+					bool recovering = daginfo->cc->recovering();
+
+					// note what the receiver holds beyond the ACK; SACKed
+					// packets leave the pipe, and so do the holes below
+					// them in fast recovery
+					for (int i = 0; i < thdr.sack_blocks(); i++) {
+						uint32_t left = thdr.sack_left(i) > ack ? thdr.sack_left(i) : ack;
+						uint32_t right = thdr.sack_right(i) < daginfo->high_seqnum ? thdr.sack_right(i) : daginfo->high_seqnum;
+						for (uint32_t seq = left; seq < right; seq++)
+							if (!daginfo->is_sacked(seq)) {
+								if (seq < daginfo->next_seqnum && daginfo->in_pipe(seq))
+									daginfo->pipe--;
+								daginfo->set_sacked(seq, true);
+							}
+						for (uint32_t seq = daginfo->sack_high; seq < right; seq++)
+							if (seq >= daginfo->base && seq < daginfo->next_seqnum && daginfo->in_pipe(seq)
+								&& recovering && seq >= daginfo->rexmit_next)
+								daginfo->pipe--;
+						if (right > daginfo->sack_high)
+							daginfo->sack_high = right;
+					}
 
-				int expected_seqnum = thdr.ack_num();
+					XIACongestionControl::Action action = daginfo->cc->ack(ack, daginfo->base, daginfo->high_seqnum, now);
+
+					if (ack > daginfo->base) {
+						// Clear all Acked packets
+						for (uint32_t i = daginfo->base; i < ack; i++) {
+							int idx = i % MAX_WIN_SIZE;
+							if (i < daginfo->next_seqnum && daginfo->in_pipe(i))
+								daginfo->pipe--;
+							if (daginfo->sent_pkt[idx]) {
+								daginfo->sent_pkt[idx]->kill();
+								daginfo->sent_pkt[idx] = NULL;
+							}
+							daginfo->set_sacked(i, false);
+						}
 
-				bool resetTimer = false;
+						// Update the variables
+						daginfo->base = ack;
+						if (daginfo->next_seqnum < ack)
+							daginfo->next_seqnum = ack;
+						if (daginfo->sack_high < ack)
+							daginfo->sack_high = ack;
+						daginfo->num_retransmit_tries = 0;
 
-				// Clear all Acked packets
-				for (int i = daginfo->base; i < expected_seqnum; i++) {
-					int idx = i % MAX_WIN_SIZE;
-					if (daginfo->sent_pkt[idx]) {
-						daginfo->sent_pkt[idx]->kill();
-						daginfo->sent_pkt[idx] = NULL;
+						// Reset timer
+						if (daginfo->base == daginfo->high_seqnum && !daginfo->send_head) {
+							// Clear timer
+							daginfo->dataack_waiting = false;
+							cancel_timer(_dport, DATA_TIMER);
+						} else {
+							daginfo->dataack_waiting = true;
+							set_timer(_dport, DATA_TIMER, now + daginfo->cc->rto());
+						}
 					}
-				
-					resetTimer = true;
-				}
-
-				// Update the variables
-				daginfo->base = expected_seqnum;
 
-				// Reset timer
-				if (resetTimer) {
-					daginfo->timer_on = true;
-					daginfo->dataack_waiting = true;
-					// FIXME: should we reset retransmit_tries here?
-					daginfo->expiry = Timestamp::now() + Timestamp::make_msec(_ackdelay_ms);
-
-					if (! _timer.scheduled() || _timer.expiry() >= daginfo->expiry )
-						_timer.reschedule_at(daginfo->expiry);
+					if (action == XIACongestionControl::RETRANSMIT) {
+						// fast retransmit, or a partial ACK in fast recovery:
+						// resend the oldest packet now, whatever the window,
+						// unless it was already resent in this recovery
+						if (daginfo->rexmit_next < ack)
+							daginfo->rexmit_next = ack;
+						if (daginfo->rexmit_next == ack && daginfo->sent_pkt[ack % MAX_WIN_SIZE]) {
+							daginfo->cc->retransmitted();
+							// a hole presumed lost is back in the pipe
+							bool lost = ack < daginfo->next_seqnum && !daginfo->in_pipe(ack);
+							daginfo->rexmit_next = ack + 1;
+							if (lost && daginfo->in_pipe(ack))
+								daginfo->pipe++;
+							output(NETWORK_PORT).push(copy_packet(daginfo->sent_pkt[ack % MAX_WIN_SIZE], daginfo));
+						}
+					}
 
-					if (daginfo->base == daginfo->next_seqnum) {
+					// entering or leaving fast recovery changes which
+					// holes count as lost
+					if (daginfo->cc->recovering() != recovering)
+						daginfo->count_pipe();
 
-						// Clear timer
-						daginfo->timer_on = false;
-						daginfo->dataack_waiting = false;
-						daginfo->num_retransmit_tries = 0;
-						//daginfo->expiry = Timestamp::now() + Timestamp::make_msec(_ackdelay_ms);
-					}
+					// the ACK may have opened the window, or shown more holes
+					TransmitPending(daginfo);
 				}
 
-				portToDAGinfo.set(_dport, *daginfo);
-
 			} else {
 				//click_chatter("port not found\n");
 			}
@@ -807,10 +947,8 @@ void XTRANSPORT::ProcessNetworkPacket(WritablePacket *p_in)
 
 	} else if (thdr.type() == TransportHeader::XSOCK_DGRAM) {
 
-		_dport = XIDtoPort.get(_destination_xid);
-		DAGinfo *daginfo = portToDAGinfo.get_pointer(_dport);
 		// check if _destination_sid is of XSOCK_DGRAM
-		if (daginfo->sock_type != XSOCKET_DGRAM) {
+		if (!daginfo || daginfo->sock_type != XSOCKET_DGRAM) {
 			sendToApplication = false;
 		}
 	
@@ -821,47 +959,119 @@ void XTRANSPORT::ProcessNetworkPacket(WritablePacket *p_in)
 
 	if(_dport && sendToApplication) {
 		//TODO: Refine the way we change DAG in case of migration. Use some control bits. Add verification
-		DAGinfo daginfo = portToDAGinfo.get(_dport);
-
-		if(daginfo.initialized == false) {
-			daginfo.dst_path = xiah.src_path();
-			daginfo.initialized = true;
-			portToDAGinfo.set(_dport, daginfo);
+		if(daginfo->initialized == false) {
+			daginfo->dst_path = xiah.src_path();
+			daginfo->tmpl_valid = false;
+			daginfo->initialized = true;
 		}
 
 		// FIXME: what is this? need constant here
-		if(xiah.nxt() == 22 && daginfo.isConnected == true)
+		if(xiah.nxt() == 22 && daginfo->isConnected == true)
 		{
 			//Verify mobility info
-			daginfo.dst_path = xiah.src_path();
-			portToDAGinfo.set(_dport, daginfo);
+			daginfo->dst_path = xiah.src_path();
+			daginfo->tmpl_valid = false;
 			click_chatter("Sender moved, update to the new DAG");
 
-		} else {
-			//Unparse dag info
-			String src_path = xiah.src_path().unparse();
-			String payload((const char*)thdr.payload(), xiah.plen() - thdr.hlen());
+		} else
+			SendToApplication(_dport, p_in);
 
-			xia::XSocketMsg xsm;
-			xsm.set_type(xia::XRECV);
-			xia::X_Recv_Msg *x_recv_msg = xsm.mutable_x_recv();
-			x_recv_msg->set_dag(src_path.c_str());
-			x_recv_msg->set_payload(payload.c_str(), payload.length());
-
-			std::string p_buf;
-			xsm.SerializeToString(&p_buf);
-
-			WritablePacket *p2 = WritablePacket::make(256, p_buf.c_str(), p_buf.size(), 0);
-
-			//_errh->debug("Sent packet to socket with port %d", _dport);
-			output(API_PORT).push(UDPIPPrep(p2, _dport));
-		}
+		// the packets that were waiting for this one are data either way
+		for (int i = 0; i < ready.size(); i++)
+			SendToApplication(_dport, ready[i]);
 
 	} else {
 		if (!_dport) {
 			click_chatter("Packet to unknown port %d XID=%s, sendToApp=%d", _dport, _destination_xid.unparse().c_str(), sendToApplication );
 		}
 	}
+
+	for (int i = 0; i < ready.size(); i++)
+		ready[i]->kill();
+
+	if (ack_daginfo)
+		SendACK(ack_daginfo);
+}
+
+/*
+** Hand the data in network packet p to the socket on _dport.
+*/
+void XTRANSPORT::SendToApplication(unsigned short _dport, Packet *p)
+{
+	XIAHeader xiah(p);
+	TransportHeader thdr(p);
+
+	//Unparse dag info
+	String src_path = xiah.src_path().unparse();
+	String payload((const char*)thdr.payload(), xiah.plen() - thdr.hlen());
+
+	xia::XSocketMsg xsm;
+	xsm.set_type(xia::XRECV);
+	xia::X_Recv_Msg *x_recv_msg = xsm.mutable_x_recv();
+	x_recv_msg->set_dag(src_path.c_str());
+	x_recv_msg->set_payload(payload.c_str(), payload.length());
+
+	std::string p_buf;
+	xsm.SerializeToString(&p_buf);
+
+	WritablePacket *p2 = WritablePacket::make(256, p_buf.c_str(), p_buf.size(), 0);
+
+	//_errh->debug("Sent packet to socket with port %d", _dport);
+	output(API_PORT).push(UDPIPPrep(p2, _dport));
+}
+
+/*
+** Send a cumulative ACK for the stream on daginfo, with SACK blocks for the
+** packets it holds out of order.  The block holding the latest one comes
+** first, wherever it lies (RFC 2018), then the lowest of the others.
+*/
+void XTRANSPORT::SendACK(DAGinfo *daginfo)
+{
+	uint32_t edges[2 * TransportHeader::MAX_SACK_BLOCKS];
+	int nblocks = 0;
+
+	uint32_t last = daginfo->recv_last;
+	if (last > daginfo->expected_seqnum && last < daginfo->recv_high && daginfo->recv_pkt[last % MAX_WIN_SIZE]) {
+		uint32_t left = last, right = last + 1;
+		while (left - 1 > daginfo->expected_seqnum && daginfo->recv_pkt[(left - 1) % MAX_WIN_SIZE])
+			left--;
+		while (right < daginfo->recv_high && daginfo->recv_pkt[right % MAX_WIN_SIZE])
+			right++;
+		edges[0] = left;
+		edges[1] = right;
+		nblocks = 1;
+	}
+
+	for (uint32_t seq = daginfo->expected_seqnum + 1; seq < daginfo->recv_high && nblocks < TransportHeader::MAX_SACK_BLOCKS; seq++) {
+		if (!daginfo->recv_pkt[seq % MAX_WIN_SIZE])
+			continue;
+		uint32_t left = seq;
+		while (seq < daginfo->recv_high && daginfo->recv_pkt[seq % MAX_WIN_SIZE])
+			seq++;
+		if (nblocks > 0 && left == edges[0])
+			continue;
+		edges[2 * nblocks] = left;
+		edges[2 * nblocks + 1] = seq;
+		nblocks++;
+	}
+
+	WritablePacket *just_payload_part = WritablePacket::make(256, NULL, 0, 0);
+
+	TransportHeaderEncap thdr(TransportHeader::XSOCK_STREAM, TransportHeader::ACK, 0, daginfo->expected_seqnum, 0); // #seq, #ack, length
+	thdr.set_sack(edges, nblocks);
+	thdr.update();
+	WritablePacket *p = thdr.encap(just_payload_part);
+
+	// XIA payload = transport header
+	p = stream_header(daginfo).encap(p, true);
+
+	daginfo->unacked = 0;
+	if (daginfo->ack_pending) {
+		daginfo->ack_pending = false;
+		cancel_timer(daginfo->port, ACK_TIMER);
+	}
+
+	output(NETWORK_PORT).push(p);
 }
 
 void XTRANSPORT::ProcessCachePacket(WritablePacket *p_in)
@@ -871,11 +1081,11 @@ void XTRANSPORT::ProcessCachePacket(WritablePacket *p_in)
 
 	
 	//Extract the SID/CID
-	XIAHeader xiah(p_in->xia_header());
-	XIAPath dst_path = xiah.dst_path();
-	XIAPath src_path = xiah.src_path();
-	XID	destination_sid = dst_path.xid(dst_path.destination_node());
-	XID	source_cid = src_path.xid(src_path.destination_node());	
+	XIAHeader xiah(p_in);
+	XIAPathView dst_view = xiah.dst_path_view();
+	XIAPathView src_view = xiah.src_path_view();
+	XID	destination_sid = dst_view.xid(dst_view.destination_node());
+	XID	source_cid = src_view.xid(src_view.destination_node());
 	
         ContentHeader ch(p_in);
 	
@@ -886,21 +1096,11 @@ void XTRANSPORT::ProcessCachePacket(WritablePacket *p_in)
 	
         if(ch.opcode()==ContentHeader::OP_PUSH){
 		// compute the hash and verify it matches the CID
-		String hash = "CID:";
-		char hexBuf[3];
-		int i = 0;
-		SHA1_ctx sha_ctx;
 		unsigned char digest[HASH_KEYSIZE];
-		SHA1_init(&sha_ctx);
-		SHA1_update(&sha_ctx, (unsigned char *)xiah.payload(), xiah.plen());
-		SHA1_final(digest, &sha_ctx);
-		for(i = 0; i < HASH_KEYSIZE; i++) {
-			sprintf(hexBuf, "%02x", digest[i]);
-			hash.append(const_cast<char *>(hexBuf), 2);
-		}
+		XIASHA1::digest(xiah.payload(), xiah.plen(), digest);
 
 // 		int status = READY_TO_READ;
-		if (hash != source_cid.unparse()) {
+		if (memcmp(digest, source_cid.xid().id, HASH_KEYSIZE) != 0) {
 			click_chatter("CID with invalid hash received: %s\n", source_cid.unparse().c_str());
 // 			status = INVALID_HASH;
 		}
@@ -911,7 +1111,7 @@ void XTRANSPORT::ProcessCachePacket(WritablePacket *p_in)
 			return;
 		}
 		
-		DAGinfo *daginfo = portToDAGinfo.get_pointer(_dport);
+		DAGinfo *daginfo = _conns.port(_dport);
 		// check if _destination_sid is of XSOCK_DGRAM
 		if (daginfo->sock_type != XSOCKET_CHUNK) {
 			click_chatter("This is not a chunk socket. dport: %i, Socktype: %i", _dport, daginfo->sock_type);
@@ -932,7 +1132,7 @@ void XTRANSPORT::ProcessCachePacket(WritablePacket *p_in)
 		x_pushchunkto_msg->set_cachesize(ch.cacheSize());
 		x_pushchunkto_msg->set_contextid(ch.contextID());
 		x_pushchunkto_msg->set_length(ch.length());
- 		x_pushchunkto_msg->set_ddag(dst_path.unparse().c_str());
+ 		x_pushchunkto_msg->set_ddag(xiah.dst_path().unparse().c_str());
 
 		std::string p_buf;
 		xia_socket_msg.SerializeToString(&p_buf);
@@ -948,11 +1148,8 @@ void XTRANSPORT::ProcessCachePacket(WritablePacket *p_in)
 		
 	}
 
-	XIDpair xid_pair;
-	xid_pair.set_src(destination_sid);
-	xid_pair.set_dst(source_cid);
-
-	unsigned short _dport = XIDpairToPort.get(xid_pair);
+	DAGinfo *daginfo = _conns.lookup(destination_sid, source_cid);
+	unsigned short _dport = daginfo ? daginfo->port : 0;
 	
 // 	click_chatter(">>packet from processCACHEpackets %d\n", _dport);
 // 	click_chatter("CachePacket, Src: %s, Dest: %s, Local: %s", xiah.dst_path().unparse().c_str(),
@@ -960,16 +1157,12 @@ void XTRANSPORT::ProcessCachePacket(WritablePacket *p_in)
 	click_chatter("CachePacket, dest: %s, src_cid %s OPCode: %d \n", destination_sid.unparse().c_str(), source_cid.unparse().c_str(), ch.opcode());
 // 	click_chatter("dst_path: %s, src_path: %s, OPCode: %d\n", dst_path.unparse().c_str(), src_path.unparse().c_str(), ch.opcode());
 
-	if(_dport)
+	if(daginfo)
 	{
 		//TODO: Refine the way we change DAG in case of migration. Use some control bits. Add verification
-		//DAGinfo daginfo=portToDAGinfo.get(_dport);
-		//daginfo.dst_path=xiah.src_path();
-		//portToDAGinfo.set(_dport,daginfo);
+		//daginfo->dst_path=xiah.src_path();
 		//ENDTODO
 
-		DAGinfo *daginfo = portToDAGinfo.get_pointer(_dport);
-
 		// Reset timer or just Remove the corresponding entry in the hash tables (Done below)
 		HashTable<XID, WritablePacket*>::iterator it1;
 		it1 = daginfo->XIDtoCIDreqPkt.find(source_cid);
@@ -977,40 +1170,15 @@ void XTRANSPORT::ProcessCachePacket(WritablePacket *p_in)
 		if(it1 != daginfo->XIDtoCIDreqPkt.end() ) {
 			// Remove the entry
 			daginfo->XIDtoCIDreqPkt.erase(it1);
-		}
-
-		HashTable<XID, Timestamp>::iterator it2;
-		it2 = daginfo->XIDtoExpiryTime.find(source_cid);
-
-		if(it2 != daginfo->XIDtoExpiryTime.end()) {
-			// Remove the entry
-			daginfo->XIDtoExpiryTime.erase(it2);
-		}
-
-		HashTable<XID, bool>::iterator it3;
-		it3 = daginfo->XIDtoTimerOn.find(source_cid);
-
-		if(it3 != daginfo->XIDtoTimerOn.end()) {
-			// Remove the entry
-			daginfo->XIDtoTimerOn.erase(it3);
+			cancel_timer(_dport, CID_TIMER, source_cid);
 		}
 
 		// compute the hash and verify it matches the CID
-		String hash = "CID:";
-		char hexBuf[3];
-		int i = 0;
-		SHA1_ctx sha_ctx;
 		unsigned char digest[HASH_KEYSIZE];
-		SHA1_init(&sha_ctx);
-		SHA1_update(&sha_ctx, (unsigned char *)xiah.payload(), xiah.plen());
-		SHA1_final(digest, &sha_ctx);
-		for(i = 0; i < HASH_KEYSIZE; i++) {
-			sprintf(hexBuf, "%02x", digest[i]);
-			hash.append(const_cast<char *>(hexBuf), 2);
-		}
+		XIASHA1::digest(xiah.payload(), xiah.plen(), digest);
 
 		int status = READY_TO_READ;
-		if (hash != source_cid.unparse()) {
+		if (memcmp(digest, source_cid.xid().id, HASH_KEYSIZE) != 0) {
 			click_chatter("CID with invalid hash received: %s\n", source_cid.unparse().c_str());
 			status = INVALID_HASH;
 		}
@@ -1030,8 +1198,6 @@ void XTRANSPORT::ProcessCachePacket(WritablePacket *p_in)
 				// Send pkt up
 				daginfo->XIDtoReadReq.erase(it4);
 
-				portToDAGinfo.set(_dport, *daginfo);
-
 				//Unparse dag info
 				String src_path = xiah.src_path().unparse();
 
@@ -1055,14 +1221,11 @@ void XTRANSPORT::ProcessCachePacket(WritablePacket *p_in)
 				// Store the packet into temp buffer (until ReadCID() is called for this CID)
 				WritablePacket *copy_response_pkt = copy_cid_response_packet(p_in, daginfo);
 				daginfo->XIDtoCIDresponsePkt.set(source_cid, copy_response_pkt);
-
-				portToDAGinfo.set(_dport, *daginfo);
 			}
 
 		} else {
 			WritablePacket *copy_response_pkt = copy_cid_response_packet(p_in, daginfo);
 			daginfo->XIDtoCIDresponsePkt.set(source_cid, copy_response_pkt);
-			portToDAGinfo.set(_dport, *daginfo);
 		}
 	}
 	else
@@ -1084,7 +1247,7 @@ void XTRANSPORT::ProcessCachePacket(WritablePacket *p_in)
 
 void XTRANSPORT::ProcessXhcpPacket(WritablePacket *p_in)
 {
-	XIAHeader xiah(p_in->xia_header());
+	XIAHeader xiah(p_in);
 	String temp = _local_addr.unparse();
 	Vector<String> ids;
 	cp_spacevec(temp, ids);;
@@ -1163,7 +1326,7 @@ XTRANSPORT::UDPIPPrep(Packet *p_in, int dport)
 }
 
 
-enum {H_MOVE};
+enum {H_MOVE, H_CONGESTION};
 
 int XTRANSPORT::write_param(const String &conf, Element *e, void *vparam,
 							ErrorHandler *errh)
@@ -1178,6 +1341,7 @@ int XTRANSPORT::write_param(const String &conf, Element *e, void *vparam,
 						 cpEnd) < 0)
 			return -1;
 		f->_local_addr = local_addr;
+		f->_addr_version++;
 		click_chatter("Moved to %s", local_addr.unparse().c_str());
 		f->_local_hid = local_addr.xid(local_addr.destination_node());
 
@@ -1189,8 +1353,31 @@ int XTRANSPORT::write_param(const String &conf, Element *e, void *vparam,
 	return 0;
 }
 
+String XTRANSPORT::read_handler(Element *e, void *thunk)
+{
+	XTRANSPORT *t = static_cast<XTRANSPORT *>(e);
+	switch ((intptr_t)thunk) {
+	case H_CONGESTION:
+	{
+		StringAccum sa;
+		for (HashTable<unsigned short, uint32_t>::const_iterator it = t->_conns.ports().begin(); it != t->_conns.ports().end(); ++it) {
+			const DAGinfo *daginfo = t->_conns.get(it->second);
+			if (!daginfo || !daginfo->cc)
+				continue;
+			sa << "port " << it->first << ' ' << daginfo->cc->unparse()
+			   << " inflight " << (daginfo->next_seqnum - daginfo->base)
+			   << " queued " << (daginfo->seq_num - daginfo->high_seqnum) << '\n';
+		}
+		return sa.take_string();
+	}
+	default:
+		return "<error>";
+	}
+}
+
 void XTRANSPORT::add_handlers() {
 	add_write_handler("local_addr", write_param, (void *)H_MOVE);
+	add_read_handler("congestion", read_handler, (void *)H_CONGESTION);
 }
 
 /*
@@ -1205,28 +1392,20 @@ void XTRANSPORT::Xsocket(unsigned short _sport) {
 	xia::X_Socket_Msg *x_socket_msg = xia_socket_msg.mutable_x_socket();
 	int sock_type = x_socket_msg->type();
 
-	//Set the source port in DAGinfo
-	DAGinfo daginfo;
-	daginfo.port = _sport;
-	daginfo.timer_on = false;
-	daginfo.synack_waiting = false;
-	daginfo.dataack_waiting = false;
-	daginfo.num_retransmit_tries = 0;
-	daginfo.teardown_waiting = false;
-	daginfo.isAcceptSocket = false;
-	daginfo.num_connect_tries = 0; // number of xconnect tries (Xconnect will fail after MAX_CONNECT_TRIES trials)
-	memset(daginfo.sent_pkt, 0, MAX_WIN_SIZE * sizeof(WritablePacket*));
+	// Map the source port to a new DAGinfo
+	DAGinfo *daginfo = new_daginfo(_sport);
+	daginfo->synack_waiting = false;
+	daginfo->dataack_waiting = false;
+	daginfo->num_retransmit_tries = 0;
+	daginfo->teardown_waiting = false;
+	daginfo->isAcceptSocket = false;
+	daginfo->num_connect_tries = 0; // number of xconnect tries (Xconnect will fail after MAX_CONNECT_TRIES trials)
+	memset(daginfo->sent_pkt, 0, MAX_WIN_SIZE * sizeof(Packet*));
+	memset(daginfo->sacked, 0, sizeof(daginfo->sacked));
+	memset(daginfo->recv_pkt, 0, MAX_WIN_SIZE * sizeof(Packet*));
 
 	//Set the socket_type (reliable or not) in DAGinfo
-	daginfo.sock_type = sock_type;
-
-	// Map the source port to DagInfo
-	portToDAGinfo.set(_sport, daginfo);
-
-	portToActive.set(_sport, true);
-
-	hlim.set(_sport, HLIM_DEFAULT);
-	nxt_xport.set(_sport, CLICK_XIA_NXT_TRN);
+	daginfo->sock_type = sock_type;
 
 	// click_chatter("XSOCKET: sport=%hu\n", _sport);
 
@@ -1242,6 +1421,7 @@ void XTRANSPORT::Xsetsockopt(unsigned short _sport) {
 
 	// click_chatter("\nSet Socket Option\n");
 	xia::X_Setsockopt_Msg *x_sso_msg = xia_socket_msg.mutable_x_setsockopt();
+	DAGinfo *daginfo = _conns.port(_sport);
 
 	switch (x_sso_msg->opt_type())
 	{
@@ -1250,7 +1430,8 @@ void XTRANSPORT::Xsetsockopt(unsigned short _sport) {
 	{
 		int hl = x_sso_msg->int_opt();
 	
-		hlim.set(_sport, hl);
+		daginfo->hlim = hl;
+		daginfo->tmpl_valid = false;
 		//click_chatter("sso:hlim:%d\n",hl);
 	}
 	break;
@@ -1258,7 +1439,8 @@ void XTRANSPORT::Xsetsockopt(unsigned short _sport) {
 	case 2:
 	{
 		int nxt = x_sso_msg->int_opt();
-		nxt_xport.set(_sport, nxt);
+		daginfo->nxt = nxt;
+		daginfo->tmpl_valid = false;
 		if (nxt == CLICK_XIA_NXT_XCMP)
 			xcmp_listeners.push_back(_sport);
 		else
@@ -1279,6 +1461,7 @@ void XTRANSPORT::Xsetsockopt(unsigned short _sport) {
 void XTRANSPORT::Xgetsockopt(unsigned short _sport) {
 	// click_chatter("\nGet Socket Option\n");
 	xia::X_Getsockopt_Msg *x_sso_msg = xia_socket_msg.mutable_x_getsockopt();
+	DAGinfo *daginfo = _conns.port(_sport);
 
 	// click_chatter("opt = %d\n", x_sso_msg->opt_type());
 	switch (x_sso_msg->opt_type())
@@ -1286,14 +1469,14 @@ void XTRANSPORT::Xgetsockopt(unsigned short _sport) {
 	// FIXME: need real opt type for protobufs
 	case 1:
 	{
-		x_sso_msg->set_int_opt(hlim.get(_sport));
-		//click_chatter("gso:hlim:%d\n", hlim.get(_sport));
+		x_sso_msg->set_int_opt(daginfo->hlim);
+		//click_chatter("gso:hlim:%d\n", daginfo->hlim);
 	}
 	break;
 
 	case 2:
 	{
-		x_sso_msg->set_int_opt(nxt_xport.get(_sport));
+		x_sso_msg->set_int_opt(daginfo->nxt);
 	}
 	break;
 
@@ -1327,14 +1510,14 @@ void XTRANSPORT::Xbind(unsigned short _sport) {
 	//str_local_addr=str_local_addr+" "+xid_string;//Make source DAG _local_addr:SID
 
 	//Set the source DAG in DAGinfo
-	DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
+	DAGinfo *daginfo = _conns.port(_sport);
 	if (daginfo->src_path.parse(sdag_string)) {
-		daginfo->nxt = LAST_NODE_DEFAULT;
 		daginfo->last = LAST_NODE_DEFAULT;
-		daginfo->hlim = hlim.get(_sport);
 		daginfo->isConnected = false;
 		daginfo->initialized = true;
 		daginfo->sdag = sdag_string;
+		daginfo->src_version = 0;
+		daginfo->tmpl_valid = false;
 
 		//Check if binding to full DAG or just to SID only
 		Vector<XIAPath::handle_t> xids = daginfo->src_path.next_nodes( daginfo->src_path.source_node() );		
@@ -1352,11 +1535,9 @@ void XTRANSPORT::Xbind(unsigned short _sport) {
 		//TODO: Add a check to see if XID is already being used
 
 		// Map the source XID to source port (for now, for either type of tranports)
-		XIDtoPort.set(source_xid, _sport);
+		_conns.bind(source_xid, XID(), daginfo->handle);
 		addRoute(source_xid);
 
-		portToDAGinfo.set(_sport, *daginfo);
-
 		//click_chatter("Bound");
 		//click_chatter("set %d %d",_sport, __LINE__);
 
@@ -1390,14 +1571,14 @@ void XTRANSPORT::XbindPush(unsigned short _sport) {
 	//str_local_addr=str_local_addr+" "+xid_string;//Make source DAG _local_addr:SID
 
 	//Set the source DAG in DAGinfo
-	DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
+	DAGinfo *daginfo = _conns.port(_sport);
 	if (daginfo->src_path.parse(sdag_string)) {
-		daginfo->nxt = LAST_NODE_DEFAULT;
 		daginfo->last = LAST_NODE_DEFAULT;
-		daginfo->hlim = hlim.get(_sport);
 		daginfo->isConnected = false;
 		daginfo->initialized = true;
 		daginfo->sdag = sdag_string;
+		daginfo->src_version = 0;
+		daginfo->tmpl_valid = false;
 
 		//Check if binding to full DAG or just to SID only
 		Vector<XIAPath::handle_t> xids = daginfo->src_path.next_nodes( daginfo->src_path.source_node() );		
@@ -1418,8 +1599,6 @@ void XTRANSPORT::XbindPush(unsigned short _sport) {
 		XIDtoPushPort.set(source_xid, _sport);
 		addRoute(source_xid);
 
-		portToDAGinfo.set(_sport, *daginfo);
-
 		//click_chatter("Bound");
 		//click_chatter("set %d %d",_sport, __LINE__);
 
@@ -1440,17 +1619,11 @@ void XTRANSPORT::Xclose(unsigned short _sport)
 	// Close port
 	//click_chatter("Xclose: closing %d\n", _sport);
 
-	DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
+	DAGinfo *daginfo = _conns.port(_sport);
 
 	// Set timer
-	daginfo->timer_on = true;
 	daginfo->teardown_waiting = true;
-	daginfo->teardown_expiry = Timestamp::now() + Timestamp::make_msec(_teardown_wait_ms);
-
-	if (! _timer.scheduled() || _timer.expiry() >= daginfo->teardown_expiry )
-		_timer.reschedule_at(daginfo->teardown_expiry);
-
-	portToDAGinfo.set(_sport, *daginfo);
+	set_timer(_sport, TEARDOWN_TIMER, Timestamp::now() + Timestamp::make_msec(_teardown_wait_ms));
 
 	xcmp_listeners.remove(_sport);
 
@@ -1476,16 +1649,17 @@ void XTRANSPORT::Xconnect(unsigned short _sport)
 	XIAPath dst_path;
 	dst_path.parse(dest);
 
-	DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
+	DAGinfo *daginfo = _conns.port(_sport);
 	//click_chatter("connect %d %x",_sport, daginfo);
 
 	if(!daginfo) {
 		//click_chatter("Create DAGINFO connect %d %x",_sport, daginfo);
 		//No local SID bound yet, so bind ephemeral one
-		daginfo = new DAGinfo();
+		daginfo = new_daginfo(_sport);
 	}
 
 	daginfo->dst_path = dst_path;
+	daginfo->tmpl_valid = false;
 	daginfo->port = _sport;
 	daginfo->isConnected = true;
 	daginfo->initialized = true;
@@ -1494,6 +1668,7 @@ void XTRANSPORT::Xconnect(unsigned short _sport)
 	daginfo->ack_num = 0;
 	daginfo->base = 0;
 	daginfo->next_seqnum = 0;
+	daginfo->high_seqnum = 0;
 	daginfo->expected_seqnum = 0;
 	daginfo->num_connect_tries++; // number of xconnect tries (Xconnect will fail after MAX_CONNECT_TRIES trials)
 
@@ -1512,24 +1687,15 @@ void XTRANSPORT::Xconnect(unsigned short _sport)
 		daginfo->src_path.parse_re(str_local_addr);
 	}
 
-	daginfo->nxt = LAST_NODE_DEFAULT;
 	daginfo->last = LAST_NODE_DEFAULT;
-	daginfo->hlim = hlim.get(_sport);
 
 	XID source_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
 	XID destination_xid = daginfo->dst_path.xid(daginfo->dst_path.destination_node());
 
-	XIDpair xid_pair;
-	xid_pair.set_src(source_xid);
-	xid_pair.set_dst(destination_xid);
-
-	// Map the src & dst XID pair to source port
+	// Map the src & dst XID pair, and the source XID, to the connection
 	//click_chatter("setting pair to port1 %d\n", _sport);
-
-	XIDpairToPort.set(xid_pair, _sport);
-
-	// Map the source XID to source port
-	XIDtoPort.set(source_xid, _sport);
+	_conns.bind(source_xid, destination_xid, daginfo->handle);
+	_conns.bind(source_xid, XID(), daginfo->handle);
 	addRoute(source_xid);
 
 	// click_chatter("XCONNECT: set %d %x",_sport, daginfo);
@@ -1540,7 +1706,7 @@ void XTRANSPORT::Xconnect(unsigned short _sport)
 	XIAHeaderEncap xiah;
 	xiah.set_nxt(CLICK_XIA_NXT_TRN);
 	xiah.set_last(LAST_NODE_DEFAULT);
-	xiah.set_hlim(hlim.get(_sport));
+	xiah.set_hlim(daginfo->hlim);
 	xiah.set_dst_path(dst_path);
 	xiah.set_src_path(daginfo->src_path);
 
@@ -1562,24 +1728,18 @@ void XTRANSPORT::Xconnect(unsigned short _sport)
 	delete thdr;
 
 	// Set timer
-	daginfo->timer_on = true;
 	daginfo->synack_waiting = true;
-	daginfo->expiry = Timestamp::now() + Timestamp::make_msec(_ackdelay_ms);
-
-	if (! _timer.scheduled() || _timer.expiry() >= daginfo->expiry )
-		_timer.reschedule_at(daginfo->expiry);
+	set_timer(_sport, SYN_TIMER, Timestamp::now() + Timestamp::make_msec(_ackdelay_ms));
 
 	// Store the syn packet for potential retransmission
 	daginfo->syn_pkt = copy_packet(p, daginfo);
 
-	portToDAGinfo.set(_sport, *daginfo);
 	XIAHeader xiah1(p);
 	//String pld((char *)xiah1.payload(), xiah1.plen());
 	// click_chatter("XCONNECT: %d: %s\n", _sport, (_local_addr.unparse()).c_str());
 	output(NETWORK_PORT).push(p);
 
-	//daginfo=portToDAGinfo.get_pointer(_sport);
-	//click_chatter("\nbound to %s\n",portToDAGinfo.get_pointer(_sport)->src_path.unparse().c_str());
+	//click_chatter("\nbound to %s\n",daginfo->src_path.unparse().c_str());
 
 	// (for Ack purpose) Reply with a packet with the destination port=source port
 	//output(API_PORT).push(UDPIPPrep(p_in,_sport));
@@ -1588,36 +1748,32 @@ void XTRANSPORT::Xconnect(unsigned short _sport)
 void XTRANSPORT::Xaccept(unsigned short _sport)
 {
 	//click_chatter("Xaccept: on %d\n", _sport);
-	hlim.set(_sport, HLIM_DEFAULT);
-	nxt_xport.set(_sport, CLICK_XIA_NXT_TRN);
 
 	if (!pending_connection_buf.empty()) {
 
-		DAGinfo daginfo = pending_connection_buf.front();
-		daginfo.port = _sport;
-
-		daginfo.seq_num = 0;
-		daginfo.ack_num = 0;
-		daginfo.base = 0;
-		daginfo.hlim = hlim.get(_sport);
-		daginfo.next_seqnum = 0;
-		daginfo.expected_seqnum = 0;
-		daginfo.isAcceptSocket = true;
-		memset(daginfo.sent_pkt, 0, MAX_WIN_SIZE * sizeof(WritablePacket*));
-
-		portToDAGinfo.set(_sport, daginfo);
-
-		XID source_xid = daginfo.src_path.xid(daginfo.src_path.destination_node());
-		XID destination_xid = daginfo.dst_path.xid(daginfo.dst_path.destination_node());
+		// the pending connection takes the place of the DAGinfo Xsocket made
+		uint32_t h = pending_connection_buf.front();
+		DAGinfo *daginfo = _conns.get(h);
+		_conns.free(_conns.port_handle(_sport));
+		_conns.set_port(_sport, h);
+		daginfo->port = _sport;
 
-		XIDpair xid_pair;
-		xid_pair.set_src(source_xid);
-		xid_pair.set_dst(destination_xid);
+		daginfo->seq_num = 0;
+		daginfo->ack_num = 0;
+		daginfo->base = 0;
+		daginfo->next_seqnum = 0;
+		daginfo->high_seqnum = 0;
+		daginfo->expected_seqnum = 0;
+		daginfo->isAcceptSocket = true;
+		memset(daginfo->sent_pkt, 0, MAX_WIN_SIZE * sizeof(Packet*));
+		memset(daginfo->sacked, 0, sizeof(daginfo->sacked));
+		memset(daginfo->recv_pkt, 0, MAX_WIN_SIZE * sizeof(Packet*));
 
-		// Map the src & dst XID pair to source port
-		XIDpairToPort.set(xid_pair, _sport);
+		XID source_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
+		XID destination_xid = daginfo->dst_path.xid(daginfo->dst_path.destination_node());
 
-		portToActive.set(_sport, true);
+		// Map the src & dst XID pair to the connection
+		_conns.bind(source_xid, destination_xid, h);
 
 		// click_chatter("XACCEPT: (%s) my_sport=%d  my_sid=%s  his_sid=%s \n\n", (_local_addr.unparse()).c_str(), _sport, source_xid.unparse().c_str(), destination_xid.unparse().c_str());
 
@@ -1628,7 +1784,7 @@ void XTRANSPORT::Xaccept(unsigned short _sport)
  		xsm.set_type(xia::XACCEPT);
 
 		xia::X_Accept_Msg *msg = xsm.mutable_x_accept();
-		msg->set_dag(daginfo.dst_path.unparse().c_str());
+		msg->set_dag(daginfo->dst_path.unparse().c_str());
 
  		std::string s;
  		xsm.SerializeToString(&s);
@@ -1665,6 +1821,7 @@ void XTRANSPORT::Xchangead(unsigned short _sport)
 	}
 	click_chatter("new address is - %s", new_local_addr.c_str());
 	_local_addr.parse(new_local_addr);		
+	_addr_version++;
 }
 
 void XTRANSPORT::Xreadlocalhostaddr(unsigned short _sport)
@@ -1733,7 +1890,7 @@ void XTRANSPORT::Xgetpeername(unsigned short _sport)
 	_xsm.set_type(xia::XGETPEERNAME);
 	xia::X_GetPeername_Msg *_msg = _xsm.mutable_x_getpeername();
 
-	DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
+	DAGinfo *daginfo = _conns.port(_sport);
 
 	_msg->set_dag(daginfo->dst_path.unparse().c_str());
 
@@ -1750,7 +1907,7 @@ void XTRANSPORT::Xgetsockname(unsigned short _sport)
 	_xsm.set_type(xia::XGETSOCKNAME);
 	xia::X_GetSockname_Msg *_msg = _xsm.mutable_x_getsockname();
 
-	DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
+	DAGinfo *daginfo = _conns.port(_sport);
 
 	_msg->set_dag(daginfo->src_path.unparse().c_str());
 
@@ -1767,93 +1924,29 @@ void XTRANSPORT::Xsend(unsigned short _sport, WritablePacket *p_in)
 
 	xia::X_Send_Msg *x_send_msg = xia_socket_msg.mutable_x_send();
 
-	String pktPayload(x_send_msg->payload().c_str(), x_send_msg->payload().size());
-
-	int pktPayloadSize = pktPayload.length();
-	//click_chatter("pkt %s port %d", pktPayload.c_str(), _sport);
+	int pktPayloadSize = x_send_msg->payload().size();
 	//click_chatter("XSEND: %d bytes from (%d)\n", pktPayloadSize, _sport);
 
 	//Find DAG info for that stream
-	DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
+	DAGinfo *daginfo = _conns.port(_sport);
 	if (daginfo && daginfo->isConnected) {
 
-		//Recalculate source path
-		XID	source_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
-		String str_local_addr = _local_addr.unparse_re() + " " + source_xid.unparse();
-		//Make source DAG _local_addr:SID
-		String dagstr = daginfo->src_path.unparse_re();
-
-		//Client Mobility...
-		if (dagstr.length() != 0 && dagstr != str_local_addr) {
-			//Moved!
-			// 1. Update 'daginfo->src_path'
-			daginfo->src_path.parse_re(str_local_addr);
-		}
-	
-		// Case of initial binding to only SID
-		if(daginfo->full_src_dag == false) {
-			daginfo->full_src_dag = true;
-			String str_local_addr = _local_addr.unparse_re();
-			XID front_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
-			String xid_string = front_xid.unparse();
-			str_local_addr = str_local_addr + " " + xid_string; //Make source DAG _local_addr:SID
-			daginfo->src_path.parse_re(str_local_addr);
-		}
-
-		//Add XIA headers
-		XIAHeaderEncap xiah;
-		xiah.set_nxt(CLICK_XIA_NXT_TRN);
-		xiah.set_last(LAST_NODE_DEFAULT);
-		xiah.set_hlim(hlim.get(_sport));
-		xiah.set_dst_path(daginfo->dst_path);
-		xiah.set_src_path(daginfo->src_path);
-		xiah.set_plen(pktPayloadSize);
-
-
-		_errh->debug("XSEND: (%d) sent packet to %s, from %s\n", _sport, daginfo->dst_path.unparse_re().c_str(), daginfo->src_path.unparse_re().c_str());
-
-		WritablePacket *just_payload_part = WritablePacket::make(p_in->headroom() + 1, (const void*)x_send_msg->payload().c_str(), pktPayloadSize, p_in->tailroom());
-
-		WritablePacket *p = NULL;
-
-		//Add XIA Transport headers
-		TransportHeaderEncap *thdr = TransportHeaderEncap::MakeDATAHeader(daginfo->next_seqnum, daginfo->ack_num, 0 ); // #seq, #ack, length
-		p = thdr->encap(just_payload_part);
-
-		thdr->update();
-		xiah.set_plen(pktPayloadSize + thdr->hlen()); // XIA payload = transport header + transport-layer data
-
-		p = xiah.encap(p, false);
-
-		delete thdr;
-
-		// Store the packet into buffer
-		WritablePacket *tmp = daginfo->sent_pkt[daginfo->seq_num % MAX_WIN_SIZE];
-		daginfo->sent_pkt[daginfo->seq_num % MAX_WIN_SIZE] = copy_packet(p, daginfo);
-		if (tmp)
-			tmp->kill();
-
-		// click_chatter("XSEND: SENT DATA at (%s) seq=%d \n\n", dagstr.c_str(), daginfo->seq_num%MAX_WIN_SIZE);
+		// the headers come from the connection's template, rebuilt only
+		// when we or the peer moved
+		WritablePacket *p = stream_packet(daginfo, x_send_msg->payload().data(), pktPayloadSize, daginfo->seq_num, daginfo->ack_num);
 
+		// Queue the packet, and send what the window allows
+		p->set_next(0);
+		if (daginfo->send_tail)
+			daginfo->send_tail->set_next(p);
+		else
+			daginfo->send_head = p;
+		daginfo->send_tail = p;
 		daginfo->seq_num++;
-		daginfo->next_seqnum++;
 
-		// Set timer
-		daginfo->timer_on = true;
-		daginfo->dataack_waiting = true;
-		daginfo->num_retransmit_tries = 0;
-		daginfo->expiry = Timestamp::now() + Timestamp::make_msec(_ackdelay_ms);
-
-		if (! _timer.scheduled() || _timer.expiry() >= daginfo->expiry )
-			_timer.reschedule_at(daginfo->expiry);
-
-		portToDAGinfo.set(_sport, *daginfo);
-
-		//click_chatter("Sent packet to network");
-		XIAHeader xiah1(p);
-		String pld((char *)xiah1.payload(), xiah1.plen());
-		//click_chatter("\n\n (%s) send (timer set at %f) =%s  len=%d \n\n", (_local_addr.unparse()).c_str(), (daginfo->expiry).doubleval(), pld.c_str(), xiah1.plen());
-		output(NETWORK_PORT).push(p);
+		if (!daginfo->cc)
+			daginfo->cc = XIACongestionControl::make(_congestion, MAX_WIN_SIZE, Timestamp::make_msec(_ackdelay_ms));
+		TransmitPending(daginfo);
 
 		// REMOVED STATUS RETURNS AS WE RAN INTO SEQUENCING ERRORS
 		// WHERE IT INTERLEAVED WITH RECEIVE PACKETS
@@ -1867,24 +1960,113 @@ void XTRANSPORT::Xsend(unsigned short _sport, WritablePacket *p_in)
 	}
 }
 
+/*
+** Send the data packets the congestion window has room for: first, in fast
+** recovery, the holes below the highest SACKed packet; then any packets a
+** timeout left to resend; then new ones from the send queue.  Only new
+** packets are timed for RTT.
+**
+** The window limits the packets in the network (the "pipe" of RFC 6675):
+** those sent and not SACKed, less the holes presumed lost in recovery,
+** plus the holes already resent.  daginfo->pipe keeps that count as packets
+** are sent, ACKed, SACKed, and resent.
+**
+** Each packet is pushed before the next is chosen.  A local receiver may ACK
+** it before push() returns; that ACK's TransmitPending() returns at once, and
+** this loop sends whatever it opened, in order.
+*/
+void XTRANSPORT::TransmitPending(DAGinfo *daginfo)
+{
+	if (daginfo->transmitting)
+		return;
+	daginfo->transmitting = true;
+
+	while (1) {
+		Timestamp now = Timestamp::now();
+		bool recovering = daginfo->cc->recovering();
+
+		if (daginfo->pipe >= daginfo->cc->window())
+			break;
+
+		uint32_t hole = daginfo->rexmit_next > daginfo->base ? daginfo->rexmit_next : daginfo->base;
+		if (recovering) {
+			while (hole < daginfo->sack_high && hole < daginfo->next_seqnum && daginfo->is_sacked(hole))
+				hole++;
+		}
+		while (daginfo->next_seqnum < daginfo->high_seqnum && daginfo->is_sacked(daginfo->next_seqnum))
+			daginfo->next_seqnum++;
+
+		WritablePacket *p;
+		uint32_t seq;
+
+		if (recovering && hole < daginfo->sack_high && hole < daginfo->next_seqnum && daginfo->sent_pkt[hole % MAX_WIN_SIZE]) {
+			// a hole the receiver's SACKs show
+			seq = hole;
+			p = copy_packet(daginfo->sent_pkt[seq % MAX_WIN_SIZE], daginfo);
+			daginfo->cc->retransmitted();
+			daginfo->rexmit_next = seq + 1;
+			daginfo->pipe++; // it was presumed lost
+
+		} else if (daginfo->next_seqnum < daginfo->high_seqnum) {
+			// going back after a timeout
+			seq = daginfo->next_seqnum++;
+			if (daginfo->in_pipe(seq))
+				daginfo->pipe++;
+			if (!daginfo->sent_pkt[seq % MAX_WIN_SIZE])
+				continue;
+			p = copy_packet(daginfo->sent_pkt[seq % MAX_WIN_SIZE], daginfo);
+			daginfo->cc->retransmitted();
+
+		} else if (daginfo->send_head && daginfo->high_seqnum - daginfo->base < MAX_WIN_SIZE) {
+			// SACKed packets leave the pipe but keep their slot in the
+			// ring until the cumulative ACK passes them
+			p = daginfo->send_head;
+			daginfo->send_head = static_cast<WritablePacket *>(p->next());
+			if (!daginfo->send_head)
+				daginfo->send_tail = NULL;
+			p->set_next(0);
+
+			// Store the packet into buffer
+			seq = daginfo->next_seqnum++;
+			Packet *tmp = daginfo->sent_pkt[seq % MAX_WIN_SIZE];
+			daginfo->sent_pkt[seq % MAX_WIN_SIZE] = p->clone();
+			if (tmp)
+				tmp->kill();
+			daginfo->set_sacked(seq, false);
+			daginfo->pipe++;
+			daginfo->high_seqnum = seq + 1;
+			daginfo->cc->sent(seq, now);
+
+		} else
+			break;
+
+		// Set timer
+		if (!daginfo->dataack_waiting) {
+			daginfo->dataack_waiting = true;
+			daginfo->num_retransmit_tries = 0;
+			set_timer(daginfo->port, DATA_TIMER, now + daginfo->cc->rto());
+		}
+
+		output(NETWORK_PORT).push(p);
+	}
+
+	daginfo->transmitting = false;
+}
+
 void XTRANSPORT::Xsendto(unsigned short _sport, WritablePacket *p_in)
 {
 	xia::X_Sendto_Msg *x_sendto_msg = xia_socket_msg.mutable_x_sendto();
 
-	String dest(x_sendto_msg->ddag().c_str());
-	String pktPayload(x_sendto_msg->payload().c_str(), x_sendto_msg->payload().size());
-	int pktPayloadSize = pktPayload.length();
+	const std::string &dest = x_sendto_msg->ddag();
+	int pktPayloadSize = x_sendto_msg->payload().size();
 	//click_chatter("\n SENDTO ddag:%s, payload:%s, length=%d\n",xia_socket_msg.ddag().c_str(), xia_socket_msg.payload().c_str(), pktPayloadSize);
 
-	XIAPath dst_path;
-	dst_path.parse(dest);
-
 	//Find DAG info for this DGRAM
-	DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
+	DAGinfo *daginfo = _conns.port(_sport);
 
 	if(!daginfo) {
 		//No local SID bound yet, so bind one
-		daginfo = new DAGinfo();
+		daginfo = new_daginfo(_sport);
 	}
 
 	if (daginfo->initialized == false) {
@@ -1902,76 +2084,46 @@ void XTRANSPORT::Xsendto(unsigned short _sport, WritablePacket *p_in)
 		daginfo->src_path.parse_re(str_local_addr);
 
 		daginfo->last = LAST_NODE_DEFAULT;
-		daginfo->hlim = hlim.get(_sport);
 
 		XID	source_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
 
-		XIDtoPort.set(source_xid, _sport); //Maybe change the mapping to XID->DAGinfo?
+		_conns.bind(source_xid, XID(), daginfo->handle);
 		addRoute(source_xid);
 	}
 
-	// Case of initial binding to only SID
-	if(daginfo->full_src_dag == false) {
-		daginfo->full_src_dag = true;
-		String str_local_addr = _local_addr.unparse_re();
-		XID front_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
-		String xid_string = front_xid.unparse();
-		str_local_addr = str_local_addr + " " + xid_string; //Make source DAG _local_addr:SID
-		daginfo->src_path.parse_re(str_local_addr);
-	}
-
+	// Rebuild the XIA header template if we moved, or this datagram goes
+	// somewhere new; otherwise the destination DAG is not even parsed
+	if (refresh_src_path(daginfo) || !daginfo->tmpl_valid
+		|| !daginfo->tmpl_ddag.equals(dest.data(), dest.length())) {
+		daginfo->tmpl_ddag = String(dest.data(), dest.length());
 
-	if(daginfo->src_path.unparse_re().length() != 0) {
-		//Recalculate source path
-		XID	source_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
-		String str_local_addr = _local_addr.unparse_re() + " " + source_xid.unparse(); //Make source DAG _local_addr:SID
-		daginfo->src_path.parse(str_local_addr);
+		XIAPath dst_path;
+		dst_path.parse(daginfo->tmpl_ddag);
+
+		// FIXME: shouldn't be a raw number
+		daginfo->tmpl.set_nxt(daginfo->sock_type == 3 ? daginfo->nxt : CLICK_XIA_NXT_TRN);
+		daginfo->tmpl.set_last(LAST_NODE_DEFAULT);
+		daginfo->tmpl.set_hlim(daginfo->hlim);
+		daginfo->tmpl.set_dst_path(dst_path);
+		daginfo->tmpl.set_src_path(daginfo->src_path);
+		daginfo->tmpl_valid = true;
 	}
 
-	portToDAGinfo.set(_sport, *daginfo);
-
-	daginfo = portToDAGinfo.get_pointer(_sport);
-
 //	_errh->debug("sent packet from %s, to %s\n", daginfo->src_path.unparse_re().c_str(), dest.c_str());
 
-	//Add XIA headers
-	XIAHeaderEncap xiah;
-
-	xiah.set_last(LAST_NODE_DEFAULT);
-	xiah.set_hlim(hlim.get(_sport));
-	xiah.set_dst_path(dst_path);
-	xiah.set_src_path(daginfo->src_path);
-
-	WritablePacket *just_payload_part = WritablePacket::make(p_in->headroom() + 1, (const void*)x_sendto_msg->payload().c_str(), pktPayloadSize, p_in->tailroom());
-
-	WritablePacket *p = NULL;
+	WritablePacket *p = WritablePacket::make(p_in->headroom() + 1, (const void*)x_sendto_msg->payload().data(), pktPayloadSize, p_in->tailroom());
 
 	// FIXME: shouldn't be a raw number
-	if (daginfo->sock_type == 3) {
-		xiah.set_nxt(nxt_xport.get(_sport));
-
-		xiah.set_plen(pktPayloadSize);
-		p = xiah.encap(just_payload_part, false);
-
-	} else {
-		xiah.set_nxt(CLICK_XIA_NXT_TRN);
-		xiah.set_plen(pktPayloadSize);
-
-		//p = xiah.encap(just_payload_part, true);
-		//click_chatter("\n\nSEND: %s ---> %s\n\n", daginfo->src_path.unparse_re().c_str(), dest.c_str());
-		//click_chatter("payload=%s len=%d \n\n", x_sendto_msg->payload().c_str(), pktPayloadSize);
-
+	if (daginfo->sock_type != 3) {
 		//Add XIA Transport headers
-		TransportHeaderEncap *thdr = TransportHeaderEncap::MakeDGRAMHeader(0); // length
-		p = thdr->encap(just_payload_part);
-
-		thdr->update();
-		xiah.set_plen(pktPayloadSize + thdr->hlen()); // XIA payload = transport header + transport-layer data
-
-		p = xiah.encap(p, false);
-		delete thdr;
+		p = p->push(_dgram_thdr.length());
+		memcpy(p->data(), _dgram_thdr.data(), _dgram_thdr.length());
+		SET_XIA_PAYLOAD_OFFSET_ANNO(p, 0);
 	}
 
+	// XIA payload = transport header (if any) + transport-layer data
+	p = daginfo->tmpl.encap(p, true);
+
 	output(NETWORK_PORT).push(p);
 
 	// removed due to multi peer collision problem
@@ -1996,11 +2148,11 @@ void XTRANSPORT::XrequestChunk(unsigned short _sport, WritablePacket *p_in)
 		dst_path.parse(dest);
 
 		//Find DAG info for this DGRAM
-		DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
+		DAGinfo *daginfo = _conns.port(_sport);
 
 		if(!daginfo) {
 			//No local SID bound yet, so bind one
-			daginfo = new DAGinfo();
+			daginfo = new_daginfo(_sport);
 		}
 
 		if (daginfo->initialized == false) {
@@ -2018,43 +2170,24 @@ void XTRANSPORT::XrequestChunk(unsigned short _sport, WritablePacket *p_in)
 			daginfo->src_path.parse_re(str_local_addr);
 
 			daginfo->last = LAST_NODE_DEFAULT;
-			daginfo->hlim = hlim.get(_sport);
 
 			XID	source_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
 
-			XIDtoPort.set(source_xid, _sport); //Maybe change the mapping to XID->DAGinfo?
+			_conns.bind(source_xid, XID(), daginfo->handle);
 			addRoute(source_xid);
 
 		}
 	
-		// Case of initial binding to only SID
-		if(daginfo->full_src_dag == false) {
-			daginfo->full_src_dag = true;
-			String str_local_addr = _local_addr.unparse_re();
-			XID front_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
-			String xid_string = front_xid.unparse();
-			str_local_addr = str_local_addr + " " + xid_string; //Make source DAG _local_addr:SID
-			daginfo->src_path.parse_re(str_local_addr);
-		}
-	
-		if(daginfo->src_path.unparse_re().length() != 0) {
-			//Recalculate source path
-			XID	source_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
-			String str_local_addr = _local_addr.unparse_re() + " " + source_xid.unparse(); //Make source DAG _local_addr:SID
-			daginfo->src_path.parse(str_local_addr);
-		}
-
-		portToDAGinfo.set(_sport, *daginfo);
-
-		daginfo = portToDAGinfo.get_pointer(_sport);
+		// Make source DAG _local_addr:SID, if we moved since the last request
+		refresh_src_path(daginfo);
 
-		_errh->debug("sent packet to %s, from %s\n", dest.c_str(), daginfo->src_path.unparse_re().c_str());
+		_errh->debug("sent packet to %s\n", dest.c_str());
 
 		//Add XIA headers
 		XIAHeaderEncap xiah;
 		xiah.set_nxt(CLICK_XIA_NXT_CID);
 		xiah.set_last(LAST_NODE_DEFAULT);
-		xiah.set_hlim(hlim.get(_sport));
+		xiah.set_hlim(daginfo->hlim);
 		xiah.set_dst_path(dst_path);
 		xiah.set_src_path(daginfo->src_path);
 		xiah.set_plen(pktPayloadSize);
@@ -2072,12 +2205,8 @@ void XTRANSPORT::XrequestChunk(unsigned short _sport, WritablePacket *p_in)
 		XID	source_sid = daginfo->src_path.xid(daginfo->src_path.destination_node());
 		XID	destination_cid = dst_path.xid(dst_path.destination_node());
 
-		XIDpair xid_pair;
-		xid_pair.set_src(source_sid);
-		xid_pair.set_dst(destination_cid);
-
-		// Map the src & dst XID pair to source port
-		XIDpairToPort.set(xid_pair, _sport);
+		// Map the src & dst XID pair to the socket
+		_conns.bind(source_sid, destination_cid, daginfo->handle);
 
 		// Store the packet into buffer
 		WritablePacket *copy_req_pkt = copy_cid_req_packet(p, daginfo);
@@ -2090,14 +2219,7 @@ void XTRANSPORT::XrequestChunk(unsigned short _sport, WritablePacket *p_in)
 		daginfo->XIDtoReadReq.set(destination_cid, false);
 
 		// Set timer
-		Timestamp cid_req_expiry  = Timestamp::now() + Timestamp::make_msec(_ackdelay_ms);
-		daginfo->XIDtoExpiryTime.set(destination_cid, cid_req_expiry);
-		daginfo->XIDtoTimerOn.set(destination_cid, true);
-
-		if (! _timer.scheduled() || _timer.expiry() >= cid_req_expiry )
-			_timer.reschedule_at(cid_req_expiry);
-
-		portToDAGinfo.set(_sport, *daginfo);
+		set_timer(_sport, CID_TIMER, Timestamp::now() + Timestamp::make_msec(_ackdelay_ms), destination_cid);
 
 		output(NETWORK_PORT).push(p);
 	}
@@ -2119,7 +2241,7 @@ void XTRANSPORT::XgetChunkStatus(unsigned short _sport)
 		dst_path.parse(dest);
 
 		//Find DAG info for this DGRAM
-		DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
+		DAGinfo *daginfo = _conns.port(_sport);
 
 		XID	destination_cid = dst_path.xid(dst_path.destination_node());
 
@@ -2178,13 +2300,12 @@ void XTRANSPORT::XreadChunk(unsigned short _sport)
 	dst_path.parse(dest);
 
 	//Find DAG info for this DGRAM
-	DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
+	DAGinfo *daginfo = _conns.port(_sport);
 
 	XID	destination_cid = dst_path.xid(dst_path.destination_node());
 
 	// Update the status of ReadCID reqeust
 	daginfo->XIDtoReadReq.set(destination_cid, true);
-	portToDAGinfo.set(_sport, *daginfo);
 
 	// Check the status of CID request
 	HashTable<XID, int>::iterator it;
@@ -2202,13 +2323,12 @@ void XTRANSPORT::XreadChunk(unsigned short _sport)
 			// Send the buffered pkt to upper layer
 
 			daginfo->XIDtoReadReq.set(destination_cid, false);
-			portToDAGinfo.set(_sport, *daginfo);
 
 			HashTable<XID, WritablePacket*>::iterator it2;
 			it2 = daginfo->XIDtoCIDresponsePkt.find(destination_cid);
 			copy = copy_cid_response_packet(it2->second, daginfo);
 
-			XIAHeader xiah(copy->xia_header());
+			XIAHeader xiah(copy);
 
 			//Unparse dag info
 			String src_path = xiah.src_path().unparse();
@@ -2233,8 +2353,6 @@ void XTRANSPORT::XreadChunk(unsigned short _sport)
 
 			it2->second->kill();
 			daginfo->XIDtoCIDresponsePkt.erase(it2);
-
-			portToDAGinfo.set(_sport, *daginfo);
 		}
 	}
 
@@ -2284,42 +2402,14 @@ void XTRANSPORT::XremoveChunk(unsigned short _sport)
 	output(API_PORT).push(UDPIPPrep(reply, _sport));
 }
 
-void XTRANSPORT::XputChunk(unsigned short _sport)
+/* Builds the packet that hands a chunk the API put to the cache */
+WritablePacket *XTRANSPORT::LocalPutPacket(unsigned short _sport, const String &cid,
+		const unsigned char *data, uint32_t length,
+		int32_t contextID, int32_t ttl, int32_t cacheSize, int32_t cachePolicy)
 {
-	
-	
-	click_chatter(">>putchunk message from API %d\n", _sport);
-	
-	
-	
-	xia::X_Putchunk_Msg *x_putchunk_msg = xia_socket_msg.mutable_x_putchunk();
-//			int hasCID = x_putchunk_msg->hascid();
-	int32_t contextID = x_putchunk_msg->contextid();
-	int32_t ttl = x_putchunk_msg->ttl();
-	int32_t cacheSize = x_putchunk_msg->cachesize();
-	int32_t cachePolicy = x_putchunk_msg->cachepolicy();
-
-	String pktPayload(x_putchunk_msg->payload().c_str(), x_putchunk_msg->payload().size());
-	String src;
-
-	/* Computes SHA1 Hash if user does not supply it */
-	char hexBuf[3];
-	int i = 0;
-	SHA1_ctx sha_ctx;
-	unsigned char digest[HASH_KEYSIZE];
-	SHA1_init(&sha_ctx);
-	SHA1_update(&sha_ctx, (unsigned char *)pktPayload.c_str() , pktPayload.length() );
-	SHA1_final(digest, &sha_ctx);
-	for(i = 0; i < HASH_KEYSIZE; i++) {
-		sprintf(hexBuf, "%02x", digest[i]);
-		src.append(const_cast<char *>(hexBuf), 2);
-	}
-
-	_errh->debug("ctxID=%d, length=%d, ttl=%d cid=%s\n", contextID, x_putchunk_msg->payload().size(), ttl, src.c_str());
-
 	//append local address before CID
 	String str_local_addr = _local_addr.unparse_re();
-	str_local_addr = "RE " + str_local_addr + " CID:" + src;
+	str_local_addr = "RE " + str_local_addr + " CID:" + cid;
 	XIAPath src_path;
 	src_path.parse(str_local_addr);
 
@@ -2341,27 +2431,57 @@ void XTRANSPORT::XputChunk(unsigned short _sport)
 	//Add XIA headers
 	XIAHeaderEncap xiah;
 	xiah.set_last(LAST_NODE_DEFAULT);
-	xiah.set_hlim(hlim.get(_sport));
+	DAGinfo *daginfo = _conns.port(_sport);
+	xiah.set_hlim(daginfo ? daginfo->hlim : HLIM_DEFAULT);
 	xiah.set_dst_path(_local_addr);
 	xiah.set_src_path(src_path);
 	xiah.set_nxt(CLICK_XIA_NXT_CID);
 
 	//Might need to remove more if another header is required (eg some control/DAG info)
 
-	WritablePacket *just_payload_part = WritablePacket::make(256, (const void*)pktPayload.c_str(), pktPayload.length(), 0);
+	WritablePacket *just_payload_part = WritablePacket::make(256, (const void*)data, length, 0);
 
 	WritablePacket *p = NULL;
-	int chunkSize = pktPayload.length();
-	ContentHeaderEncap  contenth(0, 0, pktPayload.length(), chunkSize, ContentHeader::OP_LOCAL_PUTCID,
+	ContentHeaderEncap  contenth(0, 0, length, length, ContentHeader::OP_LOCAL_PUTCID,
 								 contextID, ttl, cacheSize, cachePolicy);
 	p = contenth.encap(just_payload_part);
 	p = xiah.encap(p, true);
+	return p;
+}
+
+void XTRANSPORT::XputChunk(unsigned short _sport)
+{
+	
+	
+	click_chatter(">>putchunk message from API %d\n", _sport);
+	
+	
+	
+	xia::X_Putchunk_Msg *x_putchunk_msg = xia_socket_msg.mutable_x_putchunk();
+//			int hasCID = x_putchunk_msg->hascid();
+	int32_t contextID = x_putchunk_msg->contextid();
+	int32_t ttl = x_putchunk_msg->ttl();
+	int32_t cacheSize = x_putchunk_msg->cachesize();
+	int32_t cachePolicy = x_putchunk_msg->cachepolicy();
+
+	const std::string &pktPayload = x_putchunk_msg->payload();
+
+	/* Computes SHA1 Hash if user does not supply it */
+	unsigned char digest[HASH_KEYSIZE];
+	XIASHA1::digest((const unsigned char *)pktPayload.data(), pktPayload.size(), digest);
+	String src = XIASHA1::hex(digest);
+
+	_errh->debug("ctxID=%d, length=%d, ttl=%d cid=%s\n", contextID, pktPayload.size(), ttl, src.c_str());
+
+	WritablePacket *p = LocalPutPacket(_sport, src, (const unsigned char *)pktPayload.data(), pktPayload.size(),
+									   contextID, ttl, cacheSize, cachePolicy);
 
 	_errh->debug("sent packet to cache");
 	
 	output(CACHE_PORT).push(p);
 
 	// (for Ack purpose) Reply with a packet with the destination port=source port
+	// The reply carries the chunk's length rather than the chunk itself
 	struct timeval timestamp;
 	gettimeofday(&timestamp, NULL);
 	xia::XSocketMsg _socketResponse;
@@ -2374,12 +2494,124 @@ void XTRANSPORT::XputChunk(unsigned short _sport)
 //	_msg->set_hascid(1);
 	_msg->set_cachepolicy(0);
 	_msg->set_cachesize(0);
-	_msg->set_payload(x_putchunk_msg->payload().c_str(), x_putchunk_msg->payload().size());
+	_msg->set_payload("");
+	_msg->set_length(pktPayload.size());
+
+	std::string p_buf1;
+	_socketResponse.SerializeToString(&p_buf1);
+	WritablePacket *reply = WritablePacket::make(256, p_buf1.c_str(), p_buf1.size(), 0);
+	output(API_PORT).push(UDPIPPrep(reply, _sport));
+}
+
+/*
+ * Puts a batch of chunks with one message and one reply.  The chunks are
+ * hashed together, several at a time, and copied into packets for the cache;
+ * the reply, which carries only their CIDs, goes out before the packets go
+ * to the cache, so the API can fill its next batch while the cache stores
+ * this one.  Chunks in a shared memory object are copied out of it with
+ * pread() first.
+ */
+void XTRANSPORT::XputChunks(unsigned short _sport)
+{
+	xia::X_Putchunks_Msg *x_putchunks_msg = xia_socket_msg.mutable_x_putchunks();
+	int32_t contextID = x_putchunks_msg->contextid();
+	int32_t ttl = x_putchunks_msg->ttl();
+	int32_t cacheSize = x_putchunks_msg->cachesize();
+	int32_t cachePolicy = x_putchunks_msg->cachepolicy();
+
+	bool shared = x_putchunks_msg->has_shm();
+	int n = shared ? x_putchunks_msg->length_size() : x_putchunks_msg->payload_size();
+	int status = 0;
+	unsigned char *shm_data = 0;
+	Vector<const unsigned char *> data;
+	Vector<size_t> length;
+
+	if (n > MAX_PUT_BATCH || (shared && x_putchunks_msg->offset_size() != n))
+		status = EINVAL;
+	else if (shared) {
+		// The chunks are copied out with pread() rather than mapped: the
+		// sender owns the object, and a mapping it truncated under us
+		// would kill the router with SIGBUS.  A short read fails the batch.
+		int fd = shm_open(x_putchunks_msg->shm().c_str(), O_RDONLY, 0);
+		struct stat st;
+		uint64_t total = 0;
+		if (fd < 0)
+			status = errno;
+		else if (fstat(fd, &st) < 0)
+			status = errno;
+		else {
+			uint64_t shm_size = st.st_size;
+			for (int i = 0; i < n && status == 0; i++) {
+				uint64_t off = x_putchunks_msg->offset(i);
+				uint32_t len = x_putchunks_msg->length(i);
+				if (off > shm_size || len > shm_size - off)
+					status = EINVAL;
+				total += len;
+			}
+			// the chunks of a batch don't overlap
+			if (total > shm_size)
+				status = EINVAL;
+		}
+		if (status == 0) {
+			shm_data = new unsigned char[total + 1];
+			unsigned char *d = shm_data;
+			for (int i = 0; i < n && status == 0; i++) {
+				uint32_t len = x_putchunks_msg->length(i);
+				ssize_t r = pread(fd, d, len, x_putchunks_msg->offset(i));
+				if (r < 0)
+					status = errno;
+				else if ((uint32_t) r != len)
+					status = EINVAL;
+				data.push_back(d);
+				length.push_back(len);
+				d += len;
+			}
+		}
+		if (fd >= 0)
+			close(fd);
+	} else
+		for (int i = 0; i < n; i++) {
+			data.push_back((const unsigned char *)x_putchunks_msg->payload(i).data());
+			length.push_back(x_putchunks_msg->payload(i).size());
+		}
+
+	xia::XSocketMsg _socketResponse;
+	_socketResponse.set_type(xia::XPUTCHUNKS);
+	xia::X_Putchunks_Msg *_msg = _socketResponse.mutable_x_putchunks();
+	_msg->set_contextid(contextID);
+	_msg->set_ttl(ttl);
+	_msg->set_cachepolicy(0);
+	_msg->set_cachesize(0);
+	_msg->set_batch(x_putchunks_msg->batch());
+
+	Vector<Packet *> packets;
+	if (status == 0 && n > 0) {
+		unsigned char (*digest)[XIASHA1::DIGEST_LEN] = new unsigned char[n][XIASHA1::DIGEST_LEN];
+		XIASHA1::digest_many(n, data.begin(), length.begin(), digest);
+		char hex[XIASHA1::HEX_LEN];
+		for (int i = 0; i < n; i++) {
+			XIASHA1::hex(digest[i], hex);
+			_msg->add_cid(hex, XIASHA1::HEX_LEN);
+			packets.push_back(LocalPutPacket(_sport, String(hex, XIASHA1::HEX_LEN), data[i], length[i],
+											 contextID, ttl, cacheSize, cachePolicy));
+		}
+		delete[] digest;
+	}
+	delete[] shm_data;
+
+	struct timeval timestamp;
+	gettimeofday(&timestamp, NULL);
+	_msg->set_timestamp(timestamp.tv_sec);
+	_msg->set_status(status);
+	_errh->debug("putchunks ctxID=%d, chunks=%d, shared=%d, status=%d\n", contextID, n, shared, status);
 
 	std::string p_buf1;
 	_socketResponse.SerializeToString(&p_buf1);
 	WritablePacket *reply = WritablePacket::make(256, p_buf1.c_str(), p_buf1.size(), 0);
 	output(API_PORT).push(UDPIPPrep(reply, _sport));
+
+	for (int i = 0; i < packets.size(); i++)
+		output(CACHE_PORT).push(packets[i]);
 }
 
 
@@ -2408,11 +2640,11 @@ void XTRANSPORT::XpushChunkto(unsigned short _sport, WritablePacket *p_in)
 	dst_path.parse(dest);
 
 	//Find DAG info for this DGRAM
-	DAGinfo *daginfo = portToDAGinfo.get_pointer(_sport);
+	DAGinfo *daginfo = _conns.port(_sport);
 
 	if(!daginfo) {
 		//No local SID bound yet, so bind one
-		daginfo = new DAGinfo();
+		daginfo = new_daginfo(_sport);
 	}
 
 	if (daginfo->initialized == false) {
@@ -2435,11 +2667,10 @@ void XTRANSPORT::XpushChunkto(unsigned short _sport, WritablePacket *p_in)
 		daginfo->src_path.parse_re(str_local_addr);
 
 		daginfo->last = LAST_NODE_DEFAULT;
-		daginfo->hlim = hlim.get(_sport);
 
 		XID source_xid = daginfo->src_path.xid(daginfo->src_path.destination_node());
 
-		XIDtoPort.set(source_xid, _sport); //Maybe change the mapping to XID->DAGinfo?
+		_conns.bind(source_xid, XID(), daginfo->handle);
 		addRoute(source_xid);
 
 	}
@@ -2463,10 +2694,6 @@ void XTRANSPORT::XpushChunkto(unsigned short _sport, WritablePacket *p_in)
 		daginfo->src_path.parse(str_local_addr);
 	}
 
-	portToDAGinfo.set(_sport, *daginfo);
-
-	daginfo = portToDAGinfo.get_pointer(_sport);
-
 	_errh->debug("sent packet to %s, from %s\n", dest.c_str(), daginfo->src_path.unparse_re().c_str());
 
 	click_chatter("PUSHCID: %s",x_pushchunkto_msg->cid().c_str());
@@ -2483,7 +2710,7 @@ void XTRANSPORT::XpushChunkto(unsigned short _sport, WritablePacket *p_in)
 	XIAHeaderEncap xiah;
 	xiah.set_nxt(CLICK_XIA_NXT_CID);
 	xiah.set_last(LAST_NODE_DEFAULT);
-	xiah.set_hlim(hlim.get(_sport));
+	xiah.set_hlim(daginfo->hlim);
 	xiah.set_dst_path(dst_path);
 	xiah.set_src_path(cid_src_path); //FIXME: is this the correct way to do it? Do we need SID? AD->HID->SID->CID 
 	xiah.set_plen(pktPayloadSize);
@@ -2512,15 +2739,8 @@ void XTRANSPORT::XpushChunkto(unsigned short _sport, WritablePacket *p_in)
 // 	XID	source_cid = daginfo->src_path.xid(cid_src_path.destination_node());
 	XID	destination_sid = dst_path.xid(dst_path.destination_node());
 
-	XIDpair xid_pair;
-	xid_pair.set_src(source_cid);
-	xid_pair.set_dst(destination_sid);
-
-	// Map the src & dst XID pair to source port
-	XIDpairToPort.set(xid_pair, _sport);
-
-
-	portToDAGinfo.set(_sport, *daginfo);
+	// Map the src & dst XID pair to the socket
+	_conns.bind(source_cid, destination_sid, daginfo->handle);
 
 	output(NETWORK_PORT).push(p);
 }
@@ -2530,5 +2750,5 @@ CLICK_ENDDECLS
 
 EXPORT_ELEMENT(XTRANSPORT)
 ELEMENT_REQUIRES(userlevel)
-ELEMENT_REQUIRES(XIAContentModule)
+ELEMENT_REQUIRES(XIAContentModule XIASHA1 XIACongestionControl)
 ELEMENT_MT_SAFE(XTRANSPORT)
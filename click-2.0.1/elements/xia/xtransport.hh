@@ -11,6 +11,9 @@
 #include <click/xiapath.hh>
 #include <clicknet/xia.h>
 #include "xiacontentmodule.hh"
+#include "xiacongestion.hh"
+#include "xiaconntable.hh"
+#include "xiaexpirywheel.hh"
 #include "xiaxidroutetable.hh"
 #include <clicknet/udp.h>
 #include <click/string.hh>
@@ -36,6 +39,7 @@ using namespace std;
 #define UNUSED(x) ((void)(x))
 
 #define ACK_DELAY			300
+#define DELAYED_ACK_DELAY	40	// msec a receiver may hold the ACK for a lone in-order packet
 #define TEARDOWN_DELAY		240000
 #define HLIM_DEFAULT		250
 #define LAST_NODE_DEFAULT	-1
@@ -48,7 +52,9 @@ using namespace std;
 #define XSOCKET_RAW		3	// Raw XIA socket
 #define XSOCKET_CHUNK	4	// Content Chunk transport (CID)
 
-#define MAX_WIN_SIZE 100
+#define MAX_WIN_SIZE 256	// most data packets outstanding or held out of order (a multiple of 32)
+
+#define MAX_PUT_BATCH 1024	// chunks in one XPUTCHUNKS message
 
 #define MAX_CONNECT_TRIES	 30
 #define MAX_RETRANSMIT_TRIES 100
@@ -79,6 +85,11 @@ output[3]: To cache for putCID
 output[2]: Network Tx data port 
 output[0]: Socket (API) Tx data port
 
+CONGESTION keyword: congestion control for new XSOCK_STREAM connections,
+"newreno" (the default) or "cubic"; see XIACongestionControl.
+"congestion" read handler: one line per stream connection that has sent
+data, with its window, RTT estimates, and retransmission counters.
+
 Might need other things to handle chunking
 */
 
@@ -98,6 +109,7 @@ class XTRANSPORT : public Element {
     XID local_4id() { return _local_4id; };
     void add_handlers();
     static int write_param(const String &, Element *, void *vparam, ErrorHandler *);
+    static String read_handler(Element *e, void *thunk);
     
     int initialize(ErrorHandler *);
     void run_timer(Timer *timer);
@@ -113,13 +125,38 @@ class XTRANSPORT : public Element {
     SyslogErrorHandler *_errh;
 
     Timer _timer;
+
+    // every pending SYN retransmission, data retransmission, delayed ACK,
+    // teardown, and chunk request retransmission is an entry in _timers,
+    // in msec; _timer fires when the next one is due
+    enum TimerKind { SYN_TIMER = 0, DATA_TIMER, ACK_TIMER, TEARDOWN_TIMER, CID_TIMER };
+    struct TimerKey {
+	unsigned short port;
+	int kind;
+	XID cid; // CID_TIMER only
+
+	TimerKey() : port(0), kind(0) { }
+	TimerKey(unsigned short p, int k, const XID &c = XID()) : port(p), kind(k), cid(c) { }
+	uint32_t hashcode() const { return cid.hashcode() ^ ((uint32_t) port << 3) ^ kind; }
+	bool operator==(const TimerKey &x) const {
+	    return port == x.port && kind == x.kind && cid == x.cid;
+	}
+    };
+    XIAExpiryWheel<TimerKey> _timers;
+
+    void set_timer(unsigned short port, TimerKind kind, const Timestamp &when, const XID &cid = XID());
+    void cancel_timer(unsigned short port, TimerKind kind, const XID &cid = XID()) {
+	_timers.remove(TimerKey(port, kind, cid));
+    }
     
     unsigned _ackdelay_ms;
     unsigned _teardown_wait_ms;
+    XIACongestionControl::Algorithm _congestion;
     
     uint32_t _cid_type, _sid_type;
     XID _local_hid;
     XIAPath _local_addr;
+    uint32_t _addr_version; // bumped whenever _local_addr changes
     XID _local_4id;
     XID _null_4id;
     bool _is_dual_stack_router;
@@ -133,17 +170,22 @@ class XTRANSPORT : public Element {
     Packet* UDPIPPrep(Packet *, int);
     
     struct DAGinfo{
-    DAGinfo(): port(0), isConnected(false), initialized(false), full_src_dag(false), timer_on(false), synack_waiting(false), dataack_waiting(false), teardown_waiting(false) {};
+    DAGinfo(): port(0), handle(0), nxt(CLICK_XIA_NXT_TRN), hlim(HLIM_DEFAULT), isConnected(false), initialized(false), full_src_dag(false), src_version(0), tmpl_valid(false), send_head(0), send_tail(0), cc(0), sack_high(0), rexmit_next(0), pipe(0), transmitting(false), recv_high(0), recv_last(0), unacked(0), ack_pending(false), synack_waiting(false), dataack_waiting(false), teardown_waiting(false) {};
     unsigned short port;
+    uint32_t handle; // names it in _conns
     XIAPath src_path;
     XIAPath dst_path;
-    int nxt;
+    int nxt; // next header of raw packets (socket option 2)
     int last;
-    uint8_t hlim;
+    uint8_t hlim; // hop limit (socket option 1)
     bool isConnected;
     bool isAcceptSocket;
     bool initialized;
     bool full_src_dag; // bind to full dag or just to SID  
+    uint32_t src_version; // the _addr_version src_path was last pointed at, 0 if none
+    XIAHeaderEncap tmpl; // XIA header of the packets it sends; see stream_header()
+    bool tmpl_valid; // tmpl matches src_path, dst_path (or tmpl_ddag), hlim, and nxt
+    String tmpl_ddag; // for a datagram socket, the destination tmpl was built for
     int sock_type; // 0: Reliable transport (SID), 1: Unreliable transport (SID), 2: Content Chunk transport (CID)
     String sdag;
     String ddag;
@@ -152,56 +194,96 @@ class XTRANSPORT : public Element {
 
     //Vector<WritablePacket*> pkt_buf;
     WritablePacket *syn_pkt;
-    WritablePacket *sent_pkt[MAX_WIN_SIZE];
-    HashTable<XID, WritablePacket*> XIDtoCIDreqPkt;
-    HashTable<XID, Timestamp> XIDtoExpiryTime;
-    HashTable<XID, bool> XIDtoTimerOn;
+    Packet *sent_pkt[MAX_WIN_SIZE]; // clones of the packets sent, for retransmission
+    WritablePacket *send_head; // data packets waiting for room in the window, linked by next()
+    WritablePacket *send_tail;
+    XIACongestionControl *cc; // created by the first Xsend
+    uint32_t sacked[MAX_WIN_SIZE / 32]; // bitmap of sent packets the receiver has SACKed
+    uint32_t sack_high; // one past the highest SACKed sequence #
+    uint32_t rexmit_next; // holes below this were already resent in this recovery
+    uint32_t pipe; // packets in [base, next_seqnum) that count as in the network; see in_pipe()
+    bool transmitting; // in TransmitPending()
+    Packet *recv_pkt[MAX_WIN_SIZE]; // out-of-order packets waiting for the ones before them
+    uint32_t recv_high; // one past the highest sequence # in recv_pkt
+    uint32_t recv_last; // the sequence # of the latest out-of-order packet
+    int unacked; // in-order packets received since the last ACK
+    bool ack_pending; // an ACK_TIMER is set
+    HashTable<XID, WritablePacket*> XIDtoCIDreqPkt; // each has a CID_TIMER set
     HashTable<XID, int> XIDtoStatus; // Content-chunk request status... 1: waiting to be read, 0: waiting for chunk response, -1: failed
     HashTable<XID, bool> XIDtoReadReq; // Indicates whether ReadCID() is called for a specific CID
     HashTable<XID, WritablePacket*> XIDtoCIDresponsePkt;
-    uint32_t seq_num;
+    uint32_t seq_num; // the sequence # for the next packet from the application
     uint32_t ack_num;
     uint32_t base; // the sequence # of the oldest unacked packet
-    uint32_t next_seqnum; // the smallest unused sequence # (i.e., the sequence # of the next packet to be sent)
+    uint32_t next_seqnum; // the sequence # of the next packet to be sent (less than high_seqnum after a timeout)
+    uint32_t high_seqnum; // one past the highest sequence # sent so far
     uint32_t expected_seqnum; // the sequence # of the next in-order packet (this is used at receiver-side)
-    bool timer_on;
-    Timestamp expiry;
-    bool synack_waiting;
-    bool dataack_waiting;
-    bool teardown_waiting;
-    Timestamp teardown_expiry;
+    bool synack_waiting; // a SYN_TIMER is set
+    bool dataack_waiting; // a DATA_TIMER is set
+    bool teardown_waiting; // a TEARDOWN_TIMER is set
+
+    bool is_sacked(uint32_t seq) const {
+	return sacked[(seq % MAX_WIN_SIZE) / 32] & (1U << (seq % 32));
+    }
+    void set_sacked(uint32_t seq, bool on) {
+	if (on)
+	    sacked[(seq % MAX_WIN_SIZE) / 32] |= 1U << (seq % 32);
+	else
+	    sacked[(seq % MAX_WIN_SIZE) / 32] &= ~(1U << (seq % 32));
+    }
+    // whether sent packet seq is in the network (the "pipe" of RFC 6675):
+    // not if it was SACKed, nor if it is a hole in fast recovery that is
+    // presumed lost and was not resent yet
+    bool in_pipe(uint32_t seq) const {
+	return !is_sacked(seq) && !(cc->recovering() && seq >= rexmit_next && seq < sack_high);
+    }
+    void count_pipe() {
+	pipe = 0;
+	for (uint32_t seq = base; seq < next_seqnum; seq++)
+	    if (in_pipe(seq))
+		pipe++;
+    }
     } ;
  
     list<int> xcmp_listeners;   // list of ports wanting xcmp notifications
 
-    HashTable<XID, unsigned short> XIDtoPort;
-    HashTable<XIDpair , unsigned short> XIDpairToPort;
-    HashTable<unsigned short, DAGinfo> portToDAGinfo;
+    // every DAGinfo, found by API port or, for received packets, by
+    // (local XID, remote XID): a stream connection by its two SIDs, a chunk
+    // request by its SID and CID, and a bound socket by its XID and XID()
+    XIAConnTable<DAGinfo> _conns;
+    DAGinfo *new_daginfo(unsigned short port);
+
+    // Data packets are built from templates instead of from DAG strings.
+    // Every DATA and every DGRAM transport header is laid out alike, so one
+    // copy of each serves all sockets, with the DATA sequence numbers patched
+    // in at the offsets below; each socket keeps its own XIA header in tmpl.
+    String _data_thdr;
+    int _data_seq_offset;
+    int _data_ack_offset;
+    String _dgram_thdr;
+
+    bool refresh_src_path(DAGinfo *daginfo);
+    const XIAHeaderEncap &stream_header(DAGinfo *daginfo);
+    WritablePacket *stream_packet(DAGinfo *daginfo, const void *data, uint32_t len, uint32_t seq, uint32_t ack);
+    void update_peer(DAGinfo *daginfo, const XIAHeader &xiah);
+
     HashTable<XID, unsigned short> XIDtoPushPort;
-    
-    
-    HashTable<unsigned short, bool> portToActive;
     HashTable<XIDpair , bool> XIDpairToConnectPending;
 
-    // FIXME: can these be rolled into the daginfo structure?
-	HashTable<unsigned short, int> nxt_xport;
-    HashTable<unsigned short, int> hlim;
-
-    queue<DAGinfo> pending_connection_buf;
+    queue<uint32_t> pending_connection_buf; // handles of connections waiting for Xaccept
     
     atomic_uint32_t _id;
     bool _cksum;
     XIAXIDRouteTable *_routeTable;
     
     //modify routing table
+    static const XIARouteData localRoute;
     void addRoute(const XID &sid) {
-		String cmd=sid.unparse() + " " + String(DESTINED_FOR_LOCALHOST);
-        HandlerCall::call_write(_routeTable, "add", cmd);
+        _routeTable->insert(sid, localRoute, false);
     }   
         
     void delRoute(const XID &sid) {
-        String cmd= sid.unparse();
-        HandlerCall::call_write(_routeTable, "remove", cmd);
+        _routeTable->erase(sid);
     }
  
 
@@ -236,12 +318,19 @@ class XTRANSPORT : public Element {
     void Xgetsockname(unsigned short _sport);    
     void Xisdualstackrouter(unsigned short _sport);
     void Xsend(unsigned short _sport, WritablePacket *p_in);
+    void TransmitPending(DAGinfo *daginfo);
+    void SendACK(DAGinfo *daginfo);
+    void SendToApplication(unsigned short _dport, Packet *p);
     void Xsendto(unsigned short _sport, WritablePacket *p_in);
     void XrequestChunk(unsigned short _sport, WritablePacket *p_in);
     void XgetChunkStatus(unsigned short _sport);
     void XreadChunk(unsigned short _sport);
     void XremoveChunk(unsigned short _sport);
     void XputChunk(unsigned short _sport);
+    void XputChunks(unsigned short _sport);
+    WritablePacket *LocalPutPacket(unsigned short _sport, const String &cid,
+		const unsigned char *data, uint32_t length,
+		int32_t contextID, int32_t ttl, int32_t cacheSize, int32_t cachePolicy);
     void XpushChunkto(unsigned short _sport, WritablePacket *p_in);
     void XbindPush(unsigned short _sport);
 };
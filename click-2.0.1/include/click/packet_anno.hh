@@ -151,12 +151,31 @@
 #define SET_DST_PORT_ANNO(p, v)        ((p)->set_anno_u16(DST_PORT_ANNO_OFFSET, (v)))
 
 #if HAVE_XIA
-// bytes 56-63
+// byte 56
 #define XIA_NEXT_PATH_ANNO_OFFSET      56
-#define XIA_NEXT_PATH_ANNO_SIZE        8
+#define XIA_NEXT_PATH_ANNO_SIZE        1
 #  define XIA_NEXT_PATH_ANNO(p)	((p)->anno_u8(XIA_NEXT_PATH_ANNO_OFFSET))
 #  define SET_XIA_NEXT_PATH_ANNO(p, v) ((p)->set_anno_u8(XIA_NEXT_PATH_ANNO_OFFSET, (v)))
 
+// byte 57: type of the payload, the nxt value that ends the extension header
+// chain; set with XIA_PAYLOAD_OFFSET_ANNO
+#define XIA_PAYLOAD_NXT_ANNO_OFFSET    57
+#define XIA_PAYLOAD_NXT_ANNO_SIZE      1
+#  define XIA_PAYLOAD_NXT_ANNO(p)	((p)->anno_u8(XIA_PAYLOAD_NXT_ANNO_OFFSET))
+#  define SET_XIA_PAYLOAD_NXT_ANNO(p, v) ((p)->set_anno_u8(XIA_PAYLOAD_NXT_ANNO_OFFSET, (v)))
+
+// bytes 58-59: payload offset from the start of the XIA header, 0 if unknown
+#define XIA_PAYLOAD_OFFSET_ANNO_OFFSET 58
+#define XIA_PAYLOAD_OFFSET_ANNO_SIZE   2
+#  define XIA_PAYLOAD_OFFSET_ANNO(p)	((p)->anno_u16(XIA_PAYLOAD_OFFSET_ANNO_OFFSET))
+#  define SET_XIA_PAYLOAD_OFFSET_ANNO(p, v) ((p)->set_anno_u16(XIA_PAYLOAD_OFFSET_ANNO_OFFSET, (v)))
+
+// bytes 60-63
+#define XIA_FASTPATH_GEN_ANNO_OFFSET   60
+#define XIA_FASTPATH_GEN_ANNO_SIZE     4
+#define XIA_FASTPATH_GEN_ANNO(p)	((p)->anno_u32(XIA_FASTPATH_GEN_ANNO_OFFSET))
+#define SET_XIA_FASTPATH_GEN_ANNO(p, v) ((p)->set_anno_u32(XIA_FASTPATH_GEN_ANNO_OFFSET, (v)))
+
 // bytes 64-87
 #define XIA_NEXT_HOP_NEIGHBOR_ANNO_OFFSET      64
 #define XIA_NEXT_HOP_NEIGHBOR_ANNO_SIZE        24
@@ -5,7 +5,6 @@
 #include <click/glue.hh>
 #include <clicknet/xia.h>
 #include <click/packet.hh>
-#include <click/hashtable.hh>
 #include <click/xiaheader.hh>
 #include <click/xiaextheader.hh>
 
@@ -17,36 +16,17 @@ class ContentHeader : public XIAGenericExtHeader { public:
     ContentHeader(const struct click_xia_ext* hdr) :XIAGenericExtHeader(hdr) {};
     ContentHeader(const Packet* p):XIAGenericExtHeader(p) {};
 
-    uint8_t opcode() { if (!exists(OPCODE)) return 0 ; return *(const uint8_t*)_map[OPCODE].data();};  
+    uint8_t opcode() const { return get<uint8_t>(OPCODE); }
 
-    bool exists(uint8_t key) { return (_map.find(key)!=_map.end()); }
+    uint16_t offset() const { return get<uint16_t>(OFFSET); }
+    uint32_t chunk_offset() const { return get<uint32_t>(CHUNK_OFFSET); }
+    uint16_t length() const { return get<uint16_t>(LENGTH); }
+    uint32_t chunk_length() const { return get<uint32_t>(CHUNK_LENGTH); }
 
-    
-    uint16_t offset() { if (!exists(OFFSET)) return 0; return *(const uint16_t*)_map[OFFSET].data();};  
-    uint32_t chunk_offset() { if (!exists(CHUNK_OFFSET)) return 0; return *(const uint32_t*)_map[CHUNK_OFFSET].data();};  
-    uint16_t length() { if (!exists(LENGTH)) return 0; return *(const uint16_t*)_map[LENGTH].data();};  
-    uint32_t chunk_length() { if (!exists(CHUNK_LENGTH)) return 0; return *(const uint32_t*)_map[CHUNK_LENGTH].data();};  
-    
-    uint32_t contextID() { 
-        if (!exists(CONTEXT_ID)) 
-            return 0; 
-        return *(const uint32_t*)_map[CONTEXT_ID].data();
-    };  
-    uint32_t ttl() { 
-        if (!exists(TTL)) 
-            return 0; 
-        return *(const uint32_t*)_map[TTL].data();
-    };  
-    uint32_t cacheSize() { 
-        if (!exists(CACHE_SIZE)) 
-            return 0; 
-        return *(const uint32_t*)_map[CACHE_SIZE].data();
-    };  
-    uint32_t cachePolicy() { 
-        if (!exists(CACHE_POLICY)) 
-            return 0; 
-        return *(const uint32_t*)_map[CACHE_POLICY].data();
-    };  
+    uint32_t contextID() const { return get<uint32_t>(CONTEXT_ID); }
+    uint32_t ttl() const { return get<uint32_t>(TTL); }
+    uint32_t cacheSize() const { return get<uint32_t>(CACHE_SIZE); }
+    uint32_t cachePolicy() const { return get<uint32_t>(CACHE_POLICY); }
     
     enum { OPCODE, OFFSET, CHUNK_OFFSET, LENGTH, CHUNK_LENGTH, CONTEXT_ID, TTL, CACHE_SIZE, CACHE_POLICY}; 
     enum { OP_REQUEST=1, OP_RESPONSE, OP_LOCAL_PUTCID, OP_REDUNDANT_REQUEST, OP_LOCAL_REMOVECID, OP_PUSH};
@@ -5,12 +5,13 @@
 #include <click/glue.hh>
 #include <clicknet/xia.h>
 #include <click/packet.hh>
-#include <click/hashtable.hh>
 #include <click/xiaheader.hh>
 
 CLICK_DECLS
 
 // A read-only helper class for XIA extension headers.
+// Values are read in place: constructing one indexes the key-value data in a
+// fixed table, without allocating.
 class XIAGenericExtHeader { public:
     XIAGenericExtHeader(const XIAGenericExtHeader& r); // copy constructor
 
@@ -23,7 +24,14 @@ class XIAGenericExtHeader { public:
 
     inline const uint8_t& hlen() const;     // header length
 
-    inline const HashTable<uint8_t, String>& map() const;  // return key-value map
+    inline bool exists(uint8_t key) const;              // check if the key is present
+
+    inline const uint8_t* value(uint8_t key) const;     // value of the key (NULL if absent)
+
+    inline size_t value_length(uint8_t key) const;      // value length (0 if absent)
+
+    // value of the key as a T in host layout (0 if absent or too short)
+    template <typename T> inline T get(uint8_t key) const;
 
     inline const uint8_t* payload() const;  // payload
 
@@ -33,7 +41,7 @@ protected:
 protected:
     const struct click_xia_ext* _hdr;
 
-    HashTable<uint8_t, String> _map;        // parsed key-value map
+    uint8_t _off[256];                      // key -> value offset in _hdr (0 if absent)
 
     inline XIAGenericExtHeader() : _hdr(NULL) { }  // for helping WritableXIAGenericExtHeader hide dangerous construction
 
@@ -65,9 +73,12 @@ private:
 
 
 // An XIA extension header encapsulation helper.
+// The header is built in fixed buffers inside the object, so an encap on the
+// stack allocates nothing.
 class XIAGenericExtHeaderEncap { public:
     XIAGenericExtHeaderEncap();
     XIAGenericExtHeaderEncap(const XIAGenericExtHeaderEncap& r);
+    XIAGenericExtHeaderEncap& operator=(const XIAGenericExtHeaderEncap& r);
     virtual ~XIAGenericExtHeaderEncap();
 
     XIAGenericExtHeaderEncap(const XIAGenericExtHeader& r);
@@ -79,7 +90,9 @@ class XIAGenericExtHeaderEncap { public:
 
     void set_nxt(uint8_t nxt);                  // set next header type
 
-    inline HashTable<uint8_t, String>& map();   // settable key-value map
+    // set the value of the key (need to manually call update() afterwards)
+    void set(uint8_t key, const void* value, size_t len);
+    inline void set(uint8_t key, const String& value);
 
     void update();                              // update internel header structure
 
@@ -87,8 +100,17 @@ class XIAGenericExtHeaderEncap { public:
     WritablePacket* encap(Packet* p_in) const;
 
 private:
-    struct click_xia_ext* _hdr;
-    HashTable<uint8_t, String> _map;            // current key-value map
+    enum { MAX_HLEN = 255, NO_VALUE = 0xFF };
+
+    struct click_xia_ext* _hdr;                 // points into _buf
+    uint8_t _buf[MAX_HLEN + 1];                 // the built header
+
+    uint8_t _vlen[256];                         // key -> value length (NO_VALUE if unset)
+    uint8_t _voff[256];                         // key -> value offset in _vals
+    uint8_t _vals[MAX_HLEN];                    // values, in the order they were set
+    int _vals_len;
+
+    void copy(const XIAGenericExtHeaderEncap& r);
 };
 
 
@@ -110,10 +132,33 @@ XIAGenericExtHeader::hlen() const
     return _hdr->hlen;
 }
 
-inline const HashTable<uint8_t, String>&
-XIAGenericExtHeader::map() const
+inline bool
+XIAGenericExtHeader::exists(uint8_t key) const
 {
-    return _map;
+    return _off[key] != 0;
+}
+
+inline const uint8_t*
+XIAGenericExtHeader::value(uint8_t key) const
+{
+    return _off[key] ? reinterpret_cast<const uint8_t*>(_hdr) + _off[key] : NULL;
+}
+
+inline size_t
+XIAGenericExtHeader::value_length(uint8_t key) const
+{
+    // the key-value length byte sits just before the key
+    return _off[key] ? reinterpret_cast<const uint8_t*>(_hdr)[_off[key] - 2] - 1 : 0;
+}
+
+template <typename T>
+inline T
+XIAGenericExtHeader::get(uint8_t key) const
+{
+    T v = 0;
+    if (value_length(key) >= sizeof(T))
+        memcpy(&v, value(key), sizeof(T));
+    return v;
 }
 
 inline const uint8_t*
@@ -140,10 +185,10 @@ WritableXIAGenericExtHeader::payload()
     return const_cast<uint8_t*>(this->XIAGenericExtHeader::payload());
 }
 
-inline HashTable<uint8_t, String>&
-XIAGenericExtHeaderEncap::map()
+inline void
+XIAGenericExtHeaderEncap::set(uint8_t key, const String& value)
 {
-    return _map;
+    set(key, value.data(), value.length());
 }
 
 CLICK_ENDDECLS
@@ -5,6 +5,7 @@
 #include <click/glue.hh>
 #include <clicknet/xia.h>
 #include <click/packet.hh>
+#include <click/packet_anno.hh>
 #include <click/xiapath.hh>
 
 CLICK_DECLS
@@ -14,7 +15,7 @@ class XIAHeader { public:
     inline XIAHeader(const XIAHeader& r);
 
     inline XIAHeader(const struct click_xia* hdr);
-    inline XIAHeader(const Packet* p);
+    inline XIAHeader(const Packet* p);      // uses the payload offset MarkXIAHeader cached, if any
 
     static inline size_t hdr_size(uint8_t dsnode);  // header size with total dsnode nodes
 
@@ -32,15 +33,30 @@ class XIAHeader { public:
 
     XIAPath dst_path() const;               // destination path (expensive call)
     XIAPath src_path() const;               // source path (expensive call)
+    inline XIAPathView dst_path_view() const;   // destination path, read in place
+    inline XIAPathView src_path_view() const;   // source path, read in place
 
     inline const uint8_t* next_header() const;  // next header 
 
-    const uint8_t* payload() const;         // payload (expensive call; need to traverse extension headers)
+    inline const uint8_t* payload() const;  // payload (traverses extension headers unless the offset is cached)
+
+    uint8_t payload_nxt() const;            // payload type (the nxt that ends the extension header chain)
+
+    // walk the extension header chain of the len-byte header at hdr;
+    // returns the payload offset and its type, or -1 if the chain is malformed
+    static int parse_payload(const struct click_xia* hdr, size_t len, uint8_t* nxt);
+
+    // cache the payload offset and type of p's XIA header in its annotations
+    static void set_payload_anno(Packet* p, size_t offset, uint8_t nxt);
 
 private:
     const struct click_xia* _hdr;
+    uint16_t _payload_off;                  // payload offset from _hdr, 0 if unknown
+    uint8_t _payload_nxt;
+
+    const uint8_t* walk_payload(uint8_t* nxt) const;
 
-    inline XIAHeader() : _hdr(NULL) { }     // for helping WritableXIAHeader hide dangerous construction
+    inline XIAHeader() : _hdr(NULL), _payload_off(0) { }    // for helping WritableXIAHeader hide dangerous construction
 
     friend class WritableXIAHeader;
 };
@@ -118,19 +134,20 @@ private:
 
 inline
 XIAHeader::XIAHeader(const XIAHeader& r)
-    : _hdr(r._hdr)
+    : _hdr(r._hdr), _payload_off(r._payload_off), _payload_nxt(r._payload_nxt)
 {
 }
 
 inline
 XIAHeader::XIAHeader(const struct click_xia* hdr)
-    : _hdr(hdr)
+    : _hdr(hdr), _payload_off(0)
 {
 }
 
 inline
 XIAHeader::XIAHeader(const Packet* p)
-    : _hdr(p->xia_header())
+    : _hdr(p->xia_header()), _payload_off(XIA_PAYLOAD_OFFSET_ANNO(p)),
+      _payload_nxt(XIA_PAYLOAD_NXT_ANNO(p))
 {
 }
 
@@ -176,15 +193,36 @@ XIAHeader::hlim() const
     return _hdr->hlim;
 }
 
+inline XIAPathView
+XIAHeader::dst_path_view() const
+{
+    return XIAPathView(_hdr->node, _hdr->dnode);
+}
+
+inline XIAPathView
+XIAHeader::src_path_view() const
+{
+    return XIAPathView(_hdr->node + _hdr->dnode, _hdr->snode);
+}
+
 inline const uint8_t*
 XIAHeader::next_header() const
 {
     return reinterpret_cast<const uint8_t*>(_hdr) + hdr_size();
 }
 
+inline const uint8_t*
+XIAHeader::payload() const
+{
+    if (_payload_off)
+        return reinterpret_cast<const uint8_t*>(_hdr) + _payload_off;
+    uint8_t nxt;
+    return walk_payload(&nxt);
+}
+
 inline
 WritableXIAHeader::WritableXIAHeader(const WritableXIAHeader& r)
-    : XIAHeader(r._hdr)
+    : XIAHeader(r)
 {
 }
 
@@ -209,7 +247,10 @@ WritableXIAHeader::hdr()
 inline void
 WritableXIAHeader::set_nxt(uint8_t nxt)
 {
+    // the extension header chain changes; a cached payload offset in the
+    // packet's annotations must be cleared by the caller
     const_cast<struct click_xia*>(_hdr)->nxt = nxt;
+    _payload_off = 0;
 }
 
 inline void
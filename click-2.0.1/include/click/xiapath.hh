@@ -115,5 +115,77 @@ private:
     handle_t _dst;
 };
 
+// A read-only, allocation-free view of a path in an XIA header.
+// Nodes and handles are numbered as XIAPath::parse_node() numbers them:
+// the header nodes come first, the last of them being the destination, and
+// the source node follows them with no XID and the header's starting edges.
+class XIAPathView { public:
+    typedef XIAPath::handle_t handle_t;
+
+    // handles of the nodes an edge set leads to
+    class Edges { public:
+        int size() const                        { return _n; }
+        handle_t operator[](int i) const        { return _h[i]; }
+      private:
+        handle_t _h[CLICK_XIA_XID_EDGE_NUM];
+        int _n;
+        friend class XIAPathView;
+    };
+
+    // view n (> 0) nodes in the XIA header format
+    inline XIAPathView(const struct click_xia_xid_node* node, size_t n);
+
+    // number of nodes, including the source node
+    size_t size() const                         { return _n + 1; }
+
+    // get the handle of the source node
+    handle_t source_node() const                { return _n; }
+
+    // get the handle of the destination node
+    handle_t destination_node() const           { return _n - 1; }
+
+    // get XID of the node
+    inline XID xid(handle_t node) const;
+
+    // get handles of connected (next) nodes to the node
+    inline Edges next_nodes(handle_t node) const;
+
+private:
+    const struct click_xia_xid_node* _node;
+    size_t _n;
+};
+
+inline
+XIAPathView::XIAPathView(const struct click_xia_xid_node* node, size_t n)
+    : _node(node), _n(n)
+{
+}
+
+inline XID
+XIAPathView::xid(handle_t node) const
+{
+    if (node == source_node())
+        return XID();
+    return XID(_node[node].xid);
+}
+
+inline XIAPathView::Edges
+XIAPathView::next_nodes(handle_t node) const
+{
+    Edges e;
+    e._n = 0;
+    // the destination's edges belong to the source node
+    if (node == destination_node())
+        return e;
+    if (node == source_node())
+        node = destination_node();
+    for (int j = 0; j < CLICK_XIA_XID_EDGE_NUM; j++) {
+        size_t idx = _node[node].edge[j].idx;
+        if (idx != CLICK_XIA_XID_EDGE_UNUSED)
+            e._h[e._n++] = idx;
+    }
+    return e;
+}
+
 CLICK_ENDDECLS
 #endif
@@ -5,7 +5,6 @@
 #include <click/glue.hh>
 #include <clicknet/xia.h>
 #include <click/packet.hh>
-#include <click/hashtable.hh>
 #include <click/xiaheader.hh>
 #include <click/xiaextheader.hh>
 #include <click/xid.hh>
@@ -18,17 +17,21 @@ class TransportHeader : public XIAGenericExtHeader { public:
     TransportHeader(const struct click_xia_ext* hdr) :XIAGenericExtHeader(hdr) {};
     TransportHeader(const Packet* p):XIAGenericExtHeader(p) {};
 
-    //uint8_t opcode() { if (!exists(OPCODE)) return 0 ; return *(const uint8_t*)_map[OPCODE].data();};  
-    uint8_t type() { if (!exists(TYPE)) return 0 ; return *(const uint8_t*)_map[TYPE].data();}; 
+    //uint8_t opcode() const { return get<uint8_t>(OPCODE); }
+    uint8_t type() const { return get<uint8_t>(TYPE); }
     
-    bool exists(uint8_t key) { return (_map.find(key)!=_map.end()); }
-    
-    uint8_t pkt_info() { if (!exists(PKT_INFO)) return 0 ; return *(const uint8_t*)_map[PKT_INFO].data();}; 
-    //XID src_xid() { if (!exists(SRC_XID)) return 0; return *(const XID*)_map[SRC_XID].data();};  
-    //XID dst_xid() { if (!exists(DST_XID)) return 0; return *(const XID*)_map[DST_XID].data();};  
-    uint32_t seq_num() { if (!exists(SEQ_NUM)) return 0; return *(const uint32_t*)_map[SEQ_NUM].data();};  
-    uint32_t ack_num() { if (!exists(ACK_NUM)) return 0; return *(const uint32_t*)_map[ACK_NUM].data();};  
-    uint16_t length() { if (!exists(LENGTH)) return 0; return *(const uint16_t*)_map[LENGTH].data();};  
+    uint8_t pkt_info() const { return get<uint8_t>(PKT_INFO); }
+    //XID src_xid() const { return get<XID>(SRC_XID); }
+    //XID dst_xid() const { return get<XID>(DST_XID); }
+    uint32_t seq_num() const { return get<uint32_t>(SEQ_NUM); }
+    uint32_t ack_num() const { return get<uint32_t>(ACK_NUM); }
+    uint16_t length() const { return get<uint16_t>(LENGTH); }
+
+    // selective acknowledgements: each block [left, right) names packets
+    // the receiver holds beyond ack_num()
+    int sack_blocks() const { return value_length(SACK) / (2 * sizeof(uint32_t)); }
+    uint32_t sack_left(int i) const { return sack_edge(2 * i); }
+    uint32_t sack_right(int i) const { return sack_edge(2 * i + 1); }
     
     //uint16_t offset() { if (!exists(OFFSET)) return 0; return *(const uint16_t*)_map[OFFSET].data();};  
     //uint32_t chunk_offset() { if (!exists(CHUNK_OFFSET)) return 0; return *(const uint32_t*)_map[CHUNK_OFFSET].data();};  
@@ -36,11 +39,19 @@ class TransportHeader : public XIAGenericExtHeader { public:
     //uint32_t chunk_length() { if (!exists(CHUNK_LENGTH)) return 0; return *(const uint32_t*)_map[CHUNK_LENGTH].data();};  
     
 
-    enum { TYPE, PKT_INFO, SRC_XID, DST_XID, SEQ_NUM, ACK_NUM, LENGTH}; 
+    enum { TYPE, PKT_INFO, SRC_XID, DST_XID, SEQ_NUM, ACK_NUM, LENGTH, SACK};
+    enum { MAX_SACK_BLOCKS = 4 };
     enum { XSOCK_STREAM=1, XSOCK_DGRAM, XSOCK_RAW, XSOCK_CHUNK};
     enum { SYN=1, SYNACK, DATA, ACK, FIN};
     
     //enum { OP_REQUEST=1, OP_RESPONSE, OP_LOCAL_PUTCID, OP_REDUNDANT_REQUEST};
+
+  private:
+    uint32_t sack_edge(int i) const {
+        uint32_t v;
+        memcpy(&v, value(SACK) + i * sizeof(uint32_t), sizeof(v));
+        return v;
+    }
 };
 
 class TransportHeaderEncap : public XIAGenericExtHeaderEncap { public:
@@ -51,6 +62,9 @@ class TransportHeaderEncap : public XIAGenericExtHeaderEncap { public:
     //TransportHeaderEncap(char type, char pkt_info, XID src_xid, XID dst_xid, uint32_t seq_num, uint32_t ack_num, uint16_t length);
     TransportHeaderEncap(char type, char pkt_info, uint32_t seq_num, uint32_t ack_num, uint16_t length);
 
+    // add @a nblocks SACK blocks, given as left and right edges in @a edges
+    void set_sack(const uint32_t *edges, int nblocks);
+
     //static TransportHeaderEncap* MakeRequestHeader() { return new TransportHeaderEncap(TransportHeader::OP_REQUEST,0,0); };
     //static TransportHeaderEncap* MakeRPTRequestHeader() { return new TransportHeaderEncap(TransportHeader::OP_REDUNDANT_REQUEST,0,0); };
     
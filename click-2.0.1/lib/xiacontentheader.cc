@@ -15,27 +15,24 @@ CLICK_DECLS
 ContentHeaderEncap::ContentHeaderEncap(uint16_t offset, uint32_t chunk_offset, 
         uint16_t length, uint32_t chunk_length, char opcode, 
         uint32_t contextID, uint32_t ttl, uint32_t cacheSize, uint32_t cachePolicy) {
-    this->map()[ContentHeader::OFFSET]= String((const char*)&offset, sizeof(offset));
-    this->map()[ContentHeader::CHUNK_OFFSET]= String((const char*)&chunk_offset, sizeof(chunk_offset));
-    this->map()[ContentHeader::LENGTH]= String((const char*)&length, sizeof(length));
-    this->map()[ContentHeader::CHUNK_LENGTH]= String((const char*)&chunk_length, sizeof(chunk_length));
-    this->map()[ContentHeader::OPCODE]= String((const char*)&opcode, sizeof(uint8_t));
+    this->set(ContentHeader::OFFSET, &offset, sizeof(offset));
+    this->set(ContentHeader::CHUNK_OFFSET, &chunk_offset, sizeof(chunk_offset));
+    this->set(ContentHeader::LENGTH, &length, sizeof(length));
+    this->set(ContentHeader::CHUNK_LENGTH, &chunk_length, sizeof(chunk_length));
+    this->set(ContentHeader::OPCODE, &opcode, sizeof(uint8_t));
     
-    this->map()[ContentHeader::CONTEXT_ID]= String((const char*)&contextID, 
-            sizeof(contextID));
-    this->map()[ContentHeader::TTL]= String((const char*)&ttl, sizeof(ttl));
-    this->map()[ContentHeader::CACHE_SIZE]= String((const char*)&cacheSize, 
-            sizeof(cacheSize));
-    this->map()[ContentHeader::CACHE_POLICY]= String((const char*)&cachePolicy, 
-            sizeof(cachePolicy));
+    this->set(ContentHeader::CONTEXT_ID, &contextID, sizeof(contextID));
+    this->set(ContentHeader::TTL, &ttl, sizeof(ttl));
+    this->set(ContentHeader::CACHE_SIZE, &cacheSize, sizeof(cacheSize));
+    this->set(ContentHeader::CACHE_POLICY, &cachePolicy, sizeof(cachePolicy));
     this->update();
 }
 
 ContentHeaderEncap::ContentHeaderEncap(uint8_t opcode, uint32_t chunk_offset, uint16_t length)
 {
-    this->map()[ContentHeader::CHUNK_OFFSET]= String((const char*)&chunk_offset, sizeof(chunk_offset));
-    this->map()[ContentHeader::LENGTH]= String((const char*)&length, sizeof(length));
-    this->map()[ContentHeader::OPCODE]= String((const char*)&opcode, sizeof(uint8_t));
+    this->set(ContentHeader::CHUNK_OFFSET, &chunk_offset, sizeof(chunk_offset));
+    this->set(ContentHeader::LENGTH, &length, sizeof(length));
+    this->set(ContentHeader::OPCODE, &opcode, sizeof(uint8_t));
     this->update();
 }
 
@@ -20,7 +20,7 @@ CLICK_DECLS
 XIAGenericExtHeader::XIAGenericExtHeader(const XIAGenericExtHeader& r)
     : _hdr(r._hdr)
 {
-    populate_map();
+    memcpy(_off, r._off, sizeof(_off));
 }
 
 XIAGenericExtHeader::XIAGenericExtHeader(const struct click_xia_ext* hdr)
@@ -38,10 +38,11 @@ XIAGenericExtHeader::XIAGenericExtHeader(const Packet* p)
 void
 XIAGenericExtHeader::populate_map()
 {
-    _map.clear();
+    memset(_off, 0, sizeof(_off));
 
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(_hdr);
     const uint8_t* d = _hdr->data;
-    const uint8_t* end = reinterpret_cast<const uint8_t*>(_hdr) + _hdr->hlen;
+    const uint8_t* end = base + _hdr->hlen;
     while (d < end) {
         uint8_t kv_len = *d++;
 
@@ -55,9 +56,9 @@ XIAGenericExtHeader::populate_map()
             break;
         }
 
+        // a later duplicate key wins
         uint8_t key = *d;
-        String value(reinterpret_cast<const char*>(d + 1), kv_len - 1);
-        _map[key] = value;
+        _off[key] = d + 1 - base;
         d += kv_len;
     }
 }
@@ -78,39 +79,56 @@ WritableXIAGenericExtHeader::WritableXIAGenericExtHeader(WritablePacket* p)
 }
 
 XIAGenericExtHeaderEncap::XIAGenericExtHeaderEncap()
+    : _hdr(reinterpret_cast<struct click_xia_ext*>(_buf)), _vals_len(0)
 {
     const size_t size = sizeof(struct click_xia_ext);
-    _hdr = reinterpret_cast<struct click_xia_ext*>(new uint8_t[size]); 
     memset(_hdr, 0, size);
     _hdr->nxt = CLICK_XIA_NXT_NO;
     _hdr->hlen = size;
+    memset(_vlen, NO_VALUE, sizeof(_vlen));
     assert(hlen() == size);
 }
 
 XIAGenericExtHeaderEncap::XIAGenericExtHeaderEncap(const XIAGenericExtHeaderEncap& r)
+    : _hdr(reinterpret_cast<struct click_xia_ext*>(_buf))
 {
-    const size_t size = r.hlen();
-    _hdr = reinterpret_cast<struct click_xia_ext*>(new uint8_t[size]); 
-    memcpy(_hdr, r._hdr, size);
-    _map = r._map;
-    assert(hlen() == size);
+    copy(r);
+}
+
+XIAGenericExtHeaderEncap&
+XIAGenericExtHeaderEncap::operator=(const XIAGenericExtHeaderEncap& r)
+{
+    if (&r != this)
+        copy(r);
+    return *this;
 }
 
 XIAGenericExtHeaderEncap::~XIAGenericExtHeaderEncap()
 {
-    delete [] reinterpret_cast<uint8_t*>(_hdr);
-    _hdr = NULL;
 }
 
 XIAGenericExtHeaderEncap::XIAGenericExtHeaderEncap(const XIAGenericExtHeader& r)
+    : _hdr(reinterpret_cast<struct click_xia_ext*>(_buf)), _vals_len(0)
 {
     const size_t size = r.hlen();
-    _hdr = reinterpret_cast<struct click_xia_ext*>(new uint8_t[size]); 
     memcpy(_hdr, r.hdr(), size);
-    _map = r.map();
+    memset(_vlen, NO_VALUE, sizeof(_vlen));
+    for (int key = 0; key < 256; key++)
+        if (r.exists(key))
+            set(key, r.value(key), r.value_length(key));
     assert(hlen() == size);
 }
 
+void
+XIAGenericExtHeaderEncap::copy(const XIAGenericExtHeaderEncap& r)
+{
+    memcpy(_buf, r._buf, r.hlen());
+    memcpy(_vlen, r._vlen, sizeof(_vlen));
+    memcpy(_voff, r._voff, sizeof(_voff));
+    memcpy(_vals, r._vals, r._vals_len);
+    _vals_len = r._vals_len;
+}
+
 const struct click_xia_ext*
 XIAGenericExtHeaderEncap::hdr() const
 {
@@ -135,56 +153,52 @@ XIAGenericExtHeaderEncap::set_nxt(uint8_t nxt)
     _hdr->nxt = nxt;
 }
 
+void
+XIAGenericExtHeaderEncap::set(uint8_t key, const void* value, size_t len)
+{
+    if (len >= MAX_HLEN - 1) {
+        click_chatter("too long value for key %d", key);
+        return;
+    }
+    // a replaced value keeps its old space; headers are built once
+    if (_vals_len + len > MAX_HLEN) {
+        click_chatter("too large key-value map");
+        return;
+    }
+    memcpy(_vals + _vals_len, value, len);
+    _voff[key] = _vals_len;
+    _vlen[key] = len;
+    _vals_len += len;
+}
+
 void
 XIAGenericExtHeaderEncap::update()
 {
+    // entries go out in key order, right after the fixed header fields
     size_t size = sizeof(struct click_xia_ext);
-    HashTable<uint8_t, String>::const_iterator it = _map.begin();
-    size_t count = 0;
-    size_t padding = 0;
-    for (; it != _map.end(); ++it) {
-        if ((*it).second.length() >= 255 - 1) {   // skip too long value
-            click_chatter("too long value for key %d", (*it).first);
+    for (int key = 0; key < 256; key++) {
+        if (_vlen[key] == NO_VALUE)
             continue;
-        }
-        size_t new_size = size + offsetof(struct click_xia_ext, data) + (*it).second.length();
-        if (new_size >= 255) {
+        size_t len = _vlen[key];
+        size_t new_size = size + offsetof(struct click_xia_ext, data) + len;
+        // leave room to pad to a multiple of 4 within hlen
+        if (new_size > (MAX_HLEN & ~3)) {
             click_chatter("too large key-value map");
             break;
         }
-        size = new_size;
-        count++;
-    }
-    if ((size & 3) != 0) {
-        padding = 4 - (size & 3);
-        size += padding;
-    }
-
-    click_xia_ext* new_hdr = reinterpret_cast<struct click_xia_ext*>(new uint8_t[size]);
-
-    // preserve the current header content except key-value map
-    memcpy(new_hdr, _hdr, sizeof(struct click_xia_ext));
-
-    // update the new header
-    new_hdr->hlen = size;
-
-    uint8_t* d = new_hdr->data;
-    for (it = _map.begin(); it != _map.end() && count > 0; ++it, count--) {
-        if ((*it).second.length() >= 255 - 1)   // skip too long value
-            continue;
+        uint8_t* d = _buf + size;
         // key-value length
-        *d++ = 1 + (*it).second.length();
+        *d++ = 1 + len;
         // key
-        *d++ = (*it).first;
+        *d++ = key;
         // value
-        memcpy(d, (*it).second.data(), (*it).second.length());
-        d += (*it).second.length();
+        memcpy(d, _vals + _voff[key], len);
+        size = new_size;
     }
     // padding
-    memset(d, 0, padding);
-
-    delete [] reinterpret_cast<uint8_t*>(_hdr);
-    _hdr = new_hdr;
+    size_t padding = (4 - (size & 3)) & 3;
+    memset(_buf + size, 0, padding);
+    _hdr->hlen = size + padding;
 }
 
 WritablePacket*
@@ -201,6 +215,7 @@ XIAGenericExtHeaderEncap::encap(Packet* p_in) const
     */
 
     memcpy(p->data(), _hdr, hlen());  // copy the header
+    SET_XIA_PAYLOAD_OFFSET_ANNO(p, 0);    // the chain changed under any cached offset
 
     return p;
 }
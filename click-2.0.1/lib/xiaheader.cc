@@ -33,7 +33,7 @@ XIAHeader::src_path() const
 
 /* Returns layer 3 payload (this includes transport header) */
 const uint8_t*
-XIAHeader::payload() const
+XIAHeader::walk_payload(uint8_t* nxt_out) const
 {
     uint8_t nxt = _hdr->nxt;
     const uint8_t* p = next_header();
@@ -47,9 +47,55 @@ XIAHeader::payload() const
 		}
 		p += exthdr->hlen;
     }
+    *nxt_out = nxt;
     return p;
 }
 
+uint8_t
+XIAHeader::payload_nxt() const
+{
+    if (_payload_off)
+        return _payload_nxt;
+    uint8_t nxt;
+    walk_payload(&nxt);
+    return nxt;
+}
+
+int
+XIAHeader::parse_payload(const struct click_xia* hdr, size_t len, uint8_t* nxt_out)
+{
+    if (len < hdr_size(0))
+        return -1;
+    size_t off = hdr_size(hdr->dnode + hdr->snode);
+    if (off > len)
+        return -1;
+
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(hdr);
+    uint8_t nxt = hdr->nxt;
+    while (nxt < CLICK_XIA_NXT_NO) {
+        if (off + sizeof(struct click_xia_ext) > len)
+            return -1;
+        const struct click_xia_ext* exthdr = reinterpret_cast<const struct click_xia_ext*>(base + off);
+        if (exthdr->hlen < sizeof(struct click_xia_ext))
+            return -1;
+        nxt = exthdr->nxt;
+        off += exthdr->hlen;
+        if (off > len)
+            return -1;
+    }
+    if (off > 0xFFFF)
+        return -1;
+    *nxt_out = nxt;
+    return off;
+}
+
+void
+XIAHeader::set_payload_anno(Packet* p, size_t offset, uint8_t nxt)
+{
+    SET_XIA_PAYLOAD_OFFSET_ANNO(p, offset);
+    SET_XIA_PAYLOAD_NXT_ANNO(p, nxt);
+}
+
 
 XIAHeaderEncap::XIAHeaderEncap()
 {
@@ -159,6 +205,8 @@ XIAHeaderEncap::encap(Packet* p_in, bool adjust_plen) const
     if (adjust_plen)
         reinterpret_cast<struct click_xia*>(p->data())->plen = htons(payload_len);
     p->set_xia_header(reinterpret_cast<struct click_xia*>(p->data()), header_len);
+    // the annotation may describe a header this packet carried before
+    SET_XIA_PAYLOAD_OFFSET_ANNO(p, 0);
     Timestamp now = Timestamp::now();   
     p->timestamp_anno() = now;
 
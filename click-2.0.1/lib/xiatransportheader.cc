@@ -13,22 +13,31 @@
 CLICK_DECLS
 
 TransportHeaderEncap::TransportHeaderEncap(char type, char pkt_info, uint32_t seq_num, uint32_t ack_num, uint16_t length) {
-    this->map()[TransportHeader::TYPE]= String((const char*)&type, sizeof(type));
-    this->map()[TransportHeader::PKT_INFO]= String((const char*)&pkt_info, sizeof(pkt_info));
-    //this->map()[TransportHeader::SRC_XID]= String((const char*)&src_xid, sizeof(src_xid));
-    //this->map()[TransportHeader::DST_XID]= String((const char*)&dst_xid, sizeof(dst_xid));
-    this->map()[TransportHeader::SEQ_NUM]= String((const char*)&seq_num, sizeof(seq_num));
-    this->map()[TransportHeader::ACK_NUM]= String((const char*)&ack_num, sizeof(ack_num));        
-    this->map()[TransportHeader::LENGTH]= String((const char*)&length, sizeof(length));
+    this->set(TransportHeader::TYPE, &type, sizeof(type));
+    this->set(TransportHeader::PKT_INFO, &pkt_info, sizeof(pkt_info));
+    //this->set(TransportHeader::SRC_XID, &src_xid, sizeof(src_xid));
+    //this->set(TransportHeader::DST_XID, &dst_xid, sizeof(dst_xid));
+    this->set(TransportHeader::SEQ_NUM, &seq_num, sizeof(seq_num));
+    this->set(TransportHeader::ACK_NUM, &ack_num, sizeof(ack_num));        
+    this->set(TransportHeader::LENGTH, &length, sizeof(length));
     this->update();
 }
 
+void TransportHeaderEncap::set_sack(const uint32_t *edges, int nblocks) {
+    if (nblocks > TransportHeader::MAX_SACK_BLOCKS)
+        nblocks = TransportHeader::MAX_SACK_BLOCKS;
+    if (nblocks > 0) {
+        this->set(TransportHeader::SACK, edges, nblocks * 2 * sizeof(uint32_t));
+        this->update();
+    }
+}
+
 /*
 TransportHeaderEncap::TransportHeaderEncap(uint8_t opcode, uint32_t chunk_offset, uint16_t length)
 {
-    this->map()[TransportHeader::CHUNK_OFFSET]= String((const char*)&chunk_offset, sizeof(chunk_offset));
-    this->map()[TransportHeader::LENGTH]= String((const char*)&length, sizeof(length));
-    this->map()[TransportHeader::OPCODE]= String((const char*)&opcode, sizeof(uint8_t));
+    this->set(TransportHeader::CHUNK_OFFSET, &chunk_offset, sizeof(chunk_offset));
+    this->set(TransportHeader::LENGTH, &length, sizeof(length));
+    this->set(TransportHeader::OPCODE, &opcode, sizeof(uint8_t));
     this->update();
 }
 */